@@ -0,0 +1,349 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "block_compress.h"
+#include "dds.h"
+#include "image.h"
+#include "mapped_file.h"
+#include "mipmap.h"
+#include "texture_file.h"
+#include "virtual_texture_file.h"
+
+//Offline processing of texture files, so the work doesn't have to be done when the app loads them
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void PrintUsage()
+{
+	std::cout << "usage: AssetTool <command> ...\n"
+		<< "  mips <in.tga> <out> [options]   writes the mip chain of in.tga as <out>_<level>.tga\n"
+		<< "    --filter <f>                  box (default) or kaiser\n"
+		<< "    --linear                      the colors aren't sRGB, e.g. normal maps and masks\n"
+		<< "  compress <in.tga> <out.dds> [options]\n"
+		<< "    --format <f>                  bc1, bc3, bc4, bc5 or bc7 (default)\n"
+		<< "    --quality <q>                 fast, normal (default) or best\n"
+		<< "    --mips                        also compress the mip chain, takes --filter and --linear like mips\n"
+		<< "  info <file>                     checks a KTX2 or DDS file the way the app loads it and lists its levels\n"
+		<< "  vtex <in.tga> <out.vtex> [options]   cuts the image and its mips into tiles for a VirtualTexture\n"
+		<< "    --tile <n>                    pixels per tile side, a power of two, 128 by default\n"
+		<< "    --border <n>                  pixels repeated around every tile for filtering, 4 by default\n"
+		<< "    takes --filter and --linear like mips\n";
+}
+
+static bool ParseMipOption(int argc, char** argv, int& i, MipOptions& options)
+{
+	std::string arg = argv[i];
+	if (arg == "--filter" && i + 1 < argc)
+	{
+		std::string filter = argv[++i];
+		if (filter != "box" && filter != "kaiser")
+			return false;
+		options.filter = filter == "box" ? MipFilter::Box : MipFilter::Kaiser;
+		return true;
+	}
+	if (arg == "--linear")
+	{
+		options.srgb = false;
+		return true;
+	}
+	return false;
+}
+
+//PSNR over the channels the format keeps
+static double Psnr(const Image& expected, const Image& actual, BlockFormat format)
+{
+	unsigned int channels = format == BlockFormat::BC4 ? 1 : format == BlockFormat::BC5 ? 2 : format == BlockFormat::BC1 ? 3 : 4;
+	double sum = 0.0;
+	for (size_t i = 0; i < expected.pixels.size(); i++)
+	{
+		for (unsigned int c = 0; c < channels; c++)
+		{
+			int delta = (int)((expected.pixels[i] >> (c * 8)) & 0xFF) - (int)((actual.pixels[i] >> (c * 8)) & 0xFF);
+			sum += delta * delta;
+		}
+	}
+	double mse = sum / ((double)expected.pixels.size() * channels);
+	return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+static int Mips(int argc, char** argv)
+{
+	std::string input, output;
+	MipOptions options;
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") == 0)
+		{
+			if (!ParseMipOption(argc, argv, i, options))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (input.empty())
+			input = arg;
+		else if (output.empty())
+			output = arg;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (output.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	Image image;
+	if (!LoadTGA(input, image))
+	{
+		std::cout << "can't read " << input << "\n";
+		return 1;
+	}
+
+	std::vector<Image> levels;
+	auto start = std::chrono::high_resolution_clock::now();
+	GenerateMipmaps(image, options, levels);
+	double ms = Milliseconds(start);
+
+	for (unsigned int i = 0; i < levels.size(); i++)
+	{
+		std::string path = output + "_" + std::to_string(i) + ".tga";
+		if (!SaveTGA(path, levels[i]))
+		{
+			std::cout << "can't write " << path << "\n";
+			return 1;
+		}
+	}
+
+	std::cout << input << ": " << levels.size() << " levels from " << image.width << "x" << image.height << " in "
+		<< std::fixed << std::setprecision(2) << ms << " ms (simd: " << SimdLevelName(GetSimdLevel()) << ")\n";
+	return 0;
+}
+
+static int Compress(int argc, char** argv)
+{
+	std::string input, output;
+	BlockOptions options;
+	MipOptions mipOptions;
+	bool mips = false;
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool valid = true;
+		if (arg == "--format" && i + 1 < argc)
+		{
+			std::string format = argv[++i];
+			const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+			valid = false;
+			for (BlockFormat f : formats)
+			{
+				if (format == BlockFormatName(f))
+				{
+					options.format = f;
+					valid = true;
+				}
+			}
+		}
+		else if (arg == "--quality" && i + 1 < argc)
+		{
+			std::string quality = argv[++i];
+			valid = quality == "fast" || quality == "normal" || quality == "best";
+			options.quality = quality == "fast" ? BlockQuality::Fast : quality == "best" ? BlockQuality::Best : BlockQuality::Normal;
+		}
+		else if (arg == "--mips")
+			mips = true;
+		else if (arg.compare(0, 2, "--") == 0)
+			valid = ParseMipOption(argc, argv, i, mipOptions);
+		else if (input.empty())
+			input = arg;
+		else if (output.empty())
+			output = arg;
+		else
+			valid = false;
+
+		if (!valid)
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (output.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	Image image;
+	if (!LoadTGA(input, image))
+	{
+		std::cout << "can't read " << input << "\n";
+		return 1;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<Image> levels;
+	if (mips)
+		GenerateMipmaps(image, mipOptions, levels);
+	else
+		levels.push_back(image);
+
+	std::vector<CompressedImage> compressed(levels.size());
+	size_t sourceBytes = 0, compressedBytes = 0;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		CompressImage(levels[i], options, compressed[i]);
+		compressed[i].srgb = mipOptions.srgb;
+		sourceBytes += levels[i].pixels.size() * sizeof(unsigned int);
+		compressedBytes += compressed[i].data.size();
+	}
+	double ms = Milliseconds(start);
+
+	if (!SaveDDS(output, compressed))
+	{
+		std::cout << "can't write " << output << "\n";
+		return 1;
+	}
+
+	Image decoded;
+	DecompressImage(compressed[0], decoded);
+	const char* qualities[] = { "fast", "normal", "best" };
+	std::cout << input << ": " << BlockFormatName(options.format) << " " << qualities[(int)options.quality] << ", "
+		<< levels.size() << (levels.size() > 1 ? " levels, " : " level, ") << sourceBytes / 1024 << " KB to " << compressedBytes / 1024 << " KB in "
+		<< std::fixed << std::setprecision(1) << ms << " ms, PSNR " << std::setprecision(2) << Psnr(image, decoded, options.format)
+		<< " dB (simd: " << SimdLevelName(GetSimdLevel()) << ")\n";
+	return 0;
+}
+
+static int Info(int argc, char** argv)
+{
+	if (argc != 1)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	MappedFile file;
+	if (!file.open(argv[0]))
+	{
+		std::cout << "can't read " << argv[0] << "\n";
+		return 1;
+	}
+
+	TextureLevels levels;
+	std::string error;
+	if (!ParseTextureFile(file.data(), file.size(), levels, error))
+	{
+		std::cout << argv[0] << ": " << error << "\n";
+		return 1;
+	}
+
+	std::cout << argv[0] << ": " << (levels.compressed ? BlockFormatName(levels.format) : "rgba8") << (levels.srgb ? " srgb, " : ", ")
+		<< levels.levels.size() << (levels.levels.size() > 1 ? " levels\n" : " level\n");
+	for (size_t i = 0; i < levels.levels.size(); i++)
+	{
+		const TextureLevelData& level = levels.levels[i];
+		std::cout << "  " << i << ": " << level.width << "x" << level.height << ", " << level.size << " bytes at "
+			<< level.data - file.data() << "\n";
+	}
+	return 0;
+}
+
+static int VirtualTextureCommand(int argc, char** argv)
+{
+	std::string input, output;
+	MipOptions options;
+	unsigned int tileSize = 128, border = 4;
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool valid = true;
+		if (arg == "--tile" && i + 1 < argc)
+			tileSize = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--border" && i + 1 < argc)
+			border = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		else if (arg.compare(0, 2, "--") == 0)
+			valid = ParseMipOption(argc, argv, i, options);
+		else if (input.empty())
+			input = arg;
+		else if (output.empty())
+			output = arg;
+		else
+			valid = false;
+
+		if (!valid)
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (output.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	Image image;
+	if (!LoadTGA(input, image))
+	{
+		std::cout << "can't read " << input << "\n";
+		return 1;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!BuildVirtualTexture(image, tileSize, border, options, output))
+	{
+		std::cout << "can't write " << output << "\n";
+		return 1;
+	}
+	double ms = Milliseconds(start);
+
+	VirtualTextureFile file;
+	std::string error;
+	if (!file.open(output, error))
+	{
+		std::cout << output << ": " << error << "\n";
+		return 1;
+	}
+	const VirtualTextureInfo& info = file.getInfo();
+	unsigned int tiles = 0;
+	for (unsigned int level = 0; level < info.levels; level++)
+		tiles += VirtualTilesAt(info.tilesX, level) * VirtualTilesAt(info.tilesY, level);
+	std::cout << input << ": " << info.tilesX << "x" << info.tilesY << " tiles of " << info.tileSize << " pixels, " << info.levels
+		<< " levels, " << tiles << " tiles in " << std::fixed << std::setprecision(1) << ms << " ms\n";
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string command = argv[1];
+	if (command == "mips")
+		return Mips(argc - 2, argv + 2);
+	if (command == "compress")
+		return Compress(argc - 2, argv + 2);
+	if (command == "info")
+		return Info(argc - 2, argv + 2);
+	if (command == "vtex")
+		return VirtualTextureCommand(argc - 2, argv + 2);
+
+	PrintUsage();
+	return 1;
+}
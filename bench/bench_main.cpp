@@ -0,0 +1,52 @@
+#include <cstring>
+#include <iostream>
+#include "benchmarks.h"
+
+struct Benchmark
+{
+	const char* name;
+	void (*run)();
+};
+
+static const Benchmark BENCHMARKS[] =
+{
+	{ "raster", RunRasterBenchmark },
+	{ "occlusion", RunOcclusionBenchmark },
+	{ "diff", RunDiffBenchmark },
+	{ "mipmap", RunMipmapBenchmark },
+	{ "compress", RunCompressBenchmark },
+	{ "math", RunMathBenchmark },
+	{ "transform", RunTransformBenchmark },
+	{ "culling", RunCullingBenchmark },
+	{ "bvh", RunBvhBenchmark },
+};
+
+//Runs the benchmarks named on the command line, or all of them without arguments
+int main(int argc, char** argv)
+{
+	bool ranAny = false;
+	for (const Benchmark& benchmark : BENCHMARKS)
+	{
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++)
+			if (std::strcmp(argv[i], benchmark.name) == 0)
+				selected = true;
+
+		if (!selected)
+			continue;
+
+		std::cout << "== " << benchmark.name << "\n";
+		benchmark.run();
+		ranAny = true;
+	}
+
+	if (!ranAny)
+	{
+		std::cout << "unknown benchmark, available:";
+		for (const Benchmark& benchmark : BENCHMARKS)
+			std::cout << " " << benchmark.name;
+		std::cout << "\n";
+		return 1;
+	}
+	return 0;
+}
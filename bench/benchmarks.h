@@ -0,0 +1,12 @@
+#pragma once
+
+//Every benchmark prints its own results to std::cout
+void RunRasterBenchmark();
+void RunOcclusionBenchmark();
+void RunDiffBenchmark();
+void RunMipmapBenchmark();
+void RunCompressBenchmark();
+void RunMathBenchmark();
+void RunTransformBenchmark();
+void RunCullingBenchmark();
+void RunBvhBenchmark();
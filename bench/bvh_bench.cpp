@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "benchmarks.h"
+#include "bvh.h"
+#include "math3d.h"
+
+//1M boxes over a 4 km square like the culling benchmark, every query is checked against a scan over all of them
+static const unsigned int OBJECTS = 1000000;
+static const float WORLD = 4000.0f;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static AABB RandomBox(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float x = (unit(rng) - 0.5f) * WORLD, z = (unit(rng) - 0.5f) * WORLD, y = unit(rng) * 50.0f;
+	float e[3] = { 0.5f + unit(rng) * 5.0f, 0.5f + unit(rng) * 10.0f, 0.5f + unit(rng) * 5.0f };
+	AABB box = { { x - e[0], y - e[1], z - e[2] }, { x + e[0], y + e[1], z + e[2] } };
+	return box;
+}
+
+//The same slab test as BVH::raycast, so the closest distances compare exactly
+static float IntersectBox(const float* origin, const float* inverse, float maxT, const AABB& box)
+{
+	float tMin = 0.0f, tMax = maxT;
+	for (int a = 0; a < 3; a++)
+	{
+		float t0 = (box.min[a] - origin[a]) * inverse[a];
+		float t1 = (box.max[a] - origin[a]) * inverse[a];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = t0 > tMin ? t0 : tMin;
+		tMax = t1 < tMax ? t1 : tMax;
+	}
+	return tMin <= tMax ? tMin : FLT_MAX;
+}
+
+//The baseline: every box against the ray
+static bool LinearRaycast(const std::vector<AABB>& boxes, const float origin[3], const float direction[3], float maxT, RayHit& hit)
+{
+	float inverse[3];
+	for (int a = 0; a < 3; a++)
+		inverse[a] = 1.0f / direction[a];
+
+	hit.id = 0xFFFFFFFFu;
+	hit.t = maxT;
+	for (unsigned int i = 0; i < (unsigned int)boxes.size(); i++)
+	{
+		float t = IntersectBox(origin, inverse, hit.t, boxes[i]);
+		if (t < hit.t || (t == hit.t && hit.id == 0xFFFFFFFFu))
+		{
+			hit.id = i;
+			hit.t = t;
+		}
+	}
+	return hit.id != 0xFFFFFFFFu;
+}
+
+static bool Overlaps(const AABB& a, const AABB& b)
+{
+	return a.min[0] <= b.max[0] && a.max[0] >= b.min[0] &&
+	       a.min[1] <= b.max[1] && a.max[1] >= b.min[1] &&
+	       a.min[2] <= b.max[2] && a.max[2] >= b.min[2];
+}
+
+static bool InsideFrustum(const Frustum& frustum, const AABB& box)
+{
+	float center[3], extent[3];
+	for (int a = 0; a < 3; a++)
+	{
+		center[a] = (box.min[a] + box.max[a]) * 0.5f;
+		extent[a] = (box.max[a] - box.min[a]) * 0.5f;
+	}
+	for (const Plane& plane : frustum.planes)
+	{
+		float distance = plane.nx * center[0] + plane.ny * center[1] + plane.nz * center[2] + plane.d;
+		float radius = std::fabs(plane.nx) * extent[0] + std::fabs(plane.ny) * extent[1] + std::fabs(plane.nz) * extent[2];
+		if (distance + radius < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+//Picking rays from a camera above the middle of the world to random points on the ground
+struct PickRay
+{
+	float origin[3];
+	float direction[3];
+};
+
+static std::vector<PickRay> MakeRays(std::mt19937& rng, unsigned int count)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<PickRay> rays(count);
+	for (PickRay& ray : rays)
+	{
+		float target[3] = { (unit(rng) - 0.5f) * 1000.0f, 0.0f, (unit(rng) - 0.5f) * 1000.0f };
+		ray.origin[0] = 0.0f;
+		ray.origin[1] = 150.0f;
+		ray.origin[2] = 0.0f;
+		float length = 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			ray.direction[a] = target[a] - ray.origin[a];
+			length += ray.direction[a] * ray.direction[a];
+		}
+		length = std::sqrt(length);
+		for (int a = 0; a < 3; a++)
+			ray.direction[a] /= length;
+	}
+	return rays;
+}
+
+//Ids differ only when two boxes are hit at exactly the same distance, which doesn't count as a mismatch
+static unsigned int CompareRaycasts(const BVH& bvh, const std::vector<PickRay>& rays, const std::vector<RayHit>& expected, const std::vector<bool>& expectedHits)
+{
+	unsigned int mismatches = 0;
+	for (unsigned int r = 0; r < (unsigned int)expected.size(); r++)
+	{
+		RayHit hit;
+		bool found = bvh.raycast(rays[r].origin, rays[r].direction, 2000.0f, hit);
+		if (found != expectedHits[r] || (found && hit.t != expected[r].t))
+			mismatches++;
+	}
+	return mismatches;
+}
+
+void RunBvhBenchmark()
+{
+	std::mt19937 rng(27);
+	std::vector<AABB> boxes(OBJECTS);
+	for (AABB& box : boxes)
+		box = RandomBox(rng);
+
+	//build
+	BVH bvh;
+	bvh.build(boxes.data(), OBJECTS); //warm up (pool threads, page faults)
+	const int buildRepeats = 5;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < buildRepeats; r++)
+		bvh.build(boxes.data(), OBJECTS);
+	double buildMs = Milliseconds(start) / buildRepeats;
+	std::cout << OBJECTS << " boxes, " << bvh.nodes().size() << " nodes, build " << std::fixed << std::setprecision(2) << buildMs << " ms\n";
+
+	//update + refit, the moved boxes stay close to where they were as in a frame of motion
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	std::cout << std::left << std::setw(16) << "moved %" << std::setw(14) << "ms/refit" << std::setw(14) << "vs build" << "\n";
+	const float fractions[] = { 0.01f, 0.1f, 1.0f };
+	for (float fraction : fractions)
+	{
+		unsigned int moved = (unsigned int)(OBJECTS * fraction);
+		const int repeats = 5;
+		double ms = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			std::vector<unsigned int> ids(moved);
+			for (unsigned int i = 0; i < moved; i++)
+				ids[i] = fraction >= 1.0f ? i : rng() % OBJECTS;
+			std::vector<AABB> updated(moved);
+			for (unsigned int i = 0; i < moved; i++)
+			{
+				updated[i] = boxes[ids[i]];
+				for (int a = 0; a < 3; a++)
+				{
+					float d = offset(rng);
+					updated[i].min[a] += d;
+					updated[i].max[a] += d;
+				}
+			}
+
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int i = 0; i < moved; i++)
+				bvh.update(ids[i], updated[i]);
+			bvh.refit();
+			ms += Milliseconds(start);
+
+			for (unsigned int i = 0; i < moved; i++)
+				boxes[ids[i]] = updated[i];
+		}
+		ms /= repeats;
+		std::cout << std::left << std::setw(16) << std::setprecision(1) << fraction * 100.0f << std::setw(14) << std::setprecision(3) << ms
+			<< std::setprecision(1) << buildMs / ms << "x faster\n";
+	}
+
+	//picking, the scan is slow enough that it only runs a tenth of the rays
+	const unsigned int RAYS = 10000, LINEAR_RAYS = RAYS / 10;
+	std::vector<PickRay> rays = MakeRays(rng, RAYS);
+	unsigned int hits = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (const PickRay& ray : rays)
+	{
+		RayHit hit;
+		hits += bvh.raycast(ray.origin, ray.direction, 2000.0f, hit);
+	}
+	double bvhUs = Milliseconds(start) * 1000.0 / RAYS;
+
+	std::vector<RayHit> expected(LINEAR_RAYS);
+	std::vector<bool> expectedHits(LINEAR_RAYS);
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int r = 0; r < LINEAR_RAYS; r++)
+		expectedHits[r] = LinearRaycast(boxes, rays[r].origin, rays[r].direction, 2000.0f, expected[r]);
+	double linearUs = Milliseconds(start) * 1000.0 / LINEAR_RAYS;
+
+	std::cout << std::left << std::setw(16) << "query" << std::setw(14) << "bvh us" << std::setw(14) << "linear us" << std::setw(12) << "speedup"
+		<< std::setw(14) << "results" << "mismatches" << "\n";
+	std::cout << std::left << std::setw(16) << "raycast" << std::setw(14) << std::setprecision(2) << bvhUs << std::setw(14) << linearUs
+		<< std::setw(12) << std::setprecision(0) << linearUs / bvhUs << std::setw(14) << hits << CompareRaycasts(bvh, rays, expected, expectedHits) << "\n";
+
+	//a 20 m selection box and the culling benchmark's camera, the results compared as sorted id lists
+	const unsigned int REGIONS = 1000;
+	std::vector<AABB> regions(REGIONS);
+	for (AABB& region : regions)
+	{
+		float x = (rng() % 1000) * 4.0f - WORLD * 0.5f, z = (rng() % 1000) * 4.0f - WORLD * 0.5f;
+		region = { { x - 10.0f, 0.0f, z - 10.0f }, { x + 10.0f, 50.0f, z + 10.0f } };
+	}
+	std::vector<unsigned int> found, inside;
+	unsigned long long results = 0;
+	unsigned int mismatches = 0;
+	double treeMs = 0.0, scanMs = 0.0;
+	for (const AABB& region : regions)
+	{
+		found.clear();
+		inside.clear();
+		start = std::chrono::high_resolution_clock::now();
+		bvh.queryAABB(region, found);
+		treeMs += Milliseconds(start);
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < OBJECTS; i++)
+			if (Overlaps(boxes[i], region))
+				inside.push_back(i);
+		scanMs += Milliseconds(start);
+
+		results += found.size();
+		std::sort(found.begin(), found.end());
+		mismatches += found != inside;
+	}
+	std::cout << std::left << std::setw(16) << "queryAABB" << std::setw(14) << std::setprecision(2) << treeMs * 1000.0 / regions.size()
+		<< std::setw(14) << scanMs * 1000.0 / regions.size() << std::setw(12) << std::setprecision(0) << scanMs / treeMs
+		<< std::setw(14) << results / regions.size() << mismatches << "\n";
+
+	Mat4 viewProjection = Mat4::Perspective(1.0472f, 16.0f / 9.0f, 0.5f, 1500.0f) * Mat4::LookAt(Vec3(0.0f, 20.0f, 0.0f), Vec3(100.0f, 15.0f, 30.0f), Vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = ExtractFrustum(viewProjection.data());
+	found.clear();
+	inside.clear();
+	start = std::chrono::high_resolution_clock::now();
+	bvh.queryFrustum(frustum, found);
+	treeMs = Milliseconds(start);
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < OBJECTS; i++)
+		if (InsideFrustum(frustum, boxes[i]))
+			inside.push_back(i);
+	scanMs = Milliseconds(start);
+	std::sort(found.begin(), found.end());
+	std::cout << std::left << std::setw(16) << "queryFrustum" << std::setw(14) << std::setprecision(2) << treeMs * 1000.0
+		<< std::setw(14) << scanMs * 1000.0 << std::setw(12) << std::setprecision(0) << scanMs / treeMs
+		<< std::setw(14) << found.size() << (found != inside) << "\n";
+}
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "benchmarks.h"
+#include "block_compress.h"
+
+static const unsigned int SIZE = 512;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RunCompressBenchmark()
+{
+	//gradients with a sprinkle of noise and hard edges, so blocks range from flat to busy
+	std::mt19937 rng(7);
+	Image image(SIZE, SIZE);
+	for (unsigned int y = 0; y < SIZE; y++)
+	{
+		for (unsigned int x = 0; x < SIZE; x++)
+		{
+			unsigned int r = x * 255 / SIZE, g = y * 255 / SIZE, b = ((x ^ y) & 64) ? 200 : 40;
+			if (rng() % 16 == 0)
+				r = rng() & 0xFF;
+			image.pixels[y * SIZE + x] = r | (g << 8) | (b << 16) | 0xFF000000u;
+		}
+	}
+
+	struct Case
+	{
+		const char* name;
+		BlockFormat format;
+		BlockQuality quality;
+	};
+	const Case cases[] =
+	{
+		{ "bc1 normal", BlockFormat::BC1, BlockQuality::Normal },
+		{ "bc3 normal", BlockFormat::BC3, BlockQuality::Normal },
+		{ "bc5 normal", BlockFormat::BC5, BlockQuality::Normal },
+		{ "bc7 fast", BlockFormat::BC7, BlockQuality::Fast },
+		{ "bc7 normal", BlockFormat::BC7, BlockQuality::Normal },
+	};
+
+	std::cout << std::left << std::setw(14) << "case" << std::setw(10) << "level" << std::setw(12) << "ms/image"
+		<< std::setw(12) << "Mpixels/s" << "\n";
+
+	SimdLevel best = GetSimdLevel();
+	CompressedImage compressed;
+	for (const Case& c : cases)
+	{
+		for (int level = 0; level <= (int)best; level++)
+		{
+			SetSimdLevel((SimdLevel)level);
+
+			BlockOptions options;
+			options.format = c.format;
+			options.quality = c.quality;
+
+			const int repeats = 3;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repeats; r++)
+				CompressImage(image, options, compressed);
+			double ms = Milliseconds(start) / repeats;
+
+			std::cout << std::left << std::setw(14) << c.name << std::setw(10) << SimdLevelName((SimdLevel)level)
+				<< std::setw(12) << std::fixed << std::setprecision(2) << ms
+				<< std::setw(12) << std::setprecision(1) << SIZE * SIZE / (ms * 1000.0) << "\n";
+		}
+		SetSimdLevel(best);
+	}
+}
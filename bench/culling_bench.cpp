@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "benchmarks.h"
+#include "culling.h"
+#include "math3d.h"
+#include "thread_pool.h"
+
+//1M objects over a 4 km square, three quarters boxes and the rest spheres, seen from the middle
+//The acceptance target is the whole million in under 1 ms
+static const unsigned int OBJECTS = 1000000;
+static const float WORLD = 4000.0f;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//The bounds as CullingSystem stores them, to call the kernels without it
+struct BenchBounds
+{
+	AlignedArray<float> arrays[7]; //center x y z, extents x y z, radius
+	AlignedArray<unsigned int> ids;
+
+	const float* soa[7];
+};
+
+//Splits [0, OBJECTS) in CullingSystem::CHUNK_SIZE chunks like cull() does, returns the visible count
+static unsigned int CullChunks(ThreadPool* pool, CullKernel kernel, const Frustum& frustum, const BenchBounds& bounds, std::vector<unsigned int>& out,
+	std::vector<unsigned int>& counts)
+{
+	unsigned int chunks = (OBJECTS + CullingSystem::CHUNK_SIZE - 1) / CullingSystem::CHUNK_SIZE;
+	auto run = [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int c = first; c < last; c++)
+		{
+			unsigned int begin = c * CullingSystem::CHUNK_SIZE;
+			unsigned int end = std::min(begin + CullingSystem::CHUNK_SIZE, OBJECTS);
+			counts[c] = kernel(frustum, bounds.soa, bounds.ids.data(), begin, end, out.data() + begin);
+		}
+	};
+	if (pool)
+		pool->parallelFor(chunks, 1, run);
+	else
+		run(0, chunks);
+
+	unsigned int total = 0;
+	for (unsigned int c = 0; c < chunks; c++)
+		total += counts[c];
+	return total;
+}
+
+void RunCullingBenchmark()
+{
+	std::mt19937 rng(26);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	CullingSystem system;
+	BenchBounds bounds;
+	for (AlignedArray<float>& array : bounds.arrays)
+		array.reserve(OBJECTS);
+	bounds.ids.reserve(OBJECTS);
+	for (unsigned int i = 0; i < OBJECTS; i++)
+	{
+		float x = (unit(rng) - 0.5f) * WORLD, z = (unit(rng) - 0.5f) * WORLD, y = unit(rng) * 50.0f;
+		float e[3] = { 0.5f + unit(rng) * 5.0f, 0.5f + unit(rng) * 10.0f, 0.5f + unit(rng) * 5.0f };
+		float radius;
+		if (i % 4 != 3)
+		{
+			AABB box = { { x - e[0], y - e[1], z - e[2] }, { x + e[0], y + e[1], z + e[2] } };
+			system.add(box);
+			radius = std::sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+		}
+		else
+		{
+			Sphere sphere = { { x, y, z }, e[0] };
+			system.add(sphere);
+			radius = e[0];
+			e[1] = e[2] = e[0];
+		}
+
+		float values[7] = { x, y, z, e[0], e[1], e[2], radius };
+		for (int k = 0; k < 7; k++)
+			bounds.arrays[k].push_back(values[k]);
+		bounds.ids.push_back(i);
+	}
+	for (int k = 0; k < 7; k++)
+		bounds.soa[k] = bounds.arrays[k].data();
+
+	Mat4 viewProjection = Mat4::Perspective(1.0472f, 16.0f / 9.0f, 0.5f, 1500.0f) * Mat4::LookAt(Vec3(0.0f, 20.0f, 0.0f), Vec3(100.0f, 15.0f, 30.0f), Vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = ExtractFrustum(viewProjection.data());
+
+	std::vector<unsigned int> out(OBJECTS);
+	std::vector<unsigned int> counts((OBJECTS + CullingSystem::CHUNK_SIZE - 1) / CullingSystem::CHUNK_SIZE);
+
+	//1, 2, 4 ... threads up to the hardware's, the caller counts as one
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < hardware; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(hardware);
+
+	//the level whose kernel runs at the CPU's best one, there isn't a kernel for every level
+	const int repeats = 20;
+	SimdLevel best = GetSimdLevel();
+	SimdLevel kernelLevel = best;
+	while (kernelLevel > SimdLevel::Scalar && GetCullKernel((SimdLevel)((int)kernelLevel - 1)) == GetCullKernel(kernelLevel))
+		kernelLevel = (SimdLevel)((int)kernelLevel - 1);
+	std::cout << OBJECTS << " objects, target < 1 ms, kernel level: " << SimdLevelName(kernelLevel) << "\n";
+	std::cout << std::left << std::setw(10) << "level" << std::setw(10) << "threads" << std::setw(12) << "visible" << std::setw(12) << "ms" << "Mobjects/s" << "\n";
+
+	for (unsigned int threads : threadCounts)
+	{
+		std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+		for (int level = 0; level <= (int)best; level++)
+		{
+			CullKernel kernel = GetCullKernel((SimdLevel)level);
+			if (level > 0 && kernel == GetCullKernel((SimdLevel)(level - 1))) //same kernel as the level below
+				continue;
+
+			unsigned int visible = CullChunks(pool.get(), kernel, frustum, bounds, out, counts); //warm up
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repeats; r++)
+				CullChunks(pool.get(), kernel, frustum, bounds, out, counts);
+			double ms = Milliseconds(start) / repeats;
+
+			std::cout << std::left << std::setw(10) << SimdLevelName((SimdLevel)level) << std::setw(10) << threads << std::setw(12) << visible
+				<< std::setw(12) << std::fixed << std::setprecision(3) << ms << std::setprecision(1) << OBJECTS / (ms * 1000.0) << "\n";
+		}
+	}
+
+	//the real thing: best level on the shared pool, packing the visible ids included
+	std::vector<unsigned int> visible;
+	system.cull(frustum, visible);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+		system.cull(frustum, visible);
+	double ms = Milliseconds(start) / repeats;
+	std::cout << "CullingSystem::cull, " << hardware << " hardware threads: " << visible.size() << " visible in "
+		<< std::setprecision(3) << ms << " ms" << (ms < 1.0 ? "" : " (over target)") << "\n";
+}
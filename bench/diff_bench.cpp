@@ -0,0 +1,71 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "benchmarks.h"
+#include "image_diff.h"
+
+//Full window frames, like the golden images
+static const unsigned int WIDTH = 1000;
+static const unsigned int HEIGHT = 1000;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RunDiffBenchmark()
+{
+	//a frame of flat shapes, like the app draws, and a copy with 1% of the pixels nudged by a few levels
+	std::mt19937 rng(3);
+	Image expected(WIDTH, HEIGHT);
+	for (unsigned int y = 0; y < HEIGHT; y++)
+		for (unsigned int x = 0; x < WIDTH; x++)
+			expected.pixels[y * WIDTH + x] = ((x / 250 + y / 250) & 1) ? 0xFFCC4D33u : 0xFF000000u;
+
+	Image nudged = expected;
+	for (unsigned int i = 0; i < WIDTH * HEIGHT / 100; i++)
+		nudged.pixels[rng() % nudged.pixels.size()] ^= (rng() % 4 + 1) << (rng() % 3 * 8);
+
+	struct Case
+	{
+		const char* name;
+		const Image* actual;
+		DiffMetric metric;
+	};
+	const Case cases[] =
+	{
+		{ "identical channel", &expected, DiffMetric::Channel },
+		{ "identical perceptual", &expected, DiffMetric::Perceptual },
+		{ "1% nudged channel", &nudged, DiffMetric::Channel },
+		{ "1% nudged perceptual", &nudged, DiffMetric::Perceptual },
+	};
+
+	std::cout << std::left << std::setw(24) << "case" << std::setw(10) << "level" << std::setw(12) << "failing"
+		<< std::setw(12) << "ms/frame" << std::setw(12) << "frames/s" << "\n";
+
+	SimdLevel best = GetSimdLevel();
+	std::vector<unsigned char> errors;
+	for (const Case& c : cases)
+	{
+		for (int level = 0; level <= (int)best; level++)
+		{
+			SetSimdLevel((SimdLevel)level);
+
+			DiffOptions options;
+			options.metric = c.metric;
+			DiffResult result = DiffImages(expected, *c.actual, options, &errors);
+
+			const int repeats = 100;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repeats; r++)
+				DiffImages(expected, *c.actual, options, &errors);
+			double ms = Milliseconds(start) / repeats;
+
+			std::cout << std::left << std::setw(24) << c.name << std::setw(10) << SimdLevelName((SimdLevel)level)
+				<< std::setw(12) << result.differentPixels << std::setw(12) << std::fixed << std::setprecision(3) << ms
+				<< std::setw(12) << std::setprecision(0) << 1000.0 / ms << "\n";
+		}
+		SetSimdLevel(best);
+	}
+}
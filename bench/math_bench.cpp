@@ -0,0 +1,74 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "benchmarks.h"
+#include "math3d.h"
+
+static const unsigned int POINTS = 1 << 20;
+static const unsigned int MATRICES = 1 << 16;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RunMathBenchmark()
+{
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+
+	std::vector<float> x(POINTS), y(POINTS), z(POINTS), outX(POINTS), outY(POINTS), outZ(POINTS);
+	for (unsigned int i = 0; i < POINTS; i++)
+	{
+		x[i] = value(rng);
+		y[i] = value(rng);
+		z[i] = value(rng);
+	}
+
+	std::vector<Mat4> a(MATRICES), b(MATRICES), out(MATRICES);
+	for (unsigned int i = 0; i < MATRICES; i++)
+	{
+		a[i] = Mat4::FromTRS(Vec3(value(rng), value(rng), value(rng)), Quat::FromAxisAngle(Normalize(Vec3(value(rng), value(rng), 1.0f)), value(rng)),
+			Vec3(1.0f, 2.0f, 0.5f));
+		b[i] = Mat4::Translation(Vec3(value(rng), value(rng), value(rng)));
+	}
+	Mat4 view = Mat4::Perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f) * Mat4::LookAt(Vec3(0.0f, 5.0f, 10.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+
+	std::cout << std::left << std::setw(16) << "case" << std::setw(10) << "level" << std::setw(12) << "ms"
+		<< std::setw(12) << "M/s" << "\n";
+
+	SimdLevel best = GetSimdLevel();
+	for (int level = 0; level <= (int)best; level++)
+	{
+		SetSimdLevel((SimdLevel)level);
+		const int repeats = 20;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeats; r++)
+			TransformPoints(view, x.data(), y.data(), z.data(), POINTS, outX.data(), outY.data(), outZ.data());
+		double pointsMs = Milliseconds(start) / repeats;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeats; r++)
+			MultiplyMatrices(a.data(), b.data(), MATRICES, out.data());
+		double pairsMs = Milliseconds(start) / repeats;
+
+		//one parent times many children, the shape of a transform hierarchy level
+		start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeats; r++)
+			MultiplyMatrices(view, a.data(), MATRICES, out.data());
+		double parentMs = Milliseconds(start) / repeats;
+
+		const char* name = SimdLevelName((SimdLevel)level);
+		std::cout << std::fixed << std::left
+			<< std::setw(16) << "points" << std::setw(10) << name << std::setw(12) << std::setprecision(3) << pointsMs
+			<< std::setw(12) << std::setprecision(0) << POINTS / (pointsMs * 1000.0) << "\n"
+			<< std::setw(16) << "matrix pairs" << std::setw(10) << name << std::setw(12) << std::setprecision(3) << pairsMs
+			<< std::setw(12) << std::setprecision(0) << MATRICES / (pairsMs * 1000.0) << "\n"
+			<< std::setw(16) << "matrix parent" << std::setw(10) << name << std::setw(12) << std::setprecision(3) << parentMs
+			<< std::setw(12) << std::setprecision(0) << MATRICES / (parentMs * 1000.0) << "\n";
+	}
+	SetSimdLevel(best);
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "benchmarks.h"
+#include "mipmap.h"
+
+static const unsigned int SIZE = 2048;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RunMipmapBenchmark()
+{
+	//noise with some transparent pixels, so the alpha weighting isn't skipped by anything
+	std::mt19937 rng(5);
+	Image image(SIZE, SIZE);
+	for (unsigned int& pixel : image.pixels)
+		pixel = rng() % 8 ? rng() | 0xFF000000u : 0u;
+
+	struct Case
+	{
+		const char* name;
+		MipFilter filter;
+		bool srgb;
+	};
+	const Case cases[] =
+	{
+		{ "box srgb", MipFilter::Box, true },
+		{ "box linear", MipFilter::Box, false },
+		{ "kaiser srgb", MipFilter::Kaiser, true },
+	};
+
+	std::cout << std::left << std::setw(16) << "case" << std::setw(10) << "level" << std::setw(12) << "ms/chain"
+		<< std::setw(12) << "Mpixels/s" << "\n";
+
+	SimdLevel best = GetSimdLevel();
+	std::vector<Image> levels;
+	for (const Case& c : cases)
+	{
+		for (int level = 0; level <= (int)best; level++)
+		{
+			SetSimdLevel((SimdLevel)level);
+
+			MipOptions options;
+			options.filter = c.filter;
+			options.srgb = c.srgb;
+			GenerateMipmaps(image, options, levels);
+
+			const int repeats = 5;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repeats; r++)
+				GenerateMipmaps(image, options, levels);
+			double ms = Milliseconds(start) / repeats;
+
+			std::cout << std::left << std::setw(16) << c.name << std::setw(10) << SimdLevelName((SimdLevel)level)
+				<< std::setw(12) << std::fixed << std::setprecision(2) << ms
+				<< std::setw(12) << std::setprecision(0) << SIZE * SIZE / (ms * 1000.0) << "\n";
+		}
+		SetSimdLevel(best);
+	}
+}
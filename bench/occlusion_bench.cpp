@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "benchmarks.h"
+#include "culling.h"
+#include "occlusion_culling.h"
+
+//City of GRID x GRID buildings with props scattered over the streets and roofs, seen from street level
+static const int GRID = 48;
+static const float SPACING = 20.0f;
+static const float FOOTPRINT = 12.0f;
+static const int PROPS = 100000;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//column major, like OpenGL
+static void Multiply(const float* a, const float* b, float* out)
+{
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				sum += a[k * 4 + row] * b[column * 4 + k];
+			out[column * 4 + row] = sum;
+		}
+}
+
+static void ViewProjection(const float* eye, const float* direction, float* out)
+{
+	const float fovY = 1.0472f, aspect = 2.0f, zNear = 0.5f, zFar = 2000.0f;
+	float f = 1.0f / std::tan(fovY * 0.5f);
+	float projection[16] = {};
+	projection[0] = f / aspect;
+	projection[5] = f;
+	projection[10] = (zFar + zNear) / (zNear - zFar);
+	projection[11] = -1.0f;
+	projection[14] = 2.0f * zFar * zNear / (zNear - zFar);
+
+	//look along direction with +y up
+	float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+	float forward[3] = { direction[0] / length, direction[1] / length, direction[2] / length };
+	float side[3] = { -forward[2], 0.0f, forward[0] };
+	float sideLength = std::sqrt(side[0] * side[0] + side[2] * side[2]);
+	side[0] /= sideLength;
+	side[2] /= sideLength;
+	float up[3] = { side[1] * forward[2] - side[2] * forward[1], side[2] * forward[0] - side[0] * forward[2], side[0] * forward[1] - side[1] * forward[0] };
+
+	float view[16] =
+	{
+		side[0], up[0], -forward[0], 0.0f,
+		side[1], up[1], -forward[1], 0.0f,
+		side[2], up[2], -forward[2], 0.0f,
+		-(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]),
+		-(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]),
+		forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2], 1.0f
+	};
+	Multiply(projection, view, out);
+}
+
+void RunOcclusionBenchmark()
+{
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	//ids 0 .. GRID * GRID - 1 are the buildings, the only occluders
+	std::vector<AABB> boxes;
+	for (int z = 0; z < GRID; z++)
+		for (int x = 0; x < GRID; x++)
+		{
+			float height = 8.0f + unit(rng) * 52.0f;
+			float x0 = x * SPACING + (SPACING - FOOTPRINT) * 0.5f, z0 = z * SPACING + (SPACING - FOOTPRINT) * 0.5f;
+			AABB box = { { x0, 0.0f, z0 }, { x0 + FOOTPRINT, height, z0 + FOOTPRINT } };
+			boxes.push_back(box);
+		}
+	unsigned int buildingCount = (unsigned int)boxes.size();
+
+	for (int i = 0; i < PROPS; i++)
+	{
+		float size = 0.5f + unit(rng) * 1.5f;
+		float x = unit(rng) * GRID * SPACING, z = unit(rng) * GRID * SPACING;
+		float y = unit(rng) < 0.8f ? 0.0f : unit(rng) * 60.0f;
+		AABB box = { { x, y, z }, { x + size, y + size, z + size } };
+		boxes.push_back(box);
+	}
+
+	CullingSystem culling;
+	for (const AABB& box : boxes)
+		culling.add(box);
+
+	//standing in the street between two rows of buildings, looking along it and across the blocks
+	const float eye[3] = { GRID * SPACING * 0.5f, 1.8f, GRID * SPACING * 0.5f };
+	const float directions[4][3] = { { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.6f }, { -0.3f, -0.05f, 1.0f }, { -1.0f, 0.1f, -1.0f } };
+
+	std::cout << "objects: " << boxes.size() << " (" << buildingCount << " building occluders)\n";
+	std::cout << std::left << std::setw(8) << "view" << std::setw(10) << "level" << std::setw(12) << "frustum"
+		<< std::setw(12) << "visible" << std::setw(10) << "removed %" << std::setw(12) << "raster ms"
+		<< std::setw(10) << "test ms" << "\n";
+
+	SimdLevel best = GetSimdLevel();
+	OcclusionCuller occlusion;
+	std::vector<unsigned int> frustumVisible, visible;
+
+	for (int view = 0; view < 4; view++)
+	{
+		float viewProjection[16];
+		ViewProjection(eye, directions[view], viewProjection);
+		culling.cull(ExtractFrustum(viewProjection), frustumVisible);
+
+		for (int level = 0; level <= (int)best; level++)
+		{
+			SetSimdLevel((SimdLevel)level);
+
+			const int repeats = 5;
+			double rasterMs = 0.0, testMs = 0.0;
+			for (int r = 0; r < repeats; r++)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				occlusion.beginFrame(viewProjection);
+				for (unsigned int id : frustumVisible)
+					if (id < buildingCount)
+						occlusion.addOccluder(boxes[id]);
+				occlusion.rasterizeOccluders();
+				rasterMs += Milliseconds(start);
+
+				visible = frustumVisible;
+				start = std::chrono::high_resolution_clock::now();
+				occlusion.cullOccluded(boxes.data(), visible);
+				testMs += Milliseconds(start);
+			}
+
+			std::cout << std::left << std::setw(8) << view << std::setw(10) << SimdLevelName((SimdLevel)level)
+				<< std::setw(12) << frustumVisible.size() << std::setw(12) << visible.size()
+				<< std::setw(10) << std::fixed << std::setprecision(1)
+				<< 100.0 * (frustumVisible.size() - visible.size()) / std::max<size_t>(1, frustumVisible.size()) << std::setw(12)
+				<< std::setprecision(3) << rasterMs / repeats << std::setw(10) << testMs / repeats << "\n";
+		}
+		SetSimdLevel(best);
+	}
+}
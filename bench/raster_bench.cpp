@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "benchmarks.h"
+#include "raster_kernels.h"
+
+static const int WIDTH = 1000;
+static const int HEIGHT = 1000;
+static const int TILE = 64;
+static const int SUBPIXEL_BITS = 4;
+static const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+
+//Triangle size classes, sizes are the bounding square in pixels
+//"grid cell" is the half quad of app.cpp's grid[] at 1000x1000: a right triangle with 250 pixel legs
+struct SizeClass
+{
+	const char* name;
+	int minSize, maxSize;
+	bool rightTriangle;
+	int count;
+};
+
+static const SizeClass SIZE_CLASSES[] =
+{
+	{ "tiny 1-4px",      1,   4, false, 200000 },
+	{ "small 4-16px",    4,  16, false, 100000 },
+	{ "medium 16-64px", 16,  64, false,  20000 },
+	{ "grid cell 250px", 250, 250, true,  2000 },
+	{ "large 300-900px", 300, 900, false,  400 },
+};
+
+struct BenchTriangle
+{
+	RasterEdges edges;
+	int minX, minY, maxX, maxY;
+};
+
+static std::vector<BenchTriangle> MakeTriangles(const SizeClass& sizeClass, std::mt19937& rng)
+{
+	std::vector<BenchTriangle> triangles;
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	while ((int)triangles.size() < sizeClass.count)
+	{
+		float size = sizeClass.minSize + unit(rng) * (sizeClass.maxSize - sizeClass.minSize);
+		float ox = unit(rng) * (WIDTH - size), oy = unit(rng) * (HEIGHT - size);
+
+		int x[3], y[3];
+		if (sizeClass.rightTriangle)
+		{
+			x[0] = (int)(ox * SUBPIXEL);          y[0] = (int)(oy * SUBPIXEL);
+			x[1] = (int)((ox + size) * SUBPIXEL); y[1] = y[0];
+			x[2] = x[0];                          y[2] = (int)((oy + size) * SUBPIXEL);
+		}
+		else
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				x[k] = (int)((ox + unit(rng) * size) * SUBPIXEL);
+				y[k] = (int)((oy + unit(rng) * size) * SUBPIXEL);
+			}
+		}
+
+		long long area = (long long)(x[1] - x[0]) * (y[2] - y[0]) - (long long)(x[2] - x[0]) * (y[1] - y[0]);
+		if (area == 0)
+			continue;
+		if (area < 0)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+		}
+
+		BenchTriangle tri;
+		SetupRasterEdges(x, y, SUBPIXEL_BITS, tri.edges);
+		if (RasterBounds(x, y, SUBPIXEL_BITS, WIDTH, HEIGHT, tri.minX, tri.minY, tri.maxX, tri.maxY))
+			triangles.push_back(tri);
+	}
+	return triangles;
+}
+
+//Rasterizes every triangle tile by tile like SoftRenderer does, returns the number of covered pixels
+static unsigned long long RunKernel(const std::vector<BenchTriangle>& triangles, BlockCoverageFn kernel)
+{
+	CoverageBlock blocks[(TILE / RASTER_BLOCK_SIZE) * (TILE / RASTER_BLOCK_SIZE)];
+	unsigned long long covered = 0;
+
+	for (const BenchTriangle& tri : triangles)
+		for (int ty = tri.minY / TILE * TILE; ty <= tri.maxY; ty += TILE)
+			for (int tx = tri.minX / TILE * TILE; tx <= tri.maxX; tx += TILE)
+			{
+				unsigned int count = RasterizeBlocks(tri.edges,
+					std::max(tri.minX, tx), std::max(tri.minY, ty),
+					std::min(tri.maxX, tx + TILE - 1), std::min(tri.maxY, ty + TILE - 1), kernel, blocks);
+
+				for (unsigned int i = 0; i < count; i++)
+					covered += PopCount(blocks[i].mask);
+			}
+
+	return covered;
+}
+
+void RunRasterBenchmark()
+{
+	std::mt19937 rng(1234);
+	SimdLevel best = GetSimdLevel();
+
+	std::cout << "single thread coverage throughput, best level: " << SimdLevelName(best) << "\n";
+	std::cout << std::left << std::setw(18) << "size class" << std::setw(10) << "level"
+		<< std::setw(14) << "pixels" << std::setw(12) << "ms" << "Gpix/s" << "\n";
+
+	for (const SizeClass& sizeClass : SIZE_CLASSES)
+	{
+		std::vector<BenchTriangle> triangles = MakeTriangles(sizeClass, rng);
+
+		for (int level = 0; level <= (int)best; level++)
+		{
+			if ((SimdLevel)level == SimdLevel::SSE2) //no SSE2 kernel, it would measure the scalar one again
+				continue;
+
+			BlockCoverageFn kernel = GetBlockCoverageFn((SimdLevel)level);
+			RunKernel(triangles, kernel); //warm up
+
+			const int repeats = 5;
+			unsigned long long covered = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repeats; r++)
+				covered += RunKernel(triangles, kernel);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / repeats;
+			covered /= repeats;
+
+			std::cout << std::left << std::setw(18) << sizeClass.name << std::setw(10) << SimdLevelName((SimdLevel)level)
+				<< std::setw(14) << covered << std::setw(12) << std::fixed << std::setprecision(3) << ms
+				<< std::setprecision(2) << covered / (ms * 1e6) << "\n";
+		}
+	}
+}
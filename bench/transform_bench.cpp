@@ -0,0 +1,72 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "benchmarks.h"
+#include "transform_hierarchy.h"
+
+static const unsigned int NODES = 1000000;
+static const unsigned int ROOTS = 1000;
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RunTransformBenchmark()
+{
+	//a random recursive tree under every root, a few dozen levels deep at most
+	std::mt19937 rng(13);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+	TransformHierarchy hierarchy;
+	std::vector<unsigned int> ids;
+	ids.reserve(NODES);
+	for (unsigned int i = 0; i < NODES; i++)
+	{
+		unsigned int parent = i < ROOTS ? 0 : ids[rng() % i];
+		ids.push_back(hierarchy.create(parent, Vec3(value(rng), value(rng), value(rng)), Quat::FromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), value(rng))));
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	hierarchy.update();
+	std::cout << NODES << " nodes, " << hierarchy.getDepth() << " levels, first update (reorder + everything) "
+		<< std::fixed << std::setprecision(2) << Milliseconds(start) << " ms\n";
+
+	//the rate is of the nodes an update actually recomputed, the moved ones and everything below them
+	std::cout << std::left << std::setw(16) << "moved %" << std::setw(12) << "ms/update" << std::setw(14) << "recomputed" << std::setw(12) << "Mnodes/s" << "\n";
+
+	const float fractions[] = { 0.0f, 0.001f, 0.01f, 0.05f, 1.0f };
+	for (float fraction : fractions)
+	{
+		unsigned int moved = (unsigned int)(NODES * fraction);
+		const int repeats = 10;
+		double ms = 0.0;
+		unsigned long long recomputed = 0;
+		for (int r = 0; r < repeats; r++)
+		{
+			for (unsigned int i = 0; i < moved; i++)
+			{
+				unsigned int id = fraction >= 1.0f ? ids[i] : ids[rng() % NODES];
+				hierarchy.setPosition(id, Vec3(value(rng), value(rng), value(rng)));
+			}
+
+			start = std::chrono::high_resolution_clock::now();
+			hierarchy.update();
+			ms += Milliseconds(start);
+
+			for (unsigned int id : ids)
+				recomputed += hierarchy.hasChanged(id);
+		}
+		ms /= repeats;
+		recomputed /= repeats;
+
+		std::cout << std::left << std::setw(16) << std::setprecision(1) << fraction * 100.0f << std::setw(12) << std::setprecision(3) << ms
+			<< std::setw(14) << recomputed;
+		if (recomputed)
+			std::cout << std::setw(12) << std::setprecision(1) << recomputed / (ms * 1000.0);
+		else
+			std::cout << std::setw(12) << "-";
+		std::cout << "\n";
+	}
+}
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "glsl_soft_shader.h"
+#include "image_diff.h"
+#include "scene_data.h"
+#include "soft_renderer.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+//Renders the scenes of app.cpp on the CPU renderer with the real shaders and compares them against reference images
+//Run from the solution directory, like the app, so res/ and golden/ resolve
+static const unsigned int WIDTH = 1000;
+static const unsigned int HEIGHT = 1000;
+
+struct GoldenScene
+{
+	const char* name;
+	const unsigned int* indices;
+	unsigned int indexCount;
+	int animationFrame; //frames of StepColorAnimation() run before drawing, -1 for SCENE_START_COLOR
+};
+
+static const GoldenScene SCENES[] =
+{
+	{ "grid",          SCENE_GRID_INDICES,     SCENE_GRID_INDEX_COUNT,     -1 },
+	{ "hexagone",      SCENE_HEXAGONE_INDICES, SCENE_HEXAGONE_INDEX_COUNT, -1 },
+	{ "grid_frame_0",  SCENE_GRID_INDICES,     SCENE_GRID_INDEX_COUNT,      0 },
+	{ "grid_frame_12", SCENE_GRID_INDICES,     SCENE_GRID_INDEX_COUNT,     12 },
+	{ "grid_frame_30", SCENE_GRID_INDICES,     SCENE_GRID_INDEX_COUNT,     30 }, //on the way back down
+};
+
+struct GoldenOptions
+{
+	bool update = false;
+	DiffOptions diff;
+	std::string referenceDir = "golden/reference";
+	std::string outputDir = "golden/output";
+	unsigned int repeat = 1;
+	std::vector<std::string> scenes;
+};
+
+static std::string ReadFile(const std::string& path)
+{
+	std::ifstream file(path);
+	std::stringstream source;
+	source << file.rdbuf();
+	return source.str();
+}
+
+static void MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0755);
+#endif
+}
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static Image RenderScene(const GoldenScene& scene, GlslSoftShader& shader)
+{
+	float color[4] = { SCENE_START_COLOR[0], SCENE_START_COLOR[1], SCENE_START_COLOR[2], SCENE_START_COLOR[3] };
+	if (scene.animationFrame >= 0)
+	{
+		//same sequence as the render loop of app.cpp
+		float r = 0.0f, g = 0.0f, increment = 0.05f;
+		for (int frame = 0; frame < scene.animationFrame; frame++)
+			StepColorAnimation(r, g, increment);
+		color[0] = r;
+		color[1] = g;
+		color[2] = 0.8f;
+		color[3] = 1.0f;
+	}
+	shader.setUniform4f(shader.getUniformLocation("u_Color"), color[0], color[1], color[2], color[3]);
+
+	VertexBufferLayout layout;
+	layout.push<float>(2);
+	layout.push<float>(4);
+
+	//the app never calls glClearColor, so it clears to transparent black
+	SoftFramebuffer framebuffer(WIDTH, HEIGHT);
+	framebuffer.clear(0.0f, 0.0f, 0.0f, 0.0f);
+	SoftRenderer renderer(framebuffer);
+	renderer.drawElements(shader, SCENE_VERTICES, layout, scene.indices, scene.indexCount);
+
+	Image image(WIDTH, HEIGHT);
+	std::memcpy(image.pixels.data(), framebuffer.color(), image.pixels.size() * sizeof(unsigned int));
+	return image;
+}
+
+//Returns false when the scene doesn't match its reference
+static bool CheckScene(const GoldenScene& scene, const Image& actual, const GoldenOptions& options)
+{
+	std::string referencePath = options.referenceDir + "/" + scene.name + ".tga";
+	if (options.update)
+	{
+		bool saved = SaveTGA(referencePath, actual);
+		std::cout << std::left << std::setw(16) << scene.name << (saved ? "updated" : "FAILED to write") << "\n";
+		return saved;
+	}
+
+	Image expected;
+	if (!LoadTGA(referencePath, expected))
+	{
+		std::cout << std::left << std::setw(16) << scene.name << "FAILED, no reference at " << referencePath << "\n";
+		return false;
+	}
+
+	std::vector<unsigned char> errors;
+	DiffResult result = DiffImages(expected, actual, options.diff, &errors);
+
+	//the extra runs only time the comparison, so the speed of the diff on full frames is visible
+	double diffMs = 0.0;
+	if (options.repeat > 1)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 1; i < options.repeat; i++)
+			DiffImages(expected, actual, options.diff);
+		diffMs = Milliseconds(start) / (options.repeat - 1);
+	}
+
+	std::cout << std::left << std::setw(16) << scene.name;
+	if (result.differentPixels == 0)
+		std::cout << "ok";
+	else if (!result.sameSize)
+		std::cout << "FAILED, size " << actual.width << "x" << actual.height << " instead of " << expected.width << "x" << expected.height;
+	else
+		std::cout << "FAILED, " << result.differentPixels << " pixels differ, worst score " << result.worstScore;
+	if (options.repeat > 1)
+		std::cout << " (" << std::fixed << std::setprecision(3) << diffMs << " ms per diff, " << std::setprecision(0) << 1000.0 / diffMs << " frames/s)";
+	std::cout << "\n";
+
+	if (result.differentPixels == 0)
+		return true;
+
+	MakeDirectory(options.outputDir);
+	std::string base = options.outputDir + "/" + scene.name;
+	SaveTGA(base + "_actual.tga", actual);
+	if (result.sameSize)
+		SaveTGA(base + "_diff.tga", MakeHeatmap(expected, errors));
+	std::cout << "  wrote " << base << "_actual.tga" << (result.sameSize ? " and _diff.tga" : "") << "\n";
+	return false;
+}
+
+static void PrintUsage()
+{
+	std::cout << "usage: Golden [options] [scene...]\n"
+		<< "  --update              render the scenes and overwrite their reference images\n"
+		<< "  --metric <m>          channel (default) or perceptual\n"
+		<< "  --tolerance <n>       largest channel difference allowed, 0..255, default 0\n"
+		<< "  --threshold <x>       perceptual threshold, 0..1, default 0.1\n"
+		<< "  --reference <dir>     reference images, default golden/reference\n"
+		<< "  --out <dir>           where failing scenes write their render and heatmap, default golden/output\n"
+		<< "  --repeat <n>          time n diffs per scene\n"
+		<< "  --compare <a> <b>     diff two TGA files instead of rendering, e.g. captures of the GL window\n"
+		<< "scenes:";
+	for (const GoldenScene& scene : SCENES)
+		std::cout << " " << scene.name;
+	std::cout << "\n";
+}
+
+static int CompareFiles(const std::string& expectedPath, const std::string& actualPath, const GoldenOptions& options)
+{
+	Image expected, actual;
+	if (!LoadTGA(expectedPath, expected) || !LoadTGA(actualPath, actual))
+	{
+		std::cout << "can't read " << expectedPath << " or " << actualPath << "\n";
+		return 1;
+	}
+
+	std::vector<unsigned char> errors;
+	DiffResult result = DiffImages(expected, actual, options.diff, &errors);
+	if (result.differentPixels == 0)
+	{
+		std::cout << "ok\n";
+		return 0;
+	}
+
+	std::cout << "FAILED, " << result.differentPixels << " pixels differ, worst score " << result.worstScore << "\n";
+	if (result.sameSize)
+	{
+		MakeDirectory(options.outputDir);
+		SaveTGA(options.outputDir + "/compare_diff.tga", MakeHeatmap(expected, errors));
+		std::cout << "  wrote " << options.outputDir << "/compare_diff.tga\n";
+	}
+	return 1;
+}
+
+//Exits with 0 when every scene matches its reference
+int main(int argc, char** argv)
+{
+	GoldenOptions options;
+	std::string compare[2];
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--update")
+			options.update = true;
+		else if (arg == "--metric" && hasValue)
+		{
+			std::string metric = argv[++i];
+			if (metric != "channel" && metric != "perceptual")
+			{
+				PrintUsage();
+				return 1;
+			}
+			options.diff.metric = metric == "channel" ? DiffMetric::Channel : DiffMetric::Perceptual;
+		}
+		else if (arg == "--tolerance" && hasValue)
+			options.diff.channelTolerance = (unsigned int)std::atoi(argv[++i]);
+		else if (arg == "--threshold" && hasValue)
+			options.diff.perceptualThreshold = (float)std::atof(argv[++i]);
+		else if (arg == "--reference" && hasValue)
+			options.referenceDir = argv[++i];
+		else if (arg == "--out" && hasValue)
+			options.outputDir = argv[++i];
+		else if (arg == "--repeat" && hasValue)
+			options.repeat = (unsigned int)std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--compare" && i + 2 < argc)
+		{
+			compare[0] = argv[++i];
+			compare[1] = argv[++i];
+		}
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			options.scenes.push_back(arg);
+	}
+
+	if (!compare[0].empty())
+		return CompareFiles(compare[0], compare[1], options);
+
+	GlslSoftShader shader(ReadFile("res/shaders/vertex.shader"), ReadFile("res/shaders/fragment.shader"));
+	if (!shader.isValid())
+	{
+		std::cout << "res/shaders failed to compile:\n" << shader.getLog();
+		return 1;
+	}
+
+	unsigned int ran = 0, failed = 0;
+	for (const GoldenScene& scene : SCENES)
+	{
+		bool selected = options.scenes.empty();
+		for (const std::string& name : options.scenes)
+			if (name == scene.name)
+				selected = true;
+		if (!selected)
+			continue;
+
+		Image actual = RenderScene(scene, shader);
+		if (!CheckScene(scene, actual, options))
+			failed++;
+		ran++;
+	}
+
+	if (ran == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::cout << ran - failed << "/" << ran << " scenes match (simd: " << SimdLevelName(GetSimdLevel()) << ")\n";
+	return failed ? 1 : 0;
+}
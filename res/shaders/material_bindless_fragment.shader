@@ -0,0 +1,20 @@
+#version 330 core
+#extension GL_ARB_bindless_texture : require
+
+#define MAX_MATERIAL_ARRAYS 256
+
+in vec2 uv;
+flat in uint texture_index;
+out vec4 out_color;
+
+//a handle per array of MaterialTextures in xy
+layout(std140) uniform MaterialTextureHandles
+{
+	uvec4 u_Handles[MAX_MATERIAL_ARRAYS];
+};
+
+void main()
+{
+	sampler2DArray textures = sampler2DArray(u_Handles[texture_index >> 16].xy);
+	out_color = texture(textures, vec3(uv, float(texture_index & 0xFFFFu)));
+}
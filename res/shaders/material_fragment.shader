@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 uv;
+flat in uint texture_index;
+out vec4 out_color;
+
+//the array of the batch, every instance in it picks its layer
+uniform sampler2DArray u_Textures;
+
+void main()
+{
+	out_color = texture(u_Textures, vec3(uv, float(texture_index & 0xFFFFu)));
+}
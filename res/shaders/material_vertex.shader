@@ -0,0 +1,14 @@
+#version 330 core
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 uv_in;
+layout(location = 2) in uint texture_in; //MaterialTextures::getDrawIndex(), per instance
+out vec2 uv;
+flat out uint texture_index;
+
+void main()
+{
+	uv = uv_in;
+	texture_index = texture_in;
+	gl_Position = position;
+}
@@ -0,0 +1,33 @@
+#version 330 core
+
+in vec2 uv;
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec4 out_feedback; //the tile this pixel wanted, for VirtualTexture::addFeedback()
+
+uniform sampler2D u_PageTable;
+uniform sampler2D u_Cache;
+uniform vec2 u_VirtualSize; //pixels of level 0, padded to whole tiles
+uniform vec2 u_UvScale;     //the part of that the image covers
+uniform float u_TileSize;
+uniform float u_Border;
+uniform float u_CacheSize;
+uniform int u_MaxLevel;
+
+void main()
+{
+	vec2 texel = uv * u_UvScale * u_VirtualSize;
+	vec2 dx = dFdx(texel), dy = dFdy(texel);
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	int level = clamp(int(floor(lod)), 0, u_MaxLevel);
+
+	//the entry holds the finest resident tile covering this one: where it is in the cache and its level
+	ivec2 tile = ivec2(texel / (u_TileSize * exp2(float(level))));
+	vec4 entry = floor(texelFetch(u_PageTable, tile, level) * 255.0 + 0.5);
+	vec2 inTile = fract(texel / (u_TileSize * exp2(entry.b)));
+	vec2 cacheTexel = entry.rg * (u_TileSize + 2.0 * u_Border) + u_Border + inTile * u_TileSize;
+	out_color = textureLod(u_Cache, cacheTexel / u_CacheSize, 0.0);
+
+	//4 more bits of each tile coordinate in blue, the level in alpha, clear the target to alpha 1 for nothing
+	ivec2 high = tile >> 8;
+	out_feedback = vec4(float(tile.x & 255), float(tile.y & 255), float(high.x | (high.y << 4)), float(level)) / 255.0;
+}
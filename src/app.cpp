@@ -2,12 +2,41 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include "ecs.h"
+#include "fixed_step_simulation.h"
+#include "frame_arena.h"
+#include "frame_contexts.h"
+#include "frame_pacer.h"
+#include "gpu_buffer_allocator.h"
+#include "gpu_resources.h"
+#include "render_system.h"
 #include "renderer.h"
+#include "scene_data.h"
+#include "texture.h"
+
+//State of the rainbow effect, see StepColorAnimation
+struct ColorAnimation
+{
+	float r, g, increment;
+};
+
+//Tag for materials that take their red and green from the rainbow effect
+struct ColorAnimationComponent
+{
+};
 
 //Reads from an std::ifstream into a string
 static void ParseFile(std::string& path, std::string& out, bool printSourceToConsole = false)
 {
 	std::ifstream fin(path);
+
+	//room for the whole file up front so appending the lines never reallocates
+	fin.seekg(0, std::ios::end);
+	std::streamoff size = fin.tellg();
+	fin.seekg(0, std::ios::beg);
+	if (size > 0)
+		out.reserve(out.size() + (size_t)size + 1);
+
 	std::string temp;
 	while (fin)
 	{
@@ -37,7 +66,7 @@ static unsigned int CompileShader(unsigned int type, const std::string& source)
 	{
 		int length;
 		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length); //get the length of the compilation error message
-		char* message = (char*)alloca(length * sizeof(char)); //dynamically allocate memory on the stack
+		char* message = GetFrameArena().local().allocateArray<char>(length); //scratch memory, back with the next frame arena reset
 		glGetShaderInfoLog(id, length, &length, message); //store the error message into "message"
 
 		std::cout << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader." << std::endl
@@ -49,6 +78,17 @@ static unsigned int CompileShader(unsigned int type, const std::string& source)
 	return id;
 }
 
+//Points attributes 0 and 1 of the bound vertex array at the vertices, starting at their range's offset
+//The buffer and offset are baked into the vertex array, so this has to run again when GpuBufferAllocator::compact() moved them
+static void SetVertexAttributes(const VertexBuffer& vertices)
+{
+	vertices.bind(); //"select" the buffer
+
+	//define how the vertex members should be interpreted
+	GLCall(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (const void*)(size_t)vertices.getOffset())); //the first two elements of a vertex represent the position argument	//glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (const void*)(sizeof(float) * 3)); //the forth element of a vertex represents the state argument (active = 1, inactive = 0)
+	GLCall(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 6, ((const void*)(vertices.getOffset() + sizeof(float) * 2))));
+}
+
 //the parameters are the source code for the shaders as strings
 //provide OpenGL with the source code for the shaders
 //link and compile the shaders
@@ -96,7 +136,9 @@ int main(void)
 
 	/* Make the window's context current */
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(2);
+
+	//picks the swap interval and switches to adaptive vsync when frames start missing refreshes, at the display's rate
+	FramePacer pacer(window);
 
 	/*initialize GLEW
 	  it needs to be initialized after a window has been created*/
@@ -106,121 +148,23 @@ int main(void)
 	std::cout << "OpenGl version: " << glGetString(GL_VERSION) << std::endl;
 	std::cout << "GLEW version : " << glewGetString(GLEW_VERSION) << std::endl;
 
-	float vertices[] =
-	{
-		 //atrib 1 - position ( 2 floats )
-		 //atrib 2 - color ( 4 floats )
-
-		 0.0f,  0.0f, 1, 0, 0, 1, // 0 (origin)
-
-		 //topleft
-		 0.0f,  1.0f, 1, 0, 0, 1, // 1
-		-0.5f,  1.0f, 1, 0, 0, 1, // 2
-		-1.0f,  1.0f, 1, 0, 0, 1, // 3
-		-1.0f,  0.5f, 1, 0, 0, 1, // 4
-		-0.5f,  0.5f, 1, 0, 0, 1, // 5
-		 0.0f,  0.5f, 1, 0, 0, 1, // 6
-		-1.0f,  0.0f, 1, 0, 0, 1, // 7
-		-0.5f,  0.0f, 1, 0, 0, 1, // 8
-
-		//botleft	  
-		-1.0f, -0.5f, 1, 0, 0, 1, //  9
-		-0.5f, -0.5f, 1, 0, 0, 1, // 10
-		 0.0f, -0.5f, 1, 0, 0, 1, // 11
-		-1.0f, -1.0f, 1, 0, 0, 1, // 12
-		-0.5f, -1.0f, 1, 0, 0, 1, // 13
-	     0.0f, -1.0f, 1, 0, 0, 1, // 14
-
-		 //botright
-		 0.5f,  0.0f, 0, 0, 1, 1, // 15
-		 1.0f,  0.0f, 0, 0, 1, 1, // 16
-		 0.5f, -0.5f, 0, 0, 1, 1, // 17
-		 1.0f, -0.5f, 0, 0, 1, 1, // 18
-		 0.5f, -1.0f, 0, 0, 1, 1, // 19
-		 1.0f, -1.0f, 0, 0, 1, 1, // 20
-
-		 //topright
-		 0.5f,  0.5f, 0, 0, 1, 1, // 21
-		 1.0f,  0.5f, 0, 0, 1, 1, // 22
-		 0.5f,  1.0f, 0, 0, 1, 1, // 23
-		 1.0f,  1.0f, 0, 0, 1, 1  // 24
-	};
-
-	unsigned int grid[] =
-	{
-		1, 6, 5,
-		5, 1, 2,
-
-		4, 5, 7,
-		7, 8, 5,
-
-		8, 0, 11,
-		11, 8, 10,
-
-		10, 12, 13,
-		9, 12, 10,
-
-		11, 14, 17,
-		17, 19, 14,
-
-		17, 15, 18,
-		16, 18, 15,
-
-		6, 21, 15,
-		0, 6 , 15,
-
-		21, 23, 22,
-		22, 24, 23
-	};
-
-	unsigned int hexagone[] =
-	{
-		1, 6, 4,
-		4, 6, 0,
-		0, 4, 7,
-
-		7,  9,  0,
-		0, 11,  9,
-		9, 11, 14,
-
-		14, 11, 18,
-		11,  0, 18,
-		18, 16,  0,
-
-		0, 16,  6,
-		6, 16, 22,
-		22, 1,  6
-	};
-
 	unsigned int vao;
 	GLCall(glGenVertexArrays(1, &vao));
 	GLCall(glBindVertexArray(vao));
 
-	unsigned int vbo; //vertex buffer object 
-	GLCall(glGenBuffers(1, &vbo)); //create a buffer
-	GLCall(glBindBuffer(GL_ARRAY_BUFFER, vbo)); //"select" a buffer
-	GLCall(glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 25, vertices, GL_STATIC_DRAW)); // "fill" the buffer with data ( or just mention its size )
-
-	//define how the vertex members should be interpreted
-	GLCall(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 6, 0)); //the first two elements of a vertex represent the position argument	//glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (const void*)(sizeof(float) * 3)); //the forth element of a vertex represents the state argument (active = 1, inactive = 0)
-	GLCall(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 6, ((const void*)(sizeof(float) * 2))));
+	//the vertices and both index lists are ranges of one shared buffer, owned by the registry and reached through handles
+	GpuResources& resources = GetGpuResources();
+	VertexBufferHandle vertexHandle = resources.createVertexBuffer(SCENE_VERTICES, sizeof(SCENE_VERTICES)); //allocate a range and "fill" it with data
+	SetVertexAttributes(*resources.get(vertexHandle));
+	unsigned int gpuBufferVersion = GetGpuBufferAllocator().getVersion();
 
 	//"activate" the atributes
 	GLCall(glEnableVertexAttribArray(0));
 	GLCall(glEnableVertexAttribArray(1));
 
-	//index buffer
-	unsigned int grid_ibo; //index buffer object for drawing a grid
-	int grid_size = 3 * 2 * 8;
-	GLCall(glGenBuffers(1, &grid_ibo));
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_ibo));
-	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * grid_size, grid, GL_STATIC_DRAW));
-
-	unsigned int hexagone_ibo; //index buffer objext for drawing a hexagone
-	int hexagone_size = 3 * 3 * 4;
-	GLCall(glGenBuffers(1, &hexagone_ibo));
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, hexagone_ibo));
-	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * hexagone_size, hexagone, GL_STATIC_DRAW));
+	//index buffers
+	IndexBufferHandle grid_indices = resources.createIndexBuffer(SCENE_GRID_INDICES, SCENE_GRID_INDEX_COUNT); //indices for drawing a grid
+	IndexBufferHandle hexagone_indices = resources.createIndexBuffer(SCENE_HEXAGONE_INDICES, SCENE_HEXAGONE_INDEX_COUNT); //indices for drawing a hexagone
 
 	//Parse the shaders from files and create a program
 	std::string vertexShader;
@@ -241,46 +185,106 @@ int main(void)
 	GLCall(glUseProgram(shader));
 
 	GLCall(int u_Color = glGetUniformLocation(shader, "u_Color"));
-	GLCall(glUniform4f(u_Color, 0.2f, 0.3f, 0.8f, 1.0f));
+	GLCall(glUniform4fv(u_Color, 1, SCENE_START_COLOR));
 
 	//"unbind" everything (for testing vertex array objects)
 	GLCall(glUseProgram(0));
 	GLCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
 	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-  
-	float r = 0.0f;
-	float g = 0.0f;
-	float increment = 0.05f;
 
+	//the grid and the hexagone share the vertex array, the hexagone is hidden
+	World world;
+	world.create(MeshComponent{ vao, grid_indices }, MaterialComponent{ shader, u_Color, { 0.0f, 0.0f, 0.8f, 1.0f } },
+		ColorAnimationComponent());
+	world.create(MeshComponent{ vao, hexagone_indices }, MaterialComponent{ shader, u_Color, { 0.0f, 0.0f, 0.8f, 1.0f } },
+		ColorAnimationComponent(), HiddenComponent());
+
+	//the rainbow effect steps 30 times a second on its own thread, whatever the frame rate
+	FixedStepSimulation<ColorAnimation> colorAnimation(ColorAnimation{ 0.0f, 0.0f, 0.05f }, 1.0f / 30.0f, [](ColorAnimation& animation, float)
+	{
+		StepColorAnimation(animation.r, animation.g, animation.increment);
+	});
+	colorAnimation.start();
+
+	//changes the red and green value in the shader to the rainbow color blended for this frame
+	float animatedColor[2] = { 0.0f, 0.0f };
+	SystemScheduler systems;
+	systems.add("color animation", ComponentMaskOf<ColorAnimationComponent>(), ComponentMaskOf<MaterialComponent>(), [&animatedColor](World& world)
+	{
+		world.each<ColorAnimationComponent, MaterialComponent>([&animatedColor](Entity, ColorAnimationComponent&, MaterialComponent& material)
+		{
+			material.color[0] = animatedColor[0];
+			material.color[1] = animatedColor[1];
+		});
+	});
+
+	//up to 3 frames in flight, the CPU only waits for the GPU when it gets that far ahead
+	FrameContexts frameContexts;
+
+	std::vector<DrawCommand> draws;
 	int rand = 0;
 	//Render loop until the user closes window
 	while (!glfwWindowShouldClose(window))
 	{
-		GLCall(glClear(GL_COLOR_BUFFER_BIT));
-
-		GLCall(glUseProgram(shader));
-		GLCall(glUniform4f(u_Color, r, g, 0.8f, 1.0f));
-
-		GLCall(glBindVertexArray(vao));
-		//	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, hexagone_ibo));
-		GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_ibo));
-
-		GLCall(glDrawElements(GL_TRIANGLES, grid_size, GL_UNSIGNED_INT, nullptr));
-
-		//changes the red and green value in the shader, rainbow effect 
-		if (r > 1.0f || g > 1.0f) 
-				increment = -0.05f;
-		else if (r < 0.0f || g < 0.0f) 
-				increment =  0.05f;
-
+		pacer.beginFrame(); //sleeps first when uncapped, so the input polled next is as fresh as possible
+		GLCall(glfwPollEvents()); //poll for and process events
+		GetFrameArena().reset(); //nothing from the last frame is kept
+		frameContexts.beginFrame(); //waits if the GPU is still on the frame that last used this context
 
-		r += increment;
-		g += increment;
+		GLCall(glClear(GL_COLOR_BUFFER_BIT));
 
-		GLCall(glfwSwapBuffers(window)); // swap front and back buffers
-		GLCall(glfwPollEvents()); //poll for and process events
+		ColorAnimation previous, current;
+		float alpha;
+		colorAnimation.read(previous, current, alpha);
+		animatedColor[0] = previous.r + (current.r - previous.r) * alpha;
+		animatedColor[1] = previous.g + (current.g - previous.g) * alpha;
+		systems.run(world);
+
+		//the vertices moved to another buffer or offset, the vertex array still points at the old ones
+		if (GetGpuBufferAllocator().getVersion() != gpuBufferVersion)
+		{
+			gpuBufferVersion = GetGpuBufferAllocator().getVersion();
+			GLCall(glBindVertexArray(vao));
+			SetVertexAttributes(*resources.get(vertexHandle));
+		}
+
+		ExtractDrawList(world, draws);
+		frameContexts.finishWrites();
+		SubmitDrawList(draws);
+
+		GetTextureLoader().update(); //moves textures that finished loading in the background to the GPU
+		resources.endFrame(); //releases buffers destroyed a few frames ago, once the GPU is done with them
+		frameContexts.endFrame();
+
+		pacer.present(); // swap front and back buffers
 	}
 
+	colorAnimation.stop();
+	std::cout << "Simulation: " << colorAnimation.getStepCount() << " steps of " << colorAnimation.getStepSeconds() * 1000.0f << " ms, "
+		<< colorAnimation.getDroppedSteps() << " dropped\n";
+
+	FramePacingStats pacing = pacer.getStats();
+	std::cout << "Frame pacing: " << pacing.frames << " frames, " << pacing.averageMs << " ms average, " << pacing.jitterMs << " ms jitter, "
+		<< pacing.worstMs << " ms worst, " << pacing.missed << " missed, " << GetPacingModeName(pacing.mode) << " after " << pacing.modeSwitches << " switches\n";
+
+	FrameContextStats contextStats = frameContexts.getStats();
+	std::cout << "Frames in flight: " << contextStats.contexts << " contexts, " << contextStats.stalls << " of " << contextStats.frames << " frames waited for the GPU, "
+		<< contextStats.stallMs << " ms in all, " << contextStats.worstStallMs << " ms worst\n";
+
+	FrameArenaStats arenaStats = GetFrameArena().getStats();
+	std::cout << "Frame arena high water: " << arenaStats.highWater / 1024 << " KB over " << arenaStats.threads << " threads\n";
+	GpuBufferStats bufferStats = GetGpuBufferAllocator().getStats();
+	std::cout << "GPU buffers: " << bufferStats.allocations << " allocations, " << bufferStats.used << " of " << bufferStats.capacity
+		<< " bytes in " << bufferStats.buffers << " buffers, fragmentation " << bufferStats.fragmentation << "\n";
+
+	resources.destroy(hexagone_indices);
+	resources.destroy(grid_indices);
+	resources.destroy(vertexHandle);
+	resources.flush(); //the ranges go back while the context is still there
+	frameContexts.destroy();
+	GetGpuBufferAllocator().destroy();
+	GetTextureLoader().destroy();
+
 	GLCall(glDeleteProgram(shader));
 	glfwTerminate();
 	return 0;
@@ -0,0 +1,1212 @@
+#include "block_compress.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "thread_pool.h"
+
+//BC7 interpolation weights out of 64, by index size
+static const unsigned char BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+static const unsigned char BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const unsigned char BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//two subset partitions, bit i is set when pixel i belongs to the second subset
+static const unsigned short BC7_PARTITIONS2[64] =
+{
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+//pixel of the second subset whose index is stored with one bit less, the first subset's is always pixel 0
+static const unsigned char BC7_ANCHORS2[64] =
+{
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+//three subset partitions, bits 2i and 2i + 1 hold the subset of pixel i
+static const unsigned int BC7_PARTITIONS3[64] =
+{
+	0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+	0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+	0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+	0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+	0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+	0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+	0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+	0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+};
+
+//pixels of the second and third subsets whose indices are stored with one bit less
+static const unsigned char BC7_ANCHORS3_SECOND[64] =
+{
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+};
+
+static const unsigned char BC7_ANCHORS3_THIRD[64] =
+{
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+};
+
+struct Bc7Mode
+{
+	unsigned int subsets;
+	unsigned int partitionBits;
+	unsigned int rotationBits;
+	unsigned int selectionBits;
+	unsigned int colorBits;
+	unsigned int alphaBits;     //0 when alpha is always 255
+	bool endpointPBits;         //one p-bit per endpoint
+	bool sharedPBits;           //one p-bit per subset
+	unsigned int indexBits;
+	unsigned int index2Bits;    //separate alpha (or color, with the selection bit) indices
+};
+
+static const Bc7Mode BC7_MODES[8] =
+{
+	{ 3, 4, 0, 0, 4, 0, true,  false, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, false, true,  3, 0 },
+	{ 3, 6, 0, 0, 5, 0, false, false, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, true,  false, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, false, false, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, false, false, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, true,  false, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, true,  false, 2, 0 }
+};
+
+//partitions whose estimate gets a full try in mode 1
+static const unsigned int BC7_NORMAL_PARTITIONS = 4;
+static const unsigned int BC7_BEST_PARTITIONS = 16;
+
+static const float MAX_ERROR = 3.4e38f;
+
+unsigned int BlockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+const char* BlockFormatName(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1: return "bc1";
+	case BlockFormat::BC3: return "bc3";
+	case BlockFormat::BC4: return "bc4";
+	case BlockFormat::BC5: return "bc5";
+	case BlockFormat::BC7: return "bc7";
+	}
+	return "unknown";
+}
+
+size_t CompressedSize(BlockFormat format, unsigned int width, unsigned int height)
+{
+	return (((size_t)width + 3) / 4) * (((size_t)height + 3) / 4) * BlockBytes(format);
+}
+
+static float BlockIndexScalar(const BlockPixels& pixels, unsigned int mask, unsigned int channelCount,
+	const float* palette, unsigned int paletteSize, unsigned char* indices)
+{
+	float total = 0.0f;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+
+		float best = MAX_ERROR;
+		unsigned int bestIndex = 0;
+		for (unsigned int p = 0; p < paletteSize; p++)
+		{
+			float distance = 0.0f;
+			for (unsigned int c = 0; c < channelCount; c++)
+			{
+				float delta = pixels.channels[c][i] - palette[p * 4 + c];
+				distance += delta * delta;
+			}
+			if (distance < best)
+			{
+				best = distance;
+				bestIndex = p;
+			}
+		}
+		indices[i] = (unsigned char)bestIndex;
+		total += best;
+	}
+	return total;
+}
+
+//the SIMD versions find the closest entries for all 16 pixels, then keep those of the mask
+//every value is a small integer, so the distances are exact and all levels pick the same indices
+static float GatherMasked(const float* best, const int* bestIndex, unsigned int mask, unsigned char* indices)
+{
+	float total = 0.0f;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		if (mask & (1u << i))
+		{
+			indices[i] = (unsigned char)bestIndex[i];
+			total += best[i];
+		}
+	}
+	return total;
+}
+
+#if SIMD_X86
+static float BlockIndexSSE2(const BlockPixels& pixels, unsigned int mask, unsigned int channelCount,
+	const float* palette, unsigned int paletteSize, unsigned char* indices)
+{
+	alignas(16) float best[16];
+	alignas(16) int bestIndex[16];
+	for (unsigned int group = 0; group < 16; group += 4)
+	{
+		__m128 x[4];
+		for (unsigned int c = 0; c < channelCount; c++)
+			x[c] = _mm_loadu_ps(&pixels.channels[c][group]);
+
+		__m128 minimum = _mm_set1_ps(MAX_ERROR);
+		__m128i index = _mm_setzero_si128();
+		for (unsigned int p = 0; p < paletteSize; p++)
+		{
+			__m128 distance = _mm_setzero_ps();
+			for (unsigned int c = 0; c < channelCount; c++)
+			{
+				__m128 delta = _mm_sub_ps(x[c], _mm_set1_ps(palette[p * 4 + c]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, minimum));
+			minimum = _mm_min_ps(distance, minimum);
+			index = _mm_or_si128(_mm_andnot_si128(closer, index), _mm_and_si128(closer, _mm_set1_epi32((int)p)));
+		}
+		_mm_store_ps(best + group, minimum);
+		_mm_store_si128((__m128i*)(bestIndex + group), index);
+	}
+	return GatherMasked(best, bestIndex, mask, indices);
+}
+
+SIMD_TARGET_AVX2
+static float BlockIndexAVX2(const BlockPixels& pixels, unsigned int mask, unsigned int channelCount,
+	const float* palette, unsigned int paletteSize, unsigned char* indices)
+{
+	alignas(32) float best[16];
+	alignas(32) int bestIndex[16];
+	for (unsigned int group = 0; group < 16; group += 8)
+	{
+		__m256 x[4];
+		for (unsigned int c = 0; c < channelCount; c++)
+			x[c] = _mm256_loadu_ps(&pixels.channels[c][group]);
+
+		__m256 minimum = _mm256_set1_ps(MAX_ERROR);
+		__m256 index = _mm256_setzero_ps();
+		for (unsigned int p = 0; p < paletteSize; p++)
+		{
+			__m256 distance = _mm256_setzero_ps();
+			for (unsigned int c = 0; c < channelCount; c++)
+			{
+				__m256 delta = _mm256_sub_ps(x[c], _mm256_set1_ps(palette[p * 4 + c]));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(delta, delta));
+			}
+			__m256 closer = _mm256_cmp_ps(distance, minimum, _CMP_LT_OQ);
+			minimum = _mm256_min_ps(distance, minimum);
+			index = _mm256_blendv_ps(index, _mm256_castsi256_ps(_mm256_set1_epi32((int)p)), closer);
+		}
+		_mm256_store_ps(best + group, minimum);
+		_mm256_store_si256((__m256i*)(bestIndex + group), _mm256_castps_si256(index));
+	}
+	return GatherMasked(best, bestIndex, mask, indices);
+}
+
+//the whole block in one register per channel
+SIMD_TARGET_AVX512
+static float BlockIndexAVX512(const BlockPixels& pixels, unsigned int mask, unsigned int channelCount,
+	const float* palette, unsigned int paletteSize, unsigned char* indices)
+{
+	alignas(64) float best[16];
+	alignas(64) int bestIndex[16];
+	__m512 x[4];
+	for (unsigned int c = 0; c < channelCount; c++)
+		x[c] = _mm512_loadu_ps(pixels.channels[c]);
+
+	__m512 minimum = _mm512_set1_ps(MAX_ERROR);
+	__m512i index = _mm512_setzero_si512();
+	for (unsigned int p = 0; p < paletteSize; p++)
+	{
+		__m512 distance = _mm512_setzero_ps();
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			__m512 delta = _mm512_sub_ps(x[c], _mm512_set1_ps(palette[p * 4 + c]));
+			distance = _mm512_add_ps(distance, _mm512_mul_ps(delta, delta));
+		}
+		__mmask16 closer = _mm512_cmp_ps_mask(distance, minimum, _CMP_LT_OQ);
+		minimum = _mm512_mask_mov_ps(minimum, closer, distance);
+		index = _mm512_mask_mov_epi32(index, closer, _mm512_set1_epi32((int)p));
+	}
+	_mm512_store_ps(best, minimum);
+	_mm512_store_si512(bestIndex, index);
+	return GatherMasked(best, bestIndex, mask, indices);
+}
+#endif
+
+BlockIndexFn GetBlockIndexFn(SimdLevel level)
+{
+#if SIMD_X86
+	if (level >= SimdLevel::AVX512)
+		return BlockIndexAVX512;
+	if (level >= SimdLevel::AVX2)
+		return BlockIndexAVX2;
+	if (level >= SimdLevel::SSE2)
+		return BlockIndexSSE2;
+#endif
+	return BlockIndexScalar;
+}
+
+static float Clamp255(float v)
+{
+	return std::min(255.0f, std::max(0.0f, v));
+}
+
+//Line through the pixels of mask along their principal axis, from the lowest to the highest projection
+static void FitPrincipalAxis(const BlockPixels& pixels, unsigned int mask, unsigned int channelCount, float* e0, float* e1)
+{
+	float mean[4] = {}, low[4], high[4];
+	float count = 0.0f;
+	for (unsigned int c = 0; c < channelCount; c++)
+	{
+		low[c] = 255.0f;
+		high[c] = 0.0f;
+	}
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			float v = pixels.channels[c][i];
+			mean[c] += v;
+			low[c] = std::min(low[c], v);
+			high[c] = std::max(high[c], v);
+		}
+		count += 1.0f;
+	}
+	if (count == 0.0f)
+	{
+		for (unsigned int c = 0; c < channelCount; c++)
+			e0[c] = e1[c] = 0.0f;
+		return;
+	}
+	for (unsigned int c = 0; c < channelCount; c++)
+		mean[c] /= count;
+
+	float covariance[4][4] = {};
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		for (unsigned int a = 0; a < channelCount; a++)
+			for (unsigned int b = a; b < channelCount; b++)
+				covariance[a][b] += (pixels.channels[a][i] - mean[a]) * (pixels.channels[b][i] - mean[b]);
+	}
+
+	//power iteration from the diagonal of the bounding box
+	float axis[4];
+	for (unsigned int c = 0; c < channelCount; c++)
+		axis[c] = high[c] - low[c];
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {}, largest = 0.0f;
+		for (unsigned int a = 0; a < channelCount; a++)
+		{
+			for (unsigned int b = 0; b < channelCount; b++)
+				next[a] += (a <= b ? covariance[a][b] : covariance[b][a]) * axis[b];
+			largest = std::max(largest, std::fabs(next[a]));
+		}
+		if (largest == 0.0f)
+			break;
+		for (unsigned int c = 0; c < channelCount; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	float length = 0.0f;
+	for (unsigned int c = 0; c < channelCount; c++)
+		length += axis[c] * axis[c];
+	if (length == 0.0f)
+	{
+		for (unsigned int c = 0; c < channelCount; c++)
+			e0[c] = e1[c] = mean[c];
+		return;
+	}
+
+	float lowest = MAX_ERROR, highest = -MAX_ERROR;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		float t = 0.0f;
+		for (unsigned int c = 0; c < channelCount; c++)
+			t += (pixels.channels[c][i] - mean[c]) * axis[c];
+		lowest = std::min(lowest, t);
+		highest = std::max(highest, t);
+	}
+	for (unsigned int c = 0; c < channelCount; c++)
+	{
+		e0[c] = Clamp255(mean[c] + lowest / length * axis[c]);
+		e1[c] = Clamp255(mean[c] + highest / length * axis[c]);
+	}
+}
+
+//Least squares endpoints for fixed indices, pixel i being approximated by (1 - t) * e0 + t * e1 with t = weights[indices[i]]
+//Returns false when the indices don't pin the endpoints down (all pixels on one weight)
+static bool RefineEndpoints(const BlockPixels& pixels, unsigned int mask, unsigned int channelCount,
+	const unsigned char* indices, const float* weights, float* e0, float* e1)
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		float t = weights[indices[i]], s = 1.0f - t;
+		aa += s * s;
+		ab += s * t;
+		bb += t * t;
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			ax[c] += s * pixels.channels[c][i];
+			bx[c] += t * pixels.channels[c][i];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+	for (unsigned int c = 0; c < channelCount; c++)
+	{
+		e0[c] = Clamp255((ax[c] * bb - bx[c] * ab) / determinant);
+		e1[c] = Clamp255((bx[c] * aa - ax[c] * ab) / determinant);
+	}
+	return true;
+}
+
+static int RefineIterations(BlockQuality quality)
+{
+	return quality == BlockQuality::Fast ? 0 : quality == BlockQuality::Normal ? 1 : 3;
+}
+
+//BC1 / BC3 color
+
+static unsigned int ToRGB565(const float* color)
+{
+	unsigned int r = (unsigned int)(Clamp255(color[0]) * (31.0f / 255.0f) + 0.5f);
+	unsigned int g = (unsigned int)(Clamp255(color[1]) * (63.0f / 255.0f) + 0.5f);
+	unsigned int b = (unsigned int)(Clamp255(color[2]) * (31.0f / 255.0f) + 0.5f);
+	return (r << 11) | (g << 5) | b;
+}
+
+static void FromRGB565(unsigned int color, int* out)
+{
+	unsigned int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+	out[0] = (int)((r << 3) | (r >> 2));
+	out[1] = (int)((g << 2) | (g >> 4));
+	out[2] = (int)((b << 3) | (b >> 2));
+}
+
+//the four RGBA colors a BC1 block can pick from, the fourth one transparent black in three color mode
+static void ColorPalette(unsigned int c0, unsigned int c1, bool fourColors, int* palette)
+{
+	FromRGB565(c0, palette);
+	FromRGB565(c1, palette + 4);
+	for (int c = 0; c < 3; c++)
+	{
+		int a = palette[c], b = palette[4 + c];
+		palette[8 + c] = fourColors ? (2 * a + b) / 3 : (a + b) / 2;
+		palette[12 + c] = fourColors ? (a + 2 * b) / 3 : 0;
+	}
+	palette[3] = palette[7] = palette[11] = 255;
+	palette[15] = fourColors ? 255 : 0;
+}
+
+//BC1 color block, also the color half of BC3 whose palette always has four colors
+//With punchThrough the pixels outside opaque use the transparent entry of three color mode
+static void EncodeColorBlock(const BlockPixels& pixels, unsigned int opaque, bool punchThrough, BlockQuality quality,
+	BlockIndexFn selectIndices, unsigned char* out)
+{
+	unsigned int c0 = 0, c1 = 0;
+	unsigned char indices[16] = {};
+	if (opaque)
+	{
+		bool fourColors = !punchThrough;
+		const float weights[4] = { 0.0f, 1.0f, fourColors ? 1.0f / 3.0f : 0.5f, 2.0f / 3.0f };
+		float e0[4], e1[4];
+		FitPrincipalAxis(pixels, opaque, 3, e0, e1);
+
+		float bestError = MAX_ERROR;
+		unsigned char candidate[16];
+		for (int iteration = 0; iteration <= RefineIterations(quality); iteration++)
+		{
+			//four color mode needs c0 > c1, three color mode c0 <= c1
+			unsigned int a = ToRGB565(e0), b = ToRGB565(e1);
+			if (fourColors == (a < b))
+				std::swap(a, b);
+
+			int palette[16];
+			float paletteFloat[16];
+			ColorPalette(a, b, fourColors, palette);
+			for (int i = 0; i < 16; i++)
+				paletteFloat[i] = (float)palette[i];
+
+			//equal endpoints decode in three color mode, index 0 is the only one that is the same in both
+			unsigned int paletteSize = a == b ? 1 : fourColors ? 4 : 3;
+			float error = selectIndices(pixels, opaque, 3, paletteFloat, paletteSize, candidate);
+			if (error < bestError)
+			{
+				bestError = error;
+				c0 = a;
+				c1 = b;
+				std::memcpy(indices, candidate, sizeof(indices));
+			}
+
+			if (error == 0.0f || a == b || !RefineEndpoints(pixels, opaque, 3, candidate, weights, e0, e1))
+				break;
+		}
+	}
+
+	unsigned int bits = 0;
+	for (unsigned int i = 0; i < 16; i++)
+		bits |= (opaque & (1u << i) ? indices[i] : 3u) << (i * 2);
+
+	out[0] = (unsigned char)c0;
+	out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)c1;
+	out[3] = (unsigned char)(c1 >> 8);
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+static void DecodeColorBlock(const unsigned char* block, bool alwaysFourColors, unsigned int* pixels)
+{
+	unsigned int c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+	unsigned int bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+
+	int palette[16];
+	ColorPalette(c0, c1, alwaysFourColors || c0 > c1, palette);
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		const int* color = palette + ((bits >> (i * 2)) & 3) * 4;
+		pixels[i] = (unsigned int)color[0] | (color[1] << 8) | (color[2] << 16) | ((unsigned int)color[3] << 24);
+	}
+}
+
+//BC4, one channel
+
+//eight values between a0 and a1 when a0 > a1, otherwise six and the two extremes
+static void Bc4Palette(int a0, int a1, int* values)
+{
+	values[0] = a0;
+	values[1] = a1;
+	if (a0 > a1)
+	{
+		for (int i = 2; i < 8; i++)
+			values[i] = (2 * ((8 - i) * a0 + (i - 1) * a1) + 7) / 14;
+	}
+	else
+	{
+		for (int i = 2; i < 6; i++)
+			values[i] = (2 * ((6 - i) * a0 + (i - 1) * a1) + 5) / 10;
+		values[6] = 0;
+		values[7] = 255;
+	}
+}
+
+static void EncodeBc4Block(const float* values, BlockQuality quality, BlockIndexFn selectIndices, unsigned char* out)
+{
+	BlockPixels pixels;
+	std::memcpy(pixels.channels[0], values, sizeof(pixels.channels[0]));
+
+	float low = 255.0f, high = 0.0f, innerLow = 255.0f, innerHigh = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		low = std::min(low, values[i]);
+		high = std::max(high, values[i]);
+		if (values[i] > 0.0f && values[i] < 255.0f)
+		{
+			innerLow = std::min(innerLow, values[i]);
+			innerHigh = std::max(innerHigh, values[i]);
+		}
+	}
+
+	float bestError = MAX_ERROR;
+	int best0 = 0, best1 = 0;
+	unsigned char indices[16] = {}, candidate[16];
+	auto tryEndpoints = [&](int a0, int a1)
+	{
+		int values[8];
+		float palette[32] = {};
+		Bc4Palette(a0, a1, values);
+		for (int i = 0; i < 8; i++)
+			palette[i * 4] = (float)values[i];
+
+		float error = selectIndices(pixels, 0xFFFF, 1, palette, 8, candidate);
+		if (error < bestError)
+		{
+			bestError = error;
+			best0 = a0;
+			best1 = a1;
+			std::memcpy(indices, candidate, sizeof(indices));
+		}
+		return error;
+	};
+
+	if (high > low)
+	{
+		//eight values between the extremes, then least squares on the indices that gave
+		float e0[1] = { high }, e1[1] = { low };
+		const float weights[8] = { 0.0f, 1.0f, 1.0f / 7, 2.0f / 7, 3.0f / 7, 4.0f / 7, 5.0f / 7, 6.0f / 7 };
+		for (int iteration = 0; iteration <= RefineIterations(quality); iteration++)
+		{
+			int a0 = (int)(e0[0] + 0.5f), a1 = (int)(e1[0] + 0.5f);
+			if (a0 < a1)
+				std::swap(a0, a1);
+			if (a0 == a1 || tryEndpoints(a0, a1) == 0.0f)
+				break;
+			std::memcpy(candidate, indices, sizeof(candidate));
+			if (!RefineEndpoints(pixels, 0xFFFF, 1, candidate, weights, e0, e1))
+				break;
+		}
+	}
+
+	//six values between the inner extremes when the block also has pure 0 or 255, or a flat block
+	if (innerLow <= innerHigh)
+		tryEndpoints((int)innerLow, (int)innerHigh);
+	else
+		tryEndpoints((int)low, (int)low);
+
+	out[0] = (unsigned char)best0;
+	out[1] = (unsigned char)best1;
+	unsigned long long bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (unsigned long long)indices[i] << (i * 3);
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+static void DecodeBc4Block(const unsigned char* block, unsigned char* out)
+{
+	int values[8];
+	Bc4Palette(block[0], block[1], values);
+	unsigned long long bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= (unsigned long long)block[2 + i] << (i * 8);
+	for (int i = 0; i < 16; i++)
+		out[i] = (unsigned char)values[(bits >> (i * 3)) & 7];
+}
+
+//BC7
+
+//Fills a zeroed 128 bit block from its lowest bit up
+struct BitWriter
+{
+	unsigned char* out;
+	unsigned int position;
+
+	void write(unsigned int value, unsigned int bits)
+	{
+		for (unsigned int b = 0; b < bits; b++, position++)
+			if ((value >> b) & 1)
+				out[position >> 3] |= (unsigned char)(1u << (position & 7));
+	}
+};
+
+struct BitReader
+{
+	const unsigned char* in;
+	unsigned int position;
+
+	unsigned int read(unsigned int bits)
+	{
+		unsigned int value = 0;
+		for (unsigned int b = 0; b < bits; b++, position++)
+			value |= ((in[position >> 3] >> (position & 7)) & 1u) << b;
+		return value;
+	}
+};
+
+static int Interpolate(int a, int b, int weight)
+{
+	return ((64 - weight) * a + weight * b + 32) >> 6;
+}
+
+//closest code of `bits` bits to v (0..255) once the p-bit is appended and the result expanded to 8 bits
+static int QuantizeWithPBit(float v, unsigned int bits, unsigned int p)
+{
+	float levels = (float)((1 << (bits + 1)) - 1);
+	int code = (int)std::floor((v * levels / 255.0f - p) * 0.5f + 0.5f);
+	return std::min((1 << bits) - 1, std::max(0, code));
+}
+
+static int ExpandWithPBit(int code, unsigned int bits, unsigned int p)
+{
+	int value = (code << 1) | (int)p;
+	int total = (int)bits + 1;
+	return total == 8 ? value : (value << (8 - total)) | (value >> (2 * total - 8));
+}
+
+//p-bit that brings the quantized endpoint closest to e
+static unsigned int ClosestPBit(const float* e, unsigned int channelCount, unsigned int bits)
+{
+	float error[2] = {};
+	for (unsigned int p = 0; p < 2; p++)
+	{
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			float delta = ExpandWithPBit(QuantizeWithPBit(e[c], bits, p), bits, p) - e[c];
+			error[p] += delta * delta;
+		}
+	}
+	return error[1] < error[0] ? 1 : 0;
+}
+
+//mode 6: one subset, RGBA endpoints of 7 bits plus a p-bit each, 4 bit indices
+static float EncodeMode6(const BlockPixels& pixels, BlockQuality quality, BlockIndexFn selectIndices, unsigned char* out)
+{
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = BC7_WEIGHTS4[i] / 64.0f;
+
+	float e0[4], e1[4];
+	FitPrincipalAxis(pixels, 0xFFFF, 4, e0, e1);
+
+	float bestError = MAX_ERROR;
+	int best0[4] = {}, best1[4] = {};
+	unsigned int bestP0 = 0, bestP1 = 0;
+	unsigned char indices[16] = {}, candidate[16];
+	for (int iteration = 0; iteration <= RefineIterations(quality); iteration++)
+	{
+		for (unsigned int pair = 0; pair < 4; pair++)
+		{
+			//fast mode only tries the p-bits closest to the endpoints
+			bool fast = quality == BlockQuality::Fast;
+			unsigned int p0 = fast ? ClosestPBit(e0, 4, 7) : pair & 1;
+			unsigned int p1 = fast ? ClosestPBit(e1, 4, 7) : pair >> 1;
+			int q0[4], q1[4], v0[4], v1[4];
+			for (int c = 0; c < 4; c++)
+			{
+				q0[c] = QuantizeWithPBit(e0[c], 7, p0);
+				q1[c] = QuantizeWithPBit(e1[c], 7, p1);
+				v0[c] = ExpandWithPBit(q0[c], 7, p0);
+				v1[c] = ExpandWithPBit(q1[c], 7, p1);
+			}
+
+			float palette[64];
+			for (int i = 0; i < 16; i++)
+				for (int c = 0; c < 4; c++)
+					palette[i * 4 + c] = (float)Interpolate(v0[c], v1[c], BC7_WEIGHTS4[i]);
+
+			float error = selectIndices(pixels, 0xFFFF, 4, palette, 16, candidate);
+			if (error < bestError)
+			{
+				bestError = error;
+				std::memcpy(best0, q0, sizeof(best0));
+				std::memcpy(best1, q1, sizeof(best1));
+				bestP0 = p0;
+				bestP1 = p1;
+				std::memcpy(indices, candidate, sizeof(indices));
+			}
+
+			if (fast)
+				break;
+		}
+
+		if (bestError == 0.0f || !RefineEndpoints(pixels, 0xFFFF, 4, indices, weights, e0, e1))
+			break;
+	}
+
+	//the anchor index is stored without its top bit, flip the endpoints when it is set
+	if (indices[0] & 8)
+	{
+		std::swap(best0, best1);
+		std::swap(bestP0, bestP1);
+		for (int i = 0; i < 16; i++)
+			indices[i] = (unsigned char)(15 - indices[i]);
+	}
+
+	std::memset(out, 0, 16);
+	BitWriter writer = { out, 0 };
+	writer.write(1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writer.write(best0[c], 7);
+		writer.write(best1[c], 7);
+	}
+	writer.write(bestP0, 1);
+	writer.write(bestP1, 1);
+	for (int i = 0; i < 16; i++)
+		writer.write(indices[i], i == 0 ? 3 : 4);
+	return bestError;
+}
+
+//Sums of the colors of a subset and of their products, enough for its covariance
+struct ColorMoments
+{
+	float count;
+	float sum[3];
+	float products[6]; //rr, rg, rb, gg, gb, bb
+};
+
+//Squared distance of the pixels of a subset to their principal axis, its error before quantization
+static float AxisResidual(const ColorMoments& moments)
+{
+	if (moments.count < 2.0f)
+		return 0.0f;
+
+	float mean[3];
+	for (int c = 0; c < 3; c++)
+		mean[c] = moments.sum[c] / moments.count;
+	const float* p = moments.products;
+	float covariance[3][3];
+	covariance[0][0] = p[0] - moments.sum[0] * mean[0];
+	covariance[0][1] = covariance[1][0] = p[1] - moments.sum[0] * mean[1];
+	covariance[0][2] = covariance[2][0] = p[2] - moments.sum[0] * mean[2];
+	covariance[1][1] = p[3] - moments.sum[1] * mean[1];
+	covariance[1][2] = covariance[2][1] = p[4] - moments.sum[1] * mean[2];
+	covariance[2][2] = p[5] - moments.sum[2] * mean[2];
+
+	//the largest eigenvalue is the part along the axis, the trace all of it
+	//a few power iterations rescaled by the largest component, then the Rayleigh quotient
+	float axis[3] = { 1.0f, 1.0f, 1.0f }, next[3];
+	for (int iteration = 0; iteration < 4; iteration++)
+	{
+		float largest = 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+			largest = std::max(largest, std::fabs(next[a]));
+		}
+		if (largest == 0.0f)
+			return 0.0f;
+		float scale = 1.0f / largest;
+		for (int a = 0; a < 3; a++)
+			axis[a] = next[a] * scale;
+	}
+
+	float along = 0.0f, length = 0.0f;
+	for (int a = 0; a < 3; a++)
+	{
+		along += axis[a] * (covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2]);
+		length += axis[a] * axis[a];
+	}
+	return std::max(0.0f, covariance[0][0] + covariance[1][1] + covariance[2][2] - along / length);
+}
+
+//Error of every two subset partition along the principal axes of its subsets, ranks them before encoding any
+//The second subset's moments are summed per partition, the first's are what's left of the block's
+static void EstimatePartitions(const BlockPixels& pixels, float* estimates)
+{
+	ColorMoments perPixel[16], block = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float r = pixels.channels[0][i], g = pixels.channels[1][i], b = pixels.channels[2][i];
+		ColorMoments m = { 1.0f, { r, g, b }, { r * r, r * g, r * b, g * g, g * b, b * b } };
+		perPixel[i] = m;
+		block.count += 1.0f;
+		for (int c = 0; c < 3; c++)
+			block.sum[c] += m.sum[c];
+		for (int c = 0; c < 6; c++)
+			block.products[c] += m.products[c];
+	}
+
+	for (unsigned int partition = 0; partition < 64; partition++)
+	{
+		ColorMoments second = {};
+		for (unsigned int bits = BC7_PARTITIONS2[partition]; bits; bits &= bits - 1)
+		{
+			int i = CountTrailingZeros(bits);
+			second.count += 1.0f;
+			for (int c = 0; c < 3; c++)
+				second.sum[c] += perPixel[i].sum[c];
+			for (int c = 0; c < 6; c++)
+				second.products[c] += perPixel[i].products[c];
+		}
+
+		ColorMoments first = block;
+		first.count -= second.count;
+		for (int c = 0; c < 3; c++)
+			first.sum[c] -= second.sum[c];
+		for (int c = 0; c < 6; c++)
+			first.products[c] -= second.products[c];
+		estimates[partition] = AxisResidual(first) + AxisResidual(second);
+	}
+}
+
+struct Mode1Subset
+{
+	int q0[3], q1[3];
+	unsigned int p;
+};
+
+//one subset of a mode 1 block, RGB endpoints of 6 bits with a p-bit shared by both, 3 bit indices
+static float EncodeMode1Subset(const BlockPixels& pixels, unsigned int mask, BlockQuality quality, BlockIndexFn selectIndices,
+	Mode1Subset& subset, unsigned char* indices)
+{
+	float weights[8];
+	for (int i = 0; i < 8; i++)
+		weights[i] = BC7_WEIGHTS3[i] / 64.0f;
+
+	float e0[4], e1[4];
+	FitPrincipalAxis(pixels, mask, 3, e0, e1);
+
+	float bestError = MAX_ERROR;
+	unsigned char candidate[16];
+	for (int iteration = 0; iteration <= RefineIterations(quality); iteration++)
+	{
+		for (unsigned int p = 0; p < 2; p++)
+		{
+			Mode1Subset trial;
+			trial.p = p;
+			float palette[32] = {};
+			for (int c = 0; c < 3; c++)
+			{
+				trial.q0[c] = QuantizeWithPBit(e0[c], 6, p);
+				trial.q1[c] = QuantizeWithPBit(e1[c], 6, p);
+				int v0 = ExpandWithPBit(trial.q0[c], 6, p), v1 = ExpandWithPBit(trial.q1[c], 6, p);
+				for (int i = 0; i < 8; i++)
+					palette[i * 4 + c] = (float)Interpolate(v0, v1, BC7_WEIGHTS3[i]);
+			}
+
+			float error = selectIndices(pixels, mask, 3, palette, 8, candidate);
+			if (error < bestError)
+			{
+				bestError = error;
+				subset = trial;
+				for (unsigned int i = 0; i < 16; i++)
+					if (mask & (1u << i))
+						indices[i] = candidate[i];
+			}
+		}
+
+		if (bestError == 0.0f || !RefineEndpoints(pixels, mask, 3, indices, weights, e0, e1))
+			break;
+	}
+	return bestError;
+}
+
+//mode 1: two subsets of RGB, for opaque blocks with more than one gradient
+static float EncodeMode1(const BlockPixels& pixels, BlockQuality quality, BlockIndexFn selectIndices, unsigned char* out)
+{
+	//only the partitions with the lowest estimate are encoded
+	unsigned int order[64];
+	float estimates[64];
+	EstimatePartitions(pixels, estimates);
+	for (unsigned int p = 0; p < 64; p++)
+		order[p] = p;
+	unsigned int tries = quality == BlockQuality::Best ? BC7_BEST_PARTITIONS : BC7_NORMAL_PARTITIONS;
+	std::partial_sort(order, order + tries, order + 64, [&](unsigned int a, unsigned int b)
+	{
+		return estimates[a] < estimates[b] || (estimates[a] == estimates[b] && a < b);
+	});
+
+	float bestError = MAX_ERROR;
+	unsigned int bestPartition = 0;
+	Mode1Subset best[2] = {};
+	unsigned char indices[16] = {};
+	for (unsigned int t = 0; t < tries; t++)
+	{
+		unsigned int partition = order[t];
+		unsigned int second = BC7_PARTITIONS2[partition];
+		Mode1Subset subsets[2];
+		unsigned char candidate[16];
+		float error = EncodeMode1Subset(pixels, ~second & 0xFFFF, quality, selectIndices, subsets[0], candidate);
+		if (error >= bestError)
+			continue;
+		error += EncodeMode1Subset(pixels, second, quality, selectIndices, subsets[1], candidate);
+		if (error < bestError)
+		{
+			bestError = error;
+			bestPartition = partition;
+			best[0] = subsets[0];
+			best[1] = subsets[1];
+			std::memcpy(indices, candidate, sizeof(indices));
+		}
+	}
+
+	//anchor indices are stored without their top bit
+	unsigned int second = BC7_PARTITIONS2[bestPartition];
+	unsigned int anchors[2] = { 0, BC7_ANCHORS2[bestPartition] };
+	for (unsigned int s = 0; s < 2; s++)
+	{
+		if (!(indices[anchors[s]] & 4))
+			continue;
+		std::swap(best[s].q0, best[s].q1);
+		for (unsigned int i = 0; i < 16; i++)
+			if (((second >> i) & 1) == s)
+				indices[i] = (unsigned char)(7 - indices[i]);
+	}
+
+	std::memset(out, 0, 16);
+	BitWriter writer = { out, 0 };
+	writer.write(1 << 1, 2);
+	writer.write(bestPartition, 6);
+	for (int c = 0; c < 3; c++)
+	{
+		for (int s = 0; s < 2; s++)
+		{
+			writer.write(best[s].q0[c], 6);
+			writer.write(best[s].q1[c], 6);
+		}
+	}
+	writer.write(best[0].p, 1);
+	writer.write(best[1].p, 1);
+	for (unsigned int i = 0; i < 16; i++)
+		writer.write(indices[i], i == anchors[0] || i == anchors[1] ? 2 : 3);
+	return bestError;
+}
+
+static void EncodeBc7Block(const BlockPixels& pixels, BlockQuality quality, BlockIndexFn selectIndices, unsigned char* out)
+{
+	float error = EncodeMode6(pixels, quality, selectIndices, out);
+	if (quality == BlockQuality::Fast || error == 0.0f)
+		return;
+
+	for (int i = 0; i < 16; i++)
+		if (pixels.channels[3][i] != 255.0f)
+			return;
+
+	unsigned char block[16];
+	if (EncodeMode1(pixels, quality, selectIndices, block) < error)
+		std::memcpy(out, block, sizeof(block));
+}
+
+static void DecodeBc7Block(const unsigned char* block, unsigned int* pixels)
+{
+	unsigned int mode = 0;
+	while (mode < 8 && !(block[0] & (1u << mode)))
+		mode++;
+	if (mode == 8)
+	{
+		//reserved, decodes to transparent black
+		std::memset(pixels, 0, 16 * sizeof(unsigned int));
+		return;
+	}
+
+	const Bc7Mode& info = BC7_MODES[mode];
+	BitReader reader = { block, mode + 1 };
+	unsigned int partition = reader.read(info.partitionBits);
+	unsigned int rotation = reader.read(info.rotationBits);
+	unsigned int selection = reader.read(info.selectionBits);
+
+	unsigned int endpointCount = info.subsets * 2;
+	int endpoints[6][4];
+	for (int c = 0; c < 3; c++)
+		for (unsigned int e = 0; e < endpointCount; e++)
+			endpoints[e][c] = (int)reader.read(info.colorBits);
+	for (unsigned int e = 0; e < endpointCount; e++)
+		endpoints[e][3] = (int)reader.read(info.alphaBits);
+
+	unsigned int pBits[6] = {};
+	bool hasPBits = info.endpointPBits || info.sharedPBits;
+	if (info.endpointPBits)
+		for (unsigned int e = 0; e < endpointCount; e++)
+			pBits[e] = reader.read(1);
+	if (info.sharedPBits)
+		for (unsigned int s = 0; s < info.subsets; s++)
+			pBits[s * 2] = pBits[s * 2 + 1] = reader.read(1);
+
+	for (unsigned int e = 0; e < endpointCount; e++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			unsigned int bits = c < 3 ? info.colorBits : info.alphaBits;
+			if (bits == 0)
+			{
+				endpoints[e][c] = 255;
+				continue;
+			}
+			int value = endpoints[e][c];
+			if (hasPBits)
+			{
+				value = (value << 1) | (int)pBits[e];
+				bits++;
+			}
+			endpoints[e][c] = bits == 8 ? value : (value << (8 - bits)) | (value >> (2 * bits - 8));
+		}
+	}
+
+	//subset of every pixel, two bits each, and the pixels starting a subset (0 for the ones not there)
+	unsigned int subsets = 0, anchors[3] = { 0, 0, 0 };
+	if (info.subsets == 2)
+	{
+		for (unsigned int i = 0; i < 16; i++)
+			subsets |= ((BC7_PARTITIONS2[partition] >> i) & 1) << (i * 2);
+		anchors[1] = BC7_ANCHORS2[partition];
+	}
+	else if (info.subsets == 3)
+	{
+		subsets = BC7_PARTITIONS3[partition];
+		anchors[1] = BC7_ANCHORS3_SECOND[partition];
+		anchors[2] = BC7_ANCHORS3_THIRD[partition];
+	}
+
+	unsigned int indices[16], indices2[16] = {};
+	for (unsigned int i = 0; i < 16; i++)
+		indices[i] = reader.read(info.indexBits - (i == anchors[0] || i == anchors[1] || i == anchors[2] ? 1 : 0));
+	if (info.index2Bits)
+		for (unsigned int i = 0; i < 16; i++)
+			indices2[i] = reader.read(info.index2Bits - (i == 0 ? 1 : 0));
+
+	const unsigned char* weights[5] = { nullptr, nullptr, BC7_WEIGHTS2, BC7_WEIGHTS3, BC7_WEIGHTS4 };
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		unsigned int subset = (subsets >> (i * 2)) & 3;
+		const int* e0 = endpoints[subset * 2];
+		const int* e1 = endpoints[subset * 2 + 1];
+
+		//with two index sets the color uses the first one and alpha the second, or the other way with the selection bit
+		int colorWeight = weights[info.indexBits][indices[i]], alphaWeight = colorWeight;
+		if (info.index2Bits)
+		{
+			int weight2 = weights[info.index2Bits][indices2[i]];
+			colorWeight = selection ? weight2 : colorWeight;
+			alphaWeight = selection ? alphaWeight : weight2;
+		}
+
+		int color[4];
+		for (int c = 0; c < 3; c++)
+			color[c] = Interpolate(e0[c], e1[c], colorWeight);
+		color[3] = Interpolate(e0[3], e1[3], alphaWeight);
+		if (rotation)
+			std::swap(color[3], color[rotation - 1]);
+
+		pixels[i] = (unsigned int)color[0] | (color[1] << 8) | (color[2] << 16) | ((unsigned int)color[3] << 24);
+	}
+}
+
+static void CompressBlockWith(const unsigned int* pixels, const BlockOptions& options, BlockIndexFn selectIndices, unsigned char* out)
+{
+	BlockPixels block;
+	unsigned int opaque = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			block.channels[c][i] = (float)((pixels[i] >> (c * 8)) & 0xFF);
+		if (pixels[i] >> 31)
+			opaque |= 1u << i;
+	}
+
+	switch (options.format)
+	{
+	case BlockFormat::BC1:
+		EncodeColorBlock(block, opaque, opaque != 0xFFFF, options.quality, selectIndices, out);
+		break;
+	case BlockFormat::BC3:
+		EncodeBc4Block(block.channels[3], options.quality, selectIndices, out);
+		EncodeColorBlock(block, 0xFFFF, false, options.quality, selectIndices, out + 8);
+		break;
+	case BlockFormat::BC4:
+		EncodeBc4Block(block.channels[0], options.quality, selectIndices, out);
+		break;
+	case BlockFormat::BC5:
+		EncodeBc4Block(block.channels[0], options.quality, selectIndices, out);
+		EncodeBc4Block(block.channels[1], options.quality, selectIndices, out + 8);
+		break;
+	case BlockFormat::BC7:
+		EncodeBc7Block(block, options.quality, selectIndices, out);
+		break;
+	}
+}
+
+void CompressBlock(const unsigned int* pixels, const BlockOptions& options, unsigned char* out)
+{
+	CompressBlockWith(pixels, options, GetBlockIndexFn(GetSimdLevel()), out);
+}
+
+void DecompressBlock(BlockFormat format, const unsigned char* block, unsigned int* pixels)
+{
+	unsigned char first[16], second[16];
+	switch (format)
+	{
+	case BlockFormat::BC1:
+		DecodeColorBlock(block, false, pixels);
+		break;
+	case BlockFormat::BC3:
+		DecodeColorBlock(block + 8, true, pixels);
+		DecodeBc4Block(block, first);
+		for (int i = 0; i < 16; i++)
+			pixels[i] = (pixels[i] & 0x00FFFFFFu) | ((unsigned int)first[i] << 24);
+		break;
+	case BlockFormat::BC4:
+		DecodeBc4Block(block, first);
+		for (int i = 0; i < 16; i++)
+			pixels[i] = first[i] | 0xFF000000u;
+		break;
+	case BlockFormat::BC5:
+		DecodeBc4Block(block, first);
+		DecodeBc4Block(block + 8, second);
+		for (int i = 0; i < 16; i++)
+			pixels[i] = first[i] | (second[i] << 8) | 0xFF000000u;
+		break;
+	case BlockFormat::BC7:
+		DecodeBc7Block(block, pixels);
+		break;
+	}
+}
+
+void CompressImage(const Image& image, const BlockOptions& options, CompressedImage& out)
+{
+	out.format = options.format;
+	out.width = image.width;
+	out.height = image.height;
+	out.data.assign(CompressedSize(options.format, image.width, image.height), 0);
+	if (image.width == 0 || image.height == 0)
+		return;
+
+	unsigned int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+	unsigned int blockBytes = BlockBytes(options.format);
+	BlockIndexFn selectIndices = GetBlockIndexFn(GetSimdLevel());
+	GetThreadPool().parallelFor(blocksY, 1, [&](unsigned int begin, unsigned int end)
+	{
+		unsigned int pixels[16];
+		for (unsigned int by = begin; by < end; by++)
+		{
+			for (unsigned int bx = 0; bx < blocksX; bx++)
+			{
+				for (unsigned int i = 0; i < 16; i++)
+				{
+					unsigned int x = std::min(bx * 4 + i % 4, image.width - 1);
+					unsigned int y = std::min(by * 4 + i / 4, image.height - 1);
+					pixels[i] = image.pixels[(size_t)y * image.width + x];
+				}
+				CompressBlockWith(pixels, options, selectIndices, &out.data[((size_t)by * blocksX + bx) * blockBytes]);
+			}
+		}
+	});
+}
+
+void DecompressImage(const CompressedImage& image, Image& out)
+{
+	out = Image(image.width, image.height);
+	unsigned int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+	unsigned int blockBytes = BlockBytes(image.format);
+	GetThreadPool().parallelFor(blocksY, 4, [&](unsigned int begin, unsigned int end)
+	{
+		unsigned int pixels[16];
+		for (unsigned int by = begin; by < end; by++)
+		{
+			for (unsigned int bx = 0; bx < blocksX; bx++)
+			{
+				DecompressBlock(image.format, &image.data[((size_t)by * blocksX + bx) * blockBytes], pixels);
+				for (unsigned int i = 0; i < 16; i++)
+				{
+					unsigned int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+					if (x < image.width && y < image.height)
+						out.pixels[(size_t)y * image.width + x] = pixels[i];
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include "image.h"
+#include "simd.h"
+
+//GPU block compression formats, all of them store 4x4 pixel blocks
+enum class BlockFormat
+{
+	BC1, //RGB and 1 bit alpha, 8 bytes per block
+	BC3, //RGBA, the color of BC1 plus a BC4 alpha block, 16 bytes
+	BC4, //one channel (R), 8 bytes
+	BC5, //two channels (R, G), normal maps, 16 bytes
+	BC7  //RGBA at close to source quality, 16 bytes
+};
+
+enum class BlockQuality
+{
+	Fast,   //endpoints from the principal axis only
+	Normal, //plus least squares refinement, BC7 also tries two subset partitions on opaque blocks
+	Best    //more refinement and more partitions, several times slower than Normal
+};
+
+struct BlockOptions
+{
+	BlockFormat format = BlockFormat::BC7;
+	BlockQuality quality = BlockQuality::Normal;
+};
+
+//Blocks of a compressed image, left to right then row by row in the same order as the rows of Image,
+//so the data can be given to glCompressedTexImage2D as is
+struct CompressedImage
+{
+	BlockFormat format = BlockFormat::BC7;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	bool srgb = true; //the color channels are sRGB encoded, only a tag for the GPU format, compression is the same
+	std::vector<unsigned char> data;
+};
+
+unsigned int BlockBytes(BlockFormat format);
+const char* BlockFormatName(BlockFormat format);
+size_t CompressedSize(BlockFormat format, unsigned int width, unsigned int height);
+
+//Compresses the image block by block on the thread pool
+//Sizes that aren't multiples of 4 are padded by repeating the last row and column
+void CompressImage(const Image& image, const BlockOptions& options, CompressedImage& out);
+
+//Back to RGBA8, for checking the quality of the compression and for GPUs without the format
+void DecompressImage(const CompressedImage& image, Image& out);
+
+//One block, pixels are 4 rows of 4 RGBA8 pixels, out gets BlockBytes(format) bytes
+void CompressBlock(const unsigned int* pixels, const BlockOptions& options, unsigned char* out);
+
+//Every BC7 mode decodes, also the three subset modes 0 and 2 the encoder never makes
+void DecompressBlock(BlockFormat format, const unsigned char* block, unsigned int* pixels);
+
+//The 16 pixels of a block with one array per channel, values 0..255
+struct BlockPixels
+{
+	float channels[4][16];
+};
+
+//Picks for every pixel of mask (bit i is pixel i) the palette entry closest over the first channelCount channels,
+//palette entries being 4 floats each, and returns the sum of the squared distances
+//Pixels outside the mask keep their index, ties go to the lowest entry
+typedef float (*BlockIndexFn)(const BlockPixels& pixels, unsigned int mask, unsigned int channelCount,
+	const float* palette, unsigned int paletteSize, unsigned char* indices);
+
+BlockIndexFn GetBlockIndexFn(SimdLevel level);
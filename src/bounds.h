@@ -0,0 +1,30 @@
+#pragma once
+
+//Axis aligned bounding box
+struct AABB
+{
+	float min[3];
+	float max[3];
+};
+
+struct Sphere
+{
+	float center[3];
+	float radius;
+};
+
+//Plane as nx*x + ny*y + nz*z + d = 0, the normal points to the inside of the volume
+struct Plane
+{
+	float nx, ny, nz, d;
+};
+
+//Left, right, bottom, top, near, far
+struct Frustum
+{
+	Plane planes[6];
+};
+
+//Extracts the six clip planes from a column-major (OpenGL layout) view-projection matrix
+//The planes are normalized so distances are in world units
+Frustum ExtractFrustum(const float* viewProjection);
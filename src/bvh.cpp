@@ -0,0 +1,470 @@
+#include "bvh.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+const unsigned int BVH::MAX_LEAF_SIZE;
+const unsigned int BVH::PARALLEL_BUILD_THRESHOLD;
+
+static const int BIN_COUNT = 16;
+static const unsigned int STACK_SIZE = 128;
+
+//The traversals hold at most one node per level on their stack, fixed is used unless the tree is deeper than that
+template<typename T>
+static T* TraversalStack(T* fixed, std::vector<T>& deep, unsigned int depth)
+{
+	if (depth <= STACK_SIZE)
+		return fixed;
+	deep.resize(depth);
+	return deep.data();
+}
+
+static void ResetBounds(float* min, float* max)
+{
+	min[0] = min[1] = min[2] = FLT_MAX;
+	max[0] = max[1] = max[2] = -FLT_MAX;
+}
+
+static void GrowBounds(float* min, float* max, const float* otherMin, const float* otherMax)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		min[i] = std::min(min[i], otherMin[i]);
+		max[i] = std::max(max[i], otherMax[i]);
+	}
+}
+
+static float HalfArea(const float* min, const float* max)
+{
+	float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+	if (x < 0.0f) //empty bounds
+		return 0.0f;
+	return x * y + y * z + z * x;
+}
+
+void BVH::build(const AABB* boxes, unsigned int count)
+{
+	m_bounds.assign(boxes, boxes + count);
+	m_indices.resize(count);
+	m_centroids.resize(count * 3);
+	m_nodes.clear();
+	m_depth = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		m_indices[i] = i;
+		for (int a = 0; a < 3; a++)
+			m_centroids[i * 3 + a] = (boxes[i].min[a] + boxes[i].max[a]) * 0.5f;
+	}
+
+	if (count == 0)
+		return;
+
+	m_nodes.reserve(count * 2 / MAX_LEAF_SIZE + 1);
+	m_depth = buildRange(0, count, m_nodes);
+
+	m_centroids.clear();
+	m_centroids.shrink_to_fit();
+}
+
+//Emits the subtree over m_indices[begin, end) into nodes, depth first, with child indices relative to nodes
+//Returns the subtree's depth, 1 for a leaf
+unsigned int BVH::buildRange(unsigned int begin, unsigned int end, std::vector<BVHNode>& nodes)
+{
+	unsigned int nodeIndex = (unsigned int)nodes.size();
+	nodes.push_back(BVHNode());
+
+	BVHNode node;
+	ResetBounds(node.min, node.max);
+	for (unsigned int i = begin; i < end; i++)
+		GrowBounds(node.min, node.max, m_bounds[m_indices[i]].min, m_bounds[m_indices[i]].max);
+
+	unsigned int mid;
+	if (!findSplit(begin, end, node, mid))
+	{
+		node.leftFirst = begin;
+		node.count = end - begin;
+		nodes[nodeIndex] = node;
+		return 1;
+	}
+
+	node.count = 0;
+	unsigned int depths[2];
+	if (end - begin > PARALLEL_BUILD_THRESHOLD)
+	{
+		//both halves work on disjoint ranges of m_indices, so they can be built at the same time
+		std::vector<BVHNode> children[2];
+		GetThreadPool().parallelFor(2, 1, [&](unsigned int first, unsigned int last)
+		{
+			for (unsigned int c = first; c < last; c++)
+				depths[c] = buildRange(c == 0 ? begin : mid, c == 0 ? mid : end, children[c]);
+		});
+
+		unsigned int offset = (unsigned int)nodes.size();
+		for (int c = 0; c < 2; c++)
+		{
+			if (c == 1)
+				node.leftFirst = offset;
+
+			for (BVHNode& child : children[c])
+			{
+				if (!child.isLeaf())
+					child.leftFirst += offset;
+				nodes.push_back(child);
+			}
+			offset += (unsigned int)children[c].size();
+		}
+	}
+	else
+	{
+		depths[0] = buildRange(begin, mid, nodes);
+		node.leftFirst = (unsigned int)nodes.size();
+		depths[1] = buildRange(mid, end, nodes);
+	}
+	nodes[nodeIndex] = node;
+	return std::max(depths[0], depths[1]) + 1;
+}
+
+//Bins the centroids along each axis and picks the cheapest SAH split
+//Returns false when the range should become a leaf, otherwise partitions it and writes the split point to mid
+bool BVH::findSplit(unsigned int begin, unsigned int end, const BVHNode& node, unsigned int& mid)
+{
+	unsigned int count = end - begin;
+	if (count <= 2)
+		return false;
+
+	float centroidMin[3], centroidMax[3];
+	ResetBounds(centroidMin, centroidMax);
+	for (unsigned int i = begin; i < end; i++)
+	{
+		const float* c = &m_centroids[m_indices[i] * 3];
+		GrowBounds(centroidMin, centroidMax, c, c);
+	}
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f)
+			continue;
+
+		float binMin[BIN_COUNT][3], binMax[BIN_COUNT][3];
+		unsigned int binCount[BIN_COUNT] = {};
+		for (int b = 0; b < BIN_COUNT; b++)
+			ResetBounds(binMin[b], binMax[b]);
+
+		float scale = BIN_COUNT / extent;
+		for (unsigned int i = begin; i < end; i++)
+		{
+			unsigned int id = m_indices[i];
+			int b = std::min(BIN_COUNT - 1, (int)((m_centroids[id * 3 + axis] - centroidMin[axis]) * scale));
+			binCount[b]++;
+			GrowBounds(binMin[b], binMax[b], m_bounds[id].min, m_bounds[id].max);
+		}
+
+		//sweep from the right to get the cost of the right side of every split plane
+		float rightArea[BIN_COUNT];
+		unsigned int rightCount[BIN_COUNT];
+		float accMin[3], accMax[3];
+		ResetBounds(accMin, accMax);
+		unsigned int accCount = 0;
+		for (int b = BIN_COUNT - 1; b > 0; b--)
+		{
+			GrowBounds(accMin, accMax, binMin[b], binMax[b]);
+			accCount += binCount[b];
+			rightArea[b] = HalfArea(accMin, accMax);
+			rightCount[b] = accCount;
+		}
+
+		ResetBounds(accMin, accMax);
+		accCount = 0;
+		for (int b = 0; b < BIN_COUNT - 1; b++)
+		{
+			GrowBounds(accMin, accMax, binMin[b], binMax[b]);
+			accCount += binCount[b];
+			if (accCount == 0 || rightCount[b + 1] == 0)
+				continue;
+
+			float cost = HalfArea(accMin, accMax) * accCount + rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	//traversal costs about as much as one box test
+	float leafCost = (float)count;
+	float area = HalfArea(node.min, node.max);
+	float splitCost = bestAxis < 0 ? FLT_MAX : 1.0f + (area > 0.0f ? bestCost / area : 0.0f);
+
+	if (bestAxis < 0)
+	{
+		//all centroids at the same spot, split the list in half if it is too long for a leaf
+		if (count <= MAX_LEAF_SIZE)
+			return false;
+		mid = begin + count / 2;
+		return true;
+	}
+
+	if (splitCost >= leafCost && count <= MAX_LEAF_SIZE)
+		return false;
+
+	float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+	float axisMin = centroidMin[bestAxis];
+	const float* centroids = m_centroids.data();
+	unsigned int* split = std::partition(m_indices.data() + begin, m_indices.data() + end, [&](unsigned int id)
+	{
+		int b = std::min(BIN_COUNT - 1, (int)((centroids[id * 3 + bestAxis] - axisMin) * scale));
+		return b <= bestBin;
+	});
+
+	mid = (unsigned int)(split - m_indices.data());
+	if (mid == begin || mid == end)
+		mid = begin + count / 2;
+	return true;
+}
+
+void BVH::update(unsigned int id, const AABB& box)
+{
+	m_bounds[id] = box;
+}
+
+void BVH::refit()
+{
+	if (m_nodes.empty())
+		return;
+
+	BVHNode* nodes = m_nodes.data();
+	const unsigned int* indices = m_indices.data();
+	const AABB* bounds = m_bounds.data();
+
+	//leaves first, they are independent of each other
+	GetThreadPool().parallelFor((unsigned int)m_nodes.size(), 4096, [=](unsigned int first, unsigned int last)
+	{
+		for (unsigned int n = first; n < last; n++)
+		{
+			BVHNode& node = nodes[n];
+			if (!node.isLeaf())
+				continue;
+
+			ResetBounds(node.min, node.max);
+			for (unsigned int i = 0; i < node.count; i++)
+				GrowBounds(node.min, node.max, bounds[indices[node.leftFirst + i]].min, bounds[indices[node.leftFirst + i]].max);
+		}
+	});
+
+	//children always come after their parent, so a reverse pass sees them before the parent
+	for (unsigned int n = (unsigned int)m_nodes.size(); n-- > 0;)
+	{
+		BVHNode& node = nodes[n];
+		if (node.isLeaf())
+			continue;
+
+		const BVHNode& left = nodes[n + 1];
+		const BVHNode& right = nodes[node.leftFirst];
+		for (int a = 0; a < 3; a++)
+		{
+			node.min[a] = std::min(left.min[a], right.min[a]);
+			node.max[a] = std::max(left.max[a], right.max[a]);
+		}
+	}
+}
+
+//-1 outside, 0 intersecting, 1 fully inside
+static int ClassifyBox(const Frustum& frustum, const float* min, const float* max)
+{
+	float center[3], extent[3];
+	for (int a = 0; a < 3; a++)
+	{
+		center[a] = (min[a] + max[a]) * 0.5f;
+		extent[a] = (max[a] - min[a]) * 0.5f;
+	}
+
+	int result = 1;
+	for (int p = 0; p < 6; p++)
+	{
+		const Plane& plane = frustum.planes[p];
+		float distance = plane.nx * center[0] + plane.ny * center[1] + plane.nz * center[2] + plane.d;
+		float radius = std::fabs(plane.nx) * extent[0] + std::fabs(plane.ny) * extent[1] + std::fabs(plane.nz) * extent[2];
+		if (distance + radius < 0.0f)
+			return -1;
+		if (distance - radius < 0.0f)
+			result = 0;
+	}
+	return result;
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& out) const
+{
+	if (m_nodes.empty())
+		return;
+
+	//the second value tells if the node is already known to be fully inside
+	unsigned int fixedStack[STACK_SIZE];
+	unsigned char fixedInside[STACK_SIZE];
+	std::vector<unsigned int> deepStack;
+	std::vector<unsigned char> deepInside;
+	unsigned int* stack = TraversalStack(fixedStack, deepStack, m_depth);
+	unsigned char* inside = TraversalStack(fixedInside, deepInside, m_depth);
+	int top = 0;
+	stack[top] = 0;
+	inside[top++] = false;
+
+	while (top > 0)
+	{
+		top--;
+		unsigned int n = stack[top];
+		bool fullyInside = inside[top];
+		const BVHNode& node = m_nodes[n];
+
+		if (!fullyInside)
+		{
+			int result = ClassifyBox(frustum, node.min, node.max);
+			if (result < 0)
+				continue;
+			fullyInside = result > 0;
+		}
+
+		if (node.isLeaf())
+		{
+			for (unsigned int i = 0; i < node.count; i++)
+			{
+				unsigned int id = m_indices[node.leftFirst + i];
+				if (fullyInside || ClassifyBox(frustum, m_bounds[id].min, m_bounds[id].max) >= 0)
+					out.push_back(id);
+			}
+			continue;
+		}
+
+		stack[top] = node.leftFirst;
+		inside[top++] = fullyInside;
+		stack[top] = n + 1;
+		inside[top++] = fullyInside;
+	}
+}
+
+static bool Overlaps(const float* minA, const float* maxA, const float* minB, const float* maxB)
+{
+	return minA[0] <= maxB[0] && maxA[0] >= minB[0] &&
+	       minA[1] <= maxB[1] && maxA[1] >= minB[1] &&
+	       minA[2] <= maxB[2] && maxA[2] >= minB[2];
+}
+
+void BVH::queryAABB(const AABB& box, std::vector<unsigned int>& out) const
+{
+	if (m_nodes.empty())
+		return;
+
+	unsigned int fixedStack[STACK_SIZE];
+	std::vector<unsigned int> deepStack;
+	unsigned int* stack = TraversalStack(fixedStack, deepStack, m_depth);
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const BVHNode& node = m_nodes[stack[--top]];
+		if (!Overlaps(node.min, node.max, box.min, box.max))
+			continue;
+
+		if (node.isLeaf())
+		{
+			for (unsigned int i = 0; i < node.count; i++)
+			{
+				unsigned int id = m_indices[node.leftFirst + i];
+				if (Overlaps(m_bounds[id].min, m_bounds[id].max, box.min, box.max))
+					out.push_back(id);
+			}
+			continue;
+		}
+
+		unsigned int n = (unsigned int)(&node - m_nodes.data());
+		stack[top++] = node.leftFirst;
+		stack[top++] = n + 1;
+	}
+}
+
+//slab test, returns the entry distance or FLT_MAX on a miss
+static float IntersectBox(const float* origin, const float* inverse, float maxT, const float* min, const float* max)
+{
+	float tMin = 0.0f, tMax = maxT;
+	for (int a = 0; a < 3; a++)
+	{
+		float t0 = (min[a] - origin[a]) * inverse[a];
+		float t1 = (max[a] - origin[a]) * inverse[a];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = t0 > tMin ? t0 : tMin; //written this way so NaNs from 0 * inf keep the old value
+		tMax = t1 < tMax ? t1 : tMax;
+	}
+	return tMin <= tMax ? tMin : FLT_MAX;
+}
+
+bool BVH::raycast(const float origin[3], const float direction[3], float maxT, RayHit& hit,
+	const std::function<bool(unsigned int, float&)>& exactTest) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	float inverse[3];
+	for (int a = 0; a < 3; a++)
+		inverse[a] = 1.0f / direction[a];
+
+	hit.id = 0xFFFFFFFFu;
+	hit.t = maxT;
+
+	unsigned int fixedStack[STACK_SIZE];
+	std::vector<unsigned int> deepStack;
+	unsigned int* stack = TraversalStack(fixedStack, deepStack, m_depth);
+	int top = 0;
+	if (IntersectBox(origin, inverse, hit.t, m_nodes[0].min, m_nodes[0].max) == FLT_MAX)
+		return false;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const BVHNode& node = m_nodes[stack[--top]];
+
+		if (node.isLeaf())
+		{
+			for (unsigned int i = 0; i < node.count; i++)
+			{
+				unsigned int id = m_indices[node.leftFirst + i];
+				float t = IntersectBox(origin, inverse, hit.t, m_bounds[id].min, m_bounds[id].max);
+				if (t == FLT_MAX)
+					continue;
+				if (exactTest && (!exactTest(id, t) || t > hit.t))
+					continue;
+
+				hit.id = id;
+				hit.t = t;
+			}
+			continue;
+		}
+
+		//visit the nearer child first so the far one is often skipped once hit.t shrinks
+		unsigned int n = (unsigned int)(&node - m_nodes.data());
+		unsigned int first = n + 1, second = node.leftFirst;
+		float tNear = IntersectBox(origin, inverse, hit.t, m_nodes[first].min, m_nodes[first].max);
+		float tFar = IntersectBox(origin, inverse, hit.t, m_nodes[second].min, m_nodes[second].max);
+		if (tFar < tNear)
+		{
+			std::swap(first, second);
+			std::swap(tNear, tFar);
+		}
+
+		if (tFar != FLT_MAX)
+			stack[top++] = second;
+		if (tNear != FLT_MAX)
+			stack[top++] = first;
+	}
+
+	return hit.id != 0xFFFFFFFFu;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "bounds.h"
+
+//32 byte node, two of them fit a cache line
+//Nodes are stored depth first: the first child of an interior node is the node right after it
+struct BVHNode
+{
+	float min[3];
+	unsigned int leftFirst; //interior: index of the second child, leaf: first entry in the primitive index list
+	float max[3];
+	unsigned int count; //number of primitives in a leaf, 0 for interior nodes
+
+	bool isLeaf() const { return count != 0; }
+};
+
+struct RayHit
+{
+	unsigned int id;
+	float t;
+};
+
+//Bounding volume hierarchy over object AABBs, object ids are the indices of the boxes passed to build()
+//Built with a binned SAH, large subtrees are built in parallel on the thread pool
+//Moving objects are handled with update() + refit(), which keeps the topology and only recomputes the bounds
+class BVH
+{
+private:
+	std::vector<BVHNode> m_nodes;
+	std::vector<unsigned int> m_indices; //primitive ids, every leaf references a contiguous range
+	std::vector<AABB> m_bounds;
+	std::vector<float> m_centroids; //3 floats per primitive, only needed while building
+	unsigned int m_depth = 0; //nodes on the longest path from the root to a leaf, what a traversal stack has to hold
+
+	unsigned int buildRange(unsigned int begin, unsigned int end, std::vector<BVHNode>& nodes);
+	bool findSplit(unsigned int begin, unsigned int end, const BVHNode& node, unsigned int& mid);
+
+public:
+	//leaves never hold more than this many primitives
+	static const unsigned int MAX_LEAF_SIZE = 8;
+
+	//subtrees with more primitives than this have their two children built in parallel
+	static const unsigned int PARALLEL_BUILD_THRESHOLD = 16384;
+
+	void build(const AABB* boxes, unsigned int count);
+
+	//Changes an object's bounds, call refit() once all the moved objects are updated
+	void update(unsigned int id, const AABB& box);
+	void refit();
+
+	//Appends the ids of the objects whose box intersects the frustum
+	void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& out) const;
+
+	//Appends the ids of the objects whose box overlaps the given box
+	void queryAABB(const AABB& box, std::vector<unsigned int>& out) const;
+
+	//Finds the closest object hit by the ray within [0, maxT]
+	//Without exactTest, the hit distance is the distance to the object's box. exactTest can refine it against the real
+	//geometry: it receives the id and the box distance, returns false for a miss or true after writing the real distance
+	bool raycast(const float origin[3], const float direction[3], float maxT, RayHit& hit,
+		const std::function<bool(unsigned int, float&)>& exactTest = nullptr) const;
+
+	const std::vector<BVHNode>& nodes() const { return m_nodes; }
+	unsigned int depth() const { return m_depth; }
+	unsigned int count() const { return (unsigned int)m_bounds.size(); }
+};
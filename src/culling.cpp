@@ -0,0 +1,297 @@
+#include "culling.h"
+#include "thread_pool.h"
+#include <cmath>
+#include <cstring>
+
+const unsigned int CullingSystem::INVALID_SLOT;
+const unsigned int CullingSystem::CHUNK_SIZE;
+
+Frustum ExtractFrustum(const float* m)
+{
+	//rows of the matrix, m is column-major so row i is m[i], m[4 + i], m[8 + i], m[12 + i]
+	Frustum frustum;
+	for (int i = 0; i < 6; i++)
+	{
+		int row = i / 2;
+		float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+
+		Plane& p = frustum.planes[i];
+		p.nx = m[3]  + sign * m[row];
+		p.ny = m[7]  + sign * m[4 + row];
+		p.nz = m[11] + sign * m[8 + row];
+		p.d  = m[15] + sign * m[12 + row];
+
+		float length = std::sqrt(p.nx * p.nx + p.ny * p.ny + p.nz * p.nz);
+		if (length > 0.0f)
+		{
+			p.nx /= length;
+			p.ny /= length;
+			p.nz /= length;
+			p.d  /= length;
+		}
+	}
+	return frustum;
+}
+
+static unsigned int CullScalar(const Frustum& frustum, const float* const* soa, const unsigned int* ids,
+	unsigned int begin, unsigned int end, unsigned int* out)
+{
+	unsigned int written = 0;
+	for (unsigned int i = begin; i < end; i++)
+	{
+		bool visible = true;
+		for (int p = 0; p < 6 && visible; p++)
+		{
+			const Plane& plane = frustum.planes[p];
+			float distance = plane.nx * soa[0][i] + plane.ny * soa[1][i] + plane.nz * soa[2][i] + plane.d;
+			float boxRadius = std::fabs(plane.nx) * soa[3][i] + std::fabs(plane.ny) * soa[4][i] + std::fabs(plane.nz) * soa[5][i];
+			float radius = boxRadius < soa[6][i] ? boxRadius : soa[6][i];
+			visible = distance + radius >= 0.0f;
+		}
+		out[written] = ids[i];
+		written += visible ? 1 : 0;
+	}
+	return written;
+}
+
+#if SIMD_X86
+//writes ids[base + bit] for every set bit of mask
+static inline unsigned int WriteMaskedIds(unsigned int mask, const unsigned int* ids, unsigned int base, unsigned int* out)
+{
+	unsigned int written = 0;
+	while (mask)
+	{
+		out[written++] = ids[base + CountTrailingZeros(mask)];
+		mask &= mask - 1;
+	}
+	return written;
+}
+
+static unsigned int CullSSE2(const Frustum& frustum, const float* const* soa, const unsigned int* ids,
+	unsigned int begin, unsigned int end, unsigned int* out)
+{
+	__m128 nx[6], ny[6], nz[6], d[6], ax[6], ay[6], az[6];
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for (int p = 0; p < 6; p++)
+	{
+		nx[p] = _mm_set1_ps(frustum.planes[p].nx);
+		ny[p] = _mm_set1_ps(frustum.planes[p].ny);
+		nz[p] = _mm_set1_ps(frustum.planes[p].nz);
+		d[p]  = _mm_set1_ps(frustum.planes[p].d);
+		ax[p] = _mm_andnot_ps(signMask, nx[p]);
+		ay[p] = _mm_andnot_ps(signMask, ny[p]);
+		az[p] = _mm_andnot_ps(signMask, nz[p]);
+	}
+
+	unsigned int written = 0;
+	for (unsigned int i = begin; i < end; i += 4)
+	{
+		__m128 cx = _mm_load_ps(soa[0] + i), cy = _mm_load_ps(soa[1] + i), cz = _mm_load_ps(soa[2] + i);
+		__m128 ex = _mm_load_ps(soa[3] + i), ey = _mm_load_ps(soa[4] + i), ez = _mm_load_ps(soa[5] + i);
+		__m128 r  = _mm_load_ps(soa[6] + i);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_add_ps(_mm_mul_ps(nz[p], cz), d[p]));
+			__m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_min_ps(boxRadius, r)), _mm_setzero_ps()));
+		}
+
+		unsigned int mask = ~(unsigned int)_mm_movemask_ps(outside) & 0xF;
+		if (end - i < 4)
+			mask &= (1u << (end - i)) - 1;
+		written += WriteMaskedIds(mask, ids, i, out + written);
+	}
+	return written;
+}
+
+SIMD_TARGET_AVX2
+static unsigned int CullAVX2(const Frustum& frustum, const float* const* soa, const unsigned int* ids,
+	unsigned int begin, unsigned int end, unsigned int* out)
+{
+	__m256 nx[6], ny[6], nz[6], d[6], ax[6], ay[6], az[6];
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	for (int p = 0; p < 6; p++)
+	{
+		nx[p] = _mm256_set1_ps(frustum.planes[p].nx);
+		ny[p] = _mm256_set1_ps(frustum.planes[p].ny);
+		nz[p] = _mm256_set1_ps(frustum.planes[p].nz);
+		d[p]  = _mm256_set1_ps(frustum.planes[p].d);
+		ax[p] = _mm256_andnot_ps(signMask, nx[p]);
+		ay[p] = _mm256_andnot_ps(signMask, ny[p]);
+		az[p] = _mm256_andnot_ps(signMask, nz[p]);
+	}
+
+	unsigned int written = 0;
+	for (unsigned int i = begin; i < end; i += 8)
+	{
+		__m256 cx = _mm256_load_ps(soa[0] + i), cy = _mm256_load_ps(soa[1] + i), cz = _mm256_load_ps(soa[2] + i);
+		__m256 ex = _mm256_load_ps(soa[3] + i), ey = _mm256_load_ps(soa[4] + i), ez = _mm256_load_ps(soa[5] + i);
+		__m256 r  = _mm256_load_ps(soa[6] + i);
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_fmadd_ps(nx[p], cx, _mm256_fmadd_ps(ny[p], cy, _mm256_fmadd_ps(nz[p], cz, d[p])));
+			__m256 boxRadius = _mm256_fmadd_ps(ax[p], ex, _mm256_fmadd_ps(ay[p], ey, _mm256_mul_ps(az[p], ez)));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, _mm256_min_ps(boxRadius, r)), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		unsigned int mask = ~(unsigned int)_mm256_movemask_ps(outside) & 0xFF;
+		if (end - i < 8)
+			mask &= (1u << (end - i)) - 1;
+		written += WriteMaskedIds(mask, ids, i, out + written);
+	}
+	return written;
+}
+#endif
+
+CullKernel GetCullKernel(SimdLevel level)
+{
+#if SIMD_X86
+	if (level >= SimdLevel::AVX2)
+		return CullAVX2;
+	if (level >= SimdLevel::SSE2)
+		return CullSSE2;
+#endif
+	return CullScalar;
+}
+
+unsigned int CullingSystem::allocate(float cx, float cy, float cz, float ex, float ey, float ez, float radius)
+{
+	unsigned int id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = (unsigned int)m_slots.size();
+		m_slots.push_back(INVALID_SLOT);
+	}
+
+	unsigned int slot = (unsigned int)m_ids.size();
+	m_centerX.push_back(cx); m_centerY.push_back(cy); m_centerZ.push_back(cz);
+	m_extentX.push_back(ex); m_extentY.push_back(ey); m_extentZ.push_back(ez);
+	m_radius.push_back(radius);
+	m_ids.push_back(id);
+	m_slots[id] = slot;
+	return id;
+}
+
+void CullingSystem::store(unsigned int slot, float cx, float cy, float cz, float ex, float ey, float ez, float radius)
+{
+	m_centerX[slot] = cx; m_centerY[slot] = cy; m_centerZ[slot] = cz;
+	m_extentX[slot] = ex; m_extentY[slot] = ey; m_extentZ[slot] = ez;
+	m_radius[slot] = radius;
+}
+
+static void BoxToCenterExtents(const AABB& box, float* out)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		out[i]     = (box.min[i] + box.max[i]) * 0.5f;
+		out[i + 3] = (box.max[i] - box.min[i]) * 0.5f;
+	}
+	out[6] = std::sqrt(out[3] * out[3] + out[4] * out[4] + out[5] * out[5]);
+}
+
+unsigned int CullingSystem::add(const AABB& box)
+{
+	float v[7];
+	BoxToCenterExtents(box, v);
+	return allocate(v[0], v[1], v[2], v[3], v[4], v[5], v[6]);
+}
+
+unsigned int CullingSystem::add(const Sphere& sphere)
+{
+	const float* c = sphere.center;
+	float r = sphere.radius;
+	return allocate(c[0], c[1], c[2], r, r, r, r);
+}
+
+void CullingSystem::update(unsigned int id, const AABB& box)
+{
+	float v[7];
+	BoxToCenterExtents(box, v);
+	store(m_slots[id], v[0], v[1], v[2], v[3], v[4], v[5], v[6]);
+}
+
+void CullingSystem::update(unsigned int id, const Sphere& sphere)
+{
+	const float* c = sphere.center;
+	float r = sphere.radius;
+	store(m_slots[id], c[0], c[1], c[2], r, r, r, r);
+}
+
+void CullingSystem::remove(unsigned int id)
+{
+	//move the last object into the freed slot to keep the arrays dense
+	unsigned int slot = m_slots[id];
+	unsigned int last = count() - 1;
+	if (slot != last)
+	{
+		store(slot, m_centerX[last], m_centerY[last], m_centerZ[last], m_extentX[last], m_extentY[last], m_extentZ[last], m_radius[last]);
+		m_ids[slot] = m_ids[last];
+		m_slots[m_ids[slot]] = slot;
+	}
+
+	m_centerX.pop_back(); m_centerY.pop_back(); m_centerZ.pop_back();
+	m_extentX.pop_back(); m_extentY.pop_back(); m_extentZ.pop_back();
+	m_radius.pop_back();
+	m_ids.pop_back();
+
+	m_slots[id] = INVALID_SLOT;
+	m_freeIds.push_back(id);
+}
+
+void CullingSystem::clear()
+{
+	m_centerX.clear(); m_centerY.clear(); m_centerZ.clear();
+	m_extentX.clear(); m_extentY.clear(); m_extentZ.clear();
+	m_radius.clear();
+	m_ids.clear();
+	m_slots.clear();
+	m_freeIds.clear();
+}
+
+unsigned int CullingSystem::cull(const Frustum& frustum, std::vector<unsigned int>& visible)
+{
+	unsigned int objects = count();
+	visible.resize(objects);
+	if (objects == 0)
+		return 0;
+
+	const float* soa[7] = { m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+		m_extentX.data(), m_extentY.data(), m_extentZ.data(), m_radius.data() };
+	const unsigned int* ids = m_ids.data();
+	unsigned int* out = visible.data();
+	CullKernel kernel = GetCullKernel(GetSimdLevel());
+
+	//every chunk writes to its own range of the output, then the ranges are packed together
+	unsigned int chunks = (objects + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	m_chunkCounts.resize(chunks);
+	unsigned int* counts = m_chunkCounts.data();
+
+	GetThreadPool().parallelFor(chunks, 1, [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int c = first; c < last; c++)
+		{
+			unsigned int begin = c * CHUNK_SIZE;
+			unsigned int end = begin + CHUNK_SIZE < objects ? begin + CHUNK_SIZE : objects;
+			counts[c] = kernel(frustum, soa, ids, begin, end, out + begin);
+		}
+	});
+
+	unsigned int total = counts[0];
+	for (unsigned int c = 1; c < chunks; c++)
+	{
+		std::memmove(out + total, out + c * CHUNK_SIZE, counts[c] * sizeof(unsigned int));
+		total += counts[c];
+	}
+
+	visible.resize(total);
+	return total;
+}
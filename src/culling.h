@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "bounds.h"
+#include "simd.h"
+
+//Frustum culling over bounding volumes stored as structure of arrays
+//Every object keeps a box (center + half extents) and a radius, boxes get radius = |extents| and
+//spheres get extents = radius, each plane then uses whichever of the two is tighter
+class CullingSystem
+{
+private:
+	AlignedArray<float> m_centerX, m_centerY, m_centerZ;
+	AlignedArray<float> m_extentX, m_extentY, m_extentZ;
+	AlignedArray<float> m_radius;
+	AlignedArray<unsigned int> m_ids; //slot -> id, what cull() outputs
+
+	std::vector<unsigned int> m_slots; //id -> slot, INVALID_SLOT for free ids
+	std::vector<unsigned int> m_freeIds;
+
+	std::vector<unsigned int> m_chunkCounts; //visible count per chunk of the last cull
+
+	unsigned int allocate(float cx, float cy, float cz, float ex, float ey, float ez, float radius);
+	void store(unsigned int slot, float cx, float cy, float cz, float ex, float ey, float ez, float radius);
+
+public:
+	static const unsigned int INVALID_SLOT = 0xFFFFFFFFu;
+
+	//objects per parallel batch, the visible ids of a batch are written contiguously
+	static const unsigned int CHUNK_SIZE = 16384;
+
+	//Returns the object's id, ids are reused after remove()
+	unsigned int add(const AABB& box);
+	unsigned int add(const Sphere& sphere);
+
+	void update(unsigned int id, const AABB& box);
+	void update(unsigned int id, const Sphere& sphere);
+	void remove(unsigned int id);
+	void clear();
+
+	unsigned int count() const { return (unsigned int)m_ids.size(); }
+
+	//Tests every object against the frustum and writes the ids of the visible ones into visible
+	//Returns the number of visible objects
+	unsigned int cull(const Frustum& frustum, std::vector<unsigned int>& visible);
+};
+
+//Kernels behind CullingSystem::cull(), exposed for benchmarking
+//Tests objects [begin, end) and writes the ids of the visible ones to out, returns how many were written
+typedef unsigned int (*CullKernel)(const Frustum& frustum, const float* const* soa, const unsigned int* ids,
+	unsigned int begin, unsigned int end, unsigned int* out);
+
+CullKernel GetCullKernel(SimdLevel level);
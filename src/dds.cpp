@@ -0,0 +1,92 @@
+#include "dds.h"
+#include <fstream>
+#include <iostream>
+
+static const unsigned int DDS_MAGIC = 0x20534444; //"DDS "
+static const unsigned int DDS_HEADER_SIZE = 124;
+static const unsigned int DDS_PIXEL_FORMAT_SIZE = 32;
+
+static const unsigned int DDSD_CAPS = 0x1;
+static const unsigned int DDSD_HEIGHT = 0x2;
+static const unsigned int DDSD_WIDTH = 0x4;
+static const unsigned int DDSD_PIXELFORMAT = 0x1000;
+static const unsigned int DDSD_MIPMAPCOUNT = 0x20000;
+static const unsigned int DDSD_LINEARSIZE = 0x80000;
+static const unsigned int DDPF_FOURCC = 0x4;
+static const unsigned int DDSCAPS_COMPLEX = 0x8;
+static const unsigned int DDSCAPS_TEXTURE = 0x1000;
+static const unsigned int DDSCAPS_MIPMAP = 0x400000;
+static const unsigned int FOURCC_DX10 = 0x30315844; //"DX10"
+static const unsigned int DX10_TEXTURE2D = 3;
+
+//DXGI_FORMAT values
+static unsigned int DxgiFormat(BlockFormat format, bool srgb)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1: return srgb ? 72 : 71;
+	case BlockFormat::BC3: return srgb ? 78 : 77;
+	case BlockFormat::BC4: return 80;
+	case BlockFormat::BC5: return 83;
+	case BlockFormat::BC7: return srgb ? 99 : 98;
+	}
+	return 0;
+}
+
+static void Put32(std::vector<unsigned char>& out, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+bool SaveDDS(const std::string& path, const std::vector<CompressedImage>& levels)
+{
+	if (levels.empty())
+		return false;
+	const CompressedImage& top = levels[0];
+	for (const CompressedImage& level : levels)
+	{
+		if (level.format != top.format)
+		{
+			std::cout << path << ": levels of different formats\n";
+			return false;
+		}
+	}
+
+	bool mipmapped = levels.size() > 1;
+	std::vector<unsigned char> header;
+	Put32(header, DDS_MAGIC);
+	Put32(header, DDS_HEADER_SIZE);
+	Put32(header, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | (mipmapped ? DDSD_MIPMAPCOUNT : 0));
+	Put32(header, top.height);
+	Put32(header, top.width);
+	Put32(header, (unsigned int)top.data.size());
+	Put32(header, 0); //depth
+	Put32(header, (unsigned int)levels.size());
+	for (int i = 0; i < 11; i++)
+		Put32(header, 0);
+
+	Put32(header, DDS_PIXEL_FORMAT_SIZE);
+	Put32(header, DDPF_FOURCC);
+	Put32(header, FOURCC_DX10);
+	for (int i = 0; i < 5; i++)
+		Put32(header, 0); //bit count and masks
+
+	Put32(header, DDSCAPS_TEXTURE | (mipmapped ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+	for (int i = 0; i < 4; i++)
+		Put32(header, 0); //caps2..4 and reserved
+
+	Put32(header, DxgiFormat(top.format, top.srgb));
+	Put32(header, DX10_TEXTURE2D);
+	Put32(header, 0); //misc flags
+	Put32(header, 1); //array size
+	Put32(header, 0); //alpha mode unknown
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file.write((const char*)header.data(), header.size());
+	for (const CompressedImage& level : levels)
+		file.write((const char*)level.data.data(), level.data.size());
+	return (bool)file;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "block_compress.h"
+
+//Writes a DDS file with a DX10 header holding the levels of a block compressed mip chain, levels[0] the largest
+//All levels must share a format; blocks are stored in the order of CompressedImage, bottom row first like GL,
+//so other DDS viewers show the image upside down
+bool SaveDDS(const std::string& path, const std::vector<CompressedImage>& levels);
@@ -0,0 +1,306 @@
+#include "ecs.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include "frame_arena.h"
+#include "thread_pool.h"
+
+static const unsigned int CHUNK_SIZE = 16 * 1024;
+
+struct ComponentInfo
+{
+	size_t size;
+	size_t alignment;
+};
+
+static std::mutex s_componentMutex;
+static ComponentInfo s_components[MAX_COMPONENT_TYPES];
+static unsigned int s_componentCount = 0;
+
+ComponentType RegisterComponentType(size_t size, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(s_componentMutex);
+	if (s_componentCount == MAX_COMPONENT_TYPES)
+	{
+		std::cout << "More than " << MAX_COMPONENT_TYPES << " component types\n";
+		std::abort();
+	}
+	if (alignment > alignof(std::max_align_t))
+	{
+		std::cout << "Component alignment " << alignment << " is more than chunks guarantee\n";
+		std::abort();
+	}
+
+	s_components[s_componentCount].size = size;
+	s_components[s_componentCount].alignment = alignment;
+	return s_componentCount++;
+}
+
+size_t GetComponentSize(ComponentType type)
+{
+	return s_components[type].size;
+}
+
+World::World()
+	:m_entityCount(0)
+{
+}
+
+unsigned int World::findArchetype(ComponentMask mask)
+{
+	for (unsigned int i = 0; i < m_archetypes.size(); i++)
+	{
+		if (m_archetypes[i].mask == mask)
+			return i;
+	}
+
+	//the most rows that fit with every array aligned, at least one even when a row is bigger than a chunk
+	size_t rowSize = sizeof(Entity);
+	for (ComponentType type = 0; type < MAX_COMPONENT_TYPES; type++)
+	{
+		if (mask & (1ull << type))
+			rowSize += s_components[type].size + s_components[type].alignment - 1;
+	}
+
+	Archetype archetype;
+	archetype.mask = mask;
+	archetype.capacity = rowSize < CHUNK_SIZE ? (unsigned int)(CHUNK_SIZE / rowSize) : 1;
+	archetype.count = 0;
+
+	size_t offset = archetype.capacity * sizeof(Entity);
+	for (ComponentType type = 0; type < MAX_COMPONENT_TYPES; type++)
+	{
+		if (!(mask & (1ull << type)))
+		{
+			archetype.offsets[type] = ChunkView::NO_OFFSET;
+			continue;
+		}
+		size_t alignment = s_components[type].alignment;
+		offset = (offset + alignment - 1) / alignment * alignment;
+		archetype.offsets[type] = (unsigned int)offset;
+		offset += archetype.capacity * s_components[type].size;
+	}
+	archetype.chunkSize = (unsigned int)offset;
+
+	m_archetypes.push_back(std::move(archetype));
+	return (unsigned int)m_archetypes.size() - 1;
+}
+
+unsigned char* World::rowAddress(const Archetype& archetype, unsigned int row, ComponentType type) const
+{
+	const Chunk& chunk = archetype.chunks[row / archetype.capacity];
+	return chunk.data.get() + archetype.offsets[type] + (row % archetype.capacity) * s_components[type].size;
+}
+
+unsigned int World::addRow(unsigned int archetypeIndex, Entity entity)
+{
+	Archetype& archetype = m_archetypes[archetypeIndex];
+	if (archetype.count == archetype.chunks.size() * archetype.capacity)
+	{
+		Chunk chunk;
+		chunk.data.reset(new unsigned char[archetype.chunkSize]);
+		chunk.count = 0;
+		archetype.chunks.push_back(std::move(chunk));
+	}
+
+	unsigned int row = archetype.count++;
+	Chunk& chunk = archetype.chunks[row / archetype.capacity];
+	((Entity*)chunk.data.get())[chunk.count++] = entity;
+	return row;
+}
+
+//Fills the hole with the archetype's last row, so the chunks stay packed
+void World::removeRow(unsigned int archetypeIndex, unsigned int row)
+{
+	Archetype& archetype = m_archetypes[archetypeIndex];
+	unsigned int last = archetype.count - 1;
+	Chunk& lastChunk = archetype.chunks.back();
+	if (row != last)
+	{
+		Chunk& chunk = archetype.chunks[row / archetype.capacity];
+		Entity moved = ((Entity*)lastChunk.data.get())[last % archetype.capacity];
+		((Entity*)chunk.data.get())[row % archetype.capacity] = moved;
+		for (ComponentType type = 0; type < MAX_COMPONENT_TYPES; type++)
+		{
+			if (archetype.mask & (1ull << type))
+				std::memcpy(rowAddress(archetype, row, type), rowAddress(archetype, last, type), s_components[type].size);
+		}
+		m_records[moved.index].row = row;
+	}
+
+	archetype.count--;
+	if (--lastChunk.count == 0)
+		archetype.chunks.pop_back();
+}
+
+Entity World::create(ComponentMask mask)
+{
+	Entity entity;
+	if (!m_freeIndices.empty())
+	{
+		entity.index = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else
+	{
+		entity.index = (unsigned int)m_records.size();
+		Record record;
+		record.generation = 1;
+		record.live = false;
+		m_records.push_back(record);
+	}
+
+	Record& record = m_records[entity.index];
+	entity.generation = record.generation;
+	record.archetype = findArchetype(mask);
+	record.row = addRow(record.archetype, entity);
+	record.live = true;
+
+	const Archetype& archetype = m_archetypes[record.archetype];
+	for (ComponentType type = 0; type < MAX_COMPONENT_TYPES; type++)
+	{
+		if (mask & (1ull << type))
+			std::memset(rowAddress(archetype, record.row, type), 0, s_components[type].size);
+	}
+
+	m_entityCount++;
+	return entity;
+}
+
+void World::destroy(Entity entity)
+{
+	if (!isAlive(entity))
+		return;
+
+	Record& record = m_records[entity.index];
+	removeRow(record.archetype, record.row);
+	record.live = false;
+	if (++record.generation == 0)
+		record.generation = 1; //0 is the null entity's
+	m_freeIndices.push_back(entity.index);
+	m_entityCount--;
+}
+
+bool World::isAlive(Entity entity) const
+{
+	return entity.index < m_records.size() && m_records[entity.index].live && m_records[entity.index].generation == entity.generation;
+}
+
+void World::setMask(Entity entity, ComponentMask mask)
+{
+	if (!isAlive(entity))
+		return;
+
+	unsigned int from = m_records[entity.index].archetype;
+	unsigned int fromRow = m_records[entity.index].row;
+	if (m_archetypes[from].mask == mask)
+		return;
+
+	unsigned int to = findArchetype(mask);
+	unsigned int toRow = addRow(to, entity);
+	const Archetype& source = m_archetypes[from];
+	const Archetype& target = m_archetypes[to];
+	for (ComponentType type = 0; type < MAX_COMPONENT_TYPES; type++)
+	{
+		if (!(mask & (1ull << type)))
+			continue;
+		if (source.mask & (1ull << type))
+			std::memcpy(rowAddress(target, toRow, type), rowAddress(source, fromRow, type), s_components[type].size);
+		else
+			std::memset(rowAddress(target, toRow, type), 0, s_components[type].size);
+	}
+
+	removeRow(from, fromRow);
+	m_records[entity.index].archetype = to;
+	m_records[entity.index].row = toRow;
+}
+
+void* World::get(Entity entity, ComponentType type)
+{
+	if (!isAlive(entity))
+		return nullptr;
+
+	const Record& record = m_records[entity.index];
+	const Archetype& archetype = m_archetypes[record.archetype];
+	if (!(archetype.mask & (1ull << type)))
+		return nullptr;
+	return rowAddress(archetype, record.row, type);
+}
+
+void World::getChunks(ComponentMask required, ComponentMask excluded, std::vector<ChunkView>& out)
+{
+	out.clear();
+	for (Archetype& archetype : m_archetypes)
+	{
+		if ((archetype.mask & required) != required || (archetype.mask & excluded))
+			continue;
+		for (Chunk& chunk : archetype.chunks)
+			out.push_back(ChunkView(chunk.data.get(), archetype.offsets, chunk.count));
+	}
+}
+
+void World::forEachChunk(ComponentMask required, ComponentMask excluded, const std::function<void(const ChunkView&)>& fn)
+{
+	for (Archetype& archetype : m_archetypes)
+	{
+		if ((archetype.mask & required) != required || (archetype.mask & excluded))
+			continue;
+		for (Chunk& chunk : archetype.chunks)
+			fn(ChunkView(chunk.data.get(), archetype.offsets, chunk.count));
+	}
+}
+
+void World::forEachChunkParallel(ComponentMask required, ComponentMask excluded, const std::function<void(const ChunkView&)>& fn)
+{
+	ArenaVector<ChunkView> chunks{ ArenaAllocator<ChunkView>(GetFrameArena().local()) };
+	forEachChunk(required, excluded, [&chunks](const ChunkView& chunk)
+	{
+		chunks.push_back(chunk);
+	});
+	GetThreadPool().parallelFor((unsigned int)chunks.size(), 4, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			fn(chunks[i]);
+	});
+}
+
+void SystemScheduler::add(const std::string& name, ComponentMask reads, ComponentMask writes, std::function<void(World&)> run)
+{
+	System system;
+	system.name = name;
+	system.reads = reads;
+	system.writes = writes;
+	system.run = std::move(run);
+	system.stage = 0;
+
+	for (const System& earlier : m_systems)
+	{
+		bool conflict = (earlier.writes & (reads | writes)) || (earlier.reads & writes);
+		if (conflict && earlier.stage + 1 > system.stage)
+			system.stage = earlier.stage + 1;
+	}
+
+	if (system.stage == m_stages.size())
+		m_stages.emplace_back();
+	m_stages[system.stage].push_back((unsigned int)m_systems.size());
+	m_systems.push_back(std::move(system));
+}
+
+void SystemScheduler::run(World& world)
+{
+	for (const std::vector<unsigned int>& stage : m_stages)
+	{
+		if (stage.size() == 1)
+		{
+			m_systems[stage[0]].run(world);
+			continue;
+		}
+
+		GetThreadPool().parallelFor((unsigned int)stage.size(), 1, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; i++)
+				m_systems[stage[i]].run(world);
+		});
+	}
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Entities are ids, components plain structs stored by archetype: every entity with the same set of components lives in
+//the same archetype, whose chunks (16KB blocks) hold one array per component, so iterating a component set walks
+//contiguous memory and never touches components it didn't ask for
+//Components are moved between chunks with memcpy, so they have to be trivially copyable
+typedef unsigned int ComponentType;
+typedef unsigned long long ComponentMask;
+static const unsigned int MAX_COMPONENT_TYPES = 64;
+
+//Gives a component type its id, ComponentTypeOf<T>() does this once per type
+ComponentType RegisterComponentType(size_t size, size_t alignment);
+size_t GetComponentSize(ComponentType type);
+
+template<typename T>
+ComponentType ComponentTypeOf()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved between chunks with memcpy");
+	static const ComponentType type = RegisterComponentType(sizeof(T), alignof(T));
+	return type;
+}
+
+template<typename... Ts>
+ComponentMask ComponentMaskOf()
+{
+	ComponentMask mask = 0;
+	int expand[] = { 0, ((mask |= 1ull << ComponentTypeOf<Ts>()), 0)... };
+	(void)expand;
+	return mask;
+}
+
+//index picks the entity's record, generation tells it apart from earlier entities that had the same index
+struct Entity
+{
+	unsigned int index;
+	unsigned int generation; //0 for no entity
+
+	bool isNull() const { return generation == 0; }
+};
+
+inline bool operator==(Entity a, Entity b) { return a.index == b.index && a.generation == b.generation; }
+inline bool operator!=(Entity a, Entity b) { return !(a == b); }
+
+//The rows of one chunk, valid until the next structural change of the world
+class ChunkView
+{
+private:
+	unsigned char* m_data;
+	const unsigned int* m_offsets; //per component type, NO_OFFSET when the archetype doesn't have it
+	unsigned int m_count;
+
+public:
+	static const unsigned int NO_OFFSET = 0xFFFFFFFFu;
+
+	ChunkView(unsigned char* data, const unsigned int* offsets, unsigned int count)
+		:m_data(data), m_offsets(offsets), m_count(count)
+	{
+	}
+
+	unsigned int count() const { return m_count; }
+	const Entity* entities() const { return (const Entity*)m_data; }
+	bool has(ComponentType type) const { return m_offsets[type] != NO_OFFSET; }
+
+	void* get(ComponentType type) const { return has(type) ? m_data + m_offsets[type] : nullptr; }
+
+	//The array of T, nullptr when the chunk's archetype doesn't have it
+	template<typename T>
+	T* get() const { return (T*)get(ComponentTypeOf<T>()); }
+};
+
+template<typename Fn, typename Arrays, size_t... I>
+void CallForEachRow(Fn& fn, const ChunkView& chunk, const Arrays& arrays, std::index_sequence<I...>)
+{
+	const Entity* entities = chunk.entities();
+	for (unsigned int i = 0; i < chunk.count(); i++)
+		fn(entities[i], std::get<I>(arrays)[i]...);
+}
+
+//Owns the entities and their components
+//Structural changes (create, destroy, adding or removing components) must not overlap anything else on the world;
+//reading and writing component data may happen from many threads as long as they don't touch the same components,
+//which is what SystemScheduler arranges
+class World
+{
+private:
+	struct Chunk
+	{
+		std::unique_ptr<unsigned char[]> data;
+		unsigned int count;
+	};
+
+	struct Archetype
+	{
+		ComponentMask mask;
+		unsigned int capacity;  //rows per chunk
+		unsigned int chunkSize; //bytes
+		unsigned int offsets[MAX_COMPONENT_TYPES]; //entities are at 0
+		std::vector<Chunk> chunks; //every one full but the last
+		unsigned int count;
+	};
+
+	struct Record
+	{
+		unsigned int archetype;
+		unsigned int row; //across the archetype's chunks
+		unsigned int generation; //bumped when the entity is destroyed
+		bool live;
+	};
+
+	std::vector<Archetype> m_archetypes;
+	std::vector<Record> m_records; //indexed by Entity::index
+	std::vector<unsigned int> m_freeIndices;
+	unsigned int m_entityCount;
+
+	unsigned int findArchetype(ComponentMask mask);
+	unsigned char* rowAddress(const Archetype& archetype, unsigned int row, ComponentType type) const;
+	unsigned int addRow(unsigned int archetype, Entity entity);
+	void removeRow(unsigned int archetype, unsigned int row);
+
+public:
+	World();
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	//A new entity with the components of mask, zeroed
+	Entity create(ComponentMask mask);
+
+	template<typename... Ts>
+	Entity create(const Ts&... components)
+	{
+		Entity entity = create(ComponentMaskOf<Ts...>());
+		int expand[] = { 0, (*get<Ts>(entity) = components, 0)... };
+		(void)expand;
+		return entity;
+	}
+
+	void destroy(Entity entity);
+	bool isAlive(Entity entity) const;
+
+	//Moves the entity to the archetype of mask, keeping the components both have and zeroing the new ones
+	void setMask(Entity entity, ComponentMask mask);
+	ComponentMask getMask(Entity entity) const { return m_archetypes[m_records[entity.index].archetype].mask; }
+
+	//The entity's component, nullptr when it doesn't have it
+	void* get(Entity entity, ComponentType type);
+
+	template<typename T>
+	T* get(Entity entity) { return (T*)get(entity, ComponentTypeOf<T>()); }
+
+	template<typename T>
+	bool has(Entity entity) const { return (getMask(entity) & ComponentMaskOf<T>()) != 0; }
+
+	template<typename T>
+	T* add(Entity entity, const T& component = T())
+	{
+		setMask(entity, getMask(entity) | ComponentMaskOf<T>());
+		T* stored = get<T>(entity);
+		*stored = component;
+		return stored;
+	}
+
+	template<typename T>
+	void remove(Entity entity) { setMask(entity, getMask(entity) & ~ComponentMaskOf<T>()); }
+
+	//The chunks whose archetype has every component of required and none of excluded
+	void getChunks(ComponentMask required, ComponentMask excluded, std::vector<ChunkView>& out);
+
+	void forEachChunk(ComponentMask required, ComponentMask excluded, const std::function<void(const ChunkView&)>& fn);
+
+	//Hands the matching chunks to the thread pool, fn runs concurrently for different chunks
+	void forEachChunkParallel(ComponentMask required, ComponentMask excluded, const std::function<void(const ChunkView&)>& fn);
+
+	//fn(Entity, Ts&...) for every entity with all of Ts
+	template<typename... Ts, typename Fn>
+	void each(Fn fn)
+	{
+		forEachChunk(ComponentMaskOf<Ts...>(), 0, [&](const ChunkView& chunk)
+		{
+			CallForEachRow(fn, chunk, std::make_tuple(chunk.get<Ts>()...), std::index_sequence_for<Ts...>());
+		});
+	}
+
+	unsigned int getEntityCount() const { return m_entityCount; }
+	unsigned int getArchetypeCount() const { return (unsigned int)m_archetypes.size(); }
+};
+
+//Runs systems over a world in stages, the systems of a stage in parallel on the thread pool
+//Every system declares the components it reads and writes; it lands in the stage after the last earlier system that
+//writes something it touches or touches something it writes, so conflicting systems keep the order they were added in
+//Systems may change component data but not the structure of the world
+class SystemScheduler
+{
+private:
+	struct System
+	{
+		std::string name;
+		ComponentMask reads;
+		ComponentMask writes;
+		std::function<void(World&)> run;
+		unsigned int stage;
+	};
+
+	std::vector<System> m_systems;
+	std::vector<std::vector<unsigned int>> m_stages;
+
+public:
+	void add(const std::string& name, ComponentMask reads, ComponentMask writes, std::function<void(World&)> run);
+
+	void run(World& world);
+
+	unsigned int getStageCount() const { return (unsigned int)m_stages.size(); }
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+//Advances a State by a fixed timestep on a thread of its own, so the simulation runs at the same rate whatever the
+//frame rate is and a slow step doesn't hold up a frame (nor a slow frame a step)
+//Every step publishes the state before and after it; the render thread picks up the latest pair without locking
+//and blends between them by how far into the next step it is, which keeps motion smooth when the rates differ at
+//the cost of showing the simulation one step late
+//The pair travels through three slots: the simulation fills one, the render thread reads one and the third is
+//swapped between them with one atomic exchange, so neither side ever waits for the other
+//State must be copyable
+template<typename State>
+class FixedStepSimulation
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::function<void(State& state, float dt)> StepFunction;
+
+private:
+	struct Snapshot
+	{
+		State previous;
+		State current;
+		Clock::time_point time; //when current is due
+		unsigned long long step;
+	};
+
+	static const unsigned int DIRTY = 4; //on m_shared when it holds a snapshot the reader hasn't seen
+	static const unsigned int MAX_CATCH_UP = 8; //steps in a row before the simulation gives up on the lost time
+
+	Snapshot m_slots[3];
+	std::atomic<unsigned int> m_shared;
+	unsigned int m_back;  //simulation thread
+	unsigned int m_front; //render thread
+	StepFunction m_step;
+	Clock::duration m_dt;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+	std::atomic<unsigned long long> m_steps;
+	std::atomic<unsigned long long> m_dropped;
+
+	void run()
+	{
+		State current = m_slots[m_back].current;
+		Clock::time_point next = Clock::now() + m_dt;
+		while (m_running.load(std::memory_order_relaxed))
+		{
+			std::this_thread::sleep_until(next);
+
+			State previous = current;
+			unsigned int steps = 0;
+			Clock::time_point now = Clock::now();
+			while (next <= now && steps < MAX_CATCH_UP)
+			{
+				previous = current;
+				m_step(current, std::chrono::duration<float>(m_dt).count());
+				next += m_dt;
+				steps++;
+			}
+			//too far behind (a breakpoint, a suspended process), carrying on from now beats running steps back to back
+			if (next <= now)
+			{
+				m_dropped.fetch_add((now - next) / m_dt + 1, std::memory_order_relaxed);
+				next = now + m_dt;
+			}
+			if (!steps)
+				continue;
+
+			unsigned long long step = m_steps.fetch_add(steps, std::memory_order_relaxed) + steps;
+			Snapshot& snapshot = m_slots[m_back];
+			snapshot.previous = previous;
+			snapshot.current = current;
+			snapshot.time = next - m_dt;
+			snapshot.step = step;
+			m_back = m_shared.exchange(m_back | DIRTY, std::memory_order_acq_rel) & ~DIRTY;
+		}
+	}
+
+public:
+	FixedStepSimulation(const State& initial, float stepSeconds, StepFunction step)
+		:m_shared(1), m_back(0), m_front(2), m_step(step), m_running(false), m_steps(0), m_dropped(0)
+	{
+		m_dt = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(stepSeconds));
+		for (Snapshot& snapshot : m_slots)
+		{
+			snapshot.previous = snapshot.current = initial;
+			snapshot.time = Clock::now();
+			snapshot.step = 0;
+		}
+	}
+
+	~FixedStepSimulation()
+	{
+		stop();
+	}
+
+	FixedStepSimulation(const FixedStepSimulation&) = delete;
+	FixedStepSimulation& operator=(const FixedStepSimulation&) = delete;
+
+	void start()
+	{
+		if (m_running.exchange(true))
+			return;
+		m_thread = std::thread(&FixedStepSimulation::run, this);
+	}
+
+	//Waits for the step in progress, the last published states stay readable
+	void stop()
+	{
+		if (!m_running.exchange(false))
+			return;
+		m_thread.join();
+	}
+
+	//Render thread: the two latest states and where between them to draw, 0 is previous and 1 current
+	//Returns the number of the step that produced current
+	unsigned long long read(State& previous, State& current, float& alpha)
+	{
+		if (m_shared.load(std::memory_order_relaxed) & DIRTY)
+			m_front = m_shared.exchange(m_front, std::memory_order_acq_rel) & ~DIRTY;
+
+		const Snapshot& snapshot = m_slots[m_front];
+		previous = snapshot.previous;
+		current = snapshot.current;
+		alpha = std::chrono::duration<float>(Clock::now() - snapshot.time).count() / std::chrono::duration<float>(m_dt).count();
+		alpha = alpha < 0.0f ? 0.0f : alpha > 1.0f ? 1.0f : alpha;
+		return snapshot.step;
+	}
+
+	float getStepSeconds() const { return std::chrono::duration<float>(m_dt).count(); }
+	unsigned long long getStepCount() const { return m_steps.load(std::memory_order_relaxed); }
+
+	//Steps skipped because the simulation fell too far behind
+	unsigned long long getDroppedSteps() const { return m_dropped.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,131 @@
+#include "frame_arena.h"
+#include <atomic>
+
+LinearArena::LinearArena(size_t blockSize)
+	:m_block(0), m_offset(0), m_used(0), m_highWater(0), m_blockSize(blockSize)
+{
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+	while (true)
+	{
+		if (m_block < m_blocks.size())
+		{
+			Block& block = m_blocks[m_block];
+			size_t address = (size_t)block.data.get() + m_offset;
+			size_t padding = (alignment - address % alignment) % alignment;
+			if (m_offset + padding + size <= block.size)
+			{
+				m_offset += padding + size;
+				m_used += padding + size;
+				if (m_used > m_highWater)
+					m_highWater = m_used;
+				return (void*)(address + padding);
+			}
+
+			//the rest of this block is lost until the reset
+			m_used += block.size - m_offset;
+			m_block++;
+			m_offset = 0;
+			if (m_block < m_blocks.size())
+				continue;
+		}
+
+		Block block;
+		block.size = size + alignment > m_blockSize ? size + alignment : m_blockSize;
+		block.data.reset(new unsigned char[block.size]);
+		m_blocks.push_back(std::move(block));
+		m_block = m_blocks.size() - 1;
+		m_offset = 0;
+	}
+}
+
+void LinearArena::reset()
+{
+	if (m_blocks.size() > 1)
+	{
+		size_t total = getCapacity();
+		m_blocks.clear();
+
+		Block block;
+		block.size = total;
+		block.data.reset(new unsigned char[total]);
+		m_blocks.push_back(std::move(block));
+	}
+
+	m_block = 0;
+	m_offset = 0;
+	m_used = 0;
+}
+
+size_t LinearArena::getCapacity() const
+{
+	size_t capacity = 0;
+	for (const Block& block : m_blocks)
+		capacity += block.size;
+	return capacity;
+}
+
+static std::atomic<unsigned int> s_frameArenaSerial(1);
+
+FrameArena::FrameArena(size_t blockSize)
+	:m_serial(s_frameArenaSerial.fetch_add(1)), m_blockSize(blockSize)
+{
+}
+
+LinearArena& FrameArena::local()
+{
+	//one entry cache, a thread almost always asks the same arena
+	static thread_local unsigned int t_serial = 0;
+	static thread_local LinearArena* t_arena = nullptr;
+	if (t_serial == m_serial)
+		return *t_arena;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::thread::id thread = std::this_thread::get_id();
+	LinearArena* arena = nullptr;
+	for (ThreadArena& entry : m_arenas)
+	{
+		if (entry.thread == thread)
+			arena = entry.arena.get();
+	}
+	if (!arena)
+	{
+		ThreadArena entry;
+		entry.thread = thread;
+		entry.arena.reset(new LinearArena(m_blockSize));
+		arena = entry.arena.get();
+		m_arenas.push_back(std::move(entry));
+	}
+
+	t_serial = m_serial;
+	t_arena = arena;
+	return *arena;
+}
+
+void FrameArena::reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (ThreadArena& entry : m_arenas)
+		entry.arena->reset();
+}
+
+FrameArenaStats FrameArena::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	FrameArenaStats stats = { 0, 0, 0, (unsigned int)m_arenas.size() };
+	for (ThreadArena& entry : m_arenas)
+	{
+		stats.used += entry.arena->getUsed();
+		stats.highWater += entry.arena->getHighWater();
+		stats.capacity += entry.arena->getCapacity();
+	}
+	return stats;
+}
+
+FrameArena& GetFrameArena()
+{
+	static FrameArena arena;
+	return arena;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Bump allocator: allocate() moves a pointer forward, nothing is freed on its own and reset() frees everything at once
+//Grows by whole blocks; a reset after growing swaps the blocks for a single one that held all of it, so a steady
+//workload stops touching the heap after its first frame
+//Not thread safe, FrameArena gives every thread its own
+class LinearArena
+{
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> m_blocks;
+	size_t m_block;  //the one being filled
+	size_t m_offset; //into it
+	size_t m_used;   //since the last reset, alignment padding included
+	size_t m_highWater;
+	size_t m_blockSize;
+
+public:
+	explicit LinearArena(size_t blockSize = 256 * 1024);
+
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template<typename T>
+	T* allocateArray(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+
+	void reset();
+
+	size_t getUsed() const { return m_used; }
+	size_t getHighWater() const { return m_highWater; }
+	size_t getCapacity() const;
+};
+
+//Adapts a LinearArena for STL containers; deallocate() does nothing, the memory comes back with the arena's reset
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	LinearArena* arena;
+
+	explicit ArenaAllocator(LinearArena& arena) :arena(&arena) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) :arena(other.arena) {}
+
+	T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+	void deallocate(T*, size_t) {}
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+//A vector living in an arena, reserve() up front where the size is known since outgrown buffers stay until the reset
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+struct FrameArenaStats
+{
+	size_t used;      //this frame, over all threads
+	size_t highWater; //the most a thread's arena held in one frame, summed over the threads
+	size_t capacity;
+	unsigned int threads;
+};
+
+//Memory for data that lives no longer than a frame (draw lists, scratch arrays, log messages), one LinearArena per
+//thread that asks for one so threads never share a cache line or a lock while allocating
+//reset() runs once per frame on the main thread while no other thread uses the arena
+class FrameArena
+{
+private:
+	struct ThreadArena
+	{
+		std::thread::id thread;
+		std::unique_ptr<LinearArena> arena;
+	};
+
+	std::vector<ThreadArena> m_arenas;
+	std::mutex m_mutex; //only taken the first time a thread asks for its arena
+	unsigned int m_serial; //tells this instance apart in the threads' caches
+	size_t m_blockSize;
+
+public:
+	explicit FrameArena(size_t blockSize = 256 * 1024);
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	//The calling thread's arena
+	LinearArena& local();
+
+	void reset();
+
+	FrameArenaStats getStats();
+};
+
+//The arena app.cpp resets at the start of every frame
+FrameArena& GetFrameArena();
+
+//Fixed size slots for objects of one type, handed out and taken back through a free list
+//Slots come in blocks that are never given back, so pointers stay valid and a steady count stops allocating
+//Not thread safe; objects still alive when the pool is destroyed aren't destroyed with it
+template<typename T>
+class ObjectPool
+{
+private:
+	union Slot
+	{
+		Slot* next;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+	};
+
+	std::vector<std::unique_ptr<Slot[]>> m_blocks;
+	Slot* m_free;
+	unsigned int m_slotsPerBlock;
+	unsigned int m_live;
+	unsigned int m_highWater;
+
+public:
+	explicit ObjectPool(unsigned int slotsPerBlock = 256)
+		:m_free(nullptr), m_slotsPerBlock(slotsPerBlock), m_live(0), m_highWater(0)
+	{
+	}
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	template<typename... Args>
+	T* create(Args&&... args)
+	{
+		if (!m_free)
+		{
+			Slot* block = new Slot[m_slotsPerBlock];
+			for (unsigned int i = 0; i < m_slotsPerBlock; i++)
+				block[i].next = i + 1 < m_slotsPerBlock ? &block[i + 1] : nullptr;
+			m_blocks.emplace_back(block);
+			m_free = block;
+		}
+
+		Slot* slot = m_free;
+		m_free = slot->next;
+		if (++m_live > m_highWater)
+			m_highWater = m_live;
+		return new (&slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object)
+	{
+		object->~T();
+		Slot* slot = (Slot*)object;
+		slot->next = m_free;
+		m_free = slot;
+		m_live--;
+	}
+
+	unsigned int getLive() const { return m_live; }
+	unsigned int getHighWater() const { return m_highWater; }
+	unsigned int getCapacity() const { return (unsigned int)m_blocks.size() * m_slotsPerBlock; }
+};
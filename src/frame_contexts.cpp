@@ -0,0 +1,160 @@
+#include "frame_contexts.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "renderer.h"
+
+//Waits for a fence and deletes it, how long it took in milliseconds
+static double WaitAndDelete(void* fence)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	GLenum status;
+	do
+	{
+		GLCall(status = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000)); //in slices of 100 ms
+	} while (status == GL_TIMEOUT_EXPIRED);
+	GLCall(glDeleteSync((GLsync)fence));
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+FrameContexts::FrameContexts(unsigned int count, unsigned int transientSize)
+	:m_current(0), m_transientSize(transientSize), m_frames(0), m_stalls(0), m_stallMs(0.0), m_worstStallMs(0.0), m_highWater(0), m_overflows(0)
+{
+	m_contexts.resize(std::max(count, 1u));
+	for (Context& context : m_contexts)
+	{
+		GLCall(glGenBuffers(1, &context.RendererID));
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, context.RendererID));
+		GLCall(glBufferData(GL_COPY_WRITE_BUFFER, transientSize, nullptr, GL_STREAM_DRAW));
+		context.fence = nullptr;
+		context.mapped = nullptr;
+		context.mapStart = 0;
+		context.used = 0;
+	}
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+	m_current = (unsigned int)m_contexts.size() - 1; //the first beginFrame() starts on context 0
+}
+
+FrameContexts::~FrameContexts()
+{
+	destroy();
+}
+
+void FrameContexts::beginFrame()
+{
+	m_current = (m_current + 1) % m_contexts.size();
+	Context& context = m_contexts[m_current];
+	context.used = 0;
+	if (!context.fence)
+		return;
+
+	//usually signaled long ago, only a GPU that's a whole ring of frames behind makes the CPU wait
+	GLenum status;
+	GLCall(status = glClientWaitSync((GLsync)context.fence, 0, 0));
+	if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+	{
+		GLCall(glDeleteSync((GLsync)context.fence));
+	}
+	else
+	{
+		double stallMs = WaitAndDelete(context.fence);
+		m_stalls++;
+		m_stallMs += stallMs;
+		m_worstStallMs = std::max(m_worstStallMs, stallMs);
+	}
+	context.fence = nullptr;
+}
+
+TransientAllocation FrameContexts::allocate(unsigned int size, unsigned int alignment)
+{
+	TransientAllocation allocation = { 0, 0, nullptr };
+	Context& context = m_contexts[m_current];
+
+	unsigned long long offset = ((unsigned long long)context.used + alignment - 1) & ~(unsigned long long)(alignment - 1);
+	if (offset + size > m_transientSize)
+	{
+		m_overflows++;
+		return allocation;
+	}
+
+	//the fence says the GPU is done with the rest of the buffer and this frame's draws only read what's in front of
+	//offset, so the driver needn't check (unsynchronized) or keep the old data
+	if (!context.mapped)
+	{
+		unsigned char* mapped;
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, context.RendererID));
+		GLCall(mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)offset, m_transientSize - (GLsizeiptr)offset,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+		if (!mapped)
+			return allocation;
+		context.mapped = mapped;
+		context.mapStart = (unsigned int)offset;
+	}
+
+	context.used = (unsigned int)(offset + size);
+	m_highWater = std::max(m_highWater, context.used);
+	allocation.buffer = context.RendererID;
+	allocation.offset = (unsigned int)offset;
+	allocation.data = context.mapped + (offset - context.mapStart);
+	return allocation;
+}
+
+void FrameContexts::finishWrites()
+{
+	Context& context = m_contexts[m_current];
+	if (!context.mapped)
+		return;
+
+	GLboolean intact;
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, context.RendererID));
+	GLCall(glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, context.used - context.mapStart)); //relative to the mapped range
+	GLCall(intact = glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	context.mapped = nullptr;
+
+	if (!intact)
+		std::cout << "[Frame contexts] transient buffer " << m_current << " lost its contents, this frame's transient data is undefined\n";
+}
+
+void FrameContexts::endFrame()
+{
+	finishWrites(); //in case the frame didn't draw from its allocations
+	Context& context = m_contexts[m_current];
+	GLCall(context.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	m_frames++;
+}
+
+void FrameContexts::destroy()
+{
+	if (m_contexts.empty())
+		return;
+
+	for (Context& context : m_contexts)
+	{
+		if (context.mapped)
+		{
+			GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, context.RendererID));
+			GLCall(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+		}
+		if (context.fence)
+			WaitAndDelete(context.fence);
+		GLCall(glDeleteBuffers(1, &context.RendererID));
+	}
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	m_contexts.clear();
+}
+
+FrameContextStats FrameContexts::getStats() const
+{
+	FrameContextStats stats;
+	stats.contexts = (unsigned int)m_contexts.size();
+	stats.frames = m_frames;
+	stats.stalls = m_stalls;
+	stats.stallMs = (float)m_stallMs;
+	stats.worstStallMs = (float)m_worstStallMs;
+	stats.transientHighWater = m_highWater;
+	stats.overflows = m_overflows;
+	return stats;
+}
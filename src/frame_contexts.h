@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+
+//Where a transient allocation went, data is where to write it until finishWrites(); all null when it didn't fit
+struct TransientAllocation
+{
+	unsigned int buffer;
+	unsigned int offset;
+	void* data;
+};
+
+struct FrameContextStats
+{
+	unsigned int contexts;
+	unsigned long long frames;
+	unsigned long long stalls; //frames that had to wait for the GPU
+	float stallMs;      //all of them together
+	float worstStallMs;
+	unsigned int transientHighWater; //bytes of one context's buffer
+	unsigned long long overflows;    //allocations that didn't fit
+};
+
+//Frames in flight: the CPU prepares a frame while the GPU still draws the ones before it, up to the number of contexts
+//Every context owns the transient buffer its frame writes per-frame data to (vertices, uniforms) and the fence
+//put behind the frame's commands, beginFrame() moves on to the next context and waits only when the GPU hasn't
+//finished the frame that used it last, so reusing its buffer is safe without the driver's implicit synchronization
+//and the CPU can't get more than the number of contexts ahead
+//Per frame: beginFrame(), allocate() as needed, finishWrites() before the draws that read the buffer, endFrame()
+//after the frame's last command; GL thread only
+class FrameContexts
+{
+private:
+	struct Context
+	{
+		unsigned int RendererID;
+		void* fence; //GLsync, nullptr until the context's first frame ends
+		unsigned char* mapped; //[mapStart, size) of the buffer while mapped
+		unsigned int mapStart;
+		unsigned int used;
+	};
+
+	std::vector<Context> m_contexts;
+	unsigned int m_current;
+	unsigned int m_transientSize;
+
+	unsigned long long m_frames;
+	unsigned long long m_stalls;
+	double m_stallMs;
+	double m_worstStallMs;
+	unsigned int m_highWater;
+	unsigned long long m_overflows;
+
+public:
+	//count contexts, each with a transientSize byte buffer
+	explicit FrameContexts(unsigned int count = 3, unsigned int transientSize = 1 << 20);
+	~FrameContexts();
+
+	FrameContexts(const FrameContexts&) = delete;
+	FrameContexts& operator=(const FrameContexts&) = delete;
+
+	void beginFrame();
+
+	//size bytes of the current context's buffer, alignment is a power of two
+	TransientAllocation allocate(unsigned int size, unsigned int alignment = 16);
+
+	//Makes the writes visible to GL, the frame's allocations can be drawn from after it
+	//Allocating again afterwards is fine, it maps the part of the buffer after them
+	void finishWrites();
+
+	void endFrame();
+
+	//Waits for every frame and deletes the buffers and fences, before the context goes away (the destructor does the same)
+	void destroy();
+
+	unsigned int getCount() const { return (unsigned int)m_contexts.size(); }
+	unsigned int getCurrent() const { return m_current; }
+	FrameContextStats getStats() const;
+};
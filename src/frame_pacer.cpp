@@ -0,0 +1,153 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <GLFW/glfw3.h>
+
+//The sleep before a deadline ends this early and the rest is yielded away, sleeps overshoot by about a scheduler tick
+static const std::chrono::microseconds SLEEP_MARGIN(1000);
+
+static float Milliseconds(std::chrono::steady_clock::duration duration)
+{
+	return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+const char* GetPacingModeName(PacingMode mode)
+{
+	switch (mode)
+	{
+	case PacingMode::Vsync: return "vsync";
+	case PacingMode::AdaptiveVsync: return "adaptive vsync";
+	case PacingMode::Uncapped: return "uncapped";
+	}
+	return "?";
+}
+
+FramePacer::FramePacer(GLFWwindow* window, const FramePacingGoal& goal)
+	:m_window(window), m_mode(PacingMode::Vsync), m_interval(1), m_windowFrames(0), m_windowLate(0),
+	m_frames(0), m_mean(0.0), m_m2(0.0), m_worst(0.0), m_workTotal(0.0), m_missed(0), m_modeSwitches(0)
+{
+	m_tearSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+
+	GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+	if (!monitor)
+		monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode* videoMode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+	m_refreshMs = videoMode && videoMode->refreshRate > 0 ? 1000.0f / videoMode->refreshRate : 1000.0f / 60.0f;
+
+	setGoal(goal);
+	m_modeSwitches = 0;
+	m_frameStart = m_lastPresent = m_deadline = Clock::now();
+}
+
+void FramePacer::setGoal(const FramePacingGoal& goal)
+{
+	m_goal = goal;
+	m_targetMs = goal.targetFrameMs > 0.0f ? goal.targetFrameMs : m_refreshMs;
+
+	if (m_targetMs < m_refreshMs * 0.95f && goal.allowTearing)
+	{
+		m_interval = 0;
+		setMode(PacingMode::Uncapped);
+	}
+	else
+	{
+		//the display's rate or an even fraction of it, 40 ms on a 60 Hz display becomes every 2nd refresh
+		m_interval = std::max(1, (int)std::lround(m_targetMs / m_refreshMs));
+		setMode(PacingMode::Vsync);
+	}
+	m_windowFrames = m_windowLate = 0;
+}
+
+void FramePacer::setMode(PacingMode mode)
+{
+	if (mode != m_mode)
+		m_modeSwitches++;
+	m_mode = mode;
+
+	switch (mode)
+	{
+	case PacingMode::Vsync: glfwSwapInterval(m_interval); break;
+	case PacingMode::AdaptiveVsync: glfwSwapInterval(-m_interval); break; //negative intervals are swap_control_tear
+	case PacingMode::Uncapped: glfwSwapInterval(0); break;
+	}
+}
+
+void FramePacer::beginFrame()
+{
+	Clock::time_point now = Clock::now();
+	if (m_mode == PacingMode::Uncapped)
+	{
+		if (now < m_deadline)
+		{
+			if (m_deadline - now > SLEEP_MARGIN)
+				std::this_thread::sleep_until(m_deadline - SLEEP_MARGIN);
+			while (Clock::now() < m_deadline)
+				std::this_thread::yield();
+			now = Clock::now();
+		}
+
+		//keeps the frames on the same grid, unless a frame ran so long that catching up would mean frames back to back
+		Clock::duration target = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(m_targetMs));
+		m_deadline += target;
+		if (m_deadline < now)
+			m_deadline = now + target;
+	}
+	m_frameStart = now;
+}
+
+void FramePacer::present()
+{
+	float workMs = Milliseconds(Clock::now() - m_frameStart);
+	glfwSwapBuffers(m_window);
+	Clock::time_point now = Clock::now();
+	float frameMs = Milliseconds(now - m_lastPresent);
+	m_lastPresent = now;
+
+	m_frames++;
+	if (m_frames == 1)
+		return; //nothing before it to measure against
+
+	unsigned long long samples = m_frames - 1;
+	double delta = frameMs - m_mean;
+	m_mean += delta / samples;
+	m_m2 += delta * (frameMs - m_mean);
+	m_worst = std::max(m_worst, (double)frameMs);
+	m_workTotal += workMs;
+	if (frameMs > m_targetMs * 1.5f)
+		m_missed++;
+
+	//in the vsync modes a frame whose work doesn't fit its refreshes is what makes vsync wait another one
+	bool late = m_mode == PacingMode::Uncapped ? frameMs > m_targetMs * 1.5f : workMs > m_interval * m_refreshMs * 0.9f;
+	if (late)
+		m_windowLate++;
+	if (++m_windowFrames == WINDOW)
+		adapt();
+}
+
+//Switches between the vsync modes on a whole window of frames, with a gap between the thresholds so a load right at
+//the edge doesn't flip the mode back and forth
+void FramePacer::adapt()
+{
+	if (m_mode == PacingMode::Vsync && m_windowLate > WINDOW / 10 && m_goal.allowTearing && m_tearSupported)
+		setMode(PacingMode::AdaptiveVsync);
+	else if (m_mode == PacingMode::AdaptiveVsync && m_windowLate <= WINDOW / 60)
+		setMode(PacingMode::Vsync);
+
+	m_windowFrames = m_windowLate = 0;
+}
+
+FramePacingStats FramePacer::getStats() const
+{
+	FramePacingStats stats;
+	unsigned long long samples = m_frames > 1 ? m_frames - 1 : 0;
+	stats.frames = m_frames;
+	stats.averageMs = (float)m_mean;
+	stats.jitterMs = samples > 1 ? (float)std::sqrt(m_m2 / (samples - 1)) : 0.0f;
+	stats.worstMs = (float)m_worst;
+	stats.averageWorkMs = samples ? (float)(m_workTotal / samples) : 0.0f;
+	stats.missed = m_missed;
+	stats.modeSwitches = m_modeSwitches;
+	stats.mode = m_mode;
+	return stats;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <chrono>
+
+struct GLFWwindow;
+
+enum class PacingMode
+{
+	Vsync,         //swaps wait for the display, a late frame waits for the next refresh
+	AdaptiveVsync, //like Vsync, but a late frame is shown right away with a tear instead of waiting (swap_control_tear)
+	Uncapped       //no waiting on the display, the pacer sleeps until the target frame time is up
+};
+
+const char* GetPacingModeName(PacingMode mode);
+
+//What the pacer aims for
+struct FramePacingGoal
+{
+	float targetFrameMs = 0.0f; //0 for the display's refresh period
+	bool allowTearing = true;   //AdaptiveVsync and Uncapped tear, without it the pacer stays on Vsync
+};
+
+struct FramePacingStats
+{
+	unsigned long long frames;
+	float averageMs; //between presents
+	float jitterMs;  //standard deviation of the time between presents
+	float worstMs;
+	float averageWorkMs; //from beginFrame() to the swap
+	unsigned long long missed; //frames longer than 1.5 target frame times
+	unsigned int modeSwitches;
+	PacingMode mode;
+};
+
+//Replaces a fixed swap interval: measures how long frames take and picks how they're presented
+//A goal faster than the display only works uncapped, the pacer then sleeps the rest of every frame instead of
+//spinning, which keeps latency low without burning a core
+//At the display's rate or slower it uses vsync with the matching interval, and when too many frames miss their
+//refresh it switches to adaptive vsync (if the driver has it), so a late frame costs a tear instead of a whole
+//refresh of latency; once frames fit again for a while it goes back to plain vsync
+//beginFrame() at the top of the loop, before input is polled, present() instead of glfwSwapBuffers()
+class FramePacer
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	static const unsigned int WINDOW = 60; //frames between mode decisions
+
+	GLFWwindow* m_window;
+	FramePacingGoal m_goal;
+	PacingMode m_mode;
+	bool m_tearSupported;
+	float m_refreshMs;
+	float m_targetMs;
+	int m_interval; //refreshes per frame in the vsync modes
+
+	Clock::time_point m_frameStart;
+	Clock::time_point m_lastPresent;
+	Clock::time_point m_deadline; //Uncapped only
+
+	//this window
+	unsigned int m_windowFrames;
+	unsigned int m_windowLate;
+
+	//whole run, jitter is Welford's running variance
+	unsigned long long m_frames;
+	double m_mean;
+	double m_m2;
+	double m_worst;
+	double m_workTotal;
+	unsigned long long m_missed;
+	unsigned int m_modeSwitches;
+
+	void setMode(PacingMode mode);
+	void adapt();
+
+public:
+	//The window's context must be current
+	FramePacer(GLFWwindow* window, const FramePacingGoal& goal = FramePacingGoal());
+
+	void setGoal(const FramePacingGoal& goal);
+	const FramePacingGoal& getGoal() const { return m_goal; }
+
+	//Sleeps until the frame is due when uncapped, then starts timing the frame's work
+	void beginFrame();
+
+	//Swaps the window's buffers and records the frame
+	void present();
+
+	PacingMode getMode() const { return m_mode; }
+	float getRefreshMs() const { return m_refreshMs; }
+	float getTargetMs() const { return m_targetMs; }
+	FramePacingStats getStats() const;
+};
@@ -0,0 +1,1203 @@
+#include "glsl_compiler.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+unsigned int GlslComponents(GlslType type)
+{
+	switch (type)
+	{
+	case GlslType::Float: return 1;
+	case GlslType::Vec2:  return 2;
+	case GlslType::Vec3:  return 3;
+	case GlslType::Vec4:  return 4;
+	case GlslType::Mat2:  return 4;
+	case GlslType::Mat3:  return 9;
+	case GlslType::Mat4:  return 16;
+	}
+	return 0;
+}
+
+static bool IsMatrix(GlslType type)
+{
+	return type == GlslType::Mat2 || type == GlslType::Mat3 || type == GlslType::Mat4;
+}
+
+//columns (and rows) of a matrix type
+static unsigned int MatrixSize(GlslType type)
+{
+	return (unsigned int)type - (unsigned int)GlslType::Mat2 + 2;
+}
+
+static GlslType VectorType(unsigned int components)
+{
+	return components == 1 ? GlslType::Float : (GlslType)((unsigned int)GlslType::Vec2 + components - 2);
+}
+
+static bool TypeFromName(const std::string& name, GlslType& type)
+{
+	static const struct { const char* name; GlslType type; } TYPES[] =
+	{
+		{ "float", GlslType::Float }, { "vec2", GlslType::Vec2 }, { "vec3", GlslType::Vec3 }, { "vec4", GlslType::Vec4 },
+		{ "mat2", GlslType::Mat2 }, { "mat3", GlslType::Mat3 }, { "mat4", GlslType::Mat4 }
+	};
+	for (const auto& t : TYPES)
+		if (name == t.name)
+		{
+			type = t.type;
+			return true;
+		}
+	return false;
+}
+
+static const char* TypeName(GlslType type)
+{
+	static const char* NAMES[] = { "float", "vec2", "vec3", "vec4", "mat2", "mat3", "mat4" };
+	return NAMES[(int)type];
+}
+
+enum TokenKind
+{
+	TOKEN_IDENTIFIER,
+	TOKEN_NUMBER,
+	TOKEN_SYMBOL,
+	TOKEN_END
+};
+
+struct Token
+{
+	TokenKind kind;
+	std::string text;
+	float number;
+	int line;
+};
+
+static bool Tokenize(const std::string& source, std::vector<Token>& tokens, std::string& log)
+{
+	static const char* SYMBOLS[] =
+	{
+		"+=", "-=", "*=", "/=", "++", "--", "==", "!=", "<=", ">=", "&&", "||",
+		"(", ")", "{", "}", "[", "]", ";", ",", ".", "=", "+", "-", "*", "/", "<", ">", "!", "?", ":", "%"
+	};
+
+	int line = 1;
+	bool lineStart = true;
+	size_t i = 0;
+	while (i < source.size())
+	{
+		char c = source[i];
+		if (c == '\n')
+		{
+			line++;
+			lineStart = true;
+			i++;
+			continue;
+		}
+		if (std::isspace((unsigned char)c) || (unsigned char)c == 0xEF || (unsigned char)c == 0xBB || (unsigned char)c == 0xBF)
+		{
+			//whitespace, or a UTF-8 byte order mark
+			i++;
+			continue;
+		}
+
+		//preprocessor lines, only the ones that don't change the code are accepted
+		if (c == '#' && lineStart)
+		{
+			size_t end = source.find('\n', i);
+			if (end == std::string::npos)
+				end = source.size();
+			std::string directive = source.substr(i + 1, end - i - 1);
+			size_t first = directive.find_first_not_of(" \t");
+			directive = first == std::string::npos ? "" : directive.substr(first);
+			if (directive.compare(0, 7, "version") != 0 && directive.compare(0, 9, "extension") != 0 && !directive.empty())
+			{
+				log += "line " + std::to_string(line) + ": unsupported preprocessor directive #" + directive + "\n";
+				return false;
+			}
+			i = end;
+			continue;
+		}
+		lineStart = false;
+
+		if (c == '/' && i + 1 < source.size() && source[i + 1] == '/')
+		{
+			while (i < source.size() && source[i] != '\n')
+				i++;
+			continue;
+		}
+		if (c == '/' && i + 1 < source.size() && source[i + 1] == '*')
+		{
+			i += 2;
+			while (i + 1 < source.size() && !(source[i] == '*' && source[i + 1] == '/'))
+			{
+				if (source[i] == '\n')
+					line++;
+				i++;
+			}
+			i += 2;
+			continue;
+		}
+
+		Token token;
+		token.line = line;
+		token.number = 0.0f;
+
+		if (std::isalpha((unsigned char)c) || c == '_')
+		{
+			size_t start = i;
+			while (i < source.size() && (std::isalnum((unsigned char)source[i]) || source[i] == '_'))
+				i++;
+			token.kind = TOKEN_IDENTIFIER;
+			token.text = source.substr(start, i - start);
+		}
+		else if (std::isdigit((unsigned char)c) || (c == '.' && i + 1 < source.size() && std::isdigit((unsigned char)source[i + 1])))
+		{
+			const char* start = source.c_str() + i;
+			char* end;
+			token.kind = TOKEN_NUMBER;
+			token.number = (float)std::strtod(start, &end);
+			i += end - start;
+			//float and unsigned suffixes
+			if (i < source.size() && std::strchr("fFuU", source[i]))
+				i++;
+			token.text = source.substr(start - source.c_str(), source.c_str() + i - start);
+		}
+		else
+		{
+			token.kind = TOKEN_SYMBOL;
+			for (const char* symbol : SYMBOLS)
+			{
+				size_t length = std::strlen(symbol);
+				if (source.compare(i, length, symbol) == 0)
+				{
+					token.text = symbol;
+					break;
+				}
+			}
+			if (token.text.empty())
+			{
+				log += "line " + std::to_string(line) + ": unexpected character '" + c + "'\n";
+				return false;
+			}
+			i += token.text.size();
+		}
+		tokens.push_back(token);
+	}
+
+	Token end;
+	end.kind = TOKEN_END;
+	end.number = 0.0f;
+	end.line = line;
+	tokens.push_back(end);
+	return true;
+}
+
+//Registers of literals and uniforms get this flag while compiling,
+//they're moved in front of the other registers once the final counts are known
+static const unsigned int CONSTANT_FLAG = 0x8000;
+
+//A value is a list of registers, one per component, so swizzles, constructors and
+//matrix columns just pick registers without emitting any code
+struct Value
+{
+	GlslType type;
+	unsigned short regs[16];
+	bool assignable;
+};
+
+enum class Storage
+{
+	Local,
+	Input,
+	Output,
+	Uniform,
+	Const
+};
+
+struct Symbol
+{
+	GlslType type;
+	unsigned int reg;
+	Storage storage;
+};
+
+class GlslCompiler
+{
+private:
+	std::vector<Token> m_tokens;
+	size_t m_pos;
+	GlslShader& m_out;
+	std::string m_error;
+
+	std::vector<std::unordered_map<std::string, Symbol>> m_scopes;
+	unsigned int m_registerCount;
+	std::vector<float> m_constants;
+	std::vector<bool> m_isLiteral;
+	std::unordered_map<unsigned int, unsigned short> m_literals; //float bits -> register
+
+	bool failed() const { return !m_error.empty(); }
+
+	void fail(const std::string& message)
+	{
+		if (m_error.empty())
+			m_error = "line " + std::to_string(peek().line) + ": " + message;
+	}
+
+	const Token& peek(size_t ahead = 0) const
+	{
+		return m_tokens[m_pos + ahead < m_tokens.size() ? m_pos + ahead : m_tokens.size() - 1];
+	}
+
+	const Token& next()
+	{
+		const Token& token = peek();
+		if (m_pos < m_tokens.size() - 1)
+			m_pos++;
+		return token;
+	}
+
+	bool is(const char* text, size_t ahead = 0) const
+	{
+		const Token& token = peek(ahead);
+		return token.kind != TOKEN_END && token.kind != TOKEN_NUMBER && token.text == text;
+	}
+
+	bool accept(const char* text)
+	{
+		if (!is(text))
+			return false;
+		next();
+		return true;
+	}
+
+	void expect(const char* text)
+	{
+		if (!accept(text))
+			fail(std::string("expected '") + text + "' but found '" + peek().text + "'");
+	}
+
+	std::string expectIdentifier()
+	{
+		if (peek().kind != TOKEN_IDENTIFIER)
+		{
+			fail("expected an identifier but found '" + peek().text + "'");
+			return "";
+		}
+		return next().text;
+	}
+
+	//precision qualifiers change nothing on the CPU
+	void skipPrecision()
+	{
+		while (accept("highp") || accept("mediump") || accept("lowp") || accept("smooth"))
+			;
+	}
+
+	bool peekType(GlslType& type) const
+	{
+		return peek().kind == TOKEN_IDENTIFIER && TypeFromName(peek().text, type);
+	}
+
+	GlslType expectType()
+	{
+		GlslType type = GlslType::Float;
+		if (!peekType(type))
+			fail("expected a type but found '" + peek().text + "'");
+		else
+			next();
+		return type;
+	}
+
+	unsigned short allocRegisters(unsigned int count)
+	{
+		if (m_registerCount + count >= CONSTANT_FLAG)
+		{
+			fail("shader uses too many registers");
+			return 0;
+		}
+		unsigned short reg = (unsigned short)m_registerCount;
+		m_registerCount += count;
+		return reg;
+	}
+
+	unsigned short allocConstants(unsigned int count, bool literal)
+	{
+		if (m_constants.size() + count >= CONSTANT_FLAG)
+		{
+			fail("shader uses too many constants");
+			return 0;
+		}
+		unsigned short reg = (unsigned short)(m_constants.size() | CONSTANT_FLAG);
+		m_constants.resize(m_constants.size() + count, 0.0f);
+		m_isLiteral.resize(m_constants.size(), literal);
+		return reg;
+	}
+
+	unsigned short literal(float v)
+	{
+		unsigned int bits;
+		std::memcpy(&bits, &v, 4);
+		auto found = m_literals.find(bits);
+		if (found != m_literals.end())
+			return found->second;
+
+		unsigned short reg = allocConstants(1, true);
+		m_constants[reg & ~CONSTANT_FLAG] = v;
+		m_literals[bits] = reg;
+		return reg;
+	}
+
+	bool literalValue(unsigned short reg, float& v) const
+	{
+		if (!(reg & CONSTANT_FLAG) || !m_isLiteral[reg & ~CONSTANT_FLAG])
+			return false;
+		v = m_constants[reg & ~CONSTANT_FLAG];
+		return true;
+	}
+
+	void emit(VmOp op, unsigned short dst, unsigned short a, unsigned short b, unsigned short c)
+	{
+		VmInstruction inst = { op, dst, a, b, c };
+		m_out.program.code.push_back(inst);
+	}
+
+	void emit(VmOp op, unsigned short dst, unsigned short a)
+	{
+		emit(op, dst, a, a, a);
+	}
+
+	void emit(VmOp op, unsigned short dst, unsigned short a, unsigned short b)
+	{
+		emit(op, dst, a, b, a);
+	}
+
+	Value temp(GlslType type)
+	{
+		Value v;
+		v.type = type;
+		v.assignable = false;
+		unsigned short reg = allocRegisters(GlslComponents(type));
+		for (unsigned int i = 0; i < GlslComponents(type); i++)
+			v.regs[i] = (unsigned short)(reg + i);
+		return v;
+	}
+
+	Value scalarLiteral(float number)
+	{
+		Value v;
+		v.type = GlslType::Float;
+		v.regs[0] = literal(number);
+		v.assignable = false;
+		return v;
+	}
+
+	//register of component i, scalars are broadcast
+	static unsigned short component(const Value& v, unsigned int i)
+	{
+		return GlslComponents(v.type) == 1 ? v.regs[0] : v.regs[i];
+	}
+
+	const Symbol* lookup(const std::string& name) const
+	{
+		for (size_t s = m_scopes.size(); s-- > 0;)
+		{
+			auto found = m_scopes[s].find(name);
+			if (found != m_scopes[s].end())
+				return &found->second;
+		}
+		return nullptr;
+	}
+
+	Symbol& declare(const std::string& name, GlslType type, Storage storage)
+	{
+		if (m_scopes.back().count(name))
+			fail("redefinition of '" + name + "'");
+
+		Symbol& symbol = m_scopes.back()[name];
+		symbol.type = type;
+		symbol.storage = storage;
+		symbol.reg = storage == Storage::Uniform ? allocConstants(GlslComponents(type), false) : allocRegisters(GlslComponents(type));
+		return symbol;
+	}
+
+	void assign(const Value& target, Value source)
+	{
+		if (!target.assignable)
+		{
+			fail("left side of the assignment can't be written");
+			return;
+		}
+		if (target.type != source.type)
+		{
+			fail(std::string("can't assign ") + TypeName(source.type) + " to " + TypeName(target.type));
+			return;
+		}
+
+		//components written first must not be read later, otherwise copy the source out first
+		unsigned int n = GlslComponents(target.type);
+		bool overlap = false;
+		for (unsigned int i = 0; i < n; i++)
+			for (unsigned int j = 0; j < i; j++)
+				if (source.regs[i] == target.regs[j])
+					overlap = true;
+		if (overlap)
+		{
+			Value copy = temp(source.type);
+			for (unsigned int i = 0; i < n; i++)
+				emit(VmOp::Mov, copy.regs[i], source.regs[i]);
+			source = copy;
+		}
+
+		for (unsigned int i = 0; i < n; i++)
+			if (target.regs[i] != source.regs[i])
+				emit(VmOp::Mov, target.regs[i], source.regs[i]);
+	}
+
+	//type of a componentwise operation, scalars combine with anything
+	bool componentwiseType(const Value* args, unsigned int count, GlslType& type)
+	{
+		type = GlslType::Float;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (GlslComponents(args[i].type) == 1)
+				continue;
+			if (type != GlslType::Float && type != args[i].type)
+			{
+				fail(std::string("mismatched operand types ") + TypeName(type) + " and " + TypeName(args[i].type));
+				return false;
+			}
+			type = args[i].type;
+		}
+		return true;
+	}
+
+	Value componentwise(VmOp op, const Value& a, const Value& b)
+	{
+		Value args[2] = { a, b };
+		GlslType type;
+		if (!componentwiseType(args, 2, type))
+			return a;
+
+		Value r = temp(type);
+		for (unsigned int i = 0; i < GlslComponents(type); i++)
+			emit(op, r.regs[i], component(a, i), component(b, i));
+		return r;
+	}
+
+	Value componentwise(VmOp op, const Value& a)
+	{
+		Value r = temp(a.type);
+		for (unsigned int i = 0; i < GlslComponents(a.type); i++)
+			emit(op, r.regs[i], a.regs[i]);
+		return r;
+	}
+
+	//dst = sum of x[i * xStride] * y[i * yStride]
+	void emitDot(unsigned short dst, const unsigned short* x, unsigned int xStride, const unsigned short* y, unsigned int yStride, unsigned int n)
+	{
+		emit(VmOp::Mul, dst, x[0], y[0]);
+		for (unsigned int i = 1; i < n; i++)
+			emit(VmOp::Mad, dst, x[i * xStride], y[i * yStride], dst);
+	}
+
+	Value binary(char op, const Value& a, const Value& b)
+	{
+		bool aScalar = GlslComponents(a.type) == 1, bScalar = GlslComponents(b.type) == 1;
+
+		//linear algebra products, everything else is componentwise
+		if (op == '*' && !aScalar && !bScalar && (IsMatrix(a.type) || IsMatrix(b.type)))
+		{
+			unsigned int n = IsMatrix(a.type) ? MatrixSize(a.type) : MatrixSize(b.type);
+			if (IsMatrix(a.type) && IsMatrix(b.type))
+			{
+				if (a.type != b.type)
+				{
+					fail(std::string("can't multiply ") + TypeName(a.type) + " by " + TypeName(b.type));
+					return a;
+				}
+				Value r = temp(a.type);
+				for (unsigned int column = 0; column < n; column++)
+					for (unsigned int row = 0; row < n; row++)
+						emitDot(r.regs[column * n + row], a.regs + row, n, b.regs + column * n, 1, n);
+				return r;
+			}
+
+			const Value& vector = IsMatrix(a.type) ? b : a;
+			if (GlslComponents(vector.type) != n || IsMatrix(vector.type))
+			{
+				fail(std::string("can't multiply ") + TypeName(a.type) + " by " + TypeName(b.type));
+				return a;
+			}
+
+			Value r = temp(vector.type);
+			for (unsigned int i = 0; i < n; i++)
+			{
+				if (IsMatrix(a.type))
+					emitDot(r.regs[i], a.regs + i, n, b.regs, 1, n);     //row i of the matrix
+				else
+					emitDot(r.regs[i], a.regs, 1, b.regs + i * n, 1, n); //column i of the matrix
+			}
+			return r;
+		}
+
+		//fold literal arithmetic like 2.0 * 3.14159
+		float x, y;
+		if (aScalar && bScalar && literalValue(a.regs[0], x) && literalValue(b.regs[0], y))
+			return scalarLiteral(op == '+' ? x + y : op == '-' ? x - y : op == '*' ? x * y : x / y);
+
+		VmOp vop = op == '+' ? VmOp::Add : op == '-' ? VmOp::Sub : op == '*' ? VmOp::Mul : VmOp::Div;
+		return componentwise(vop, a, b);
+	}
+
+	Value construct(GlslType type, const std::vector<Value>& args)
+	{
+		Value r;
+		r.type = type;
+		r.assignable = false;
+		unsigned int n = GlslComponents(type);
+
+		if (args.size() == 1 && GlslComponents(args[0].type) == 1)
+		{
+			//scalars fill vectors and the diagonal of matrices
+			for (unsigned int i = 0; i < n; i++)
+				r.regs[i] = args[0].regs[0];
+			if (IsMatrix(type))
+			{
+				unsigned int size = MatrixSize(type);
+				for (unsigned int i = 0; i < n; i++)
+					if (i / size != i % size)
+						r.regs[i] = literal(0.0f);
+			}
+			return r;
+		}
+
+		if (args.size() == 1 && IsMatrix(type) && IsMatrix(args[0].type))
+		{
+			//resizing a matrix keeps the overlap and fills the rest from the identity
+			unsigned int size = MatrixSize(type), from = MatrixSize(args[0].type);
+			for (unsigned int column = 0; column < size; column++)
+				for (unsigned int row = 0; row < size; row++)
+					r.regs[column * size + row] = column < from && row < from ? args[0].regs[column * from + row]
+						: literal(column == row ? 1.0f : 0.0f);
+			return r;
+		}
+
+		//the last argument may be cut short, but each one has to be used
+		unsigned int filled = 0;
+		for (const Value& arg : args)
+		{
+			if (filled == n)
+			{
+				fail(std::string("too many arguments provided to ") + TypeName(type) + " constructor");
+				return r;
+			}
+			for (unsigned int i = 0; i < GlslComponents(arg.type) && filled < n; i++)
+				r.regs[filled++] = arg.regs[i];
+		}
+		if (filled < n)
+			fail(std::string("not enough data provided for ") + TypeName(type) + " constructor");
+		return r;
+	}
+
+	Value callBuiltin(const std::string& name, const std::vector<Value>& args)
+	{
+		static const struct { const char* name; VmOp op; } UNARY[] =
+		{
+			{ "abs", VmOp::Abs }, { "sign", VmOp::Sign }, { "floor", VmOp::Floor }, { "fract", VmOp::Fract },
+			{ "sqrt", VmOp::Sqrt }, { "inversesqrt", VmOp::InverseSqrt }, { "sin", VmOp::Sin }, { "cos", VmOp::Cos },
+			{ "tan", VmOp::Tan }, { "exp", VmOp::Exp }, { "log", VmOp::Log }, { "exp2", VmOp::Exp2 }, { "log2", VmOp::Log2 }
+		};
+		static const struct { const char* name; VmOp op; } BINARY[] =
+		{
+			{ "min", VmOp::Min }, { "max", VmOp::Max }, { "mod", VmOp::Mod }, { "pow", VmOp::Pow }, { "step", VmOp::Step }
+		};
+
+		size_t count = args.size();
+		for (const Value& arg : args)
+			if (IsMatrix(arg.type) && name != "transpose")
+			{
+				fail(name + "() doesn't take matrices");
+				return args[0];
+			}
+
+		for (const auto& f : UNARY)
+			if (name == f.name)
+			{
+				if (count != 1)
+					break;
+				return componentwise(f.op, args[0]);
+			}
+		for (const auto& f : BINARY)
+			if (name == f.name)
+			{
+				if (count != 2)
+					break;
+				return componentwise(f.op, args[0], args[1]);
+			}
+
+		if (name == "radians" && count == 1)
+			return binary('*', args[0], scalarLiteral(0.01745329252f));
+		if (name == "degrees" && count == 1)
+			return binary('*', args[0], scalarLiteral(57.29577951f));
+		if (name == "clamp" && count == 3)
+			return componentwise(VmOp::Min, componentwise(VmOp::Max, args[0], args[1]), args[2]);
+
+		if (name == "mix" && count == 3)
+		{
+			GlslType type;
+			if (!componentwiseType(args.data(), 3, type))
+				return args[0];
+			Value difference = componentwise(VmOp::Sub, args[1], args[0]);
+			Value r = temp(type);
+			for (unsigned int i = 0; i < GlslComponents(type); i++)
+				emit(VmOp::Mad, r.regs[i], component(difference, i), component(args[2], i), component(args[0], i));
+			return r;
+		}
+
+		if (name == "smoothstep" && count == 3)
+		{
+			GlslType type;
+			if (!componentwiseType(args.data(), 3, type))
+				return args[0];
+			Value t = componentwise(VmOp::Div, componentwise(VmOp::Sub, args[2], args[0]), componentwise(VmOp::Sub, args[1], args[0]));
+			t = componentwise(VmOp::Min, componentwise(VmOp::Max, t, scalarLiteral(0.0f)), scalarLiteral(1.0f));
+			Value r = temp(t.type);
+			for (unsigned int i = 0; i < GlslComponents(t.type); i++)
+			{
+				//t * t * (3 - 2 * t)
+				emit(VmOp::Mad, r.regs[i], t.regs[i], literal(-2.0f), literal(3.0f));
+				emit(VmOp::Mul, r.regs[i], r.regs[i], t.regs[i]);
+				emit(VmOp::Mul, r.regs[i], r.regs[i], t.regs[i]);
+			}
+			return r;
+		}
+
+		if ((name == "dot" || name == "distance") && count == 2)
+		{
+			if (args[0].type != args[1].type)
+			{
+				fail(name + "() needs arguments of the same type");
+				return args[0];
+			}
+			Value r = temp(GlslType::Float);
+			if (name == "dot")
+			{
+				emitDot(r.regs[0], args[0].regs, 1, args[1].regs, 1, GlslComponents(args[0].type));
+				return r;
+			}
+			Value d = componentwise(VmOp::Sub, args[0], args[1]);
+			emitDot(r.regs[0], d.regs, 1, d.regs, 1, GlslComponents(d.type));
+			emit(VmOp::Sqrt, r.regs[0], r.regs[0]);
+			return r;
+		}
+
+		if ((name == "length" || name == "normalize") && count == 1)
+		{
+			Value squared = temp(GlslType::Float);
+			emitDot(squared.regs[0], args[0].regs, 1, args[0].regs, 1, GlslComponents(args[0].type));
+			if (name == "length")
+			{
+				emit(VmOp::Sqrt, squared.regs[0], squared.regs[0]);
+				return squared;
+			}
+			emit(VmOp::InverseSqrt, squared.regs[0], squared.regs[0]);
+			return componentwise(VmOp::Mul, args[0], squared);
+		}
+
+		if (name == "cross" && count == 2)
+		{
+			if (args[0].type != GlslType::Vec3 || args[1].type != GlslType::Vec3)
+			{
+				fail("cross() needs two vec3");
+				return args[0];
+			}
+			const unsigned short* a = args[0].regs;
+			const unsigned short* b = args[1].regs;
+			Value r = temp(GlslType::Vec3);
+			for (int i = 0; i < 3; i++)
+			{
+				int j = (i + 1) % 3, k = (i + 2) % 3;
+				emit(VmOp::Mul, r.regs[i], a[k], b[j]);
+				emit(VmOp::Msb, r.regs[i], a[j], b[k], r.regs[i]);
+			}
+			return r;
+		}
+
+		if (name == "reflect" && count == 2)
+		{
+			//I - 2 * dot(N, I) * N
+			if (args[0].type != args[1].type)
+			{
+				fail("reflect() needs arguments of the same type");
+				return args[0];
+			}
+			Value d = temp(GlslType::Float);
+			emitDot(d.regs[0], args[0].regs, 1, args[1].regs, 1, GlslComponents(args[0].type));
+			emit(VmOp::Mul, d.regs[0], d.regs[0], literal(-2.0f));
+			Value r = temp(args[0].type);
+			for (unsigned int i = 0; i < GlslComponents(r.type); i++)
+				emit(VmOp::Mad, r.regs[i], d.regs[0], args[1].regs[i], args[0].regs[i]);
+			return r;
+		}
+
+		if (name == "transpose" && count == 1 && IsMatrix(args[0].type))
+		{
+			Value r = args[0];
+			r.assignable = false;
+			unsigned int n = MatrixSize(r.type);
+			for (unsigned int column = 0; column < n; column++)
+				for (unsigned int row = 0; row < n; row++)
+					r.regs[column * n + row] = args[0].regs[row * n + column];
+			return r;
+		}
+
+		fail("no matching overload for " + name + "() with " + std::to_string(count) + " argument(s)");
+		return count ? args[0] : scalarLiteral(0.0f);
+	}
+
+	Value parsePrimary()
+	{
+		const Token& token = peek();
+		if (token.kind == TOKEN_NUMBER)
+		{
+			next();
+			return scalarLiteral(token.number);
+		}
+
+		if (accept("("))
+		{
+			Value v = parseExpression();
+			expect(")");
+			return v;
+		}
+
+		if (token.kind != TOKEN_IDENTIFIER)
+		{
+			fail("unexpected '" + token.text + "'");
+			return scalarLiteral(0.0f);
+		}
+
+		std::string name = next().text;
+		GlslType type = GlslType::Float;
+		bool constructor = TypeFromName(name, type);
+		if (constructor || is("("))
+		{
+			std::vector<Value> args;
+			expect("(");
+			if (!is(")"))
+			{
+				do
+					args.push_back(parseExpression());
+				while (!failed() && accept(","));
+			}
+			expect(")");
+			if (failed())
+				return scalarLiteral(0.0f);
+
+			if (constructor)
+			{
+				if (args.empty())
+				{
+					fail(name + " constructor needs arguments");
+					return scalarLiteral(0.0f);
+				}
+				return construct(type, args);
+			}
+			return callBuiltin(name, args);
+		}
+
+		const Symbol* symbol = lookup(name);
+		if (!symbol)
+		{
+			fail("undeclared identifier '" + name + "'");
+			return scalarLiteral(0.0f);
+		}
+
+		Value v;
+		v.type = symbol->type;
+		v.assignable = symbol->storage == Storage::Local || symbol->storage == Storage::Output;
+		for (unsigned int i = 0; i < GlslComponents(symbol->type); i++)
+			v.regs[i] = (unsigned short)(symbol->reg + i);
+		return v;
+	}
+
+	Value swizzle(const Value& v, const std::string& fields)
+	{
+		static const char* SETS[] = { "xyzw", "rgba", "stpq" };
+		unsigned int size = GlslComponents(v.type);
+		if (IsMatrix(v.type) || fields.empty() || fields.size() > 4)
+		{
+			fail("invalid swizzle ." + fields);
+			return v;
+		}
+
+		Value r;
+		r.type = VectorType((unsigned int)fields.size());
+		r.assignable = v.assignable;
+		for (const char* set : SETS)
+		{
+			if (!std::strchr(set, fields[0]))
+				continue;
+			for (size_t i = 0; i < fields.size(); i++)
+			{
+				const char* field = std::strchr(set, fields[i]);
+				if (!field || (unsigned int)(field - set) >= size)
+				{
+					fail("invalid swizzle ." + fields);
+					return v;
+				}
+				r.regs[i] = v.regs[field - set];
+				for (size_t j = 0; j < i; j++)
+					if (fields[j] == fields[i])
+						r.assignable = false; //repeated components can't be written
+			}
+			return r;
+		}
+
+		fail("invalid swizzle ." + fields);
+		return v;
+	}
+
+	Value parsePostfix()
+	{
+		Value v = parsePrimary();
+		while (!failed())
+		{
+			if (accept("."))
+				v = swizzle(v, expectIdentifier());
+			else if (accept("["))
+			{
+				//only constant indices, they pick registers at compile time
+				const Token& index = next();
+				expect("]");
+				unsigned int count = IsMatrix(v.type) ? MatrixSize(v.type) : GlslComponents(v.type);
+				if (count == 1)
+				{
+					fail(std::string("can't index a ") + TypeName(v.type));
+					return v;
+				}
+				if (index.kind != TOKEN_NUMBER || index.number != (float)(int)index.number || index.number < 0 || index.number >= count)
+				{
+					fail("index must be a constant within the size of the " + std::string(TypeName(v.type)));
+					return v;
+				}
+
+				unsigned int i = (unsigned int)index.number;
+				Value r;
+				r.assignable = v.assignable;
+				if (IsMatrix(v.type))
+				{
+					r.type = VectorType(count);
+					for (unsigned int k = 0; k < count; k++)
+						r.regs[k] = v.regs[i * count + k];
+				}
+				else
+				{
+					r.type = GlslType::Float;
+					r.regs[0] = v.regs[i];
+				}
+				v = r;
+			}
+			else
+				break;
+		}
+		return v;
+	}
+
+	Value parseUnary()
+	{
+		if (accept("+"))
+			return parseUnary();
+		if (accept("-"))
+		{
+			Value v = parseUnary();
+			float x;
+			if (GlslComponents(v.type) == 1 && literalValue(v.regs[0], x))
+				return scalarLiteral(-x);
+			return componentwise(VmOp::Neg, v);
+		}
+		return parsePostfix();
+	}
+
+	Value parseMultiplicative()
+	{
+		Value v = parseUnary();
+		while (!failed() && (is("*") || is("/")))
+		{
+			char op = next().text[0];
+			v = binary(op, v, parseUnary());
+		}
+		return v;
+	}
+
+	Value parseExpression()
+	{
+		Value v = parseMultiplicative();
+		while (!failed() && (is("+") || is("-")))
+		{
+			char op = next().text[0];
+			v = binary(op, v, parseMultiplicative());
+		}
+		return v;
+	}
+
+	//type name [= expression] {, name [= expression]} ;
+	void parseDeclaration(Storage storage)
+	{
+		GlslType type = expectType();
+		do
+		{
+			std::string name = expectIdentifier();
+			if (is("["))
+			{
+				fail("arrays are not supported");
+				return;
+			}
+
+			if (accept("="))
+			{
+				//the initializer can't see the variable it declares
+				Value init = parseExpression();
+				Symbol& symbol = declare(name, type, Storage::Local);
+				Value target;
+				target.type = type;
+				target.assignable = true;
+				for (unsigned int i = 0; i < GlslComponents(type); i++)
+					target.regs[i] = (unsigned short)(symbol.reg + i);
+				assign(target, init);
+				symbol.storage = storage;
+			}
+			else if (storage == Storage::Const)
+				fail("const variable '" + name + "' needs an initializer");
+			else
+				declare(name, type, storage);
+		} while (!failed() && accept(","));
+		expect(";");
+	}
+
+	void parseGlobal()
+	{
+		int location = -1;
+		if (accept("layout"))
+		{
+			expect("(");
+			expect("location");
+			expect("=");
+			const Token& number = next();
+			if (number.kind != TOKEN_NUMBER || number.number < 0)
+				fail("invalid location");
+			location = (int)number.number;
+			expect(")");
+		}
+
+		if (is("flat") || is("noperspective") || is("centroid"))
+		{
+			fail("'" + peek().text + "' interpolation is not supported");
+			return;
+		}
+		skipPrecision();
+
+		Storage storage = Storage::Local;
+		if (accept("in") || accept("attribute") || (m_out.stage == GlslStage::Fragment && accept("varying")))
+			storage = Storage::Input;
+		else if (accept("out") || accept("varying"))
+			storage = Storage::Output;
+		else if (accept("uniform"))
+			storage = Storage::Uniform;
+		else if (accept("const"))
+			storage = Storage::Const;
+		skipPrecision();
+
+		if (storage == Storage::Local || storage == Storage::Const)
+		{
+			parseDeclaration(storage);
+			return;
+		}
+
+		GlslType type = expectType();
+		do
+		{
+			std::string name = expectIdentifier();
+			if (is("["))
+			{
+				fail("arrays are not supported");
+				return;
+			}
+			if (storage != Storage::Uniform && IsMatrix(type))
+			{
+				fail("matrix inputs and outputs are not supported");
+				return;
+			}
+
+			Symbol& symbol = declare(name, type, storage);
+			GlslVariable variable = { name, type, location, symbol.reg };
+			if (storage == Storage::Input)
+				m_out.inputs.push_back(variable);
+			else if (storage == Storage::Output)
+				m_out.outputs.push_back(variable);
+			else
+				m_out.uniforms.push_back(variable);
+		} while (!failed() && accept(","));
+		expect(";");
+	}
+
+	void parseBlock()
+	{
+		expect("{");
+		m_scopes.emplace_back();
+		while (!failed() && !is("}") && peek().kind != TOKEN_END)
+			parseStatement();
+		m_scopes.pop_back();
+		expect("}");
+	}
+
+	void parseStatement()
+	{
+		static const char* UNSUPPORTED[] = { "if", "for", "while", "do", "switch", "discard", "break", "continue" };
+		for (const char* keyword : UNSUPPORTED)
+			if (is(keyword))
+			{
+				fail(std::string("'") + keyword + "' is not supported");
+				return;
+			}
+
+		if (is("{"))
+		{
+			parseBlock();
+			return;
+		}
+		if (accept(";"))
+			return;
+		if (accept("return"))
+		{
+			expect(";");
+			if (m_scopes.size() != 2 || !is("}"))
+				fail("return is only supported at the end of main()");
+			return;
+		}
+
+		skipPrecision();
+		GlslType type;
+		if (accept("const"))
+		{
+			skipPrecision();
+			parseDeclaration(Storage::Const);
+			return;
+		}
+		if (peekType(type) && peek(1).kind == TOKEN_IDENTIFIER)
+		{
+			parseDeclaration(Storage::Local);
+			return;
+		}
+
+		Value target = parseExpression();
+		static const char* ASSIGNMENTS[] = { "=", "+=", "-=", "*=", "/=" };
+		for (const char* op : ASSIGNMENTS)
+		{
+			if (!accept(op))
+				continue;
+			Value source = parseExpression();
+			if (op[1] == '=')
+				source = binary(op[0], target, source);
+			if (!failed())
+				assign(target, source);
+			break;
+		}
+		expect(";");
+	}
+
+	void parseMain()
+	{
+		expect("void");
+		std::string name = expectIdentifier();
+		if (name != "main")
+		{
+			fail("only main() can be defined");
+			return;
+		}
+		expect("(");
+		accept("void");
+		expect(")");
+		parseBlock();
+	}
+
+	//Moves literals and uniforms to the front of the register file
+	static unsigned short relocate(unsigned int reg, unsigned int constantCount)
+	{
+		return (unsigned short)(reg & CONSTANT_FLAG ? reg & ~CONSTANT_FLAG : reg + constantCount);
+	}
+
+public:
+	GlslCompiler(GlslShader& out)
+		:m_pos(0), m_out(out), m_registerCount(0)
+	{
+	}
+
+	bool compile(const std::string& source, GlslStage stage, std::string& log)
+	{
+		m_out = GlslShader();
+		m_out.stage = stage;
+		if (!Tokenize(source, m_tokens, log))
+			return false;
+
+		m_scopes.emplace_back();
+		if (stage == GlslStage::Vertex)
+		{
+			Symbol& position = declare("gl_Position", GlslType::Vec4, Storage::Output);
+			GlslVariable variable = { "gl_Position", GlslType::Vec4, -1, position.reg };
+			m_out.outputs.push_back(variable);
+		}
+
+		bool hasMain = false;
+		while (!failed() && peek().kind != TOKEN_END)
+		{
+			if (accept("precision"))
+			{
+				while (!accept(";") && peek().kind != TOKEN_END)
+					next();
+			}
+			else if (accept(";"))
+				continue;
+			else if (is("void"))
+			{
+				if (hasMain)
+					fail("main() is already defined");
+				parseMain();
+				hasMain = true;
+			}
+			else
+				parseGlobal();
+		}
+		if (!hasMain)
+			fail("missing main()");
+
+		if (failed())
+		{
+			log += m_error + "\n";
+			return false;
+		}
+
+		unsigned int constantCount = (unsigned int)m_constants.size();
+		for (VmInstruction& inst : m_out.program.code)
+		{
+			inst.dst = relocate(inst.dst, constantCount);
+			inst.a = relocate(inst.a, constantCount);
+			inst.b = relocate(inst.b, constantCount);
+			inst.c = relocate(inst.c, constantCount);
+		}
+		for (std::vector<GlslVariable>* list : { &m_out.inputs, &m_out.outputs, &m_out.uniforms })
+			for (GlslVariable& variable : *list)
+				variable.reg = relocate(variable.reg, constantCount);
+
+		m_out.program.constants = m_constants;
+		m_out.program.registerCount = constantCount + m_registerCount;
+		return true;
+	}
+};
+
+bool CompileGlsl(const std::string& source, GlslStage stage, GlslShader& out, std::string& log)
+{
+	GlslCompiler compiler(out);
+	return compiler.compile(source, stage, log);
+}
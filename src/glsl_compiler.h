@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include "shader_vm.h"
+
+//Value types of the GLSL subset, matrices are column major like in GLSL
+enum class GlslType
+{
+	Float,
+	Vec2,
+	Vec3,
+	Vec4,
+	Mat2,
+	Mat3,
+	Mat4
+};
+
+enum class GlslStage
+{
+	Vertex,
+	Fragment
+};
+
+//Number of floats (and VM registers) a value of the type takes
+unsigned int GlslComponents(GlslType type);
+
+//in/out/uniform variable of a compiled stage, its components are in consecutive registers starting at reg
+struct GlslVariable
+{
+	std::string name;
+	GlslType type;
+	int location;        //layout(location = N) for inputs and outputs, -1 when not given
+	unsigned int reg;
+};
+
+struct GlslShader
+{
+	GlslStage stage;
+	VmProgram program;
+	std::vector<GlslVariable> inputs;
+	std::vector<GlslVariable> outputs;   //gl_Position is listed as an output of vertex shaders
+	std::vector<GlslVariable> uniforms;  //registers in the constant range of the program
+};
+
+//Compiles one stage of a GLSL subset to VM bytecode:
+//  - in/out/uniform/const globals of type float, vec2-4 and mat2-4, layout(location = N) qualifiers
+//  - a void main() of straight line code: declarations, assignments (=, +=, -=, *=, /=),
+//    arithmetic, constructors, swizzles, constant indices and the common math built-ins
+//No control flow, integers, samplers or user functions; #version and precision statements are ignored
+//Returns false and fills log with "line N: message" on errors
+bool CompileGlsl(const std::string& source, GlslStage stage, GlslShader& out, std::string& log);
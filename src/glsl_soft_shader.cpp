@@ -0,0 +1,216 @@
+#include "glsl_soft_shader.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static_assert(SOFT_BATCH == VM_LANES, "fragment batches are run as one VM invocation");
+
+//register file of the calling thread, shared by every shader since a run always reloads the constants
+static float* Registers(unsigned int registerCount)
+{
+	thread_local std::vector<float> registers;
+	if (registers.size() < registerCount * VM_LANES)
+		registers.resize(registerCount * VM_LANES);
+	return registers.data();
+}
+
+GlslSoftShader::GlslSoftShader(const std::string& vertexSource, const std::string& fragmentSource)
+	:m_valid(false), m_positionReg(0), m_colorReg(0), m_colorComponents(0)
+{
+	std::string log;
+	if (!CompileGlsl(vertexSource, GlslStage::Vertex, m_vertex, log))
+		m_log += "Failed to compile vertex shader.\n" + log;
+
+	log.clear();
+	if (!CompileGlsl(fragmentSource, GlslStage::Fragment, m_fragment, log))
+		m_log += "Failed to compile fragment shader.\n" + log;
+
+	if (m_log.empty())
+		m_valid = link();
+
+	if (!m_valid)
+		std::cout << m_log << std::endl;
+}
+
+bool GlslSoftShader::link()
+{
+	//attributes without a layout take the locations after the last one used, in declaration order
+	int nextLocation = 0;
+	for (const GlslVariable& input : m_vertex.inputs)
+		nextLocation = std::max(nextLocation, input.location + 1);
+	for (const GlslVariable& input : m_vertex.inputs)
+	{
+		Attribute attribute;
+		attribute.location = input.location >= 0 ? input.location : nextLocation++;
+		attribute.reg = input.reg;
+		attribute.components = GlslComponents(input.type);
+		m_attributes.push_back(attribute);
+	}
+
+	for (const GlslVariable& output : m_vertex.outputs)
+		if (output.name == "gl_Position")
+			m_positionReg = output.reg;
+
+	for (const GlslVariable& input : m_fragment.inputs)
+	{
+		const GlslVariable* output = nullptr;
+		for (const GlslVariable& candidate : m_vertex.outputs)
+			if (candidate.name == input.name)
+				output = &candidate;
+
+		if (!output || output->type != input.type)
+		{
+			m_log += "Link error: fragment input '" + input.name + "' has no matching vertex shader output.\n";
+			return false;
+		}
+		for (unsigned int i = 0; i < GlslComponents(input.type); i++)
+		{
+			m_varyingVertexRegs.push_back(output->reg + i);
+			m_varyingFragmentRegs.push_back(input.reg + i);
+		}
+	}
+	if (m_varyingVertexRegs.size() > SOFT_MAX_VARYINGS)
+	{
+		m_log += "Link error: more than " + std::to_string(SOFT_MAX_VARYINGS) + " varying components.\n";
+		return false;
+	}
+
+	//the color comes from the output at location 0, or the only one
+	const GlslVariable* color = nullptr;
+	for (const GlslVariable& output : m_fragment.outputs)
+		if (!color || output.location == 0)
+			color = &output;
+	if (!color)
+	{
+		m_log += "Link error: the fragment shader has no output.\n";
+		return false;
+	}
+	m_colorReg = color->reg;
+	m_colorComponents = GlslComponents(color->type);
+
+	for (int stage = 0; stage < 2; stage++)
+	{
+		const GlslShader& shader = stage == 0 ? m_vertex : m_fragment;
+		for (const GlslVariable& variable : shader.uniforms)
+		{
+			int location = getUniformLocation(variable.name);
+			if (location < 0)
+			{
+				Uniform uniform = { variable.name, variable.type, -1, -1 };
+				m_uniforms.push_back(uniform);
+				location = (int)m_uniforms.size() - 1;
+			}
+			else if (m_uniforms[location].type != variable.type)
+			{
+				m_log += "Link error: uniform '" + variable.name + "' has different types in the two stages.\n";
+				return false;
+			}
+			(stage == 0 ? m_uniforms[location].vertexReg : m_uniforms[location].fragmentReg) = (int)variable.reg;
+		}
+	}
+	return true;
+}
+
+int GlslSoftShader::getUniformLocation(const std::string& name) const
+{
+	for (size_t i = 0; i < m_uniforms.size(); i++)
+		if (m_uniforms[i].name == name)
+			return (int)i;
+	return -1;
+}
+
+void GlslSoftShader::setUniformfv(int location, const float* values, unsigned int count)
+{
+	if (location < 0 || location >= (int)m_uniforms.size())
+		return;
+
+	const Uniform& uniform = m_uniforms[location];
+	count = std::min(count, GlslComponents(uniform.type));
+	if (uniform.vertexReg >= 0)
+		std::memcpy(&m_vertex.program.constants[uniform.vertexReg], values, count * sizeof(float));
+	if (uniform.fragmentReg >= 0)
+		std::memcpy(&m_fragment.program.constants[uniform.fragmentReg], values, count * sizeof(float));
+}
+
+void GlslSoftShader::setUniform1f(int location, float x)
+{
+	setUniformfv(location, &x, 1);
+}
+
+void GlslSoftShader::setUniform4f(int location, float x, float y, float z, float w)
+{
+	float values[4] = { x, y, z, w };
+	setUniformfv(location, values, 4);
+}
+
+void GlslSoftShader::setUniformMatrix4fv(int location, const float* value)
+{
+	setUniformfv(location, value, 16);
+}
+
+void GlslSoftShader::shadeVertices(const unsigned char* vertices, const VertexBufferLayout& layout,
+	unsigned int first, unsigned int count, SoftVertex* out) const
+{
+	if (!m_valid)
+	{
+		//w = 0 gets every triangle clipped, like drawing with a program that failed to link
+		std::memset(out, 0, count * sizeof(SoftVertex));
+		return;
+	}
+
+	const VmProgram& program = m_vertex.program;
+	VmExecuteFn execute = GetVmExecuteFn(GetSimdLevel());
+	float* registers = Registers(program.registerCount);
+	VmLoadConstants(program, registers);
+
+	unsigned int stride = layout.getStride();
+	for (unsigned int base = 0; base < count; base += VM_LANES)
+	{
+		unsigned int lanes = std::min((unsigned int)VM_LANES, count - base);
+
+		//attributes go from array of structures to one register per component, spare lanes repeat the last vertex
+		for (int lane = 0; lane < VM_LANES; lane++)
+		{
+			const unsigned char* vertex = vertices + (first + base + std::min((unsigned int)lane, lanes - 1)) * stride;
+			for (const Attribute& attribute : m_attributes)
+			{
+				float value[4];
+				FetchAttribute(vertex, layout, attribute.location, value);
+				for (unsigned int c = 0; c < attribute.components; c++)
+					registers[(attribute.reg + c) * VM_LANES + lane] = value[c];
+			}
+		}
+
+		execute(program.code.data(), (unsigned int)program.code.size(), registers);
+
+		for (unsigned int lane = 0; lane < lanes; lane++)
+		{
+			SoftVertex& vertex = out[base + lane];
+			for (int c = 0; c < 4; c++)
+				vertex.position[c] = registers[(m_positionReg + c) * VM_LANES + lane];
+			for (size_t v = 0; v < m_varyingVertexRegs.size(); v++)
+				vertex.varyings[v] = registers[m_varyingVertexRegs[v] * VM_LANES + lane];
+		}
+	}
+}
+
+void GlslSoftShader::shadeFragments(SoftFragmentBatch& batch) const
+{
+	const VmProgram& program = m_fragment.program;
+	float* registers = Registers(program.registerCount);
+	VmLoadConstants(program, registers);
+
+	//the batch is already one float per lane, like the registers
+	for (size_t v = 0; v < m_varyingFragmentRegs.size(); v++)
+		std::memcpy(registers + m_varyingFragmentRegs[v] * VM_LANES, batch.varyings[v], sizeof(float) * VM_LANES);
+
+	GetVmExecuteFn(GetSimdLevel())(program.code.data(), (unsigned int)program.code.size(), registers);
+
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		if (c < m_colorComponents)
+			std::memcpy(batch.color[c], registers + (m_colorReg + c) * VM_LANES, sizeof(float) * VM_LANES);
+		else
+			std::fill(batch.color[c], batch.color[c] + VM_LANES, c == 3 ? 1.0f : 0.0f);
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include "glsl_compiler.h"
+#include "soft_renderer.h"
+
+//SoftShader that runs a GLSL vertex + fragment shader pair (see CompileGlsl for the supported subset)
+//on the shader VM, VM_LANES vertices or fragments per run
+//Behaves like a linked GL program: vertex inputs are read from the attribute at their location,
+//fragment inputs are matched to vertex outputs by name and uniforms are set through locations
+class GlslSoftShader : public SoftShader
+{
+private:
+	struct Attribute
+	{
+		unsigned int location;
+		unsigned int reg;
+		unsigned int components;
+	};
+
+	struct Uniform
+	{
+		std::string name;
+		GlslType type;
+		int vertexReg;   //-1 when the stage doesn't use it
+		int fragmentReg;
+	};
+
+	GlslShader m_vertex;
+	GlslShader m_fragment;
+	bool m_valid;
+	std::string m_log;
+
+	std::vector<Attribute> m_attributes;
+	std::vector<unsigned int> m_varyingVertexRegs;   //varying i is written to this register of the vertex stage...
+	std::vector<unsigned int> m_varyingFragmentRegs; //...and read from this one in the fragment stage
+	std::vector<Uniform> m_uniforms;
+	unsigned int m_positionReg;
+	unsigned int m_colorReg;
+	unsigned int m_colorComponents;
+
+	bool link();
+
+public:
+	GlslSoftShader(const std::string& vertexSource, const std::string& fragmentSource);
+
+	//false when compiling or linking failed, getLog() has the errors and nothing gets drawn
+	bool isValid() const { return m_valid; }
+	const std::string& getLog() const { return m_log; }
+
+	//Same as glGetUniformLocation, -1 for names neither stage declares
+	int getUniformLocation(const std::string& name) const;
+
+	//Like glUniform*, location -1 is ignored
+	void setUniform1f(int location, float x);
+	void setUniform4f(int location, float x, float y, float z, float w);
+	void setUniformMatrix4fv(int location, const float* value); //column major, like transpose = GL_FALSE
+	void setUniformfv(int location, const float* values, unsigned int count);
+
+	unsigned int varyingCount() const override { return (unsigned int)m_varyingVertexRegs.size(); }
+	void shadeVertices(const unsigned char* vertices, const VertexBufferLayout& layout,
+		unsigned int first, unsigned int count, SoftVertex* out) const override;
+	void shadeFragments(SoftFragmentBatch& batch) const override;
+};
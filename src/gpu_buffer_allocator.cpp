@@ -0,0 +1,202 @@
+#include "gpu_buffer_allocator.h"
+#include <algorithm>
+#include "renderer.h"
+
+GpuBufferAllocator::GpuBufferAllocator(unsigned int backingSize, bool dynamic)
+	:m_backingSize(backingSize), m_usage(dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW), m_version(0)
+{
+}
+
+GpuBufferAllocator::~GpuBufferAllocator()
+{
+	//no GL calls, the allocator is usually a static that outlives the context; destroy() deletes the buffers
+}
+
+void GpuBufferAllocator::destroy()
+{
+	for (Backing& backing : m_backings)
+	{
+		GLCall(glDeleteBuffers(1, &backing.RendererID));
+	}
+	m_backings.clear();
+	m_entries.clear();
+	m_freeIds.clear();
+}
+
+//Bound to the copy targets only, so the element array binding of whatever vertex array is bound stays untouched
+unsigned int GpuBufferAllocator::createBuffer(unsigned int size) const
+{
+	unsigned int buffer;
+	GLCall(glGenBuffers(1, &buffer));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+	GLCall(glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, m_usage));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	return buffer;
+}
+
+unsigned int GpuBufferAllocator::addBacking(unsigned int size)
+{
+	Backing backing;
+	backing.size = std::max(m_backingSize, size);
+	backing.RendererID = createBuffer(backing.size);
+	backing.allocator.reset(backing.size);
+	m_backings.push_back(std::move(backing));
+	return (unsigned int)m_backings.size() - 1;
+}
+
+GpuAllocation GpuBufferAllocator::allocate(unsigned int size, unsigned int alignment)
+{
+	GpuAllocation allocation = { 0, 0, 0, 0 };
+
+	Entry entry;
+	entry.alignment = std::max(alignment, (unsigned int)TlsfAllocator::GRANULARITY);
+	entry.live = true;
+
+	bool found = false;
+	for (unsigned int i = 0; i < m_backings.size() && !found; i++)
+	{
+		found = m_backings[i].allocator.allocate(size, entry.alignment, entry.range);
+		entry.backing = i;
+	}
+	if (!found)
+	{
+		//room for the worst case padding and the allocator's rounding to its bins too
+		unsigned long long needed = TlsfAllocator::GetRequiredSize(size, entry.alignment);
+		if (needed > 0xFFFFFFF0ull)
+			return allocation;
+		entry.backing = addBacking((unsigned int)needed);
+		if (!m_backings[entry.backing].allocator.allocate(size, entry.alignment, entry.range))
+		{
+			GLCall(glDeleteBuffers(1, &m_backings.back().RendererID));
+			m_backings.pop_back();
+			return allocation;
+		}
+	}
+
+	unsigned int id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+		m_entries[id - 1] = entry;
+	}
+	else
+	{
+		m_entries.push_back(entry);
+		id = (unsigned int)m_entries.size();
+	}
+	return get(id);
+}
+
+GpuAllocation GpuBufferAllocator::allocate(const void* data, unsigned int size, unsigned int alignment)
+{
+	GpuAllocation allocation = allocate(size, alignment);
+	if (allocation.id)
+		upload(allocation.id, data, size);
+	return allocation;
+}
+
+void GpuBufferAllocator::upload(unsigned int id, const void* data, unsigned int size, unsigned int offset)
+{
+	const Entry& entry = m_entries[id - 1];
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, m_backings[entry.backing].RendererID));
+	GLCall(glBufferSubData(GL_COPY_WRITE_BUFFER, entry.range.offset + offset, size, data));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+void GpuBufferAllocator::free(unsigned int id)
+{
+	if (!isValid(id))
+		return;
+
+	Entry& entry = m_entries[id - 1];
+	m_backings[entry.backing].allocator.free(entry.range.block);
+	entry.live = false;
+	m_freeIds.push_back(id);
+}
+
+GpuAllocation GpuBufferAllocator::get(unsigned int id) const
+{
+	const Entry& entry = m_entries[id - 1];
+	GpuAllocation allocation = { id, m_backings[entry.backing].RendererID, entry.range.offset, entry.range.size };
+	return allocation;
+}
+
+unsigned int GpuBufferAllocator::compact(float threshold)
+{
+	unsigned int compacted = 0;
+	std::vector<unsigned int> ids;
+	std::vector<TlsfAllocation> ranges;
+	for (unsigned int i = 0; i < m_backings.size(); i++)
+	{
+		Backing& backing = m_backings[i];
+		TlsfStats stats = backing.allocator.getStats();
+		if (stats.allocations == 0 || stats.freeBlocks < 2 || stats.fragmentation <= threshold)
+			continue;
+
+		//in offset order, so every allocation moves towards the front and the free space ends up in one piece
+		ids.clear();
+		for (unsigned int id = 1; id <= m_entries.size(); id++)
+		{
+			if (m_entries[id - 1].live && m_entries[id - 1].backing == i)
+				ids.push_back(id);
+		}
+		std::sort(ids.begin(), ids.end(), [this](unsigned int a, unsigned int b) { return m_entries[a - 1].range.offset < m_entries[b - 1].range.offset; });
+
+		//every range is placed before anything is copied, if one doesn't fit (the bin rounding can waste room at the
+		//end) the backing stays as it is
+		TlsfAllocator packed(backing.size);
+		ranges.resize(ids.size());
+		bool placed = true;
+		for (unsigned int j = 0; j < ids.size() && placed; j++)
+		{
+			const Entry& entry = m_entries[ids[j] - 1];
+			placed = packed.allocate(entry.range.size, entry.alignment, ranges[j]);
+		}
+		if (!placed)
+			continue;
+
+		unsigned int buffer = createBuffer(backing.size);
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, backing.RendererID));
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+		for (unsigned int j = 0; j < ids.size(); j++)
+		{
+			Entry& entry = m_entries[ids[j] - 1];
+			GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, entry.range.offset, ranges[j].offset, entry.range.size));
+			entry.range = ranges[j];
+		}
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+		GLCall(glDeleteBuffers(1, &backing.RendererID));
+		backing.RendererID = buffer;
+		backing.allocator = packed;
+		compacted++;
+	}
+
+	if (compacted)
+		m_version++;
+	return compacted;
+}
+
+GpuBufferStats GpuBufferAllocator::getStats() const
+{
+	GpuBufferStats stats = { (unsigned int)m_backings.size(), 0, 0, 0, 0, 0, 0.0f };
+	for (const Backing& backing : m_backings)
+	{
+		TlsfStats tlsf = backing.allocator.getStats();
+		stats.capacity += tlsf.size;
+		stats.used += tlsf.used;
+		stats.allocations += tlsf.allocations;
+		stats.freeBlocks += tlsf.freeBlocks;
+		stats.largestFree = std::max(stats.largestFree, tlsf.largestFree);
+		stats.fragmentation = std::max(stats.fragmentation, tlsf.fragmentation);
+	}
+	return stats;
+}
+
+GpuBufferAllocator& GetGpuBufferAllocator()
+{
+	static GpuBufferAllocator allocator;
+	return allocator;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include "tlsf_allocator.h"
+
+//A range of one of the allocator's GL buffers, offset and size in bytes
+struct GpuAllocation
+{
+	unsigned int id; //0 when the allocation failed
+	unsigned int buffer;
+	unsigned int offset;
+	unsigned int size;
+};
+
+struct GpuBufferStats
+{
+	unsigned int buffers;
+	unsigned long long capacity;
+	unsigned long long used;
+	unsigned int allocations;
+	unsigned int freeBlocks;
+	unsigned int largestFree;
+	float fragmentation; //of the most fragmented buffer
+};
+
+//Vertex, index and uniform data suballocated from a few big GL buffers instead of a buffer object each, so small
+//meshes don't each cost a buffer object and draws of different meshes can share one binding
+//Every backing buffer is managed by a TlsfAllocator; a request that fits none of them adds a buffer
+//compact() repacks fragmented buffers into fresh ones with glCopyBufferSubData, allocations move when that happens
+//and getVersion() changes so cached offsets (vertex array setups, draw commands) can be refreshed
+//Must be used on the GL thread
+class GpuBufferAllocator
+{
+private:
+	struct Backing
+	{
+		unsigned int RendererID;
+		unsigned int size;
+		TlsfAllocator allocator;
+	};
+
+	struct Entry
+	{
+		unsigned int backing;
+		TlsfAllocation range;
+		unsigned int alignment;
+		bool live;
+	};
+
+	std::vector<Backing> m_backings;
+	std::vector<Entry> m_entries; //indexed by id - 1
+	std::vector<unsigned int> m_freeIds;
+	unsigned int m_backingSize;
+	unsigned int m_usage;
+	unsigned int m_version;
+
+	unsigned int addBacking(unsigned int size);
+	unsigned int createBuffer(unsigned int size) const;
+
+public:
+	//backingSize is the size of every buffer, bigger allocations get a buffer of their own
+	explicit GpuBufferAllocator(unsigned int backingSize = 4 << 20, bool dynamic = false);
+	~GpuBufferAllocator();
+
+	GpuBufferAllocator(const GpuBufferAllocator&) = delete;
+	GpuBufferAllocator& operator=(const GpuBufferAllocator&) = delete;
+
+	//alignment is a power of two, 16 bytes at least
+	GpuAllocation allocate(unsigned int size, unsigned int alignment = 16);
+
+	//Allocates and uploads size bytes of data
+	GpuAllocation allocate(const void* data, unsigned int size, unsigned int alignment = 16);
+
+	void upload(unsigned int id, const void* data, unsigned int size, unsigned int offset = 0);
+	void free(unsigned int id);
+
+	bool isValid(unsigned int id) const { return id > 0 && id <= m_entries.size() && m_entries[id - 1].live; }
+	GpuAllocation get(unsigned int id) const;
+
+	//Deletes the buffers and forgets every allocation, before the context goes away; later frees are ignored
+	void destroy();
+
+	//Repacks every buffer whose fragmentation is above threshold, returns how many were repacked
+	unsigned int compact(float threshold = 0.5f);
+
+	unsigned int getVersion() const { return m_version; }
+	GpuBufferStats getStats() const;
+};
+
+//The allocator VertexBuffer and IndexBuffer draw from, created on first use (after the GL context)
+GpuBufferAllocator& GetGpuBufferAllocator();
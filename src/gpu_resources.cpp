@@ -0,0 +1,94 @@
+#include "gpu_resources.h"
+#include "gpu_buffer_allocator.h"
+#include "renderer.h"
+
+GpuResources::GpuResources()
+	:m_pending(0)
+{
+	GetGpuBufferAllocator(); //created first so it's destroyed after the buffers that free into it
+}
+
+GpuResources::~GpuResources()
+{
+	//no GL calls, this is usually a static that outlives the context; flush() before it goes away
+}
+
+VertexBufferHandle GpuResources::createVertexBuffer(const void* data, unsigned int size)
+{
+	VertexBuffer buffer(data, size);
+	if (!buffer.isValid())
+		return VertexBufferHandle();
+	return m_vertexBuffers.create(std::move(buffer));
+}
+
+IndexBufferHandle GpuResources::createIndexBuffer(const void* data, unsigned int count)
+{
+	IndexBuffer buffer(data, count);
+	if (!buffer.isValid())
+		return IndexBufferHandle();
+	return m_indexBuffers.create(std::move(buffer));
+}
+
+void GpuResources::destroy(VertexBufferHandle handle)
+{
+	if (!m_vertexBuffers.isValid(handle))
+		return;
+	m_retiring.vertexBuffers.push_back(m_vertexBuffers.take(handle));
+	m_pending++;
+}
+
+void GpuResources::destroy(IndexBufferHandle handle)
+{
+	if (!m_indexBuffers.isValid(handle))
+		return;
+	m_retiring.indexBuffers.push_back(m_indexBuffers.take(handle));
+	m_pending++;
+}
+
+//Fences signal in submission order, so releasing stops at the first one that hasn't
+void GpuResources::release(bool wait)
+{
+	while (!m_retired.empty())
+	{
+		Retired& retired = m_retired.front();
+		GLenum status;
+		if (wait)
+		{
+			GLCall(status = glClientWaitSync((GLsync)retired.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0xFFFFFFFFFFFFFFFFull));
+		}
+		else
+		{
+			//no flush bit, the buffer swap flushes every frame
+			GLCall(status = glClientWaitSync((GLsync)retired.fence, 0, 0));
+		}
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED)
+			return;
+
+		GLCall(glDeleteSync((GLsync)retired.fence));
+		m_pending -= (unsigned int)(retired.vertexBuffers.size() + retired.indexBuffers.size());
+		m_retired.pop_front(); //the buffers' destructors give the ranges back
+	}
+}
+
+void GpuResources::endFrame()
+{
+	if (!m_retiring.vertexBuffers.empty() || !m_retiring.indexBuffers.empty())
+	{
+		GLCall(m_retiring.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+		m_retired.push_back(std::move(m_retiring));
+		m_retiring = Retired();
+	}
+	release(false);
+}
+
+void GpuResources::flush()
+{
+	endFrame();
+	release(true);
+}
+
+GpuResources& GetGpuResources()
+{
+	static GpuResources resources;
+	return resources;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include "index_buffer.h"
+#include "resource_pool.h"
+#include "vertex_buffer.h"
+
+typedef Handle<VertexBuffer> VertexBufferHandle;
+typedef Handle<IndexBuffer> IndexBufferHandle;
+
+//Owns the vertex and index buffers the scene is built from and hands out handles to them, which draw commands and
+//components keep instead of GL ids or offsets: they stay 4 bytes, resolve to the buffer's current range (even after
+//GpuBufferAllocator::compact() moved it) and resolve to nothing once the buffer is destroyed
+//What was resolved earlier and kept in GL state doesn't follow: a vertex array's attribute pointers have to be set
+//again when GpuBufferAllocator::getVersion() changes
+//Destroying takes effect for the handle right away, but the range is only given back to the allocator once the GPU
+//has finished the frames that may still read it: endFrame() puts a fence behind the frame's destroyed buffers
+//Must be used on the GL thread; resolving handles from several threads is fine while nothing is created or destroyed
+class GpuResources
+{
+private:
+	//buffers destroyed during a frame, released once its fence signals
+	struct Retired
+	{
+		std::vector<VertexBuffer> vertexBuffers;
+		std::vector<IndexBuffer> indexBuffers;
+		void* fence = nullptr; //GLsync
+	};
+
+	ResourcePool<VertexBuffer> m_vertexBuffers;
+	ResourcePool<IndexBuffer> m_indexBuffers;
+	Retired m_retiring; //destroyed this frame, no fence yet
+	std::deque<Retired> m_retired; //oldest first
+	unsigned int m_pending;
+
+	void release(bool wait);
+
+public:
+	GpuResources();
+	~GpuResources();
+
+	GpuResources(const GpuResources&) = delete;
+	GpuResources& operator=(const GpuResources&) = delete;
+
+	//Null handles when the allocation failed
+	VertexBufferHandle createVertexBuffer(const void* data, unsigned int size);
+	IndexBufferHandle createIndexBuffer(const void* data, unsigned int count);
+
+	//nullptr for null, destroyed or stale handles
+	const VertexBuffer* get(VertexBufferHandle handle) const { return m_vertexBuffers.get(handle); }
+	const IndexBuffer* get(IndexBufferHandle handle) const { return m_indexBuffers.get(handle); }
+
+	void destroy(VertexBufferHandle handle);
+	void destroy(IndexBufferHandle handle);
+
+	//Fences the buffers destroyed since the last call and releases those whose fence has signaled, once per frame
+	void endFrame();
+
+	//Waits for the GPU and releases every destroyed buffer, e.g. before the context goes away
+	void flush();
+
+	unsigned int getVertexBufferCount() const { return m_vertexBuffers.size(); }
+	unsigned int getIndexBufferCount() const { return m_indexBuffers.size(); }
+
+	//Destroyed but still waiting for the GPU
+	unsigned int getPendingCount() const { return m_pending; }
+};
+
+//Created on first use (after the GL context)
+GpuResources& GetGpuResources();
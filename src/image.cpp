@@ -0,0 +1,161 @@
+#include "image.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const int TGA_HEADER_SIZE = 18;
+static const unsigned char TGA_TRUE_COLOR = 2;
+static const unsigned char TGA_TRUE_COLOR_RLE = 10;
+
+//TGA stores B, G, R, A while our pixels are R, G, B, A from the lowest byte up
+static unsigned int SwapRedBlue(unsigned int pixel)
+{
+	return (pixel & 0xFF00FF00u) | ((pixel & 0xFFu) << 16) | ((pixel >> 16) & 0xFFu);
+}
+
+bool LoadTGA(const std::string& path, Image& out)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (data.size() < TGA_HEADER_SIZE)
+	{
+		std::cout << path << ": not a TGA file\n";
+		return false;
+	}
+
+	const unsigned char* header = data.data();
+	unsigned char type = header[2];
+	unsigned int width = header[12] | (header[13] << 8);
+	unsigned int height = header[14] | (header[15] << 8);
+	unsigned int bytesPerPixel = header[16] / 8;
+	bool topDown = (header[17] & 0x20) != 0;
+
+	if ((type != TGA_TRUE_COLOR && type != TGA_TRUE_COLOR_RLE) || (bytesPerPixel != 3 && bytesPerPixel != 4) || header[1] != 0)
+	{
+		std::cout << path << ": only true color TGA files are supported\n";
+		return false;
+	}
+
+	out = Image(width, height);
+	size_t pos = TGA_HEADER_SIZE + header[0]; //skip the image id
+	size_t count = (size_t)width * height;
+	size_t written = 0;
+
+	auto readPixel = [&](unsigned int& pixel) -> bool
+	{
+		if (pos + bytesPerPixel > data.size())
+			return false;
+		const unsigned char* p = &data[pos];
+		pixel = p[2] | (p[1] << 8) | (p[0] << 16) | ((bytesPerPixel == 4 ? p[3] : 255u) << 24);
+		pos += bytesPerPixel;
+		return true;
+	};
+
+	while (written < count)
+	{
+		unsigned int run = 1;
+		bool repeat = false;
+		if (type == TGA_TRUE_COLOR_RLE)
+		{
+			if (pos >= data.size())
+				break;
+			unsigned char packet = data[pos++];
+			run = (packet & 0x7F) + 1;
+			repeat = (packet & 0x80) != 0;
+		}
+		if (written + run > count)
+			break;
+
+		unsigned int pixel;
+		if (repeat)
+		{
+			if (!readPixel(pixel))
+				break;
+			std::fill(out.pixels.begin() + written, out.pixels.begin() + written + run, pixel);
+			written += run;
+		}
+		else
+		{
+			unsigned int i = 0;
+			for (; i < run && readPixel(pixel); i++)
+				out.pixels[written++] = pixel;
+			if (i < run) //out of data, the check below reports it
+				break;
+		}
+	}
+
+	if (written != count)
+	{
+		std::cout << path << ": truncated TGA file\n";
+		return false;
+	}
+
+	if (topDown)
+		for (unsigned int y = 0; y < height / 2; y++)
+			std::swap_ranges(out.pixels.begin() + (size_t)y * width, out.pixels.begin() + (size_t)(y + 1) * width,
+				out.pixels.begin() + (size_t)(height - 1 - y) * width);
+	return true;
+}
+
+bool SaveTGA(const std::string& path, const Image& image)
+{
+	if (image.width > 0xFFFF || image.height > 0xFFFF)
+		return false;
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "can't write " << path << "\n";
+		return false;
+	}
+
+	unsigned char header[TGA_HEADER_SIZE] = {};
+	header[2] = TGA_TRUE_COLOR_RLE;
+	header[12] = image.width & 0xFF;
+	header[13] = (image.width >> 8) & 0xFF;
+	header[14] = image.height & 0xFF;
+	header[15] = (image.height >> 8) & 0xFF;
+	header[16] = 32;
+	header[17] = 8; //8 alpha bits, bottom-left origin like our rows
+	file.write((const char*)header, TGA_HEADER_SIZE);
+
+	//packets never cross rows, as the format asks
+	std::vector<unsigned char> encoded;
+	for (unsigned int y = 0; y < image.height; y++)
+	{
+		const unsigned int* row = image.pixels.data() + (size_t)y * image.width;
+		unsigned int x = 0;
+		while (x < image.width)
+		{
+			unsigned int run = 1;
+			while (x + run < image.width && run < 128 && row[x + run] == row[x])
+				run++;
+
+			if (run > 1)
+			{
+				unsigned int pixel = SwapRedBlue(row[x]);
+				encoded.push_back((unsigned char)(0x80 | (run - 1)));
+				encoded.insert(encoded.end(), (const unsigned char*)&pixel, (const unsigned char*)&pixel + 4);
+				x += run;
+				continue;
+			}
+
+			//raw packet up to the next run of 2 or more
+			unsigned int raw = 1;
+			while (x + raw < image.width && raw < 128 && !(x + raw + 1 < image.width && row[x + raw] == row[x + raw + 1]))
+				raw++;
+			encoded.push_back((unsigned char)(raw - 1));
+			for (unsigned int i = 0; i < raw; i++)
+			{
+				unsigned int pixel = SwapRedBlue(row[x + i]);
+				encoded.insert(encoded.end(), (const unsigned char*)&pixel, (const unsigned char*)&pixel + 4);
+			}
+			x += raw;
+		}
+	}
+	file.write((const char*)encoded.data(), encoded.size());
+	return (bool)file;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//RGBA8 image in the same layout as SoftFramebuffer: R in the lowest byte, rows stored bottom to top
+struct Image
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<unsigned int> pixels;
+
+	Image() {}
+	Image(unsigned int w, unsigned int h, unsigned int fill = 0)
+		:width(w), height(h), pixels((size_t)w * h, fill)
+	{
+	}
+};
+
+//Reads uncompressed or RLE true color TGA files (24 or 32 bits), 24 bit images get alpha 255
+bool LoadTGA(const std::string& path, Image& out);
+
+//Writes a 32 bit RLE compressed TGA, flat colored renders shrink to a few kilobytes
+bool SaveTGA(const std::string& path, const Image& image);
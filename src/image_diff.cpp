@@ -0,0 +1,435 @@
+#include "image_diff.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "thread_pool.h"
+
+//YIQ distance of pure black against pure white, the largest the perceptual metric can see
+static const float YIQ_MAX_DELTA = 35215.0f;
+
+static const float YIQ_Y[3] = { 0.29889531f, 0.58662247f, 0.11448223f };
+static const float YIQ_I[3] = { 0.59597799f, -0.27417610f, -0.32180189f };
+static const float YIQ_Q[3] = { 0.21147017f, -0.52261711f, 0.31114694f };
+static const float YIQ_WEIGHTS[3] = { 0.5053f, 0.299f, 0.1957f };
+static const float INV_255 = 1.0f / 255.0f;
+
+static unsigned int ChannelScore(unsigned int expected, unsigned int actual)
+{
+	unsigned int score = 0;
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		int a = (expected >> shift) & 0xFF, b = (actual >> shift) & 0xFF;
+		score = std::max(score, (unsigned int)std::abs(a - b));
+	}
+	return score;
+}
+
+//Every kernel does the same float operations in the same order so the levels agree on borderline pixels
+static float Blend(unsigned int channel, float alpha)
+{
+	return 255.0f + ((float)channel - 255.0f) * alpha;
+}
+
+static float YiqDelta(unsigned int expected, unsigned int actual)
+{
+	float alphaE = (float)(expected >> 24) * INV_255, alphaA = (float)(actual >> 24) * INV_255;
+	float dr = Blend(expected & 0xFF, alphaE) - Blend(actual & 0xFF, alphaA);
+	float dg = Blend((expected >> 8) & 0xFF, alphaE) - Blend((actual >> 8) & 0xFF, alphaA);
+	float db = Blend((expected >> 16) & 0xFF, alphaE) - Blend((actual >> 16) & 0xFF, alphaA);
+
+	float y = dr * YIQ_Y[0] + dg * YIQ_Y[1] + db * YIQ_Y[2];
+	float i = dr * YIQ_I[0] + dg * YIQ_I[1] + db * YIQ_I[2];
+	float q = dr * YIQ_Q[0] + dg * YIQ_Q[1] + db * YIQ_Q[2];
+	return YIQ_WEIGHTS[0] * y * y + YIQ_WEIGHTS[1] * i * i + YIQ_WEIGHTS[2] * q * q;
+}
+
+//1..255 for any difference, 0 for none
+static unsigned int YiqScore(float delta)
+{
+	return delta > 0.0f ? 1 + (unsigned int)(254.0f * std::sqrt(delta * (1.0f / YIQ_MAX_DELTA))) : 0;
+}
+
+static unsigned int DiffChannelScalar(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst)
+{
+	unsigned int tolerance = (unsigned int)limit;
+	unsigned int failing = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int score = expected[i] == actual[i] ? 0 : ChannelScore(expected[i], actual[i]);
+		bool fail = score > tolerance;
+		worst = std::max(worst, score);
+		failing += fail;
+		if (errors)
+			errors[i] = fail ? (unsigned char)score : 0;
+	}
+	return failing;
+}
+
+static unsigned int DiffPerceptualScalar(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst)
+{
+	unsigned int failing = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float delta = expected[i] == actual[i] ? 0.0f : YiqDelta(expected[i], actual[i]);
+		unsigned int score = YiqScore(delta);
+		bool fail = delta > limit;
+		worst = std::max(worst, score);
+		failing += fail;
+		if (errors)
+			errors[i] = fail ? (unsigned char)score : 0;
+	}
+	return failing;
+}
+
+#if SIMD_X86
+//4 pixels: per pixel largest channel delta in the low byte of each 32 bit lane
+static inline __m128i ChannelScoreSSE2(__m128i e, __m128i a)
+{
+	__m128i d = _mm_or_si128(_mm_subs_epu8(e, a), _mm_subs_epu8(a, e));
+	d = _mm_max_epu8(d, _mm_srli_epi32(d, 8));
+	d = _mm_max_epu8(d, _mm_srli_epi32(d, 16));
+	return _mm_and_si128(d, _mm_set1_epi32(0xFF));
+}
+
+//4 scores of 0..255 in 32 bit lanes to 4 bytes
+static inline void StoreScoresSSE2(unsigned char* out, __m128i scores)
+{
+	__m128i packed = _mm_packus_epi16(_mm_packs_epi32(scores, scores), _mm_setzero_si128());
+	int bytes = _mm_cvtsi128_si32(packed);
+	std::memcpy(out, &bytes, 4);
+}
+
+static unsigned int HorizontalMaxSSE2(__m128i v)
+{
+	v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+	v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+	return (unsigned int)_mm_cvtsi128_si32(v);
+}
+
+static unsigned int DiffChannelSSE2(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst)
+{
+	const __m128i tolerance = _mm_set1_epi32((int)limit);
+	__m128i worstV = _mm_setzero_si128();
+	unsigned int failing = 0, i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i e = _mm_loadu_si128((const __m128i*)(expected + i)), a = _mm_loadu_si128((const __m128i*)(actual + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(e, a)) == 0xFFFF)
+		{
+			if (errors)
+				std::memset(errors + i, 0, 4);
+			continue;
+		}
+
+		__m128i score = ChannelScoreSSE2(e, a);
+		__m128i fail = _mm_cmpgt_epi32(score, tolerance);
+		worstV = _mm_max_epu8(worstV, score);
+		failing += PopCount((unsigned int)_mm_movemask_ps(_mm_castsi128_ps(fail)));
+		if (errors)
+			StoreScoresSSE2(errors + i, _mm_and_si128(score, fail));
+	}
+	worst = std::max(worst, HorizontalMaxSSE2(worstV));
+	return failing + DiffChannelScalar(expected + i, actual + i, count - i, limit, errors ? errors + i : nullptr, worst);
+}
+
+//YIQ distance of 4 pixel pairs, same operations as YiqDelta()
+static inline __m128 ChannelSSE2(__m128i p, int shift)
+{
+	return _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, shift), _mm_set1_epi32(0xFF)));
+}
+
+static inline __m128 BlendSSE2(__m128 c, __m128 alpha)
+{
+	const __m128 white = _mm_set1_ps(255.0f);
+	return _mm_add_ps(white, _mm_mul_ps(_mm_sub_ps(c, white), alpha));
+}
+
+static inline __m128 DotSSE2(__m128 r, __m128 g, __m128 b, const float* k)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(k[0])), _mm_mul_ps(g, _mm_set1_ps(k[1]))), _mm_mul_ps(b, _mm_set1_ps(k[2])));
+}
+
+static inline __m128 YiqDeltaSSE2(__m128i e, __m128i a)
+{
+	const __m128 inv255 = _mm_set1_ps(INV_255);
+	__m128 alphaE = _mm_mul_ps(ChannelSSE2(e, 24), inv255), alphaA = _mm_mul_ps(ChannelSSE2(a, 24), inv255);
+	__m128 dr = _mm_sub_ps(BlendSSE2(ChannelSSE2(e, 0), alphaE), BlendSSE2(ChannelSSE2(a, 0), alphaA));
+	__m128 dg = _mm_sub_ps(BlendSSE2(ChannelSSE2(e, 8), alphaE), BlendSSE2(ChannelSSE2(a, 8), alphaA));
+	__m128 db = _mm_sub_ps(BlendSSE2(ChannelSSE2(e, 16), alphaE), BlendSSE2(ChannelSSE2(a, 16), alphaA));
+	__m128 y = DotSSE2(dr, dg, db, YIQ_Y), i = DotSSE2(dr, dg, db, YIQ_I), q = DotSSE2(dr, dg, db, YIQ_Q);
+	return _mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(YIQ_WEIGHTS[0]), y), y),
+		_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(YIQ_WEIGHTS[1]), i), i)),
+		_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(YIQ_WEIGHTS[2]), q), q));
+}
+
+static unsigned int DiffPerceptualSSE2(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst)
+{
+	const __m128 zero = _mm_setzero_ps(), limitV = _mm_set1_ps(limit);
+	__m128i worstV = _mm_setzero_si128();
+	unsigned int failing = 0, i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i e = _mm_loadu_si128((const __m128i*)(expected + i)), a = _mm_loadu_si128((const __m128i*)(actual + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(e, a)) == 0xFFFF)
+		{
+			if (errors)
+				std::memset(errors + i, 0, 4);
+			continue;
+		}
+
+		__m128 delta = YiqDeltaSSE2(e, a);
+		__m128 scaled = _mm_mul_ps(_mm_set1_ps(254.0f), _mm_sqrt_ps(_mm_mul_ps(delta, _mm_set1_ps(1.0f / YIQ_MAX_DELTA))));
+		__m128i score = _mm_and_si128(_mm_add_epi32(_mm_cvttps_epi32(scaled), _mm_set1_epi32(1)), _mm_castps_si128(_mm_cmpgt_ps(delta, zero)));
+		__m128 fail = _mm_cmpgt_ps(delta, limitV);
+		worstV = _mm_max_epu8(worstV, score);
+		failing += PopCount((unsigned int)_mm_movemask_ps(fail));
+		if (errors)
+			StoreScoresSSE2(errors + i, _mm_and_si128(score, _mm_castps_si128(fail)));
+	}
+	worst = std::max(worst, HorizontalMaxSSE2(worstV));
+	return failing + DiffPerceptualScalar(expected + i, actual + i, count - i, limit, errors ? errors + i : nullptr, worst);
+}
+
+//8 scores of 0..255 in 32 bit lanes to 8 bytes
+SIMD_TARGET_AVX2
+static inline void StoreScoresAVX2(unsigned char* out, __m256i scores)
+{
+	__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(scores), _mm256_extracti128_si256(scores, 1));
+	packed = _mm_packus_epi16(packed, packed);
+	_mm_storel_epi64((__m128i*)out, packed);
+}
+
+SIMD_TARGET_AVX2
+static unsigned int HorizontalMaxAVX2(__m256i v)
+{
+	__m128i m = _mm_max_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+	return (unsigned int)_mm_cvtsi128_si32(m);
+}
+
+SIMD_TARGET_AVX2
+static unsigned int DiffChannelAVX2(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst)
+{
+	const __m256i tolerance = _mm256_set1_epi32((int)limit), byteMask = _mm256_set1_epi32(0xFF);
+	__m256i worstV = _mm256_setzero_si256();
+	unsigned int failing = 0, i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i e = _mm256_loadu_si256((const __m256i*)(expected + i)), a = _mm256_loadu_si256((const __m256i*)(actual + i));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(e, a)) == -1)
+		{
+			if (errors)
+				std::memset(errors + i, 0, 8);
+			continue;
+		}
+
+		__m256i d = _mm256_or_si256(_mm256_subs_epu8(e, a), _mm256_subs_epu8(a, e));
+		d = _mm256_max_epu8(d, _mm256_srli_epi32(d, 8));
+		d = _mm256_max_epu8(d, _mm256_srli_epi32(d, 16));
+		__m256i score = _mm256_and_si256(d, byteMask);
+		__m256i fail = _mm256_cmpgt_epi32(score, tolerance);
+		worstV = _mm256_max_epu8(worstV, score);
+		failing += PopCount((unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(fail)));
+		if (errors)
+			StoreScoresAVX2(errors + i, _mm256_and_si256(score, fail));
+	}
+	worst = std::max(worst, HorizontalMaxAVX2(worstV));
+	return failing + DiffChannelScalar(expected + i, actual + i, count - i, limit, errors ? errors + i : nullptr, worst);
+}
+
+//YIQ distance of 8 pixel pairs, same operations as YiqDelta()
+SIMD_TARGET_AVX2
+static inline __m256 ChannelAVX2(__m256i p, int shift)
+{
+	return _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, shift), _mm256_set1_epi32(0xFF)));
+}
+
+SIMD_TARGET_AVX2
+static inline __m256 BlendAVX2(__m256 c, __m256 alpha)
+{
+	const __m256 white = _mm256_set1_ps(255.0f);
+	return _mm256_add_ps(white, _mm256_mul_ps(_mm256_sub_ps(c, white), alpha));
+}
+
+SIMD_TARGET_AVX2
+static inline __m256 DotAVX2(__m256 r, __m256 g, __m256 b, const float* k)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(k[0])), _mm256_mul_ps(g, _mm256_set1_ps(k[1]))), _mm256_mul_ps(b, _mm256_set1_ps(k[2])));
+}
+
+SIMD_TARGET_AVX2
+static inline __m256 YiqDeltaAVX2(__m256i e, __m256i a)
+{
+	const __m256 inv255 = _mm256_set1_ps(INV_255);
+	__m256 alphaE = _mm256_mul_ps(ChannelAVX2(e, 24), inv255), alphaA = _mm256_mul_ps(ChannelAVX2(a, 24), inv255);
+	__m256 dr = _mm256_sub_ps(BlendAVX2(ChannelAVX2(e, 0), alphaE), BlendAVX2(ChannelAVX2(a, 0), alphaA));
+	__m256 dg = _mm256_sub_ps(BlendAVX2(ChannelAVX2(e, 8), alphaE), BlendAVX2(ChannelAVX2(a, 8), alphaA));
+	__m256 db = _mm256_sub_ps(BlendAVX2(ChannelAVX2(e, 16), alphaE), BlendAVX2(ChannelAVX2(a, 16), alphaA));
+	__m256 y = DotAVX2(dr, dg, db, YIQ_Y), i = DotAVX2(dr, dg, db, YIQ_I), q = DotAVX2(dr, dg, db, YIQ_Q);
+	return _mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(YIQ_WEIGHTS[0]), y), y),
+		_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(YIQ_WEIGHTS[1]), i), i)),
+		_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(YIQ_WEIGHTS[2]), q), q));
+}
+
+SIMD_TARGET_AVX2
+static unsigned int DiffPerceptualAVX2(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst)
+{
+	const __m256 zero = _mm256_setzero_ps(), limitV = _mm256_set1_ps(limit);
+	__m256i worstV = _mm256_setzero_si256();
+	unsigned int failing = 0, i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i e = _mm256_loadu_si256((const __m256i*)(expected + i)), a = _mm256_loadu_si256((const __m256i*)(actual + i));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(e, a)) == -1)
+		{
+			if (errors)
+				std::memset(errors + i, 0, 8);
+			continue;
+		}
+
+		__m256 delta = YiqDeltaAVX2(e, a);
+		__m256 scaled = _mm256_mul_ps(_mm256_set1_ps(254.0f), _mm256_sqrt_ps(_mm256_mul_ps(delta, _mm256_set1_ps(1.0f / YIQ_MAX_DELTA))));
+		__m256i score = _mm256_and_si256(_mm256_add_epi32(_mm256_cvttps_epi32(scaled), _mm256_set1_epi32(1)),
+			_mm256_castps_si256(_mm256_cmp_ps(delta, zero, _CMP_GT_OQ)));
+		__m256 fail = _mm256_cmp_ps(delta, limitV, _CMP_GT_OQ);
+		worstV = _mm256_max_epu8(worstV, score);
+		failing += PopCount((unsigned int)_mm256_movemask_ps(fail));
+		if (errors)
+			StoreScoresAVX2(errors + i, _mm256_and_si256(score, _mm256_castps_si256(fail)));
+	}
+
+	worst = std::max(worst, HorizontalMaxAVX2(worstV));
+	return failing + DiffPerceptualScalar(expected + i, actual + i, count - i, limit, errors ? errors + i : nullptr, worst);
+}
+
+SIMD_TARGET_AVX512
+static unsigned int DiffChannelAVX512(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst)
+{
+	const __m512i tolerance = _mm512_set1_epi32((int)limit), byteMask = _mm512_set1_epi32(0xFF);
+	__m512i worstV = _mm512_setzero_si512();
+	unsigned int failing = 0, i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i e = _mm512_loadu_si512(expected + i), a = _mm512_loadu_si512(actual + i);
+		if (_mm512_cmpneq_epi32_mask(e, a) == 0)
+		{
+			if (errors)
+				std::memset(errors + i, 0, 16);
+			continue;
+		}
+
+		__m512i d = _mm512_or_si512(_mm512_subs_epu8(e, a), _mm512_subs_epu8(a, e));
+		d = _mm512_max_epu8(d, _mm512_srli_epi32(d, 8));
+		d = _mm512_max_epu8(d, _mm512_srli_epi32(d, 16));
+		__m512i score = _mm512_and_si512(d, byteMask);
+		__mmask16 fail = _mm512_cmpgt_epi32_mask(score, tolerance);
+		worstV = _mm512_max_epu32(worstV, score);
+		failing += PopCount(fail);
+		if (errors)
+			_mm_storeu_si128((__m128i*)(errors + i), _mm512_maskz_cvtepi32_epi8(fail, score));
+	}
+	worst = std::max(worst, (unsigned int)_mm512_reduce_max_epu32(worstV));
+	return failing + DiffChannelScalar(expected + i, actual + i, count - i, limit, errors ? errors + i : nullptr, worst);
+}
+#endif
+
+DiffSpanFn GetDiffSpanFn(DiffMetric metric, SimdLevel level)
+{
+#if SIMD_X86
+	if (metric == DiffMetric::Channel)
+	{
+		if (level >= SimdLevel::AVX512)
+			return DiffChannelAVX512;
+		if (level >= SimdLevel::AVX2)
+			return DiffChannelAVX2;
+		if (level >= SimdLevel::SSE2)
+			return DiffChannelSSE2;
+	}
+	else
+	{
+		//the float math doesn't get anything out of wider registers that AVX2 doesn't, memory is the limit by then
+		if (level >= SimdLevel::AVX2)
+			return DiffPerceptualAVX2;
+		if (level >= SimdLevel::SSE2)
+			return DiffPerceptualSSE2;
+	}
+#endif
+	return metric == DiffMetric::Channel ? DiffChannelScalar : DiffPerceptualScalar;
+}
+
+DiffResult DiffImages(const Image& expected, const Image& actual, const DiffOptions& options,
+	std::vector<unsigned char>* errors)
+{
+	DiffResult result = { true, 0, 0 };
+	size_t pixelCount = expected.pixels.size();
+
+	if (expected.width != actual.width || expected.height != actual.height)
+	{
+		result.sameSize = false;
+		result.differentPixels = (unsigned int)pixelCount;
+		result.worstScore = 255;
+		if (errors)
+			errors->assign(pixelCount, 255);
+		return result;
+	}
+
+	if (errors)
+		errors->resize(pixelCount);
+
+	float limit = options.metric == DiffMetric::Channel ? (float)std::min(options.channelTolerance, 255u)
+		: options.perceptualThreshold * options.perceptualThreshold * YIQ_MAX_DELTA;
+	DiffSpanFn diff = GetDiffSpanFn(options.metric, GetSimdLevel());
+
+	//one slot per row, summed afterwards, so rows can be compared in any order without atomics
+	unsigned int width = expected.width, height = expected.height;
+	std::vector<unsigned int> rowFailing(height), rowWorst(height);
+	GetThreadPool().parallelFor(height, 16, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int y = begin; y < end; y++)
+		{
+			size_t offset = (size_t)y * width;
+			unsigned int worst = 0;
+			rowFailing[y] = diff(expected.pixels.data() + offset, actual.pixels.data() + offset, width, limit,
+				errors ? errors->data() + offset : nullptr, worst);
+			rowWorst[y] = worst;
+		}
+	});
+
+	for (unsigned int y = 0; y < height; y++)
+	{
+		result.differentPixels += rowFailing[y];
+		result.worstScore = std::max(result.worstScore, rowWorst[y]);
+	}
+	return result;
+}
+
+Image MakeHeatmap(const Image& expected, const std::vector<unsigned char>& errors)
+{
+	Image heatmap(expected.width, expected.height);
+	for (size_t i = 0; i < heatmap.pixels.size(); i++)
+	{
+		unsigned int score = i < errors.size() ? errors[i] : 255;
+		if (score)
+		{
+			heatmap.pixels[i] = 0xFF0000FFu | (score << 8);
+			continue;
+		}
+
+		unsigned int p = expected.pixels[i];
+		unsigned int luma = ((p & 0xFF) * 77 + ((p >> 8) & 0xFF) * 150 + ((p >> 16) & 0xFF) * 29) >> 8;
+		unsigned int faded = 255 - ((255 - luma) >> 2);
+		heatmap.pixels[i] = 0xFF000000u | faded | (faded << 8) | (faded << 16);
+	}
+	return heatmap;
+}
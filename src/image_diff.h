@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "image.h"
+#include "simd.h"
+
+enum class DiffMetric
+{
+	Channel,   //fails pixels where any of R, G, B, A differs by more than channelTolerance
+	Perceptual //fails pixels whose YIQ color distance, after blending both over white, exceeds perceptualThreshold
+};
+
+struct DiffOptions
+{
+	DiffMetric metric = DiffMetric::Channel;
+	unsigned int channelTolerance = 0;  //0..255, 0 asks for identical images
+	float perceptualThreshold = 0.1f;   //0..1 share of the largest YIQ distance, 0.1 is about what the eye notices
+};
+
+struct DiffResult
+{
+	bool sameSize;
+	unsigned int differentPixels; //pixels failing the metric, every pixel when the sizes differ
+	unsigned int worstScore;      //0..255, largest channel delta or scaled YIQ distance over the whole image
+};
+
+//Compares count pixels, limit is the channel tolerance or the squared YIQ distance allowed
+//Writes the 1..255 score of failing pixels to errors and 0 for the others, errors can be null
+//Returns the number of failing pixels and raises worst to the highest score seen
+typedef unsigned int (*DiffSpanFn)(const unsigned int* expected, const unsigned int* actual, unsigned int count,
+	float limit, unsigned char* errors, unsigned int& worst);
+
+DiffSpanFn GetDiffSpanFn(DiffMetric metric, SimdLevel level);
+
+//Compares two images row by row on the thread pool, identical spans cost little more than reading them
+//errors, when given, is resized to one score per pixel for MakeHeatmap()
+DiffResult DiffImages(const Image& expected, const Image& actual, const DiffOptions& options,
+	std::vector<unsigned char>* errors = nullptr);
+
+//Failing pixels in a red to yellow ramp by score over a faded grayscale copy of expected
+Image MakeHeatmap(const Image& expected, const std::vector<unsigned char>& errors);
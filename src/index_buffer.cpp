@@ -1,25 +1,52 @@
 #include "index_buffer.h"
+#include "gpu_buffer_allocator.h"
 #include "renderer.h"
 
 IndexBuffer::IndexBuffer(const void* data, unsigned int count)
 	:m_count(count)
 {
-	GLCall(glGenBuffers(1, &m_RendererID)); //create a buffer
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID)); //"select" a buffer
-	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * count, data, GL_STATIC_DRAW));
+	m_allocation = GetGpuBufferAllocator().allocate(data, sizeof(unsigned int) * count).id; //a range of a shared buffer instead of a buffer object of its own
 }
 
 IndexBuffer::~IndexBuffer()
 {
-	GLCall(glDeleteBuffers(1, &m_RendererID));
+	GetGpuBufferAllocator().free(m_allocation);
+}
+
+IndexBuffer::IndexBuffer(IndexBuffer&& other) noexcept
+	:m_allocation(other.m_allocation), m_count(other.m_count)
+{
+	other.m_allocation = 0;
+}
+
+IndexBuffer& IndexBuffer::operator=(IndexBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		GetGpuBufferAllocator().free(m_allocation);
+		m_allocation = other.m_allocation;
+		m_count = other.m_count;
+		other.m_allocation = 0;
+	}
+	return *this;
 }
 
 void IndexBuffer::bind() const
 {
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
+	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetGpuBufferAllocator().get(m_allocation).buffer));
 }
 
 void IndexBuffer::unbind() const
 {
 	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+}
+
+unsigned int IndexBuffer::getBuffer() const
+{
+	return GetGpuBufferAllocator().get(m_allocation).buffer;
+}
+
+unsigned int IndexBuffer::getOffset() const
+{
+	return GetGpuBufferAllocator().get(m_allocation).offset;
 }
\ No newline at end of file
@@ -1,15 +1,33 @@
 #pragma once
 
+//Indices in a range of one of GetGpuBufferAllocator()'s buffers
 class IndexBuffer
 {
 private:
-	unsigned int m_RendererID; 
+	unsigned int m_allocation; //id in GetGpuBufferAllocator()
 	unsigned int m_count;
 
 public:
 	IndexBuffer(const void* data, unsigned int count);
 	~IndexBuffer();
 
+	//Owns its range, moving hands it over and leaves the source empty
+	IndexBuffer(IndexBuffer&& other) noexcept;
+	IndexBuffer& operator=(IndexBuffer&& other) noexcept;
+	IndexBuffer(const IndexBuffer&) = delete;
+	IndexBuffer& operator=(const IndexBuffer&) = delete;
+
+	//false when the allocation failed or the buffer was moved from
+	bool isValid() const { return m_allocation != 0; }
+
 	void bind() const;
 	void unbind() const;
+
+	unsigned int getCount() const { return m_count; }
+
+	//The shared GL buffer the indices are in, can change when the allocator compacts
+	unsigned int getBuffer() const;
+
+	//Where the indices start in the bound buffer, the indices argument of glDrawElements
+	unsigned int getOffset() const;
 };
\ No newline at end of file
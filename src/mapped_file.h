@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+//Read-only view of a whole file in the address space
+//Pages are read from disk the first time they are touched, so whoever reads the data pays the disk time,
+//and nothing is copied into buffers of our own
+class MappedFile
+{
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;    //HANDLE
+	void* m_mapping; //HANDLE
+#else
+	int m_file;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//Maps path, hinting the OS that it will be read front to back; false if it can't be opened or is empty
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+	const unsigned char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+};
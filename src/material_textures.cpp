@@ -0,0 +1,213 @@
+#include "material_textures.h"
+#include <algorithm>
+#include "mipmap.h"
+#include "renderer.h"
+#include "texture.h"
+
+static const unsigned int NO_ARRAY = 0xFFFFFFFFu;
+static const unsigned int FIRST_CAPACITY = 4;
+static const unsigned int MAX_CAPACITY = 64;
+
+MaterialTextures::MaterialTextures(bool allowBindless)
+	:m_maxLayers(MAX_CAPACITY), m_bindless(allowBindless && GLEW_ARB_bindless_texture), m_handleBuffer(0)
+{
+	int maxLayers;
+	GLCall(glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers));
+	m_maxLayers = std::min(m_maxLayers, (unsigned int)maxLayers);
+
+	if (m_bindless)
+	{
+		std::vector<unsigned int> zeros(MAX_ARRAYS * 4, 0);
+		GLCall(glGenBuffers(1, &m_handleBuffer));
+		GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_handleBuffer));
+		GLCall(glBufferData(GL_UNIFORM_BUFFER, zeros.size() * sizeof(unsigned int), zeros.data(), GL_DYNAMIC_DRAW));
+		GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	}
+}
+
+MaterialTextures::~MaterialTextures()
+{
+	for (ArrayTexture& array : m_arrays)
+	{
+		if (array.handle)
+		{
+			GLCall(glMakeTextureHandleNonResidentARB(array.handle));
+		}
+		GLCall(glDeleteTextures(1, &array.RendererID));
+	}
+	if (m_handleBuffer)
+	{
+		GLCall(glDeleteBuffers(1, &m_handleBuffer));
+	}
+}
+
+//An array of this format with a free layer, a new one when they are all full
+unsigned int MaterialTextures::findArray(const TextureLevels& levels, unsigned int internalFormat)
+{
+	const TextureLevelData& top = levels.levels[0];
+	unsigned int levelCount = (unsigned int)levels.levels.size();
+	unsigned int capacity = FIRST_CAPACITY;
+	for (unsigned int i = 0; i < m_arrays.size(); i++)
+	{
+		const ArrayTexture& array = m_arrays[i];
+		if (array.internalFormat != internalFormat || array.width != top.width || array.height != top.height || array.levels != levelCount)
+			continue;
+		if (!array.freeLayers.empty() || array.used < array.capacity)
+			return i;
+		capacity = std::max(capacity, array.capacity * 2);
+	}
+
+	if (m_arrays.size() >= MAX_ARRAYS)
+		return NO_ARRAY;
+
+	ArrayTexture array;
+	array.internalFormat = internalFormat;
+	array.compressed = levels.compressed;
+	array.width = top.width;
+	array.height = top.height;
+	array.levels = levelCount;
+	array.capacity = std::min(capacity, m_maxLayers);
+	array.used = 0;
+	array.handle = 0;
+
+	//storage for every layer up front, layers are only ever written after this
+	GLCall(glGenTextures(1, &array.RendererID));
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, array.RendererID));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT)); //materials tile
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (int)levelCount - 1));
+	for (unsigned int i = 0; i < levelCount; i++)
+	{
+		const TextureLevelData& level = levels.levels[i];
+		if (array.compressed)
+		{
+			GLCall(glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, internalFormat, level.width, level.height, array.capacity, 0,
+				(GLsizei)(level.size * array.capacity), nullptr));
+		}
+		else
+		{
+			GLCall(glTexImage3D(GL_TEXTURE_2D_ARRAY, i, internalFormat, level.width, level.height, array.capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+		}
+	}
+
+	//the handle freezes the texture's parameters and storage, but not the contents of its layers
+	if (m_bindless)
+	{
+		GLCall(array.handle = glGetTextureHandleARB(array.RendererID));
+		GLCall(glMakeTextureHandleResidentARB(array.handle));
+		GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_handleBuffer));
+		GLCall(glBufferSubData(GL_UNIFORM_BUFFER, m_arrays.size() * 4 * sizeof(unsigned int), sizeof(array.handle), &array.handle));
+		GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	}
+
+	m_arrays.push_back(array);
+	return (unsigned int)m_arrays.size() - 1;
+}
+
+unsigned int MaterialTextures::add(const Image& image, bool mipmaps)
+{
+	std::vector<Image> images;
+	TextureLevels levels;
+	if (mipmaps)
+	{
+		GenerateMipmaps(image, MipOptions(), images);
+		TextureLevelsFromImages(images, false, levels);
+	}
+	else
+	{
+		TextureLevelData level = { image.width, image.height, (const unsigned char*)image.pixels.data(), image.pixels.size() * sizeof(unsigned int) };
+		levels.levels.push_back(level);
+	}
+	return add(levels);
+}
+
+unsigned int MaterialTextures::add(const TextureLevels& levels)
+{
+	if (levels.levels.empty())
+		return 0;
+
+	unsigned int internalFormat = TextureInternalFormat(levels);
+	unsigned int arrayIndex = findArray(levels, internalFormat);
+	if (arrayIndex == NO_ARRAY)
+		return 0;
+
+	ArrayTexture& array = m_arrays[arrayIndex];
+	unsigned int layer;
+	if (!array.freeLayers.empty())
+	{
+		layer = array.freeLayers.back();
+		array.freeLayers.pop_back();
+	}
+	else
+		layer = array.used++;
+
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, array.RendererID));
+	for (unsigned int i = 0; i < levels.levels.size(); i++)
+	{
+		const TextureLevelData& level = levels.levels[i];
+		if (array.compressed)
+		{
+			GLCall(glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, internalFormat, (GLsizei)level.size, level.data));
+		}
+		else
+		{
+			GLCall(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.data));
+		}
+	}
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+
+	Entry entry;
+	entry.ref.array = arrayIndex;
+	entry.ref.layer = layer;
+	entry.live = true;
+
+	unsigned int id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+		m_entries[id - 1] = entry;
+	}
+	else
+	{
+		m_entries.push_back(entry);
+		id = (unsigned int)m_entries.size();
+	}
+	return id;
+}
+
+void MaterialTextures::remove(unsigned int id)
+{
+	if (!isValid(id))
+		return;
+
+	Entry& entry = m_entries[id - 1];
+	entry.live = false;
+	m_arrays[entry.ref.array].freeLayers.push_back(entry.ref.layer);
+	m_freeIds.push_back(id);
+}
+
+void MaterialTextures::bindArray(unsigned int array, unsigned int slot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[array].RendererID));
+}
+
+void MaterialTextures::unbindArray(unsigned int slot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+}
+
+void MaterialTextures::bindHandles(unsigned int program, unsigned int bindingPoint) const
+{
+	unsigned int block;
+	GLCall(block = glGetUniformBlockIndex(program, "MaterialTextureHandles"));
+	if (block != GL_INVALID_INDEX)
+	{
+		GLCall(glUniformBlockBinding(program, block, bindingPoint));
+	}
+	GLCall(glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_handleBuffer));
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include "image.h"
+#include "texture_file.h"
+
+//Where a material texture lives: which of the MaterialTextures' arrays and which layer of it
+struct MaterialTextureRef
+{
+	unsigned int array;
+	unsigned int layer;
+};
+
+//Material textures grouped by format into GL_TEXTURE_2D_ARRAYs, so draws using different textures don't need a bind in between
+//Textures with the same internal format, size and level count share arrays; a full array isn't grown but joined by a new
+//one twice its size (up to 64 layers), so layers never move and nothing has to be copied
+//Every texture has a draw index, array << 16 | layer, meant to go into a per instance attribute:
+//- with ARB_bindless_texture the arrays are resident and their handles sit in a uniform block, so a single draw can use
+//  every texture (res/shaders/material_bindless_fragment.shader)
+//- without it the draws are sorted by array and the array is bound once per batch, the layer still comes from the
+//  instance (res/shaders/material_fragment.shader)
+//Must be used on the GL thread
+class MaterialTextures
+{
+private:
+	struct ArrayTexture
+	{
+		unsigned int RendererID;
+		unsigned int internalFormat;
+		bool compressed;
+		unsigned int width, height, levels;
+		unsigned int capacity;
+		unsigned int used;
+		std::vector<unsigned int> freeLayers; //below used, given back by remove()
+		unsigned long long handle; //bindless, 0 without
+	};
+
+	struct Entry
+	{
+		MaterialTextureRef ref;
+		bool live;
+	};
+
+	std::vector<ArrayTexture> m_arrays;
+	std::vector<Entry> m_entries; //indexed by id - 1
+	std::vector<unsigned int> m_freeIds;
+	unsigned int m_maxLayers;
+	bool m_bindless;
+	unsigned int m_handleBuffer; //uniform buffer of the arrays' handles, a uvec4 each with the handle in xy
+
+	unsigned int findArray(const TextureLevels& levels, unsigned int internalFormat);
+
+public:
+	//Arrays the handle block has room for, MAX_MATERIAL_ARRAYS in the bindless shader
+	static const unsigned int MAX_ARRAYS = 256;
+
+	//allowBindless = false keeps to bound arrays even where bindless textures are supported
+	explicit MaterialTextures(bool allowBindless = true);
+	~MaterialTextures();
+
+	MaterialTextures(const MaterialTextures&) = delete;
+	MaterialTextures& operator=(const MaterialTextures&) = delete;
+
+	//Uploads an RGBA8 image, generating its mipmaps on this thread; returns its id, 0 when there's no room
+	unsigned int add(const Image& image, bool mipmaps = true);
+
+	//Uploads a chain as it is, e.g. the levels of a KTX2 or DDS file
+	unsigned int add(const TextureLevels& levels);
+
+	//Frees the layer of id for the next texture of its format
+	void remove(unsigned int id);
+
+	bool isValid(unsigned int id) const { return id > 0 && id <= m_entries.size() && m_entries[id - 1].live; }
+	const MaterialTextureRef& getRef(unsigned int id) const { return m_entries[id - 1].ref; }
+	unsigned int getDrawIndex(unsigned int id) const { return (getRef(id).array << 16) | getRef(id).layer; }
+
+	unsigned int getArrayCount() const { return (unsigned int)m_arrays.size(); }
+	bool isBindless() const { return m_bindless; }
+
+	//Bound array path, once per batch of draws that only use textures of array
+	void bindArray(unsigned int array, unsigned int slot = 0) const;
+	void unbindArray(unsigned int slot = 0) const;
+
+	//Bindless path, binds the handles to the MaterialTextureHandles block of the program
+	void bindHandles(unsigned int program, unsigned int bindingPoint = 0) const;
+};
@@ -0,0 +1,470 @@
+#include "math3d.h"
+
+Mat3 Mat3::Rotation(const Quat& q)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	return Mat3(Vec3(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy)),
+		Vec3(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx)),
+		Vec3(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy)));
+}
+
+Mat4 Mat4::Translation(const Vec3& t)
+{
+	Mat4 m;
+	m.columns[3] = Vec4(t, 1.0f);
+	return m;
+}
+
+Mat4 Mat4::Scale(const Vec3& s)
+{
+	return Mat4(Vec4(s.x, 0.0f, 0.0f, 0.0f), Vec4(0.0f, s.y, 0.0f, 0.0f), Vec4(0.0f, 0.0f, s.z, 0.0f), Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+Mat4 Mat4::Rotation(const Quat& q)
+{
+	Mat3 r = Mat3::Rotation(q);
+	return Mat4(Vec4(r.columns[0], 0.0f), Vec4(r.columns[1], 0.0f), Vec4(r.columns[2], 0.0f), Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+Mat4 Mat4::FromTRS(const Vec3& translation, const Quat& rotation, const Vec3& scale)
+{
+	Mat3 r = Mat3::Rotation(rotation);
+	return Mat4(Vec4(r.columns[0] * scale.x, 0.0f), Vec4(r.columns[1] * scale.y, 0.0f), Vec4(r.columns[2] * scale.z, 0.0f), Vec4(translation, 1.0f));
+}
+
+Mat4 Mat4::Perspective(float fovY, float aspect, float zNear, float zFar)
+{
+	float f = 1.0f / std::tan(fovY * 0.5f);
+	return Mat4(Vec4(f / aspect, 0.0f, 0.0f, 0.0f), Vec4(0.0f, f, 0.0f, 0.0f),
+		Vec4(0.0f, 0.0f, (zFar + zNear) / (zNear - zFar), -1.0f), Vec4(0.0f, 0.0f, 2.0f * zFar * zNear / (zNear - zFar), 0.0f));
+}
+
+Mat4 Mat4::Orthographic(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+	return Mat4(Vec4(2.0f / (right - left), 0.0f, 0.0f, 0.0f), Vec4(0.0f, 2.0f / (top - bottom), 0.0f, 0.0f),
+		Vec4(0.0f, 0.0f, -2.0f / (zFar - zNear), 0.0f),
+		Vec4(-(right + left) / (right - left), -(top + bottom) / (top - bottom), -(zFar + zNear) / (zFar - zNear), 1.0f));
+}
+
+Mat4 Mat4::LookAt(const Vec3& eye, const Vec3& target, const Vec3& up)
+{
+	Vec3 f = Normalize(target - eye);
+	Vec3 s = Normalize(Cross(f, up));
+	Vec3 u = Cross(s, f);
+	return Mat4(Vec4(s.x, u.x, -f.x, 0.0f), Vec4(s.y, u.y, -f.y, 0.0f), Vec4(s.z, u.z, -f.z, 0.0f),
+		Vec4(-Dot(s, eye), -Dot(u, eye), Dot(f, eye), 1.0f));
+}
+
+Quat Slerp(const Quat& a, const Quat& b, float t)
+{
+	//q and -q are the same rotation, take the one on a's side
+	float cosAngle = Dot(a, b);
+	Quat to = b;
+	if (cosAngle < 0.0f)
+	{
+		cosAngle = -cosAngle;
+		to = Quat(-b.x, -b.y, -b.z, -b.w);
+	}
+
+	//nearly the same rotation, sin(angle) would divide by almost 0
+	float wa = 1.0f - t, wb = t;
+	if (cosAngle < 0.9995f)
+	{
+		float angle = std::acos(cosAngle);
+		float invSin = 1.0f / std::sin(angle);
+		wa = std::sin((1.0f - t) * angle) * invSin;
+		wb = std::sin(t * angle) * invSin;
+	}
+	return Normalize(Quat(a.x * wa + to.x * wb, a.y * wa + to.y * wb, a.z * wa + to.z * wb, a.w * wa + to.w * wb));
+}
+
+Mat3 Transpose(const Mat3& m)
+{
+	const Vec3* c = m.columns;
+	return Mat3(Vec3(c[0].x, c[1].x, c[2].x), Vec3(c[0].y, c[1].y, c[2].y), Vec3(c[0].z, c[1].z, c[2].z));
+}
+
+float Determinant(const Mat3& m)
+{
+	return Dot(m.columns[0], Cross(m.columns[1], m.columns[2]));
+}
+
+Mat3 Inverse(const Mat3& m)
+{
+	//rows of the inverse are the cross products of the other two columns
+	Vec3 r0 = Cross(m.columns[1], m.columns[2]);
+	Vec3 r1 = Cross(m.columns[2], m.columns[0]);
+	Vec3 r2 = Cross(m.columns[0], m.columns[1]);
+	float determinant = Dot(m.columns[0], r0);
+	if (determinant == 0.0f)
+		return Mat3();
+	float inv = 1.0f / determinant;
+	return Mat3(Vec3(r0.x, r1.x, r2.x) * inv, Vec3(r0.y, r1.y, r2.y) * inv, Vec3(r0.z, r1.z, r2.z) * inv);
+}
+
+Mat4 Transpose(const Mat4& m)
+{
+	const Vec4* c = m.columns;
+	return Mat4(Vec4(c[0].x, c[1].x, c[2].x, c[3].x), Vec4(c[0].y, c[1].y, c[2].y, c[3].y),
+		Vec4(c[0].z, c[1].z, c[2].z, c[3].z), Vec4(c[0].w, c[1].w, c[2].w, c[3].w));
+}
+
+Mat4 Inverse(const Mat4& m)
+{
+	//cofactors from the 2x2 determinants of the top and bottom row pairs
+	const float* a = m.data();
+	float s0 = a[0] * a[5] - a[4] * a[1];
+	float s1 = a[0] * a[9] - a[8] * a[1];
+	float s2 = a[0] * a[13] - a[12] * a[1];
+	float s3 = a[4] * a[9] - a[8] * a[5];
+	float s4 = a[4] * a[13] - a[12] * a[5];
+	float s5 = a[8] * a[13] - a[12] * a[9];
+	float c5 = a[10] * a[15] - a[14] * a[11];
+	float c4 = a[6] * a[15] - a[14] * a[7];
+	float c3 = a[6] * a[11] - a[10] * a[7];
+	float c2 = a[2] * a[15] - a[14] * a[3];
+	float c1 = a[2] * a[11] - a[10] * a[3];
+	float c0 = a[2] * a[7] - a[6] * a[3];
+
+	float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (determinant == 0.0f)
+		return Mat4();
+	float inv = 1.0f / determinant;
+
+	Mat4 out;
+	float* o = out.data();
+	o[0] = (a[5] * c5 - a[9] * c4 + a[13] * c3) * inv;
+	o[1] = (-a[1] * c5 + a[9] * c2 - a[13] * c1) * inv;
+	o[2] = (a[1] * c4 - a[5] * c2 + a[13] * c0) * inv;
+	o[3] = (-a[1] * c3 + a[5] * c1 - a[9] * c0) * inv;
+	o[4] = (-a[4] * c5 + a[8] * c4 - a[12] * c3) * inv;
+	o[5] = (a[0] * c5 - a[8] * c2 + a[12] * c1) * inv;
+	o[6] = (-a[0] * c4 + a[4] * c2 - a[12] * c0) * inv;
+	o[7] = (a[0] * c3 - a[4] * c1 + a[8] * c0) * inv;
+	o[8] = (a[7] * s5 - a[11] * s4 + a[15] * s3) * inv;
+	o[9] = (-a[3] * s5 + a[11] * s2 - a[15] * s1) * inv;
+	o[10] = (a[3] * s4 - a[7] * s2 + a[15] * s0) * inv;
+	o[11] = (-a[3] * s3 + a[7] * s1 - a[11] * s0) * inv;
+	o[12] = (-a[6] * s5 + a[10] * s4 - a[14] * s3) * inv;
+	o[13] = (a[2] * s5 - a[10] * s2 + a[14] * s1) * inv;
+	o[14] = (-a[2] * s4 + a[6] * s2 - a[14] * s0) * inv;
+	o[15] = (a[2] * s3 - a[6] * s1 + a[10] * s0) * inv;
+	return out;
+}
+
+Mat4 InverseAffine(const Mat4& m)
+{
+	Mat3 r = Inverse(UpperLeft(m));
+	Vec3 t = -(r * m.columns[3].xyz());
+	return Mat4(Vec4(r.columns[0], 0.0f), Vec4(r.columns[1], 0.0f), Vec4(r.columns[2], 0.0f), Vec4(t, 1.0f));
+}
+
+Mat3 UpperLeft(const Mat4& m)
+{
+	return Mat3(m.columns[0].xyz(), m.columns[1].xyz(), m.columns[2].xyz());
+}
+
+Mat3 NormalMatrix(const Mat4& m)
+{
+	return Transpose(Inverse(UpperLeft(m)));
+}
+
+static void TransformPointsScalar(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Vec3 p = TransformPoint(m, Vec3(x[i], y[i], z[i]));
+		outX[i] = p.x;
+		outY[i] = p.y;
+		outZ[i] = p.z;
+	}
+}
+
+static void TransformVectorsScalar(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Vec3 v = TransformVector(m, Vec3(x[i], y[i], z[i]));
+		outX[i] = v.x;
+		outY[i] = v.y;
+		outZ[i] = v.z;
+	}
+}
+
+static void MultiplyMatricesScalar(const Mat4* a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+		out[i] = a[i] * b[i];
+}
+
+static void MultiplyMatrixScalar(const Mat4& a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	Mat4 left = a; //a may be one of the outputs
+	for (unsigned int i = 0; i < count; i++)
+		out[i] = left * b[i];
+}
+
+#if SIMD_X86
+//SoA points: the 12 matrix entries broadcast once, then 3 rows of multiply-adds per register of points
+static void TransformSSE2(const Mat4& m, float w, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	const float* a = m.data();
+	__m128 m0 = _mm_set1_ps(a[0]), m1 = _mm_set1_ps(a[1]), m2 = _mm_set1_ps(a[2]);
+	__m128 m4 = _mm_set1_ps(a[4]), m5 = _mm_set1_ps(a[5]), m6 = _mm_set1_ps(a[6]);
+	__m128 m8 = _mm_set1_ps(a[8]), m9 = _mm_set1_ps(a[9]), m10 = _mm_set1_ps(a[10]);
+	__m128 t0 = _mm_set1_ps(a[12] * w), t1 = _mm_set1_ps(a[13] * w), t2 = _mm_set1_ps(a[14] * w);
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_add_ps(_mm_mul_ps(m8, pz), t0));
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_add_ps(_mm_mul_ps(m9, pz), t1));
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_add_ps(_mm_mul_ps(m10, pz), t2));
+		_mm_storeu_ps(outX + i, rx);
+		_mm_storeu_ps(outY + i, ry);
+		_mm_storeu_ps(outZ + i, rz);
+	}
+	if (w != 0.0f)
+		TransformPointsScalar(m, x + i, y + i, z + i, count - i, outX + i, outY + i, outZ + i);
+	else
+		TransformVectorsScalar(m, x + i, y + i, z + i, count - i, outX + i, outY + i, outZ + i);
+}
+
+static void TransformPointsSSE2(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	TransformSSE2(m, 1.0f, x, y, z, count, outX, outY, outZ);
+}
+
+static void TransformVectorsSSE2(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	TransformSSE2(m, 0.0f, x, y, z, count, outX, outY, outZ);
+}
+
+//a * column, the column's 4 entries broadcast with shuffles
+static inline __m128 MultiplyColumnSSE2(__m128 a0, __m128 a1, __m128 a2, __m128 a3, __m128 column)
+{
+	__m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+	r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+	r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+	return _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+
+//every input is loaded before the first store, so out may alias a or b
+static inline void MultiplySSE2(__m128 a0, __m128 a1, __m128 a2, __m128 a3, const float* b, float* out)
+{
+	__m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+	_mm_storeu_ps(out, MultiplyColumnSSE2(a0, a1, a2, a3, b0));
+	_mm_storeu_ps(out + 4, MultiplyColumnSSE2(a0, a1, a2, a3, b1));
+	_mm_storeu_ps(out + 8, MultiplyColumnSSE2(a0, a1, a2, a3, b2));
+	_mm_storeu_ps(out + 12, MultiplyColumnSSE2(a0, a1, a2, a3, b3));
+}
+
+static void MultiplyMatricesSSE2(const Mat4* a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const float* left = a[i].data();
+		MultiplySSE2(_mm_loadu_ps(left), _mm_loadu_ps(left + 4), _mm_loadu_ps(left + 8), _mm_loadu_ps(left + 12), b[i].data(), out[i].data());
+	}
+}
+
+static void MultiplyMatrixSSE2(const Mat4& a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	const float* left = a.data();
+	__m128 a0 = _mm_loadu_ps(left), a1 = _mm_loadu_ps(left + 4), a2 = _mm_loadu_ps(left + 8), a3 = _mm_loadu_ps(left + 12);
+	for (unsigned int i = 0; i < count; i++)
+		MultiplySSE2(a0, a1, a2, a3, b[i].data(), out[i].data());
+}
+
+SIMD_TARGET_AVX2
+static void TransformAVX2(const Mat4& m, float w, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	const float* a = m.data();
+	__m256 m0 = _mm256_set1_ps(a[0]), m1 = _mm256_set1_ps(a[1]), m2 = _mm256_set1_ps(a[2]);
+	__m256 m4 = _mm256_set1_ps(a[4]), m5 = _mm256_set1_ps(a[5]), m6 = _mm256_set1_ps(a[6]);
+	__m256 m8 = _mm256_set1_ps(a[8]), m9 = _mm256_set1_ps(a[9]), m10 = _mm256_set1_ps(a[10]);
+	__m256 t0 = _mm256_set1_ps(a[12] * w), t1 = _mm256_set1_ps(a[13] * w), t2 = _mm256_set1_ps(a[14] * w);
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		__m256 rx = _mm256_fmadd_ps(m0, px, _mm256_fmadd_ps(m4, py, _mm256_fmadd_ps(m8, pz, t0)));
+		__m256 ry = _mm256_fmadd_ps(m1, px, _mm256_fmadd_ps(m5, py, _mm256_fmadd_ps(m9, pz, t1)));
+		__m256 rz = _mm256_fmadd_ps(m2, px, _mm256_fmadd_ps(m6, py, _mm256_fmadd_ps(m10, pz, t2)));
+		_mm256_storeu_ps(outX + i, rx);
+		_mm256_storeu_ps(outY + i, ry);
+		_mm256_storeu_ps(outZ + i, rz);
+	}
+	TransformSSE2(m, w, x + i, y + i, z + i, count - i, outX + i, outY + i, outZ + i);
+}
+
+SIMD_TARGET_AVX2
+static void TransformPointsAVX2(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	TransformAVX2(m, 1.0f, x, y, z, count, outX, outY, outZ);
+}
+
+SIMD_TARGET_AVX2
+static void TransformVectorsAVX2(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	TransformAVX2(m, 0.0f, x, y, z, count, outX, outY, outZ);
+}
+
+//two columns per register, the left matrix's columns repeated in both halves
+SIMD_TARGET_AVX2
+static inline void MultiplyAVX2(__m256 a0, __m256 a1, __m256 a2, __m256 a3, const float* b, float* out)
+{
+	__m256 b01 = _mm256_loadu_ps(b), b23 = _mm256_loadu_ps(b + 8);
+	__m256 r01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(0, 0, 0, 0)));
+	__m256 r23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(0, 0, 0, 0)));
+	r01 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1)), r01);
+	r23 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(1, 1, 1, 1)), r23);
+	r01 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2)), r01);
+	r23 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(2, 2, 2, 2)), r23);
+	r01 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3)), r01);
+	r23 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(3, 3, 3, 3)), r23);
+	_mm256_storeu_ps(out, r01);
+	_mm256_storeu_ps(out + 8, r23);
+}
+
+SIMD_TARGET_AVX2
+static void MultiplyMatricesAVX2(const Mat4* a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const float* left = a[i].data();
+		MultiplyAVX2(_mm256_broadcast_ps((const __m128*)left), _mm256_broadcast_ps((const __m128*)(left + 4)),
+			_mm256_broadcast_ps((const __m128*)(left + 8)), _mm256_broadcast_ps((const __m128*)(left + 12)), b[i].data(), out[i].data());
+	}
+}
+
+SIMD_TARGET_AVX2
+static void MultiplyMatrixAVX2(const Mat4& a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	const float* left = a.data();
+	__m256 a0 = _mm256_broadcast_ps((const __m128*)left), a1 = _mm256_broadcast_ps((const __m128*)(left + 4));
+	__m256 a2 = _mm256_broadcast_ps((const __m128*)(left + 8)), a3 = _mm256_broadcast_ps((const __m128*)(left + 12));
+	for (unsigned int i = 0; i < count; i++)
+		MultiplyAVX2(a0, a1, a2, a3, b[i].data(), out[i].data());
+}
+
+SIMD_TARGET_AVX512
+static void TransformAVX512(const Mat4& m, float w, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	const float* a = m.data();
+	__m512 m0 = _mm512_set1_ps(a[0]), m1 = _mm512_set1_ps(a[1]), m2 = _mm512_set1_ps(a[2]);
+	__m512 m4 = _mm512_set1_ps(a[4]), m5 = _mm512_set1_ps(a[5]), m6 = _mm512_set1_ps(a[6]);
+	__m512 m8 = _mm512_set1_ps(a[8]), m9 = _mm512_set1_ps(a[9]), m10 = _mm512_set1_ps(a[10]);
+	__m512 t0 = _mm512_set1_ps(a[12] * w), t1 = _mm512_set1_ps(a[13] * w), t2 = _mm512_set1_ps(a[14] * w);
+	unsigned int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 px = _mm512_loadu_ps(x + i), py = _mm512_loadu_ps(y + i), pz = _mm512_loadu_ps(z + i);
+		__m512 rx = _mm512_fmadd_ps(m0, px, _mm512_fmadd_ps(m4, py, _mm512_fmadd_ps(m8, pz, t0)));
+		__m512 ry = _mm512_fmadd_ps(m1, px, _mm512_fmadd_ps(m5, py, _mm512_fmadd_ps(m9, pz, t1)));
+		__m512 rz = _mm512_fmadd_ps(m2, px, _mm512_fmadd_ps(m6, py, _mm512_fmadd_ps(m10, pz, t2)));
+		_mm512_storeu_ps(outX + i, rx);
+		_mm512_storeu_ps(outY + i, ry);
+		_mm512_storeu_ps(outZ + i, rz);
+	}
+	TransformAVX2(m, w, x + i, y + i, z + i, count - i, outX + i, outY + i, outZ + i);
+}
+
+SIMD_TARGET_AVX512
+static void TransformPointsAVX512(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	TransformAVX512(m, 1.0f, x, y, z, count, outX, outY, outZ);
+}
+
+SIMD_TARGET_AVX512
+static void TransformVectorsAVX512(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+	float* outX, float* outY, float* outZ)
+{
+	TransformAVX512(m, 0.0f, x, y, z, count, outX, outY, outZ);
+}
+
+SIMD_TARGET_AVX512
+static inline __m512 BroadcastColumnAVX512(const float* column)
+{
+	return _mm512_broadcast_f32x4(_mm_loadu_ps(column));
+}
+
+//the whole matrix in one register, each 128 bit lane a column
+SIMD_TARGET_AVX512
+static inline void MultiplyAVX512(__m512 a0, __m512 a1, __m512 a2, __m512 a3, const float* b, float* out)
+{
+	__m512 columns = _mm512_loadu_ps(b);
+	__m512 r = _mm512_mul_ps(a0, _mm512_permute_ps(columns, _MM_SHUFFLE(0, 0, 0, 0)));
+	r = _mm512_fmadd_ps(a1, _mm512_permute_ps(columns, _MM_SHUFFLE(1, 1, 1, 1)), r);
+	r = _mm512_fmadd_ps(a2, _mm512_permute_ps(columns, _MM_SHUFFLE(2, 2, 2, 2)), r);
+	r = _mm512_fmadd_ps(a3, _mm512_permute_ps(columns, _MM_SHUFFLE(3, 3, 3, 3)), r);
+	_mm512_storeu_ps(out, r);
+}
+
+SIMD_TARGET_AVX512
+static void MultiplyMatricesAVX512(const Mat4* a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const float* left = a[i].data();
+		MultiplyAVX512(BroadcastColumnAVX512(left), BroadcastColumnAVX512(left + 4), BroadcastColumnAVX512(left + 8),
+			BroadcastColumnAVX512(left + 12), b[i].data(), out[i].data());
+	}
+}
+
+SIMD_TARGET_AVX512
+static void MultiplyMatrixAVX512(const Mat4& a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	const float* left = a.data();
+	__m512 a0 = BroadcastColumnAVX512(left), a1 = BroadcastColumnAVX512(left + 4);
+	__m512 a2 = BroadcastColumnAVX512(left + 8), a3 = BroadcastColumnAVX512(left + 12);
+	for (unsigned int i = 0; i < count; i++)
+		MultiplyAVX512(a0, a1, a2, a3, b[i].data(), out[i].data());
+}
+#endif
+
+MathKernels GetMathKernels(SimdLevel level)
+{
+	MathKernels kernels = { TransformPointsScalar, TransformVectorsScalar, MultiplyMatricesScalar, MultiplyMatrixScalar };
+#if SIMD_X86
+	if (level >= SimdLevel::SSE2)
+		kernels = { TransformPointsSSE2, TransformVectorsSSE2, MultiplyMatricesSSE2, MultiplyMatrixSSE2 };
+	if (level >= SimdLevel::AVX2)
+		kernels = { TransformPointsAVX2, TransformVectorsAVX2, MultiplyMatricesAVX2, MultiplyMatrixAVX2 };
+	if (level >= SimdLevel::AVX512)
+		kernels = { TransformPointsAVX512, TransformVectorsAVX512, MultiplyMatricesAVX512, MultiplyMatrixAVX512 };
+#endif
+	return kernels;
+}
+
+void TransformPoints(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count, float* outX, float* outY, float* outZ)
+{
+	GetMathKernels(GetSimdLevel()).transformPoints(m, x, y, z, count, outX, outY, outZ);
+}
+
+void TransformVectors(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count, float* outX, float* outY, float* outZ)
+{
+	GetMathKernels(GetSimdLevel()).transformVectors(m, x, y, z, count, outX, outY, outZ);
+}
+
+void MultiplyMatrices(const Mat4* a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	GetMathKernels(GetSimdLevel()).multiplyMatrices(a, b, count, out);
+}
+
+void MultiplyMatrices(const Mat4& a, const Mat4* b, unsigned int count, Mat4* out)
+{
+	GetMathKernels(GetSimdLevel()).multiplyMatrix(a, b, count, out);
+}
@@ -0,0 +1,240 @@
+#pragma once
+#include <cmath>
+#include "simd.h"
+
+//Small vector, matrix and quaternion types for camera and model transforms
+//Plain floats, so they can sit in any array or vertex and go to glUniform* as they are; the single operations are scalar
+//inline code the compiler can fold, the SIMD is in the batch functions at the end that go over many points or matrices
+//Matrices are column-major like OpenGL and multiply column vectors: (a * b) * v == a * (b * v)
+
+struct Vec2
+{
+	float x, y;
+
+	Vec2() :x(0.0f), y(0.0f) {}
+	Vec2(float x, float y) :x(x), y(y) {}
+};
+
+struct Vec3
+{
+	float x, y, z;
+
+	Vec3() :x(0.0f), y(0.0f), z(0.0f) {}
+	Vec3(float x, float y, float z) :x(x), y(y), z(z) {}
+};
+
+struct Vec4
+{
+	float x, y, z, w;
+
+	Vec4() :x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	Vec4(float x, float y, float z, float w) :x(x), y(y), z(z), w(w) {}
+	Vec4(const Vec3& v, float w) :x(v.x), y(v.y), z(v.z), w(w) {}
+
+	Vec3 xyz() const { return Vec3(x, y, z); }
+};
+
+//Rotation as a unit quaternion, w is the real part
+struct Quat
+{
+	float x, y, z, w;
+
+	Quat() :x(0.0f), y(0.0f), z(0.0f), w(1.0f) {}
+	Quat(float x, float y, float z, float w) :x(x), y(y), z(z), w(w) {}
+
+	//angle in radians, counterclockwise looking down the axis, which must be normalized
+	static Quat FromAxisAngle(const Vec3& axis, float angle)
+	{
+		float s = std::sin(angle * 0.5f);
+		return Quat(axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f));
+	}
+};
+
+struct Mat3
+{
+	Vec3 columns[3];
+
+	Mat3() { columns[0] = Vec3(1.0f, 0.0f, 0.0f); columns[1] = Vec3(0.0f, 1.0f, 0.0f); columns[2] = Vec3(0.0f, 0.0f, 1.0f); }
+	Mat3(const Vec3& c0, const Vec3& c1, const Vec3& c2) { columns[0] = c0; columns[1] = c1; columns[2] = c2; }
+
+	static Mat3 Identity() { return Mat3(); }
+	static Mat3 Rotation(const Quat& q);
+
+	const float* data() const { return &columns[0].x; }
+};
+
+struct Mat4
+{
+	Vec4 columns[4];
+
+	Mat4() { columns[0] = Vec4(1.0f, 0.0f, 0.0f, 0.0f); columns[1] = Vec4(0.0f, 1.0f, 0.0f, 0.0f); columns[2] = Vec4(0.0f, 0.0f, 1.0f, 0.0f); columns[3] = Vec4(0.0f, 0.0f, 0.0f, 1.0f); }
+	Mat4(const Vec4& c0, const Vec4& c1, const Vec4& c2, const Vec4& c3) { columns[0] = c0; columns[1] = c1; columns[2] = c2; columns[3] = c3; }
+
+	static Mat4 Identity() { return Mat4(); }
+	static Mat4 Translation(const Vec3& t);
+	static Mat4 Scale(const Vec3& s);
+	static Mat4 Rotation(const Quat& q);
+
+	//translation * rotation * scale, how most scene nodes are described
+	static Mat4 FromTRS(const Vec3& translation, const Quat& rotation, const Vec3& scale);
+
+	//Right handed, looking down -z, depth mapped to [-1, 1] like glOrtho and gluPerspective; fovY in radians
+	static Mat4 Perspective(float fovY, float aspect, float zNear, float zFar);
+	static Mat4 Orthographic(float left, float right, float bottom, float top, float zNear, float zFar);
+	static Mat4 LookAt(const Vec3& eye, const Vec3& target, const Vec3& up);
+
+	//16 floats for glUniformMatrix4fv with transpose = GL_FALSE, and for ExtractFrustum()
+	const float* data() const { return &columns[0].x; }
+	float* data() { return &columns[0].x; }
+};
+
+//Vec2
+inline Vec2 operator+(const Vec2& a, const Vec2& b) { return Vec2(a.x + b.x, a.y + b.y); }
+inline Vec2 operator-(const Vec2& a, const Vec2& b) { return Vec2(a.x - b.x, a.y - b.y); }
+inline Vec2 operator-(const Vec2& a) { return Vec2(-a.x, -a.y); }
+inline Vec2 operator*(const Vec2& a, const Vec2& b) { return Vec2(a.x * b.x, a.y * b.y); }
+inline Vec2 operator*(const Vec2& a, float s) { return Vec2(a.x * s, a.y * s); }
+inline Vec2 operator*(float s, const Vec2& a) { return a * s; }
+inline Vec2 operator/(const Vec2& a, float s) { return a * (1.0f / s); }
+inline Vec2& operator+=(Vec2& a, const Vec2& b) { return a = a + b; }
+inline Vec2& operator-=(Vec2& a, const Vec2& b) { return a = a - b; }
+inline Vec2& operator*=(Vec2& a, float s) { return a = a * s; }
+inline float Dot(const Vec2& a, const Vec2& b) { return a.x * b.x + a.y * b.y; }
+inline float Length(const Vec2& a) { return std::sqrt(Dot(a, a)); }
+inline Vec2 Normalize(const Vec2& a) { return a / Length(a); }
+inline Vec2 Lerp(const Vec2& a, const Vec2& b, float t) { return a + (b - a) * t; }
+
+//Vec3
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator-(const Vec3& a) { return Vec3(-a.x, -a.y, -a.z); }
+inline Vec3 operator*(const Vec3& a, const Vec3& b) { return Vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline Vec3 operator*(const Vec3& a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator*(float s, const Vec3& a) { return a * s; }
+inline Vec3 operator/(const Vec3& a, float s) { return a * (1.0f / s); }
+inline Vec3& operator+=(Vec3& a, const Vec3& b) { return a = a + b; }
+inline Vec3& operator-=(Vec3& a, const Vec3& b) { return a = a - b; }
+inline Vec3& operator*=(Vec3& a, float s) { return a = a * s; }
+inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross(const Vec3& a, const Vec3& b) { return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+inline float Length(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+inline Vec3 Normalize(const Vec3& a) { return a / Length(a); }
+inline Vec3 Lerp(const Vec3& a, const Vec3& b, float t) { return a + (b - a) * t; }
+
+//Vec4
+inline Vec4 operator+(const Vec4& a, const Vec4& b) { return Vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+inline Vec4 operator-(const Vec4& a, const Vec4& b) { return Vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
+inline Vec4 operator-(const Vec4& a) { return Vec4(-a.x, -a.y, -a.z, -a.w); }
+inline Vec4 operator*(const Vec4& a, const Vec4& b) { return Vec4(a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w); }
+inline Vec4 operator*(const Vec4& a, float s) { return Vec4(a.x * s, a.y * s, a.z * s, a.w * s); }
+inline Vec4 operator*(float s, const Vec4& a) { return a * s; }
+inline Vec4 operator/(const Vec4& a, float s) { return a * (1.0f / s); }
+inline Vec4& operator+=(Vec4& a, const Vec4& b) { return a = a + b; }
+inline Vec4& operator-=(Vec4& a, const Vec4& b) { return a = a - b; }
+inline Vec4& operator*=(Vec4& a, float s) { return a = a * s; }
+inline float Dot(const Vec4& a, const Vec4& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+inline float Length(const Vec4& a) { return std::sqrt(Dot(a, a)); }
+inline Vec4 Normalize(const Vec4& a) { return a / Length(a); }
+inline Vec4 Lerp(const Vec4& a, const Vec4& b, float t) { return a + (b - a) * t; }
+
+//Quat
+inline Quat operator*(const Quat& a, const Quat& b)
+{
+	return Quat(a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+inline float Dot(const Quat& a, const Quat& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+inline Quat Conjugate(const Quat& q) { return Quat(-q.x, -q.y, -q.z, q.w); }
+inline Quat Normalize(const Quat& q)
+{
+	float s = 1.0f / std::sqrt(Dot(q, q));
+	return Quat(q.x * s, q.y * s, q.z * s, q.w * s);
+}
+
+//v rotated by q
+inline Vec3 Rotate(const Quat& q, const Vec3& v)
+{
+	Vec3 u(q.x, q.y, q.z);
+	Vec3 t = Cross(u, v) * 2.0f;
+	return v + t * q.w + Cross(u, t);
+}
+
+//Shortest path interpolation, constant angular speed
+Quat Slerp(const Quat& a, const Quat& b, float t);
+
+//Mat3
+inline Vec3 operator*(const Mat3& m, const Vec3& v)
+{
+	return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z;
+}
+inline Mat3 operator*(const Mat3& a, const Mat3& b)
+{
+	return Mat3(a * b.columns[0], a * b.columns[1], a * b.columns[2]);
+}
+Mat3 Transpose(const Mat3& m);
+float Determinant(const Mat3& m);
+Mat3 Inverse(const Mat3& m);
+
+//Mat4
+inline Vec4 operator*(const Mat4& m, const Vec4& v)
+{
+	return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+}
+inline Mat4 operator*(const Mat4& a, const Mat4& b)
+{
+	return Mat4(a * b.columns[0], a * b.columns[1], a * b.columns[2], a * b.columns[3]);
+}
+
+//m * (p, 1) without the divide by w, for affine matrices
+inline Vec3 TransformPoint(const Mat4& m, const Vec3& p)
+{
+	return (m.columns[0] * p.x + m.columns[1] * p.y + m.columns[2] * p.z + m.columns[3]).xyz();
+}
+
+//m * (v, 0), directions don't move
+inline Vec3 TransformVector(const Mat4& m, const Vec3& v)
+{
+	return (m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z).xyz();
+}
+
+Mat4 Transpose(const Mat4& m);
+
+//General inverse, the identity when m is singular
+Mat4 Inverse(const Mat4& m);
+
+//Inverse of a matrix whose last row is 0 0 0 1, cheaper than Inverse()
+Mat4 InverseAffine(const Mat4& m);
+
+//Upper left 3x3, and the matrix for normals: the inverse transpose of that
+Mat3 UpperLeft(const Mat4& m);
+Mat3 NormalMatrix(const Mat4& m);
+
+//Batches
+//Points are structure of arrays, x, y and z each in their own array, so a register holds the same coordinate of
+//4, 8 or 16 points; in and out may be the same arrays
+struct MathKernels
+{
+	//out = m * (x, y, z, 1) without the divide by w
+	void (*transformPoints)(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+		float* outX, float* outY, float* outZ);
+
+	//out = m * (x, y, z, 0)
+	void (*transformVectors)(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count,
+		float* outX, float* outY, float* outZ);
+
+	//out[i] = a[i] * b[i], out may be a or b
+	void (*multiplyMatrices)(const Mat4* a, const Mat4* b, unsigned int count, Mat4* out);
+
+	//out[i] = a * b[i], what transforming many local matrices into one space comes down to
+	void (*multiplyMatrix)(const Mat4& a, const Mat4* b, unsigned int count, Mat4* out);
+};
+
+MathKernels GetMathKernels(SimdLevel level);
+
+//The kernels of GetSimdLevel(), on the calling thread
+void TransformPoints(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count, float* outX, float* outY, float* outZ);
+void TransformVectors(const Mat4& m, const float* x, const float* y, const float* z, unsigned int count, float* outX, float* outY, float* outZ);
+void MultiplyMatrices(const Mat4* a, const Mat4* b, unsigned int count, Mat4* out);
+void MultiplyMatrices(const Mat4& a, const Mat4* b, unsigned int count, Mat4* out);
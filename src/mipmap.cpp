@@ -0,0 +1,398 @@
+#include "mipmap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "thread_pool.h"
+
+//no filter here gets close, a Kaiser kernel over an odd 3:1 reduction is the widest at 13
+static const unsigned int MAX_TAPS = 32;
+
+static const float KAISER_ALPHA = 4.0f;
+static const float KAISER_RADIUS = 2.0f; //in destination pixels
+
+//Lookup tables between 8 bit codes and linear values, built once
+struct ColorTables
+{
+	float srgbToLinear[256];
+	float codeToLinear[256];
+	unsigned char linearToSrgb[65536 + 4]; //+4 so a 32 bit gather of the last entry stays inside
+	unsigned char linearToCode[65536 + 4];
+
+	ColorTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			codeToLinear[i] = c;
+		}
+		for (int i = 0; i <= 65535; i++)
+		{
+			float v = i / 65535.0f;
+			float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+			linearToSrgb[i] = (unsigned char)(std::min(1.0f, s) * 255.0f + 0.5f);
+			linearToCode[i] = (unsigned char)(v * 255.0f + 0.5f);
+		}
+		std::memset(linearToSrgb + 65536, 0, 4);
+		std::memset(linearToCode + 65536, 0, 4);
+	}
+};
+
+static const ColorTables& GetColorTables()
+{
+	static ColorTables tables;
+	return tables;
+}
+
+unsigned int MipLevelCount(unsigned int width, unsigned int height)
+{
+	unsigned int levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+		levels++;
+	}
+	return levels;
+}
+
+static double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x * 0.5 / k) * (x * 0.5 / k);
+		sum += term;
+	}
+	return sum;
+}
+
+//weight of a source pixel at distance x from the destination pixel's center, x in destination pixels
+static double KaiserWeight(double x)
+{
+	if (std::fabs(x) >= KAISER_RADIUS)
+		return 0.0;
+
+	const double pi = 3.14159265358979323846;
+	double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+	double t = x / KAISER_RADIUS;
+	return sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / BesselI0(KAISER_ALPHA);
+}
+
+void BuildMipFilterTable(MipFilter filter, unsigned int sourceSize, unsigned int destinationSize, MipFilterTable& table)
+{
+	double scale = (double)sourceSize / destinationSize;
+	double support = filter == MipFilter::Box ? 0.5 * scale : KAISER_RADIUS * scale; //in source pixels
+
+	//weights per destination pixel, source indices clamped to the edge like GL_CLAMP_TO_EDGE
+	std::vector<std::vector<double>> weights(destinationSize);
+	std::vector<int> lowest(destinationSize);
+	unsigned int taps = 1;
+	for (unsigned int d = 0; d < destinationSize; d++)
+	{
+		double center = (d + 0.5) * scale;
+		int begin = (int)std::floor(center - support), end = (int)std::ceil(center + support);
+		int low = std::max(0, std::min(begin, (int)sourceSize - 1));
+		int high = std::max(0, std::min(end - 1, (int)sourceSize - 1));
+		std::vector<double>& w = weights[d];
+		w.assign(high - low + 1, 0.0);
+
+		double total = 0.0;
+		for (int s = begin; s < end; s++)
+		{
+			double weight;
+			if (filter == MipFilter::Box)
+				weight = std::max(0.0, std::min(s + 1.0, center + support) - std::max((double)s, center - support));
+			else
+				weight = KaiserWeight((s + 0.5 - center) / scale);
+			w[std::max(low, std::min(s, high)) - low] += weight;
+			total += weight;
+		}
+		for (double& weight : w)
+			weight /= total;
+
+		lowest[d] = low;
+		taps = std::max(taps, (unsigned int)w.size());
+	}
+
+	taps = std::min(std::min(taps, sourceSize), MAX_TAPS);
+	table.taps = taps;
+	table.first.resize(destinationSize);
+	table.weights.assign((size_t)destinationSize * taps, 0.0f);
+	for (unsigned int d = 0; d < destinationSize; d++)
+	{
+		unsigned int first = std::min((unsigned int)lowest[d], sourceSize - taps);
+		table.first[d] = first;
+		for (unsigned int i = 0; i < weights[d].size(); i++)
+		{
+			unsigned int tap = lowest[d] + i - first;
+			if (tap < taps)
+				table.weights[(size_t)d * taps + tap] = (float)weights[d][i];
+		}
+	}
+}
+
+static void ToLinearScalar(const unsigned int* source, unsigned int count, const float* colorTable, float* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int p = source[i];
+		float alpha = (p >> 24) * (1.0f / 255.0f);
+		out[i * 4 + 0] = colorTable[p & 0xFF] * alpha;
+		out[i * 4 + 1] = colorTable[(p >> 8) & 0xFF] * alpha;
+		out[i * 4 + 2] = colorTable[(p >> 16) & 0xFF] * alpha;
+		out[i * 4 + 3] = alpha;
+	}
+}
+
+static void FromLinearScalar(const float* source, unsigned int count, const unsigned char* colorTable, unsigned int* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const float* p = source + i * 4;
+		float alpha = std::min(1.0f, std::max(0.0f, p[3]));
+		unsigned int pixel = (unsigned int)(alpha * 255.0f + 0.5f) << 24;
+		if (alpha > 0.0f)
+			for (int c = 0; c < 3; c++)
+			{
+				float v = std::min(1.0f, std::max(0.0f, p[c] / alpha));
+				pixel |= (unsigned int)colorTable[(int)(v * 65535.0f + 0.5f)] << (c * 8);
+			}
+		out[i] = pixel;
+	}
+}
+
+static void FilterRowScalar(const float* source, const MipFilterTable& table, unsigned int width, float* out)
+{
+	for (unsigned int d = 0; d < width; d++)
+	{
+		const float* weights = &table.weights[(size_t)d * table.taps];
+		const float* pixel = source + table.first[d] * 4;
+		float sum[4] = {};
+		for (unsigned int t = 0; t < table.taps; t++)
+			for (int c = 0; c < 4; c++)
+				sum[c] += weights[t] * pixel[t * 4 + c];
+		std::memcpy(out + d * 4, sum, sizeof(sum));
+	}
+}
+
+static void FilterColumnsScalar(const float* const* rows, const float* weights, unsigned int taps, unsigned int count, float* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (unsigned int t = 0; t < taps; t++)
+			sum += weights[t] * rows[t][i];
+		out[i] = std::min(1.0f, std::max(0.0f, sum));
+	}
+}
+
+#if SIMD_X86
+static void FilterRowSSE2(const float* source, const MipFilterTable& table, unsigned int width, float* out)
+{
+	//one RGBA pixel per register
+	for (unsigned int d = 0; d < width; d++)
+	{
+		const float* weights = &table.weights[(size_t)d * table.taps];
+		const float* pixel = source + table.first[d] * 4;
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned int t = 0; t < table.taps; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(pixel + t * 4)));
+		_mm_storeu_ps(out + d * 4, sum);
+	}
+}
+
+static void FilterColumnsSSE2(const float* const* rows, const float* weights, unsigned int taps, unsigned int count, float* out)
+{
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned int t = 0; t < taps; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+		_mm_storeu_ps(out + i, _mm_min_ps(one, _mm_max_ps(zero, sum)));
+	}
+	for (; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (unsigned int t = 0; t < taps; t++)
+			sum += weights[t] * rows[t][i];
+		out[i] = std::min(1.0f, std::max(0.0f, sum));
+	}
+}
+
+static void ToLinearSSE2(const unsigned int* source, unsigned int count, const float* colorTable, float* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int p = source[i];
+		__m128 alpha = _mm_set1_ps((p >> 24) * (1.0f / 255.0f));
+		__m128 color = _mm_setr_ps(colorTable[p & 0xFF], colorTable[(p >> 8) & 0xFF], colorTable[(p >> 16) & 0xFF], 1.0f);
+		_mm_storeu_ps(out + i * 4, _mm_mul_ps(color, alpha));
+	}
+}
+
+static void FromLinearSSE2(const float* source, unsigned int count, const unsigned char* colorTable, unsigned int* out)
+{
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(65535.0f), half = _mm_set1_ps(0.5f);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		__m128 p = _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(source + i * 4)));
+		__m128 alpha = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3));
+		__m128 visible = _mm_cmpgt_ps(alpha, zero);
+		__m128 color = _mm_and_ps(visible, _mm_min_ps(one, _mm_div_ps(p, _mm_max_ps(alpha, _mm_set1_ps(1e-20f)))));
+
+		int index[4];
+		_mm_storeu_si128((__m128i*)index, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(color, scale), half)));
+		//hidden pixels have index 0, which both tables map to 0
+		unsigned int a = (unsigned int)(_mm_cvtss_f32(alpha) * 255.0f + 0.5f);
+		out[i] = (a << 24) | colorTable[index[0]] | (colorTable[index[1]] << 8) | (colorTable[index[2]] << 16);
+	}
+}
+
+SIMD_TARGET_AVX2
+static void FilterColumnsAVX2(const float* const* rows, const float* weights, unsigned int taps, unsigned int count, float* out)
+{
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (unsigned int t = 0; t < taps; t++)
+			sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + i), sum);
+		_mm256_storeu_ps(out + i, _mm256_min_ps(one, _mm256_max_ps(zero, sum)));
+	}
+	for (; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (unsigned int t = 0; t < taps; t++)
+			sum += weights[t] * rows[t][i];
+		out[i] = std::min(1.0f, std::max(0.0f, sum));
+	}
+}
+
+//two pixels per register, the color channels are gathered from the table
+SIMD_TARGET_AVX2
+static void ToLinearAVX2(const unsigned int* source, unsigned int count, const float* colorTable, float* out)
+{
+	const __m256 inv255 = _mm256_set1_ps(1.0f / 255.0f);
+	unsigned int i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256i codes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + i)));
+		__m256 color = _mm256_i32gather_ps(colorTable, codes, 4);
+		__m256 alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(codes), inv255);
+		alpha = _mm256_permute_ps(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm256_storeu_ps(out + i * 4, _mm256_blend_ps(_mm256_mul_ps(color, alpha), alpha, 0x88));
+	}
+	ToLinearScalar(source + i, count - i, colorTable, out + i * 4);
+}
+
+SIMD_TARGET_AVX2
+static void FromLinearAVX2(const float* source, unsigned int count, const unsigned char* colorTable, unsigned int* out)
+{
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f);
+	const __m256 scale = _mm256_setr_ps(65535.0f, 65535.0f, 65535.0f, 255.0f, 65535.0f, 65535.0f, 65535.0f, 255.0f);
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	unsigned int i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256 p = _mm256_min_ps(one, _mm256_max_ps(zero, _mm256_loadu_ps(source + i * 4)));
+		__m256 alpha = _mm256_permute_ps(p, _MM_SHUFFLE(3, 3, 3, 3));
+		__m256 visible = _mm256_cmp_ps(alpha, zero, _CMP_GT_OQ);
+		__m256 color = _mm256_and_ps(visible, _mm256_min_ps(one, _mm256_div_ps(p, _mm256_max_ps(alpha, _mm256_set1_ps(1e-20f)))));
+		color = _mm256_blend_ps(color, alpha, 0x88);
+
+		__m256i index = _mm256_cvttps_epi32(_mm256_fmadd_ps(color, scale, half));
+		__m256i codes = _mm256_and_si256(_mm256_i32gather_epi32((const int*)colorTable, index, 1), byteMask);
+		codes = _mm256_blend_epi32(codes, index, 0x88); //alpha is already a code
+
+		__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(codes, codes), _mm256_setzero_si256());
+		out[i] = (unsigned int)_mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+		out[i + 1] = (unsigned int)_mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+	}
+	FromLinearScalar(source + i * 4, count - i, colorTable, out + i);
+}
+#endif
+
+MipKernels GetMipKernels(SimdLevel level)
+{
+	MipKernels kernels = { ToLinearScalar, FromLinearScalar, FilterRowScalar, FilterColumnsScalar };
+#if SIMD_X86
+	if (level >= SimdLevel::SSE2)
+	{
+		kernels.toLinear = ToLinearSSE2;
+		kernels.fromLinear = FromLinearSSE2;
+		kernels.filterRow = FilterRowSSE2;
+		kernels.filterColumns = FilterColumnsSSE2;
+	}
+	if (level >= SimdLevel::AVX2)
+	{
+		kernels.toLinear = ToLinearAVX2;
+		kernels.fromLinear = FromLinearAVX2;
+		kernels.filterColumns = FilterColumnsAVX2;
+	}
+#endif
+	return kernels;
+}
+
+void GenerateMipmaps(const Image& source, const MipOptions& options, std::vector<Image>& levels)
+{
+	levels.clear();
+	levels.push_back(source);
+	if (source.width == 0 || source.height == 0)
+		return;
+
+	const ColorTables& tables = GetColorTables();
+	const float* toLinearTable = options.srgb ? tables.srgbToLinear : tables.codeToLinear;
+	const unsigned char* fromLinearTable = options.srgb ? tables.linearToSrgb : tables.linearToCode;
+	MipKernels kernels = GetMipKernels(GetSimdLevel());
+	ThreadPool& pool = GetThreadPool();
+
+	unsigned int width = source.width, height = source.height;
+	std::vector<float> current((size_t)width * height * 4), filtered, next;
+	pool.parallelFor(height, 16, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int y = begin; y < end; y++)
+			kernels.toLinear(&source.pixels[(size_t)y * width], width, toLinearTable, &current[(size_t)y * width * 4]);
+	});
+
+	MipFilterTable horizontal, vertical;
+	unsigned int levelCount = MipLevelCount(width, height);
+	for (unsigned int level = 1; level < levelCount; level++)
+	{
+		unsigned int levelWidth = std::max(1u, width / 2), levelHeight = std::max(1u, height / 2);
+		BuildMipFilterTable(options.filter, width, levelWidth, horizontal);
+		BuildMipFilterTable(options.filter, height, levelHeight, vertical);
+
+		//horizontal pass over every source row, then the vertical pass combines rows of that
+		filtered.resize((size_t)levelWidth * height * 4);
+		pool.parallelFor(height, 8, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int y = begin; y < end; y++)
+				kernels.filterRow(&current[(size_t)y * width * 4], horizontal, levelWidth, &filtered[(size_t)y * levelWidth * 4]);
+		});
+
+		next.resize((size_t)levelWidth * levelHeight * 4);
+		Image image(levelWidth, levelHeight);
+		pool.parallelFor(levelHeight, 8, [&](unsigned int begin, unsigned int end)
+		{
+			const float* rows[MAX_TAPS];
+			for (unsigned int y = begin; y < end; y++)
+			{
+				for (unsigned int t = 0; t < vertical.taps; t++)
+					rows[t] = &filtered[(size_t)(vertical.first[y] + t) * levelWidth * 4];
+
+				float* out = &next[(size_t)y * levelWidth * 4];
+				kernels.filterColumns(rows, &vertical.weights[(size_t)y * vertical.taps], vertical.taps, levelWidth * 4, out);
+				kernels.fromLinear(out, levelWidth, fromLinearTable, &image.pixels[(size_t)y * levelWidth]);
+			}
+		});
+
+		levels.push_back(std::move(image));
+		current.swap(next);
+		width = levelWidth;
+		height = levelHeight;
+	}
+}
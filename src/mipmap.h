@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include "image.h"
+#include "simd.h"
+
+enum class MipFilter
+{
+	Box,   //average of the source pixels under each destination pixel, soft but never rings
+	Kaiser //Kaiser windowed sinc over 8 source pixels, keeps small map details sharp, may ring slightly at hard edges
+};
+
+struct MipOptions
+{
+	MipFilter filter = MipFilter::Box;
+	bool srgb = true; //color channels are sRGB encoded and get filtered as linear light, alpha is always linear
+};
+
+//Levels of a full chain down to 1x1
+unsigned int MipLevelCount(unsigned int width, unsigned int height);
+
+//Builds the mip chain of an RGBA8 image, levels[0] is a copy of source
+//Every level is a separable 2:1 reduction of the previous one, computed in floating point from the unrounded level
+//above so rounding doesn't add up; colors are weighted by alpha, so transparent pixels don't darken the edges of
+//opaque ones. Odd sizes round down, like GL
+//Rows of each level are filtered in parallel on the thread pool
+void GenerateMipmaps(const Image& source, const MipOptions& options, std::vector<Image>& levels);
+
+//Contributions of the source pixels to every destination pixel along one axis
+struct MipFilterTable
+{
+	unsigned int taps;          //weights per destination pixel, the same for all of them
+	std::vector<unsigned int> first; //first source pixel of each destination pixel, clamped so taps stay in bounds
+	std::vector<float> weights; //[destination][tap]
+};
+
+void BuildMipFilterTable(MipFilter filter, unsigned int sourceSize, unsigned int destinationSize, MipFilterTable& table);
+
+//Kernels behind GenerateMipmaps(), exposed for benchmarking
+//Pixels in float form are premultiplied linear RGBA, 4 floats each
+struct MipKernels
+{
+	//RGBA8 to float, colorTable maps the 256 codes of a color channel to linear values
+	void (*toLinear)(const unsigned int* source, unsigned int count, const float* colorTable, float* out);
+
+	//float back to RGBA8, colorTable maps a linear value v to table[(int)(v * 65535 + 0.5)]
+	void (*fromLinear)(const float* source, unsigned int count, const unsigned char* colorTable, unsigned int* out);
+
+	//one destination row from a source row
+	void (*filterRow)(const float* source, const MipFilterTable& table, unsigned int width, float* out);
+
+	//out[i] = sum of weights[t] * rows[t][i], clamped to [0, 1], for count floats
+	void (*filterColumns)(const float* const* rows, const float* weights, unsigned int taps, unsigned int count, float* out);
+};
+
+MipKernels GetMipKernels(SimdLevel level);
@@ -0,0 +1,431 @@
+#include "occlusion_culling.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+const int OcclusionCuller::SUBPIXEL_BITS;
+const int OcclusionCuller::TILE_SIZE;
+
+//vertices closer to the eye plane than this can't be projected
+static const float MIN_W = 1e-5f;
+
+//occluders are skipped beyond this many viewports around the screen so fixed point coordinates can't overflow
+static const float GUARD_BAND = 8.0f;
+
+static const int BLOCK_PIXELS = RASTER_BLOCK_SIZE * RASTER_BLOCK_SIZE;
+
+static float UpdateBlockScalar(float* depth, unsigned long long mask, float z)
+{
+	float farthest = std::numeric_limits<float>::lowest();
+	for (int i = 0; i < BLOCK_PIXELS; i++)
+	{
+		if (((mask >> i) & 1) && z < depth[i])
+			depth[i] = z;
+		farthest = std::max(farthest, depth[i]);
+	}
+	return farthest;
+}
+
+static unsigned long long VisibleMaskScalar(const float* depth, float z)
+{
+	unsigned long long mask = 0;
+	for (int i = 0; i < BLOCK_PIXELS; i++)
+		if (depth[i] >= z)
+			mask |= 1ull << i;
+	return mask;
+}
+
+#if SIMD_X86
+static float HorizontalMax(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+static float UpdateBlockSSE2(float* depth, unsigned long long mask, float z)
+{
+	const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+	__m128 vz = _mm_set1_ps(z);
+	__m128 farthest = _mm_set1_ps(std::numeric_limits<float>::lowest());
+	for (int i = 0; i < BLOCK_PIXELS; i += 4)
+	{
+		//one mask bit per lane -> all ones in the lanes that are covered
+		__m128i laneBits = _mm_and_si128(_mm_set1_epi32((int)((mask >> i) & 15)), bits);
+		__m128 covered = _mm_castsi128_ps(_mm_cmpeq_epi32(laneBits, bits));
+		__m128 d = _mm_load_ps(depth + i);
+		d = _mm_or_ps(_mm_and_ps(covered, _mm_min_ps(d, vz)), _mm_andnot_ps(covered, d));
+		_mm_store_ps(depth + i, d);
+		farthest = _mm_max_ps(farthest, d);
+	}
+	return HorizontalMax(farthest);
+}
+
+static unsigned long long VisibleMaskSSE2(const float* depth, float z)
+{
+	__m128 vz = _mm_set1_ps(z);
+	unsigned long long mask = 0;
+	for (int i = 0; i < BLOCK_PIXELS; i += 4)
+		mask |= (unsigned long long)_mm_movemask_ps(_mm_cmpge_ps(_mm_load_ps(depth + i), vz)) << i;
+	return mask;
+}
+
+SIMD_TARGET_AVX2
+static float UpdateBlockAVX2(float* depth, unsigned long long mask, float z)
+{
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256 vz = _mm256_set1_ps(z);
+	__m256 farthest = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+	for (int i = 0; i < BLOCK_PIXELS; i += 8)
+	{
+		__m256i laneBits = _mm256_and_si256(_mm256_set1_epi32((int)((mask >> i) & 0xFF)), bits);
+		__m256 covered = _mm256_castsi256_ps(_mm256_cmpeq_epi32(laneBits, bits));
+		__m256 d = _mm256_load_ps(depth + i);
+		d = _mm256_blendv_ps(d, _mm256_min_ps(d, vz), covered);
+		_mm256_store_ps(depth + i, d);
+		farthest = _mm256_max_ps(farthest, d);
+	}
+	return HorizontalMax(_mm_max_ps(_mm256_castps256_ps128(farthest), _mm256_extractf128_ps(farthest, 1)));
+}
+
+SIMD_TARGET_AVX2
+static unsigned long long VisibleMaskAVX2(const float* depth, float z)
+{
+	__m256 vz = _mm256_set1_ps(z);
+	unsigned long long mask = 0;
+	for (int i = 0; i < BLOCK_PIXELS; i += 8)
+		mask |= (unsigned long long)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(depth + i), vz, _CMP_GE_OQ)) << i;
+	return mask;
+}
+
+SIMD_TARGET_AVX512
+static float UpdateBlockAVX512(float* depth, unsigned long long mask, float z)
+{
+	__m512 vz = _mm512_set1_ps(z);
+	__m512 farthest = _mm512_set1_ps(std::numeric_limits<float>::lowest());
+	for (int i = 0; i < BLOCK_PIXELS; i += 16)
+	{
+		__m512 d = _mm512_load_ps(depth + i);
+		d = _mm512_mask_min_ps(d, (__mmask16)(mask >> i), d, vz);
+		_mm512_store_ps(depth + i, d);
+		farthest = _mm512_max_ps(farthest, d);
+	}
+	return _mm512_reduce_max_ps(farthest);
+}
+
+SIMD_TARGET_AVX512
+static unsigned long long VisibleMaskAVX512(const float* depth, float z)
+{
+	__m512 vz = _mm512_set1_ps(z);
+	unsigned long long mask = 0;
+	for (int i = 0; i < BLOCK_PIXELS; i += 16)
+		mask |= (unsigned long long)_mm512_cmp_ps_mask(_mm512_load_ps(depth + i), vz, _CMP_GE_OQ) << i;
+	return mask;
+}
+#endif
+
+OcclusionKernels GetOcclusionKernels(SimdLevel level)
+{
+	OcclusionKernels kernels = { UpdateBlockScalar, VisibleMaskScalar };
+#if SIMD_X86
+	if (level >= SimdLevel::AVX512)
+	{
+		kernels.updateBlock = UpdateBlockAVX512;
+		kernels.visibleMask = VisibleMaskAVX512;
+	}
+	else if (level >= SimdLevel::AVX2)
+	{
+		kernels.updateBlock = UpdateBlockAVX2;
+		kernels.visibleMask = VisibleMaskAVX2;
+	}
+	else if (level >= SimdLevel::SSE2)
+	{
+		kernels.updateBlock = UpdateBlockSSE2;
+		kernels.visibleMask = VisibleMaskSSE2;
+	}
+#endif
+	return kernels;
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+	:m_width(width), m_height(height)
+{
+	m_blocksX = (width + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+	m_blocksY = (height + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+	m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	m_depth.resize(m_blocksX * m_blocksY * BLOCK_PIXELS);
+	m_blockMax.resize(m_blocksX * m_blocksY);
+	m_tileMax.resize(m_tilesX * m_tilesY);
+	m_bins.resize(m_tilesX * m_tilesY);
+
+	static const float IDENTITY[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	beginFrame(IDENTITY);
+}
+
+void OcclusionCuller::beginFrame(const float* viewProjection)
+{
+	std::memcpy(m_viewProjection, viewProjection, sizeof(m_viewProjection));
+	std::fill(m_depth.data(), m_depth.data() + m_depth.size(), 1.0f);
+	std::fill(m_blockMax.begin(), m_blockMax.end(), 1.0f);
+	std::fill(m_tileMax.begin(), m_tileMax.end(), 1.0f);
+	m_triangles.clear();
+	std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+static void TransformPoint(const float* m, float x, float y, float z, float* out)
+{
+	for (int i = 0; i < 4; i++)
+		out[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+}
+
+void OcclusionCuller::addTriangle(const float* a, const float* b, const float* c)
+{
+	m_stats.occluderTriangles++;
+
+	const float* clip[3] = { a, b, c };
+	const float scale = (float)(1 << SUBPIXEL_BITS);
+	OccluderTriangle tri;
+	float z[3];
+	for (int k = 0; k < 3; k++)
+	{
+		if (clip[k][3] < MIN_W)
+			return;
+
+		float inverseW = 1.0f / clip[k][3];
+		float x = clip[k][0] * inverseW, y = clip[k][1] * inverseW;
+		if (std::fabs(x) > GUARD_BAND || std::fabs(y) > GUARD_BAND)
+			return;
+
+		tri.x[k] = (int)std::lround((x * 0.5f + 0.5f) * m_width * scale);
+		tri.y[k] = (int)std::lround((y * 0.5f + 0.5f) * m_height * scale);
+		z[k] = clip[k][2] * inverseW * 0.5f + 0.5f;
+	}
+
+	long long area = (long long)(tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (long long)(tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+	if (area == 0)
+		return;
+	if (area < 0)
+	{
+		//both windings occlude, clockwise triangles are flipped to counter-clockwise
+		std::swap(tri.x[1], tri.x[2]);
+		std::swap(tri.y[1], tri.y[2]);
+		std::swap(z[1], z[2]);
+	}
+
+	SetupRasterEdges(tri.x, tri.y, SUBPIXEL_BITS, tri.edges);
+	if (!RasterBounds(tri.x, tri.y, SUBPIXEL_BITS, (int)m_width, (int)m_height, tri.minX, tri.minY, tri.maxX, tri.maxY))
+		return;
+
+	//depth is linear in screen space, solve for its plane in pixel units
+	double x0 = tri.x[0] / (double)scale, y0 = tri.y[0] / (double)scale;
+	double x1 = tri.x[1] / (double)scale - x0, y1 = tri.y[1] / (double)scale - y0;
+	double x2 = tri.x[2] / (double)scale - x0, y2 = tri.y[2] / (double)scale - y0;
+	double z1 = (double)z[1] - z[0], z2 = (double)z[2] - z[0];
+	double determinant = x1 * y2 - x2 * y1;
+	double dzdx = (z1 * y2 - z2 * y1) / determinant;
+	double dzdy = (x1 * z2 - x2 * z1) / determinant;
+	tri.zPlane[0] = (float)dzdx;
+	tri.zPlane[1] = (float)dzdy;
+	tri.zPlane[2] = (float)(z[0] - dzdx * x0 - dzdy * y0);
+	tri.maxZ = std::max(z[0], std::max(z[1], z[2]));
+
+	m_triangles.push_back(tri);
+}
+
+void OcclusionCuller::addOccluder(const float* positions, unsigned int stride, const unsigned int* indices, unsigned int indexCount)
+{
+	if (indexCount < 3)
+		return;
+
+	//every referenced vertex is transformed once
+	unsigned int vertexCount = *std::max_element(indices, indices + indexCount) + 1;
+	std::vector<float> clip(vertexCount * 4);
+	const unsigned char* data = (const unsigned char*)positions;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const float* p = (const float*)(data + i * stride);
+		TransformPoint(m_viewProjection, p[0], p[1], p[2], &clip[i * 4]);
+	}
+
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+		addTriangle(&clip[indices[i] * 4], &clip[indices[i + 1] * 4], &clip[indices[i + 2] * 4]);
+}
+
+void OcclusionCuller::addOccluder(const AABB& box)
+{
+	static const unsigned int BOX_INDICES[36] =
+	{
+		0, 1, 3, 0, 3, 2, //-x
+		4, 6, 7, 4, 7, 5, //+x
+		0, 4, 5, 0, 5, 1, //-y
+		2, 3, 7, 2, 7, 6, //+y
+		0, 2, 6, 0, 6, 4, //-z
+		1, 5, 7, 1, 7, 3  //+z
+	};
+
+	//corner i takes max on axis k when bit (2 - k) is set
+	float corners[8][3];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i][0] = (i & 4) ? box.max[0] : box.min[0];
+		corners[i][1] = (i & 2) ? box.max[1] : box.min[1];
+		corners[i][2] = (i & 1) ? box.max[2] : box.min[2];
+	}
+	addOccluder(&corners[0][0], sizeof(corners[0]), BOX_INDICES, 36);
+}
+
+void OcclusionCuller::rasterizeTile(unsigned int tile, const OcclusionKernels& kernels)
+{
+	int tileX = (int)(tile % m_tilesX) * TILE_SIZE;
+	int tileY = (int)(tile / m_tilesX) * TILE_SIZE;
+	int tileMaxX = std::min(tileX + TILE_SIZE, (int)m_width) - 1;
+	int tileMaxY = std::min(tileY + TILE_SIZE, (int)m_height) - 1;
+
+	BlockCoverageFn coverage = GetBlockCoverageFn(GetSimdLevel());
+	CoverageBlock blocks[(TILE_SIZE / RASTER_BLOCK_SIZE) * (TILE_SIZE / RASTER_BLOCK_SIZE)];
+
+	//min() doesn't care about order, so the triangles of a tile can go in any order
+	for (unsigned int t : m_bins[tile])
+	{
+		const OccluderTriangle& tri = m_triangles[t];
+		int minX = std::max(tri.minX, tileX), maxX = std::min(tri.maxX, tileMaxX);
+		int minY = std::max(tri.minY, tileY), maxY = std::min(tri.maxY, tileMaxY);
+
+		unsigned int blockCount = RasterizeBlocks(tri.edges, minX, minY, maxX, maxY, coverage, blocks);
+		for (unsigned int i = 0; i < blockCount; i++)
+		{
+			const CoverageBlock& block = blocks[i];
+			unsigned int index = (block.y / RASTER_BLOCK_SIZE) * m_blocksX + block.x / RASTER_BLOCK_SIZE;
+
+			//farthest depth of the triangle over the pixel centers of the block it can touch
+			float x0 = std::max(block.x, minX) + 0.5f, x1 = std::min(block.x + RASTER_BLOCK_SIZE - 1, maxX) + 0.5f;
+			float y0 = std::max(block.y, minY) + 0.5f, y1 = std::min(block.y + RASTER_BLOCK_SIZE - 1, maxY) + 0.5f;
+			float z = tri.zPlane[2] + std::max(tri.zPlane[0] * x0, tri.zPlane[0] * x1) + std::max(tri.zPlane[1] * y0, tri.zPlane[1] * y1);
+			z = std::min(z, tri.maxZ);
+
+			//nothing in the block is farther, the triangle can't change it
+			if (z >= m_blockMax[index])
+				continue;
+			m_blockMax[index] = kernels.updateBlock(&m_depth[index * BLOCK_PIXELS], block.mask, z);
+		}
+	}
+
+	float farthest = std::numeric_limits<float>::lowest();
+	for (int by = tileY / RASTER_BLOCK_SIZE; by <= tileMaxY / RASTER_BLOCK_SIZE; by++)
+		for (int bx = tileX / RASTER_BLOCK_SIZE; bx <= tileMaxX / RASTER_BLOCK_SIZE; bx++)
+			farthest = std::max(farthest, m_blockMax[by * m_blocksX + bx]);
+	m_tileMax[tile] = farthest;
+}
+
+void OcclusionCuller::rasterizeOccluders()
+{
+	for (std::vector<unsigned int>& bin : m_bins)
+		bin.clear();
+
+	for (unsigned int t = 0; t < (unsigned int)m_triangles.size(); t++)
+	{
+		const OccluderTriangle& tri = m_triangles[t];
+		for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++)
+			for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++)
+				m_bins[ty * m_tilesX + tx].push_back(t);
+	}
+	m_stats.rasterizedTriangles = (unsigned int)m_triangles.size();
+
+	OcclusionKernels kernels = GetOcclusionKernels(GetSimdLevel());
+	GetThreadPool().parallelFor(m_tilesX * m_tilesY, 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int tile = begin; tile < end; tile++)
+			rasterizeTile(tile, kernels);
+	});
+}
+
+bool OcclusionCuller::testBox(const AABB& box, const OcclusionKernels& kernels) const
+{
+	float minX = std::numeric_limits<float>::max(), minY = minX, nearest = minX;
+	float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+	for (int i = 0; i < 8; i++)
+	{
+		float clip[4];
+		TransformPoint(m_viewProjection, (i & 4) ? box.max[0] : box.min[0], (i & 2) ? box.max[1] : box.min[1],
+			(i & 1) ? box.max[2] : box.min[2], clip);
+
+		//boxes reaching behind the camera cover too much of the screen to bother
+		if (clip[3] < MIN_W)
+			return true;
+
+		float inverseW = 1.0f / clip[3];
+		float x = (clip[0] * inverseW * 0.5f + 0.5f) * m_width;
+		float y = (clip[1] * inverseW * 0.5f + 0.5f) * m_height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip[2] * inverseW * 0.5f + 0.5f);
+	}
+
+	//every pixel the projected box touches, not only the ones whose centers it covers
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width || minY >= (float)m_height)
+		return false;
+	int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min((int)m_width - 1, (int)std::floor(maxX));
+	int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min((int)m_height - 1, (int)std::floor(maxY));
+
+	for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++)
+		for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++)
+		{
+			if (nearest > m_tileMax[ty * m_tilesX + tx])
+				continue;
+
+			int bx0 = std::max(x0, tx * TILE_SIZE) / RASTER_BLOCK_SIZE, bx1 = std::min(x1, tx * TILE_SIZE + TILE_SIZE - 1) / RASTER_BLOCK_SIZE;
+			int by0 = std::max(y0, ty * TILE_SIZE) / RASTER_BLOCK_SIZE, by1 = std::min(y1, ty * TILE_SIZE + TILE_SIZE - 1) / RASTER_BLOCK_SIZE;
+			for (int by = by0; by <= by1; by++)
+				for (int bx = bx0; bx <= bx1; bx++)
+				{
+					unsigned int index = by * m_blocksX + bx;
+					if (nearest > m_blockMax[index])
+						continue;
+
+					unsigned long long inside = RasterRectMask(bx * RASTER_BLOCK_SIZE, by * RASTER_BLOCK_SIZE, x0, y0, x1, y1);
+					if (kernels.visibleMask(&m_depth[index * BLOCK_PIXELS], nearest) & inside)
+						return true;
+				}
+		}
+	return false;
+}
+
+bool OcclusionCuller::isVisible(const AABB& box) const
+{
+	return testBox(box, GetOcclusionKernels(GetSimdLevel()));
+}
+
+unsigned int OcclusionCuller::cullOccluded(const AABB* boxes, std::vector<unsigned int>& ids)
+{
+	unsigned int count = (unsigned int)ids.size();
+	m_visible.resize(count);
+
+	OcclusionKernels kernels = GetOcclusionKernels(GetSimdLevel());
+	GetThreadPool().parallelFor(count, 256, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			m_visible[i] = testBox(boxes[ids[i]], kernels) ? 1 : 0;
+	});
+
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < count; i++)
+		if (m_visible[i])
+			ids[kept++] = ids[i];
+	ids.resize(kept);
+
+	m_stats.tested = count;
+	m_stats.occluded = count - kept;
+	return kept;
+}
+
+float OcclusionCuller::depthAt(unsigned int x, unsigned int y) const
+{
+	unsigned int block = (y / RASTER_BLOCK_SIZE) * m_blocksX + x / RASTER_BLOCK_SIZE;
+	return m_depth[block * BLOCK_PIXELS + (y % RASTER_BLOCK_SIZE) * RASTER_BLOCK_SIZE + x % RASTER_BLOCK_SIZE];
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include "bounds.h"
+#include "raster_kernels.h"
+
+struct OcclusionStats
+{
+	unsigned int occluderTriangles;   //triangles added since beginFrame()
+	unsigned int rasterizedTriangles; //the ones that survived clipping and got rasterized
+	unsigned int tested;              //boxes tested by the last cullOccluded()
+	unsigned int occluded;            //boxes it removed
+};
+
+//Kernels behind OcclusionCuller, exposed for benchmarking
+//A block is 64 depths, bit (y * 8 + x) of a mask is pixel (x, y) of the block
+struct OcclusionKernels
+{
+	//depth = min(depth, z) on the pixels in mask, returns the farthest depth of the block afterwards
+	float (*updateBlock)(float* depth, unsigned long long mask, float z);
+
+	//bits of the pixels with depth >= z, the pixels an object at depth z would still be visible through
+	unsigned long long (*visibleMask)(const float* depth, float z);
+};
+
+OcclusionKernels GetOcclusionKernels(SimdLevel level);
+
+//Software occlusion culling against a low resolution depth buffer
+//Occluder triangles are rasterized with the coverage kernels of raster_kernels.h, the depth is stored in
+//8x8 pixel blocks of 64 floats with the farthest depth of every block and every TILE_SIZE tile kept on top of it
+//Tiles are rasterized in parallel and boxes are tested in parallel against that hierarchy
+//Occluder depth is rounded away from the camera and box depth toward it, coverage is sampled at pixel centers like
+//on the GPU, so a box can only be wrongly culled when it peeks past a silhouette by less than a pixel of this buffer
+class OcclusionCuller
+{
+private:
+	struct OccluderTriangle
+	{
+		int x[3], y[3];  //28.4 fixed point
+		RasterEdges edges;
+		int minX, minY, maxX, maxY;
+		float zPlane[3]; //depth = zPlane[0] * x + zPlane[1] * y + zPlane[2], x and y in pixels
+		float maxZ;
+	};
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_blocksX;
+	unsigned int m_blocksY;
+	unsigned int m_tilesX;
+	unsigned int m_tilesY;
+	float m_viewProjection[16];
+
+	AlignedArray<float> m_depth;  //[block][64]
+	std::vector<float> m_blockMax;
+	std::vector<float> m_tileMax;
+
+	std::vector<OccluderTriangle> m_triangles;
+	std::vector<std::vector<unsigned int>> m_bins; //tile -> triangle indices
+	std::vector<unsigned char> m_visible;          //scratch for cullOccluded()
+	OcclusionStats m_stats;
+
+	void addTriangle(const float* a, const float* b, const float* c);
+	void rasterizeTile(unsigned int tile, const OcclusionKernels& kernels);
+	bool testBox(const AABB& box, const OcclusionKernels& kernels) const;
+
+public:
+	static const int SUBPIXEL_BITS = 4;
+
+	//pixels per tile side, multiple of 8
+	static const int TILE_SIZE = 64;
+
+	//A quarter of the screen resolution or less is plenty, small occluders don't hide much anyway
+	OcclusionCuller(unsigned int width = 512, unsigned int height = 256);
+
+	//Clears the depth buffer and the occluders, viewProjection is column major like OpenGL
+	void beginFrame(const float* viewProjection);
+
+	//Adds the triangles of a mesh, positions are world space xyz found every stride bytes
+	//Triangles crossing the near plane or far outside the screen are skipped, which only makes culling less aggressive
+	void addOccluder(const float* positions, unsigned int stride, const unsigned int* indices, unsigned int indexCount);
+
+	//Adds a solid box, e.g. the bounds of a building
+	void addOccluder(const AABB& box);
+
+	//Rasterizes the occluders added since beginFrame()
+	void rasterizeOccluders();
+
+	//False when the box is hidden behind the occluders
+	bool isVisible(const AABB& box) const;
+
+	//Removes the ids of hidden boxes from ids, boxes is indexed by id
+	//ids is typically the output of CullingSystem::cull(), returns how many ids are left
+	unsigned int cullOccluded(const AABB* boxes, std::vector<unsigned int>& ids);
+
+	const OcclusionStats& getStats() const { return m_stats; }
+
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+
+	//Depth at a pixel, for debugging
+	float depthAt(unsigned int x, unsigned int y) const;
+};
@@ -0,0 +1,272 @@
+#include "raster_kernels.h"
+#include <algorithm>
+
+//blocks are grouped into 32x32 pixel super blocks, which are classified first
+static const int SUPER_BLOCK_SIZE = 32;
+
+enum BlockClass
+{
+	BLOCK_OUTSIDE,
+	BLOCK_INSIDE,
+	BLOCK_PARTIAL
+};
+
+//Classifies a size x size pixel square from the edge values at its first pixel
+//partialEdges gets a bit for every edge that crosses the square
+static BlockClass ClassifySquare(const RasterEdges& edges, const long long* e, int size, unsigned int& partialEdges)
+{
+	long long extent = size - 1;
+	partialEdges = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		long long stepA = edges.a[k] * extent, stepB = edges.b[k] * extent;
+		long long min = e[k] + (stepA < 0 ? stepA : 0) + (stepB < 0 ? stepB : 0);
+		long long max = e[k] + (stepA > 0 ? stepA : 0) + (stepB > 0 ? stepB : 0);
+		if (max < 0)
+			return BLOCK_OUTSIDE;
+		if (min < 0)
+			partialEdges |= 1u << k;
+	}
+	return partialEdges ? BLOCK_PARTIAL : BLOCK_INSIDE;
+}
+
+unsigned long long RasterRectMask(int bx, int by, int minX, int minY, int maxX, int maxY)
+{
+	if (bx >= minX && by >= minY && bx + 7 <= maxX && by + 7 <= maxY)
+		return ~0ull;
+
+	int x0 = minX > bx ? minX - bx : 0;
+	int x1 = maxX < bx + 7 ? maxX - bx : 7;
+	int y0 = minY > by ? minY - by : 0;
+	int y1 = maxY < by + 7 ? maxY - by : 7;
+
+	unsigned long long row = ((1ull << (x1 + 1)) - 1) & ~((1ull << x0) - 1);
+	unsigned long long rows = (y1 == 7 ? ~0ull : (1ull << ((y1 + 1) * 8)) - 1) & ~((1ull << (y0 * 8)) - 1);
+	return (row * 0x0101010101010101ull) & rows;
+}
+
+static unsigned long long BlockCoverageScalar(const int* e0, const int* a, const int* b)
+{
+	unsigned long long mask = 0;
+	for (int y = 0; y < 8; y++)
+	{
+		int e[3] = { e0[0] + b[0] * y, e0[1] + b[1] * y, e0[2] + b[2] * y };
+		for (int x = 0; x < 8; x++)
+		{
+			if ((e[0] | e[1] | e[2]) >= 0)
+				mask |= 1ull << (y * 8 + x);
+			e[0] += a[0];
+			e[1] += a[1];
+			e[2] += a[2];
+		}
+	}
+	return mask;
+}
+
+#if SIMD_X86
+SIMD_TARGET_SSE41
+static unsigned long long BlockCoverageSSE41(const int* e0, const int* a, const int* b)
+{
+	const __m128i ramp = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i left[3], right[3], stepY[3];
+	for (int k = 0; k < 3; k++)
+	{
+		left[k] = _mm_add_epi32(_mm_set1_epi32(e0[k]), _mm_mullo_epi32(_mm_set1_epi32(a[k]), ramp));
+		right[k] = _mm_add_epi32(left[k], _mm_set1_epi32(a[k] * 4));
+		stepY[k] = _mm_set1_epi32(b[k]);
+	}
+
+	unsigned long long mask = 0;
+	for (int y = 0; y < 8; y++)
+	{
+		//the sign bit of the OR is set when any edge is negative
+		__m128i l = _mm_or_si128(_mm_or_si128(left[0], left[1]), left[2]);
+		__m128i r = _mm_or_si128(_mm_or_si128(right[0], right[1]), right[2]);
+		unsigned int outside = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(l)) | ((unsigned int)_mm_movemask_ps(_mm_castsi128_ps(r)) << 4);
+		mask |= (unsigned long long)(~outside & 0xFF) << (y * 8);
+
+		for (int k = 0; k < 3; k++)
+		{
+			left[k] = _mm_add_epi32(left[k], stepY[k]);
+			right[k] = _mm_add_epi32(right[k], stepY[k]);
+		}
+	}
+	return mask;
+}
+
+SIMD_TARGET_AVX2
+static unsigned long long BlockCoverageAVX2(const int* e0, const int* a, const int* b)
+{
+	const __m256i ramp = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i row[3], stepY[3];
+	for (int k = 0; k < 3; k++)
+	{
+		row[k] = _mm256_add_epi32(_mm256_set1_epi32(e0[k]), _mm256_mullo_epi32(_mm256_set1_epi32(a[k]), ramp));
+		stepY[k] = _mm256_set1_epi32(b[k]);
+	}
+
+	unsigned long long mask = 0;
+	for (int y = 0; y < 8; y++)
+	{
+		__m256i any = _mm256_or_si256(_mm256_or_si256(row[0], row[1]), row[2]);
+		unsigned int outside = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(any));
+		mask |= (unsigned long long)(~outside & 0xFF) << (y * 8);
+
+		row[0] = _mm256_add_epi32(row[0], stepY[0]);
+		row[1] = _mm256_add_epi32(row[1], stepY[1]);
+		row[2] = _mm256_add_epi32(row[2], stepY[2]);
+	}
+	return mask;
+}
+
+SIMD_TARGET_AVX512
+static unsigned long long BlockCoverageAVX512(const int* e0, const int* a, const int* b)
+{
+	//16 lanes cover two rows of the block
+	const __m512i rampX = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7);
+	const __m512i rampY = _mm512_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+	__m512i rows[3], stepY[3];
+	for (int k = 0; k < 3; k++)
+	{
+		rows[k] = _mm512_add_epi32(_mm512_set1_epi32(e0[k]), _mm512_add_epi32(
+			_mm512_mullo_epi32(_mm512_set1_epi32(a[k]), rampX),
+			_mm512_mullo_epi32(_mm512_set1_epi32(b[k]), rampY)));
+		stepY[k] = _mm512_set1_epi32(b[k] * 2);
+	}
+
+	unsigned long long mask = 0;
+	for (int y = 0; y < 8; y += 2)
+	{
+		__m512i any = _mm512_or_si512(_mm512_or_si512(rows[0], rows[1]), rows[2]);
+		__mmask16 inside = _mm512_cmpge_epi32_mask(any, _mm512_setzero_si512());
+		mask |= (unsigned long long)inside << (y * 8);
+
+		rows[0] = _mm512_add_epi32(rows[0], stepY[0]);
+		rows[1] = _mm512_add_epi32(rows[1], stepY[1]);
+		rows[2] = _mm512_add_epi32(rows[2], stepY[2]);
+	}
+	return mask;
+}
+#endif
+
+BlockCoverageFn GetBlockCoverageFn(SimdLevel level)
+{
+#if SIMD_X86
+	if (level >= SimdLevel::AVX512)
+		return BlockCoverageAVX512;
+	if (level >= SimdLevel::AVX2)
+		return BlockCoverageAVX2;
+	if (level >= SimdLevel::SSE41)
+		return BlockCoverageSSE41;
+#endif
+	return BlockCoverageScalar;
+}
+
+void SetupRasterEdges(const int* x, const int* y, int subpixelBits, RasterEdges& edges)
+{
+	const int half = 1 << (subpixelBits - 1);
+	for (int e = 0; e < 3; e++)
+	{
+		int a = e, b = (e + 1) % 3;
+		int edgeA = y[a] - y[b];
+		int edgeB = x[b] - x[a];
+		long long edgeC = (long long)x[a] * y[b] - (long long)x[b] * y[a];
+
+		//fill rule: pixels exactly on an edge belong to only one of the two triangles sharing it
+		bool inclusive = edgeA > 0 || (edgeA == 0 && edgeB < 0);
+		if (!inclusive)
+			edgeC -= 1;
+
+		//move to pixel steps, evaluated at pixel centers
+		edges.a[e] = edgeA * (1 << subpixelBits);
+		edges.b[e] = edgeB * (1 << subpixelBits);
+		edges.c[e] = edgeC + (long long)(edgeA + edgeB) * half;
+	}
+}
+
+bool RasterBounds(const int* x, const int* y, int subpixelBits, int width, int height,
+	int& minX, int& minY, int& maxX, int& maxY)
+{
+	const int scale = 1 << subpixelBits;
+	const int half = scale / 2;
+	int lowX = std::min(x[0], std::min(x[1], x[2]));
+	int highX = std::max(x[0], std::max(x[1], x[2]));
+	int lowY = std::min(y[0], std::min(y[1], y[2]));
+	int highY = std::max(y[0], std::max(y[1], y[2]));
+
+	//pixel p is sampled at p * scale + half
+	minX = std::max(0, (lowX - half + scale - 1) >> subpixelBits);
+	minY = std::max(0, (lowY - half + scale - 1) >> subpixelBits);
+	maxX = std::min(width - 1, (highX - half) >> subpixelBits);
+	maxY = std::min(height - 1, (highY - half) >> subpixelBits);
+	return minX <= maxX && minY <= maxY;
+}
+
+unsigned int RasterizeBlocks(const RasterEdges& edges, int minX, int minY, int maxX, int maxY,
+	BlockCoverageFn partial, CoverageBlock* out)
+{
+	if (minX > maxX || minY > maxY)
+		return 0;
+
+	unsigned int written = 0;
+	int superMinX = minX & ~(SUPER_BLOCK_SIZE - 1), superMinY = minY & ~(SUPER_BLOCK_SIZE - 1);
+
+	for (int sy = superMinY; sy <= maxY; sy += SUPER_BLOCK_SIZE)
+		for (int sx = superMinX; sx <= maxX; sx += SUPER_BLOCK_SIZE)
+		{
+			long long e[3];
+			for (int k = 0; k < 3; k++)
+				e[k] = edges.c[k] + (long long)edges.a[k] * sx + (long long)edges.b[k] * sy;
+
+			unsigned int superPartial;
+			BlockClass superClass = ClassifySquare(edges, e, SUPER_BLOCK_SIZE, superPartial);
+			if (superClass == BLOCK_OUTSIDE)
+				continue;
+
+			int blockMinX = sx > (minX & ~7) ? sx : (minX & ~7);
+			int blockMinY = sy > (minY & ~7) ? sy : (minY & ~7);
+			int blockMaxX = sx + SUPER_BLOCK_SIZE - 1 < maxX ? sx + SUPER_BLOCK_SIZE - 1 : maxX;
+			int blockMaxY = sy + SUPER_BLOCK_SIZE - 1 < maxY ? sy + SUPER_BLOCK_SIZE - 1 : maxY;
+
+			for (int by = blockMinY; by <= blockMaxY; by += RASTER_BLOCK_SIZE)
+				for (int bx = blockMinX; bx <= blockMaxX; bx += RASTER_BLOCK_SIZE)
+				{
+					unsigned long long mask = RasterRectMask(bx, by, minX, minY, maxX, maxY);
+					if (superClass == BLOCK_PARTIAL)
+					{
+						long long be[3];
+						for (int k = 0; k < 3; k++)
+							be[k] = e[k] + (long long)edges.a[k] * (bx - sx) + (long long)edges.b[k] * (by - sy);
+
+						unsigned int partialEdges;
+						BlockClass blockClass = ClassifySquare(edges, be, RASTER_BLOCK_SIZE, partialEdges);
+						if (blockClass == BLOCK_OUTSIDE)
+							continue;
+
+						if (blockClass == BLOCK_PARTIAL)
+						{
+							//edges that don't cross the block always pass, the others fit in 32 bits here
+							int e0[3], a[3], b[3];
+							for (int k = 0; k < 3; k++)
+							{
+								bool crosses = (partialEdges & (1u << k)) != 0;
+								e0[k] = crosses ? (int)be[k] : 0;
+								a[k] = crosses ? edges.a[k] : 0;
+								b[k] = crosses ? edges.b[k] : 0;
+							}
+							mask &= partial(e0, a, b);
+						}
+					}
+
+					if (mask)
+					{
+						out[written].x = bx;
+						out[written].y = by;
+						out[written].mask = mask;
+						written++;
+					}
+				}
+		}
+
+	return written;
+}
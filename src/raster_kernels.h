@@ -0,0 +1,46 @@
+#pragma once
+#include "simd.h"
+
+//Edge functions of a triangle in pixel units: E_k(x, y) = a[k] * x + b[k] * y + c[k] is the value at the center
+//of pixel (x, y), a pixel is covered when all three are >= 0 (fill rule bias already folded into c)
+struct RasterEdges
+{
+	int a[3];
+	int b[3];
+	long long c[3];
+};
+
+//8x8 pixel block with one coverage bit per pixel, bit (y * 8 + x)
+struct CoverageBlock
+{
+	int x, y; //pixel coordinates of the block's bottom-left corner, multiples of 8
+	unsigned long long mask;
+};
+
+static const int RASTER_BLOCK_SIZE = 8;
+
+//Builds the edge functions of a counter-clockwise triangle, x/y are in fixed point with subpixelBits fractional bits
+//and pixel p is sampled at its center p + 0.5
+//Uses the top-left fill rule so pixels on an edge shared by two triangles belong to only one of them
+void SetupRasterEdges(const int* x, const int* y, int subpixelBits, RasterEdges& edges);
+
+//Pixels whose centers are inside the bounding box of the vertices, clamped to a width x height target
+//Returns false when there are none
+bool RasterBounds(const int* x, const int* y, int subpixelBits, int width, int height,
+	int& minX, int& minY, int& maxX, int& maxY);
+
+//Bits of the pixels of the 8x8 block at (bx, by) that are inside the rectangle [minX, maxX] x [minY, maxY]
+unsigned long long RasterRectMask(int bx, int by, int minX, int minY, int maxX, int maxY);
+
+//Coverage of the pixels of one 8x8 block, edge values are relative to the block's first pixel
+//Only called for blocks the edges partially cover, so the values fit in 32 bits
+typedef unsigned long long (*BlockCoverageFn)(const int* e0, const int* a, const int* b);
+
+BlockCoverageFn GetBlockCoverageFn(SimdLevel level);
+
+//Walks the 8x8 blocks overlapping the pixel rectangle [minX, maxX] x [minY, maxY] (inclusive)
+//Blocks outside the triangle are rejected and blocks inside it accepted from their corners,
+//only the blocks crossing an edge run the per-pixel kernel
+//Writes the blocks with at least one covered pixel to out and returns how many, out must fit every block of the rectangle
+unsigned int RasterizeBlocks(const RasterEdges& edges, int minX, int minY, int maxX, int maxY,
+	BlockCoverageFn partial, CoverageBlock* out);
@@ -0,0 +1,85 @@
+#include "render_system.h"
+#include <algorithm>
+#include "frame_arena.h"
+#include "renderer.h"
+#include "thread_pool.h"
+
+void ExtractDrawList(World& world, std::vector<DrawCommand>& out)
+{
+	LinearArena& arena = GetFrameArena().local();
+	ArenaVector<ChunkView> chunks{ ArenaAllocator<ChunkView>(arena) };
+	world.forEachChunk(ComponentMaskOf<MeshComponent, MaterialComponent>(), ComponentMaskOf<HiddenComponent>(), [&chunks](const ChunkView& chunk)
+	{
+		chunks.push_back(chunk);
+	});
+
+	//every chunk writes its own range of the list
+	ArenaVector<unsigned int> starts(chunks.size() + 1, 0, ArenaAllocator<unsigned int>(arena));
+	for (unsigned int i = 0; i < chunks.size(); i++)
+		starts[i + 1] = starts[i] + chunks[i].count();
+	out.resize(starts.back());
+
+	const GpuResources& resources = GetGpuResources();
+
+	GetThreadPool().parallelFor((unsigned int)chunks.size(), 4, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const MeshComponent* meshes = chunks[i].get<MeshComponent>();
+			const MaterialComponent* materials = chunks[i].get<MaterialComponent>();
+			DrawCommand* draws = out.data() + starts[i];
+			for (unsigned int row = 0; row < chunks[i].count(); row++)
+			{
+				DrawCommand& draw = draws[row];
+				draw.program = materials[row].program;
+				draw.vertexArray = meshes[row].vertexArray;
+				const IndexBuffer* indices = resources.get(meshes[row].indices);
+				draw.indexBuffer = indices ? indices->getBuffer() : 0;
+				draw.indexOffset = indices ? indices->getOffset() : 0;
+				draw.indexCount = indices ? indices->getCount() : 0; //dropped below
+				draw.colorLocation = materials[row].colorLocation;
+				std::copy(materials[row].color, materials[row].color + 4, draw.color);
+			}
+		}
+	});
+	out.erase(std::remove_if(out.begin(), out.end(), [](const DrawCommand& draw) { return draw.indexCount == 0; }), out.end());
+
+	std::sort(out.begin(), out.end(), [](const DrawCommand& a, const DrawCommand& b)
+	{
+		if (a.program != b.program)
+			return a.program < b.program;
+		if (a.vertexArray != b.vertexArray)
+			return a.vertexArray < b.vertexArray;
+		return a.indexBuffer < b.indexBuffer;
+	});
+}
+
+void SubmitDrawList(const std::vector<DrawCommand>& draws)
+{
+	unsigned int program = 0, vertexArray = 0, indexBuffer = 0;
+	for (unsigned int i = 0; i < draws.size(); i++)
+	{
+		const DrawCommand& draw = draws[i];
+		if (i == 0 || draw.program != program)
+		{
+			program = draw.program;
+			GLCall(glUseProgram(program));
+		}
+		//the element array binding belongs to the vertex array, so a new vertex array needs it bound again
+		if (i == 0 || draw.vertexArray != vertexArray)
+		{
+			vertexArray = draw.vertexArray;
+			indexBuffer = draw.indexBuffer;
+			GLCall(glBindVertexArray(vertexArray));
+			GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+		}
+		else if (draw.indexBuffer != indexBuffer)
+		{
+			indexBuffer = draw.indexBuffer;
+			GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+		}
+
+		GLCall(glUniform4fv(draw.colorLocation, 1, draw.color));
+		GLCall(glDrawElements(GL_TRIANGLES, draw.indexCount, GL_UNSIGNED_INT, (const void*)(size_t)draw.indexOffset));
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "ecs.h"
+#include "gpu_resources.h"
+
+//What an entity draws: an indexed vertex array, drawn as GL_TRIANGLES
+//The indices are a handle into GetGpuResources(), resolved when the draw list is extracted
+struct MeshComponent
+{
+	unsigned int vertexArray;
+	IndexBufferHandle indices;
+};
+
+//How it's drawn: the program and the u_Color it gets
+struct MaterialComponent
+{
+	unsigned int program;
+	int colorLocation;
+	float color[4];
+};
+
+//Tag that keeps an entity out of the draw list
+struct HiddenComponent
+{
+};
+
+//indexBuffer and indexOffset (in bytes) locate the indices in a shared buffer (GpuBufferAllocator)
+struct DrawCommand
+{
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int indexBuffer;
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	int colorLocation;
+	float color[4];
+};
+
+//A draw for every entity with a mesh and a material that isn't hidden, reading the chunks in parallel
+//Meshes whose index buffer was destroyed are skipped
+//The list comes out sorted by program, then vertex array, then index buffer, so draws sharing state are adjacent
+void ExtractDrawList(World& world, std::vector<DrawCommand>& out);
+
+//Issues the draws, only binding what differs from the previous draw
+void SubmitDrawList(const std::vector<DrawCommand>& draws);
@@ -0,0 +1,109 @@
+#pragma once
+#include <utility>
+#include <vector>
+
+//32 bit reference to an object of a ResourcePool<T>: the low 20 bits pick a slot, the high 12 are the slot's
+//generation, which changes when the object is destroyed so an old handle can't reach the slot's next object
+//0 is no object
+template<typename T>
+struct Handle
+{
+	static const unsigned int INDEX_BITS = 20;
+	static const unsigned int INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+	unsigned int value;
+
+	Handle() :value(0) {}
+	Handle(unsigned int index, unsigned int generation) :value(generation << INDEX_BITS | index) {}
+
+	unsigned int index() const { return value & INDEX_MASK; }
+	unsigned int generation() const { return value >> INDEX_BITS; }
+	bool isNull() const { return value == 0; }
+
+	bool operator==(Handle other) const { return value == other.value; }
+	bool operator!=(Handle other) const { return value != other.value; }
+};
+
+//Objects kept packed in one array and reached through handles; destroying one moves the last object into its place,
+//so walking data() never skips holes
+//Pointers from get() are valid until the next create() or destroy()
+template<typename T>
+class ResourcePool
+{
+private:
+	static const unsigned int MAX_GENERATION = (1u << (32 - Handle<T>::INDEX_BITS)) - 1;
+	static const unsigned int NO_ITEM = 0xFFFFFFFFu;
+
+	std::vector<T> m_items;
+	std::vector<unsigned int> m_itemSlots;   //slot of every item
+	std::vector<unsigned int> m_slotItems;   //item of every slot, NO_ITEM when free
+	std::vector<unsigned int> m_generations; //of every slot, never 0
+	std::vector<unsigned int> m_freeSlots;
+
+public:
+	//A null handle when every slot is taken
+	Handle<T> create(T item)
+	{
+		unsigned int slot;
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			if (m_slotItems.size() > Handle<T>::INDEX_MASK)
+				return Handle<T>();
+			slot = (unsigned int)m_slotItems.size();
+			m_slotItems.push_back((unsigned int)NO_ITEM);
+			m_generations.push_back(1);
+		}
+
+		m_slotItems[slot] = (unsigned int)m_items.size();
+		m_items.push_back(std::move(item));
+		m_itemSlots.push_back(slot);
+		return Handle<T>(slot, m_generations[slot]);
+	}
+
+	bool isValid(Handle<T> handle) const
+	{
+		unsigned int slot = handle.index();
+		return !handle.isNull() && slot < m_slotItems.size() && m_slotItems[slot] != NO_ITEM && m_generations[slot] == handle.generation();
+	}
+
+	T* get(Handle<T> handle) { return isValid(handle) ? &m_items[m_slotItems[handle.index()]] : nullptr; }
+	const T* get(Handle<T> handle) const { return isValid(handle) ? &m_items[m_slotItems[handle.index()]] : nullptr; }
+
+	//Removes the object and hands it back, e.g. to keep it alive a little longer; handle must be valid
+	T take(Handle<T> handle)
+	{
+		unsigned int slot = handle.index();
+		unsigned int item = m_slotItems[slot];
+		T taken = std::move(m_items[item]);
+
+		unsigned int last = (unsigned int)m_items.size() - 1;
+		if (item != last)
+		{
+			m_items[item] = std::move(m_items[last]);
+			m_itemSlots[item] = m_itemSlots[last];
+			m_slotItems[m_itemSlots[item]] = item;
+		}
+		m_items.pop_back();
+		m_itemSlots.pop_back();
+
+		m_slotItems[slot] = NO_ITEM;
+		m_generations[slot] = m_generations[slot] == MAX_GENERATION ? 1 : m_generations[slot] + 1;
+		m_freeSlots.push_back(slot);
+		return taken;
+	}
+
+	void destroy(Handle<T> handle)
+	{
+		if (isValid(handle))
+			take(handle);
+	}
+
+	unsigned int size() const { return (unsigned int)m_items.size(); }
+	T* data() { return m_items.data(); }
+	const T* data() const { return m_items.data(); }
+};
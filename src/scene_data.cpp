@@ -0,0 +1,87 @@
+#include "scene_data.h"
+
+const float SCENE_VERTICES[SCENE_VERTEX_COUNT * SCENE_VERTEX_FLOATS] =
+{
+	 //atrib 1 - position ( 2 floats )
+	 //atrib 2 - color ( 4 floats )
+
+	 0.0f,  0.0f, 1, 0, 0, 1, // 0 (origin)
+
+	 //topleft
+	 0.0f,  1.0f, 1, 0, 0, 1, // 1
+	-0.5f,  1.0f, 1, 0, 0, 1, // 2
+	-1.0f,  1.0f, 1, 0, 0, 1, // 3
+	-1.0f,  0.5f, 1, 0, 0, 1, // 4
+	-0.5f,  0.5f, 1, 0, 0, 1, // 5
+	 0.0f,  0.5f, 1, 0, 0, 1, // 6
+	-1.0f,  0.0f, 1, 0, 0, 1, // 7
+	-0.5f,  0.0f, 1, 0, 0, 1, // 8
+
+	//botleft
+	-1.0f, -0.5f, 1, 0, 0, 1, //  9
+	-0.5f, -0.5f, 1, 0, 0, 1, // 10
+	 0.0f, -0.5f, 1, 0, 0, 1, // 11
+	-1.0f, -1.0f, 1, 0, 0, 1, // 12
+	-0.5f, -1.0f, 1, 0, 0, 1, // 13
+	 0.0f, -1.0f, 1, 0, 0, 1, // 14
+
+	 //botright
+	 0.5f,  0.0f, 0, 0, 1, 1, // 15
+	 1.0f,  0.0f, 0, 0, 1, 1, // 16
+	 0.5f, -0.5f, 0, 0, 1, 1, // 17
+	 1.0f, -0.5f, 0, 0, 1, 1, // 18
+	 0.5f, -1.0f, 0, 0, 1, 1, // 19
+	 1.0f, -1.0f, 0, 0, 1, 1, // 20
+
+	 //topright
+	 0.5f,  0.5f, 0, 0, 1, 1, // 21
+	 1.0f,  0.5f, 0, 0, 1, 1, // 22
+	 0.5f,  1.0f, 0, 0, 1, 1, // 23
+	 1.0f,  1.0f, 0, 0, 1, 1  // 24
+};
+
+const unsigned int SCENE_GRID_INDICES[SCENE_GRID_INDEX_COUNT] =
+{
+	1, 6, 5,
+	5, 1, 2,
+
+	4, 5, 7,
+	7, 8, 5,
+
+	8, 0, 11,
+	11, 8, 10,
+
+	10, 12, 13,
+	9, 12, 10,
+
+	11, 14, 17,
+	17, 19, 14,
+
+	17, 15, 18,
+	16, 18, 15,
+
+	6, 21, 15,
+	0, 6 , 15,
+
+	21, 23, 22,
+	22, 24, 23
+};
+
+const unsigned int SCENE_HEXAGONE_INDICES[SCENE_HEXAGONE_INDEX_COUNT] =
+{
+	1, 6, 4,
+	4, 6, 0,
+	0, 4, 7,
+
+	7,  9,  0,
+	0, 11,  9,
+	9, 11, 14,
+
+	14, 11, 18,
+	11,  0, 18,
+	18, 16,  0,
+
+	0, 16,  6,
+	6, 16, 22,
+	22, 1,  6
+};
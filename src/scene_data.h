@@ -0,0 +1,28 @@
+#pragma once
+
+//Geometry drawn by app.cpp, shared with the tools that render the same scenes without a window
+//Vertices are position (2 floats) + color (4 floats)
+static const unsigned int SCENE_VERTEX_FLOATS = 6;
+static const unsigned int SCENE_VERTEX_COUNT = 25;
+static const unsigned int SCENE_GRID_INDEX_COUNT = 3 * 2 * 8;
+static const unsigned int SCENE_HEXAGONE_INDEX_COUNT = 3 * 3 * 4;
+
+extern const float SCENE_VERTICES[SCENE_VERTEX_COUNT * SCENE_VERTEX_FLOATS];
+extern const unsigned int SCENE_GRID_INDICES[SCENE_GRID_INDEX_COUNT];
+extern const unsigned int SCENE_HEXAGONE_INDICES[SCENE_HEXAGONE_INDEX_COUNT];
+
+//u_Color before the render loop starts
+static const float SCENE_START_COLOR[4] = { 0.2f, 0.3f, 0.8f, 1.0f };
+
+//One step of the rainbow effect: r and g move by increment, which flips when they leave [0, 1]
+//u_Color is (r, g, 0.8, 1), app.cpp starts from r = g = 0 and increment = 0.05 and steps 30 times a second
+inline void StepColorAnimation(float& r, float& g, float& increment)
+{
+	if (r > 1.0f || g > 1.0f)
+		increment = -0.05f;
+	else if (r < 0.0f || g < 0.0f)
+		increment = 0.05f;
+
+	r += increment;
+	g += increment;
+}
@@ -0,0 +1,167 @@
+#include "shader_vm.h"
+#include <cmath>
+
+//One instruction on plain floats, the vector executors fall back to this for transcendentals
+static void ExecuteScalar(const VmInstruction& inst, float* registers)
+{
+	float* d = registers + inst.dst * VM_LANES;
+	const float* a = registers + inst.a * VM_LANES;
+	const float* b = registers + inst.b * VM_LANES;
+	const float* c = registers + inst.c * VM_LANES;
+
+	//results go through a temporary so dst may alias an operand
+	float r[VM_LANES];
+	for (int l = 0; l < VM_LANES; l++)
+	{
+		switch (inst.op)
+		{
+		case VmOp::Mov:         r[l] = a[l]; break;
+		case VmOp::Add:         r[l] = a[l] + b[l]; break;
+		case VmOp::Sub:         r[l] = a[l] - b[l]; break;
+		case VmOp::Mul:         r[l] = a[l] * b[l]; break;
+		case VmOp::Div:         r[l] = a[l] / b[l]; break;
+		case VmOp::Neg:         r[l] = -a[l]; break;
+		case VmOp::Abs:         r[l] = std::fabs(a[l]); break;
+		case VmOp::Sign:        r[l] = a[l] > 0.0f ? 1.0f : (a[l] < 0.0f ? -1.0f : 0.0f); break;
+		case VmOp::Min:         r[l] = b[l] < a[l] ? b[l] : a[l]; break;
+		case VmOp::Max:         r[l] = a[l] < b[l] ? b[l] : a[l]; break;
+		case VmOp::Mad:         r[l] = a[l] * b[l] + c[l]; break;
+		case VmOp::Msb:         r[l] = a[l] * b[l] - c[l]; break;
+		case VmOp::Floor:       r[l] = std::floor(a[l]); break;
+		case VmOp::Fract:       r[l] = a[l] - std::floor(a[l]); break;
+		case VmOp::Mod:         r[l] = a[l] - b[l] * std::floor(a[l] / b[l]); break;
+		case VmOp::Step:        r[l] = b[l] < a[l] ? 0.0f : 1.0f; break;
+		case VmOp::Sqrt:        r[l] = std::sqrt(a[l]); break;
+		case VmOp::InverseSqrt: r[l] = 1.0f / std::sqrt(a[l]); break;
+		case VmOp::Sin:         r[l] = std::sin(a[l]); break;
+		case VmOp::Cos:         r[l] = std::cos(a[l]); break;
+		case VmOp::Tan:         r[l] = std::tan(a[l]); break;
+		case VmOp::Exp:         r[l] = std::exp(a[l]); break;
+		case VmOp::Log:         r[l] = std::log(a[l]); break;
+		case VmOp::Exp2:        r[l] = std::exp2(a[l]); break;
+		case VmOp::Log2:        r[l] = std::log2(a[l]); break;
+		case VmOp::Pow:         r[l] = std::pow(a[l], b[l]); break;
+		}
+	}
+
+	for (int l = 0; l < VM_LANES; l++)
+		d[l] = r[l];
+}
+
+static void ExecuteScalarProgram(const VmInstruction* code, unsigned int count, float* registers)
+{
+	for (unsigned int i = 0; i < count; i++)
+		ExecuteScalar(code[i], registers);
+}
+
+#if SIMD_X86
+//a register is two SSE vectors
+static void ExecuteSSE2(const VmInstruction* code, unsigned int count, float* registers)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const VmInstruction& inst = code[i];
+		float* d = registers + inst.dst * VM_LANES;
+		const float* pa = registers + inst.a * VM_LANES;
+		const float* pb = registers + inst.b * VM_LANES;
+		const float* pc = registers + inst.c * VM_LANES;
+
+		__m128 r[2];
+		bool scalar = false;
+		for (int h = 0; h < 2 && !scalar; h++)
+		{
+			__m128 a = _mm_loadu_ps(pa + h * 4);
+			__m128 b = _mm_loadu_ps(pb + h * 4);
+			switch (inst.op)
+			{
+			case VmOp::Mov:         r[h] = a; break;
+			case VmOp::Add:         r[h] = _mm_add_ps(a, b); break;
+			case VmOp::Sub:         r[h] = _mm_sub_ps(a, b); break;
+			case VmOp::Mul:         r[h] = _mm_mul_ps(a, b); break;
+			case VmOp::Div:         r[h] = _mm_div_ps(a, b); break;
+			case VmOp::Neg:         r[h] = _mm_xor_ps(a, signMask); break;
+			case VmOp::Abs:         r[h] = _mm_andnot_ps(signMask, a); break;
+			case VmOp::Min:         r[h] = _mm_min_ps(b, a); break;
+			case VmOp::Max:         r[h] = _mm_max_ps(b, a); break;
+			case VmOp::Mad:         r[h] = _mm_add_ps(_mm_mul_ps(a, b), _mm_loadu_ps(pc + h * 4)); break;
+			case VmOp::Msb:         r[h] = _mm_sub_ps(_mm_mul_ps(a, b), _mm_loadu_ps(pc + h * 4)); break;
+			case VmOp::Step:        r[h] = _mm_andnot_ps(_mm_cmplt_ps(b, a), one); break;
+			case VmOp::Sqrt:        r[h] = _mm_sqrt_ps(a); break;
+			case VmOp::InverseSqrt: r[h] = _mm_div_ps(one, _mm_sqrt_ps(a)); break;
+			default:
+				scalar = true;
+				break;
+			}
+		}
+
+		if (scalar)
+		{
+			ExecuteScalar(inst, registers);
+			continue;
+		}
+		_mm_storeu_ps(d, r[0]);
+		_mm_storeu_ps(d + 4, r[1]);
+	}
+}
+
+SIMD_TARGET_AVX2
+static void ExecuteAVX2(const VmInstruction* code, unsigned int count, float* registers)
+{
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const VmInstruction& inst = code[i];
+		float* d = registers + inst.dst * VM_LANES;
+		__m256 a = _mm256_loadu_ps(registers + inst.a * VM_LANES);
+		__m256 b = _mm256_loadu_ps(registers + inst.b * VM_LANES);
+		__m256 r;
+		switch (inst.op)
+		{
+		case VmOp::Mov:         r = a; break;
+		case VmOp::Add:         r = _mm256_add_ps(a, b); break;
+		case VmOp::Sub:         r = _mm256_sub_ps(a, b); break;
+		case VmOp::Mul:         r = _mm256_mul_ps(a, b); break;
+		case VmOp::Div:         r = _mm256_div_ps(a, b); break;
+		case VmOp::Neg:         r = _mm256_xor_ps(a, signMask); break;
+		case VmOp::Abs:         r = _mm256_andnot_ps(signMask, a); break;
+		case VmOp::Min:         r = _mm256_min_ps(b, a); break;
+		case VmOp::Max:         r = _mm256_max_ps(b, a); break;
+		case VmOp::Mad:         r = _mm256_add_ps(_mm256_mul_ps(a, b), _mm256_loadu_ps(registers + inst.c * VM_LANES)); break; //no FMA, it rounds once and the other levels twice
+		case VmOp::Msb:         r = _mm256_sub_ps(_mm256_mul_ps(a, b), _mm256_loadu_ps(registers + inst.c * VM_LANES)); break;
+		case VmOp::Floor:       r = _mm256_floor_ps(a); break;
+		case VmOp::Fract:       r = _mm256_sub_ps(a, _mm256_floor_ps(a)); break;
+		case VmOp::Mod:         r = _mm256_sub_ps(a, _mm256_mul_ps(b, _mm256_floor_ps(_mm256_div_ps(a, b)))); break;
+		case VmOp::Step:        r = _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ), one); break;
+		case VmOp::Sqrt:        r = _mm256_sqrt_ps(a); break;
+		case VmOp::InverseSqrt: r = _mm256_div_ps(one, _mm256_sqrt_ps(a)); break;
+		default:
+			ExecuteScalar(inst, registers);
+			continue;
+		}
+		_mm256_storeu_ps(d, r);
+	}
+}
+#endif
+
+VmExecuteFn GetVmExecuteFn(SimdLevel level)
+{
+#if SIMD_X86
+	if (level >= SimdLevel::AVX2)
+		return ExecuteAVX2;
+	if (level >= SimdLevel::SSE2)
+		return ExecuteSSE2;
+#endif
+	return ExecuteScalarProgram;
+}
+
+void VmLoadConstants(const VmProgram& program, float* registers)
+{
+	for (size_t i = 0; i < program.constants.size(); i++)
+		for (int l = 0; l < VM_LANES; l++)
+			registers[i * VM_LANES + l] = program.constants[i];
+}
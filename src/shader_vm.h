@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include "simd.h"
+
+//Number of invocations one VM run processes, matches SOFT_BATCH
+static const int VM_LANES = 8;
+
+//Operations of the shader VM
+//Every instruction works on single float registers across VM_LANES lanes, vectors and matrices are
+//split into components by the compiler so swizzles and broadcasts cost nothing at run time
+enum class VmOp : unsigned char
+{
+	Mov,         //dst = a
+	Add,         //dst = a + b
+	Sub,         //dst = a - b
+	Mul,         //dst = a * b
+	Div,         //dst = a / b
+	Neg,         //dst = -a
+	Abs,
+	Sign,
+	Min,
+	Max,
+	Mad,         //dst = a * b + c
+	Msb,         //dst = a * b - c
+	Floor,
+	Fract,       //dst = a - floor(a)
+	Mod,         //dst = a - b * floor(a / b), like GLSL mod()
+	Step,        //dst = a <= b ? 1 : 0, GLSL step(edge = a, x = b)
+	Sqrt,
+	InverseSqrt,
+	Sin,
+	Cos,
+	Tan,
+	Exp,
+	Log,
+	Exp2,
+	Log2,
+	Pow
+};
+
+struct VmInstruction
+{
+	VmOp op;
+	unsigned short dst, a, b, c; //register indices, unused operands are 0
+};
+
+//Compiled shader stage
+//Registers [0, constants.size()) hold literals and uniforms and are broadcast to every lane before a run,
+//the rest are inputs, outputs and temporaries
+struct VmProgram
+{
+	std::vector<VmInstruction> code;
+	std::vector<float> constants;
+	unsigned int registerCount = 0;
+};
+
+//Runs count instructions over a register file laid out as [register][lane]
+typedef void (*VmExecuteFn)(const VmInstruction* code, unsigned int count, float* registers);
+
+VmExecuteFn GetVmExecuteFn(SimdLevel level);
+
+//Broadcasts the constant registers of a program into a register file
+void VmLoadConstants(const VmProgram& program, float* registers);
@@ -0,0 +1,139 @@
+#include "simd.h"
+#include <cstdlib>
+#include <cstring>
+
+#if SIMD_X86 && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#if SIMD_X86
+static void CpuId(int leaf, int subleaf, int out[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex(out, leaf, subleaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	out[0] = (int)a; out[1] = (int)b; out[2] = (int)c; out[3] = (int)d;
+#endif
+}
+
+//reads XCR0, which tells which register states the OS saves on a context switch
+static unsigned long long ReadXcr0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+static SimdLevel DetectSimdLevel()
+{
+#if SIMD_X86
+	int info[4];
+	CpuId(0, 0, info);
+	int maxLeaf = info[0];
+
+	CpuId(1, 0, info);
+	bool sse2  = (info[3] & (1 << 26)) != 0;
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx  = (info[2] & (1 << 28)) != 0;
+	bool fma  = (info[2] & (1 << 12)) != 0;
+
+	if (!sse2)
+		return SimdLevel::Scalar;
+	if (!sse41)
+		return SimdLevel::SSE2;
+	if (!osxsave || !avx || !fma || maxLeaf < 7)
+		return SimdLevel::SSE41;
+
+	unsigned long long xcr0 = ReadXcr0();
+	if ((xcr0 & 0x6) != 0x6) //xmm and ymm state
+		return SimdLevel::SSE41;
+
+	CpuId(7, 0, info);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool bmi1 = (info[1] & (1 << 3)) != 0;
+	bool bmi2 = (info[1] & (1 << 8)) != 0;
+	bool avx512f  = (info[1] & (1 << 16)) != 0;
+	bool avx512bw = (info[1] & (1 << 30)) != 0;
+	bool avx512vl = (info[1] & (1u << 31)) != 0;
+
+	if (!avx2 || !bmi1 || !bmi2)
+		return SimdLevel::SSE41;
+	if (!avx512f || !avx512bw || !avx512vl || (xcr0 & 0xE6) != 0xE6) //opmask, zmm upper halves and zmm16-31 state
+		return SimdLevel::AVX2;
+	return SimdLevel::AVX512;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+static SimdLevel LevelFromEnvironment(SimdLevel detected)
+{
+	const char* env = std::getenv("SIMD_LEVEL");
+	if (!env)
+		return detected;
+
+	SimdLevel requested = detected;
+	for (int i = 0; i <= (int)SimdLevel::AVX512; i++)
+		if (std::strcmp(env, SimdLevelName((SimdLevel)i)) == 0)
+			requested = (SimdLevel)i;
+
+	return requested < detected ? requested : detected;
+}
+
+static SimdLevel s_detectedLevel = DetectSimdLevel();
+static SimdLevel s_activeLevel = LevelFromEnvironment(s_detectedLevel);
+
+SimdLevel GetSimdLevel()
+{
+	return s_activeLevel;
+}
+
+void SetSimdLevel(SimdLevel level)
+{
+	s_activeLevel = level < s_detectedLevel ? level : s_detectedLevel;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::SSE2:   return "sse2";
+	case SimdLevel::SSE41:  return "sse41";
+	case SimdLevel::AVX2:   return "avx2";
+	case SimdLevel::AVX512: return "avx512";
+	default:                return "scalar";
+	}
+}
+
+void* AlignedAlloc(size_t size, size_t alignment)
+{
+#if defined(_MSC_VER)
+	return _aligned_malloc(size, alignment);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, size) != 0)
+		return nullptr;
+	return ptr;
+#endif
+}
+
+void AlignedFree(void* ptr)
+{
+#if defined(_MSC_VER)
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <cstddef>
+
+//x86 is the only SIMD target, everything else runs the scalar paths
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif SIMD_X86 && !defined(__clang__)
+//g++'s AVX-512 intrinsics pass _mm512_undefined_*() as the unused source of the unmasked forms, which its own
+//uninitialized warnings then report wherever they are inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <x86intrin.h>
+#pragma GCC diagnostic pop
+#elif SIMD_X86
+#include <x86intrin.h>
+#endif
+
+//MSVC lets any function use any intrinsic, GCC/Clang need the instruction set named per function
+#if defined(_MSC_VER) || !SIMD_X86
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#else
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma,bmi,bmi2,popcnt")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx2,fma,bmi,bmi2,popcnt")))
+#endif
+
+//instruction set levels, each one implies the ones before it
+enum class SimdLevel
+{
+	Scalar = 0,
+	SSE2,
+	SSE41,
+	AVX2,
+	AVX512
+};
+
+//Returns the best level supported by both the CPU and the OS (detected once)
+//Can be lowered with SetSimdLevel() or the SIMD_LEVEL environment variable (scalar, sse2, sse41, avx2, avx512)
+SimdLevel GetSimdLevel();
+
+//Forces a lower level, mainly for benchmarks and comparing kernels against each other
+//Levels above what the CPU supports are clamped
+void SetSimdLevel(SimdLevel level);
+
+const char* SimdLevelName(SimdLevel level);
+
+//Index of the lowest set bit, v must not be 0
+inline int CountTrailingZeros(unsigned long long v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long bit;
+	_BitScanForward64(&bit, v);
+	return (int)bit;
+#elif defined(_MSC_VER)
+	unsigned long bit;
+	if (_BitScanForward(&bit, (unsigned long)v))
+		return (int)bit;
+	_BitScanForward(&bit, (unsigned long)(v >> 32));
+	return (int)bit + 32;
+#else
+	return __builtin_ctzll(v);
+#endif
+}
+
+//Index of the highest set bit, v must not be 0
+inline int HighestSetBit(unsigned int v)
+{
+#if defined(_MSC_VER)
+	unsigned long bit;
+	_BitScanReverse(&bit, (unsigned long)v);
+	return (int)bit;
+#else
+	return 31 - __builtin_clz(v);
+#endif
+}
+
+//Number of set bits, without relying on the POPCNT instruction
+inline int PopCount(unsigned long long v)
+{
+	v = v - ((v >> 1) & 0x5555555555555555ull);
+	v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return (int)((v * 0x0101010101010101ull) >> 56);
+}
+
+//64 byte aligned allocations so SoA arrays can be loaded with aligned AVX/AVX-512 loads
+void* AlignedAlloc(size_t size, size_t alignment = 64);
+void AlignedFree(void* ptr);
+
+//Minimal growable array with aligned storage, capacity is always a multiple of 16 elements
+//so SIMD loops can read whole registers past the end without going out of bounds
+//Only meant for trivially copyable types
+template<typename T>
+class AlignedArray
+{
+private:
+	T* m_data;
+	size_t m_size;
+	size_t m_capacity;
+
+public:
+	AlignedArray()
+		:m_data(nullptr), m_size(0), m_capacity(0)
+	{
+	}
+
+	~AlignedArray()
+	{
+		AlignedFree(m_data);
+	}
+
+	AlignedArray(const AlignedArray&) = delete;
+	AlignedArray& operator=(const AlignedArray&) = delete;
+
+	void reserve(size_t capacity)
+	{
+		if (capacity <= m_capacity)
+			return;
+
+		capacity = (capacity + 15) & ~size_t(15);
+		T* data = (T*)AlignedAlloc(capacity * sizeof(T));
+		for (size_t i = 0; i < m_size; i++)
+			data[i] = m_data[i];
+		for (size_t i = m_size; i < capacity; i++)
+			data[i] = T();
+
+		AlignedFree(m_data);
+		m_data = data;
+		m_capacity = capacity;
+	}
+
+	void resize(size_t size)
+	{
+		if (size > m_capacity)
+			reserve(size > m_capacity * 2 ? size : m_capacity * 2);
+		m_size = size;
+	}
+
+	void push_back(const T& value)
+	{
+		if (m_size == m_capacity)
+			reserve(m_capacity ? m_capacity * 2 : 16);
+		m_data[m_size++] = value;
+	}
+
+	void pop_back() { m_size--; }
+	void clear() { m_size = 0; }
+
+	T& operator[](size_t i) { return m_data[i]; }
+	const T& operator[](size_t i) const { return m_data[i]; }
+
+	T* data() { return m_data; }
+	const T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_capacity; }
+};
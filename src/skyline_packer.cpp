@@ -0,0 +1,100 @@
+#include "skyline_packer.h"
+
+SkylinePacker::SkylinePacker(unsigned int width, unsigned int height)
+{
+	reset(width, height);
+}
+
+void SkylinePacker::reset(unsigned int width, unsigned int height)
+{
+	m_width = width;
+	m_height = height;
+	m_usedArea = 0;
+	m_skyline.clear();
+	Segment floor = { 0, 0, width };
+	m_skyline.push_back(floor);
+}
+
+bool SkylinePacker::fits(unsigned int index, unsigned int width, unsigned int height, unsigned int& y) const
+{
+	unsigned int x = m_skyline[index].x;
+	if (x + width > m_width)
+		return false;
+
+	//the rectangle rests on the highest segment under it
+	y = 0;
+	unsigned int covered = 0;
+	for (unsigned int i = index; covered < width; i++)
+	{
+		if (m_skyline[i].y > y)
+			y = m_skyline[i].y;
+		if (y + height > m_height)
+			return false;
+		covered += m_skyline[i].width;
+	}
+	return true;
+}
+
+bool SkylinePacker::insert(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y)
+{
+	if (width == 0 || height == 0)
+		return false;
+
+	//lowest top edge wins, then the narrowest segment so wide ones stay available for wide rectangles
+	unsigned int bestIndex = (unsigned int)m_skyline.size();
+	unsigned int bestTop = m_height + 1, bestWidth = 0;
+	for (unsigned int i = 0; i < m_skyline.size(); i++)
+	{
+		unsigned int top;
+		if (!fits(i, width, height, top))
+			continue;
+
+		top += height;
+		if (top < bestTop || (top == bestTop && m_skyline[i].width < bestWidth))
+		{
+			bestIndex = i;
+			bestTop = top;
+			bestWidth = m_skyline[i].width;
+		}
+	}
+
+	if (bestIndex == m_skyline.size())
+		return false;
+
+	x = m_skyline[bestIndex].x;
+	y = bestTop - height;
+
+	//the new segment covers [x, x + width), segments under it are cut back or removed
+	Segment added = { x, bestTop, width };
+	m_skyline.insert(m_skyline.begin() + bestIndex, added);
+
+	unsigned int end = x + width;
+	unsigned int i = bestIndex + 1;
+	while (i < m_skyline.size() && m_skyline[i].x < end)
+	{
+		unsigned int segmentEnd = m_skyline[i].x + m_skyline[i].width;
+		if (segmentEnd <= end)
+		{
+			m_skyline.erase(m_skyline.begin() + i);
+			continue;
+		}
+		m_skyline[i].width = segmentEnd - end;
+		m_skyline[i].x = end;
+		break;
+	}
+
+	//neighbours at the same height become one segment
+	for (unsigned int j = bestIndex > 0 ? bestIndex - 1 : 0; j + 1 < m_skyline.size() && j <= bestIndex + 1;)
+	{
+		if (m_skyline[j].y == m_skyline[j + 1].y)
+		{
+			m_skyline[j].width += m_skyline[j + 1].width;
+			m_skyline.erase(m_skyline.begin() + j + 1);
+		}
+		else
+			j++;
+	}
+
+	m_usedArea += width * height;
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+//Packs rectangles into a fixed size bin with the skyline bottom-left heuristic
+//The packed area is described by its top contour, a list of horizontal segments, so an insert only looks at
+//those segments instead of every free rectangle: tens of thousands of small rectangles pack in milliseconds
+//Space can't be given back, TextureAtlas repacks a page instead
+class SkylinePacker
+{
+private:
+	struct Segment
+	{
+		unsigned int x, y, width;
+	};
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_usedArea;
+	std::vector<Segment> m_skyline;
+
+	//lowest y a width wide rectangle can sit at when its left edge is on segment index, false if it doesn't fit
+	bool fits(unsigned int index, unsigned int width, unsigned int height, unsigned int& y) const;
+
+public:
+	SkylinePacker(unsigned int width = 0, unsigned int height = 0);
+
+	void reset(unsigned int width, unsigned int height);
+
+	//Finds room for a width x height rectangle and returns its bottom-left corner, false when the bin is full
+	bool insert(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y);
+
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+
+	//Sum of the inserted areas, the space wasted under the skyline is what's left below its top
+	unsigned int getUsedArea() const { return m_usedArea; }
+};
@@ -0,0 +1,409 @@
+#include "soft_renderer.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const int SoftRenderer::TILE_SIZE;
+const int SoftRenderer::SUBPIXEL_BITS;
+
+//triangles are clipped to this many viewports around the real one so fixed point coordinates can't overflow
+static const float GUARD_BAND = 8.0f;
+
+SoftFramebuffer::SoftFramebuffer(unsigned int width, unsigned int height)
+	:m_width(width), m_height(height), m_color(width * height, 0), m_depth(width * height, 1.0f)
+{
+}
+
+static unsigned int PackColor(float r, float g, float b, float a)
+{
+	float c[4] = { r, g, b, a };
+	unsigned int packed = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		float v = c[i] < 0.0f ? 0.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+		packed |= (unsigned int)(v * 255.0f + 0.5f) << (i * 8);
+	}
+	return packed;
+}
+
+void SoftFramebuffer::clear(float r, float g, float b, float a)
+{
+	std::fill(m_color.begin(), m_color.end(), PackColor(r, g, b, a));
+}
+
+void SoftFramebuffer::clearDepth(float depth)
+{
+	std::fill(m_depth.begin(), m_depth.end(), depth);
+}
+
+void FetchAttribute(const unsigned char* vertex, const VertexBufferLayout& layout, unsigned int location, float out[4])
+{
+	out[0] = out[1] = out[2] = 0.0f;
+	out[3] = 1.0f;
+
+	const std::vector<VertexBufferElement>& elements = layout.getElements();
+	if (location >= elements.size())
+		return;
+
+	const VertexBufferElement& element = elements[location];
+	const unsigned char* data = vertex + layout.getOffset(location);
+	for (unsigned int i = 0; i < element.count && i < 4; i++)
+	{
+		switch (element.type)
+		{
+		case GL_FLOAT:
+			std::memcpy(&out[i], data + i * 4, 4);
+			break;
+		case GL_UNSIGNED_INT:
+		{
+			unsigned int v;
+			std::memcpy(&v, data + i * 4, 4);
+			out[i] = element.normalized ? v / 4294967295.0f : (float)v;
+			break;
+		}
+		case GL_UNSIGNED_BYTE:
+			out[i] = element.normalized ? data[i] / 255.0f : (float)data[i];
+			break;
+		}
+	}
+}
+
+FlatColorShader::FlatColorShader()
+{
+	setColor(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void FlatColorShader::setColor(float r, float g, float b, float a)
+{
+	m_color[0] = r;
+	m_color[1] = g;
+	m_color[2] = b;
+	m_color[3] = a;
+}
+
+void FlatColorShader::shadeVertices(const unsigned char* vertices, const VertexBufferLayout& layout,
+	unsigned int first, unsigned int count, SoftVertex* out) const
+{
+	unsigned int stride = layout.getStride();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		FetchAttribute(vertices + (first + i) * stride, layout, 0, out[i].position);
+		for (int c = 0; c < 4; c++)
+			out[i].varyings[c] = m_color[c];
+	}
+}
+
+void FlatColorShader::shadeFragments(SoftFragmentBatch& batch) const
+{
+	for (int c = 0; c < 4; c++)
+		for (int lane = 0; lane < SOFT_BATCH; lane++)
+			batch.color[c][lane] = batch.varyings[c][lane];
+}
+
+SoftRenderer::SoftRenderer(SoftFramebuffer& target)
+	:m_target(target), m_depthTest(false)
+{
+	m_tilesX = (target.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (target.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+//clip space planes as dot(plane, position) >= 0: near, far, then the guard band
+static const float CLIP_PLANES[7][4] =
+{
+	{ 0, 0,  1, 1 },
+	{ 0, 0, -1, 1 },
+	{  1,  0, 0, GUARD_BAND },
+	{ -1,  0, 0, GUARD_BAND },
+	{  0,  1, 0, GUARD_BAND },
+	{  0, -1, 0, GUARD_BAND },
+	{ 0, 0, 0, 1 } //w > 0, offset by a small epsilon below
+};
+
+static float PlaneDistance(int plane, const SoftVertex& v)
+{
+	const float* p = CLIP_PLANES[plane];
+	float d = p[0] * v.position[0] + p[1] * v.position[1] + p[2] * v.position[2] + p[3] * v.position[3];
+	return plane == 6 ? d - 1e-5f : d;
+}
+
+static SoftVertex LerpVertex(const SoftVertex& a, const SoftVertex& b, float t)
+{
+	SoftVertex v;
+	for (int i = 0; i < 4; i++)
+		v.position[i] = a.position[i] + (b.position[i] - a.position[i]) * t;
+	for (int i = 0; i < SOFT_MAX_VARYINGS; i++)
+		v.varyings[i] = a.varyings[i] + (b.varyings[i] - a.varyings[i]) * t;
+	return v;
+}
+
+void SoftRenderer::setupTriangles(const unsigned int* indices, unsigned int indexCount, unsigned int firstVertex)
+{
+	float width = (float)m_target.getWidth();
+	float height = (float)m_target.getHeight();
+	const float scale = (float)(1 << SUBPIXEL_BITS);
+
+	m_triangles.clear();
+	m_triangles.reserve(indexCount / 3);
+
+	for (unsigned int t = 0; t + 2 < indexCount; t += 3)
+	{
+		//every clip plane can add one vertex to the triangle
+		unsigned int polygon[3 + 7] = { indices[t] - firstVertex, indices[t + 1] - firstVertex, indices[t + 2] - firstVertex };
+		unsigned int polygonSize = 3;
+
+		//only triangles crossing a clip plane pay for clipping
+		unsigned int outside = 0;
+		for (int plane = 0; plane < 7; plane++)
+			for (int i = 0; i < 3; i++)
+				if (PlaneDistance(plane, m_vertices[polygon[i]]) < 0.0f)
+					outside |= 1u << plane;
+
+		for (int plane = 0; plane < 7 && polygonSize >= 3; plane++)
+		{
+			if (!(outside & (1u << plane)))
+				continue;
+
+			unsigned int clipped[3 + 7];
+			unsigned int clippedSize = 0;
+			for (unsigned int i = 0; i < polygonSize; i++)
+			{
+				unsigned int a = polygon[i], b = polygon[(i + 1) % polygonSize];
+				float da = PlaneDistance(plane, m_vertices[a]);
+				float db = PlaneDistance(plane, m_vertices[b]);
+
+				if (da >= 0.0f)
+					clipped[clippedSize++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f))
+				{
+					m_vertices.push_back(LerpVertex(m_vertices[a], m_vertices[b], da / (da - db)));
+					clipped[clippedSize++] = (unsigned int)m_vertices.size() - 1;
+				}
+			}
+			std::memcpy(polygon, clipped, sizeof(unsigned int) * clippedSize);
+			polygonSize = clippedSize;
+		}
+
+		//fan out whatever is left of the polygon
+		for (unsigned int i = 1; i + 1 < polygonSize; i++)
+		{
+			unsigned int v[3] = { polygon[0], polygon[i], polygon[i + 1] };
+			SoftTriangle tri;
+			for (int k = 0; k < 3; k++)
+			{
+				const float* p = m_vertices[v[k]].position;
+				float inverseW = 1.0f / p[3];
+				tri.x[k] = (int)std::lround((p[0] * inverseW * 0.5f + 0.5f) * width * scale);
+				tri.y[k] = (int)std::lround((p[1] * inverseW * 0.5f + 0.5f) * height * scale);
+				tri.z[k] = p[2] * inverseW * 0.5f + 0.5f;
+				tri.inverseW[k] = inverseW;
+				tri.vertex[k] = v[k];
+			}
+
+			long long area = (long long)(tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (long long)(tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+			if (area == 0)
+				continue;
+			if (area < 0)
+			{
+				//no face culling, clockwise triangles are flipped to counter-clockwise
+				std::swap(tri.x[1], tri.x[2]);
+				std::swap(tri.y[1], tri.y[2]);
+				std::swap(tri.z[1], tri.z[2]);
+				std::swap(tri.inverseW[1], tri.inverseW[2]);
+				std::swap(tri.vertex[1], tri.vertex[2]);
+				area = -area;
+			}
+
+			SetupRasterEdges(tri.x, tri.y, SUBPIXEL_BITS, tri.edges);
+			if (!RasterBounds(tri.x, tri.y, SUBPIXEL_BITS, (int)m_target.getWidth(), (int)m_target.getHeight(),
+				tri.minX, tri.minY, tri.maxX, tri.maxY))
+				continue;
+
+			tri.inverseArea = 1.0f / (float)area;
+			m_triangles.push_back(tri);
+		}
+	}
+}
+
+void SoftRenderer::binTriangles(unsigned int chunks)
+{
+	unsigned int tileCount = m_tilesX * m_tilesY;
+	m_bins.resize(chunks * tileCount);
+	for (std::vector<unsigned int>& bin : m_bins)
+		bin.clear();
+
+	//triangles are split into consecutive chunks binned in parallel, tiles walk the chunks in order
+	unsigned int triangleCount = (unsigned int)m_triangles.size();
+	unsigned int perChunk = (triangleCount + chunks - 1) / chunks;
+
+	GetThreadPool().parallelFor(chunks, 1, [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int c = first; c < last; c++)
+		{
+			unsigned int begin = c * perChunk;
+			unsigned int end = std::min(triangleCount, begin + perChunk);
+			std::vector<unsigned int>* bins = &m_bins[c * tileCount];
+
+			for (unsigned int t = begin; t < end; t++)
+			{
+				const SoftTriangle& tri = m_triangles[t];
+				for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++)
+					for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++)
+						bins[ty * m_tilesX + tx].push_back(t);
+			}
+		}
+	});
+}
+
+//Interpolates the varyings of the lanes in batch.mask, shades them and writes the results
+static void FlushBatch(const SoftShader& shader, const SoftVertex* vertices, const SoftTriangle& tri,
+	SoftFragmentBatch& batch, const float (*barycentric)[SOFT_BATCH], unsigned int varyingCount,
+	unsigned int* color, unsigned int width)
+{
+	const float* v0 = vertices[tri.vertex[0]].varyings;
+	const float* v1 = vertices[tri.vertex[1]].varyings;
+	const float* v2 = vertices[tri.vertex[2]].varyings;
+
+	for (int lane = 0; lane < SOFT_BATCH; lane++)
+	{
+		//perspective correct weights
+		float w0 = barycentric[0][lane] * tri.inverseW[0];
+		float w1 = barycentric[1][lane] * tri.inverseW[1];
+		float w2 = barycentric[2][lane] * tri.inverseW[2];
+		float normalize = 1.0f / (w0 + w1 + w2);
+		w0 *= normalize;
+		w1 *= normalize;
+		w2 *= normalize;
+
+		for (unsigned int v = 0; v < varyingCount; v++)
+			batch.varyings[v][lane] = w0 * v0[v] + w1 * v1[v] + w2 * v2[v];
+	}
+
+	shader.shadeFragments(batch);
+
+	for (int lane = 0; lane < SOFT_BATCH; lane++)
+		if (batch.mask & (1u << lane))
+			color[batch.y[lane] * width + batch.x[lane]] = PackColor(batch.color[0][lane], batch.color[1][lane], batch.color[2][lane], batch.color[3][lane]);
+}
+
+void SoftRenderer::rasterizeTile(const SoftShader& shader, unsigned int tile, unsigned int chunks, BlockCoverageFn coverage)
+{
+	unsigned int tileCount = m_tilesX * m_tilesY;
+	int tileX = (int)(tile % m_tilesX) * TILE_SIZE;
+	int tileY = (int)(tile / m_tilesX) * TILE_SIZE;
+	int tileMaxX = std::min(tileX + TILE_SIZE, (int)m_target.getWidth()) - 1;
+	int tileMaxY = std::min(tileY + TILE_SIZE, (int)m_target.getHeight()) - 1;
+
+	unsigned int width = m_target.getWidth();
+	unsigned int* color = m_target.color();
+	float* depth = m_target.depth();
+	unsigned int varyingCount = std::min(shader.varyingCount(), (unsigned int)SOFT_MAX_VARYINGS);
+
+	CoverageBlock blocks[(TILE_SIZE / RASTER_BLOCK_SIZE) * (TILE_SIZE / RASTER_BLOCK_SIZE)];
+	SoftFragmentBatch batch;
+	std::memset(&batch, 0, sizeof(batch));
+	float barycentric[3][SOFT_BATCH] = {};
+
+	for (unsigned int c = 0; c < chunks; c++)
+	{
+		for (unsigned int t : m_bins[c * tileCount + tile])
+		{
+			const SoftTriangle& tri = m_triangles[t];
+			int minX = std::max(tri.minX, tileX), maxX = std::min(tri.maxX, tileMaxX);
+			int minY = std::max(tri.minY, tileY), maxY = std::min(tri.maxY, tileMaxY);
+
+			unsigned int blockCount = RasterizeBlocks(tri.edges, minX, minY, maxX, maxY, coverage, blocks);
+
+			int lane = 0;
+			batch.mask = 0;
+			for (unsigned int i = 0; i < blockCount; i++)
+			{
+				unsigned long long mask = blocks[i].mask;
+				while (mask)
+				{
+					int bit = CountTrailingZeros(mask);
+					mask &= mask - 1;
+
+					int x = blocks[i].x + (bit & 7);
+					int y = blocks[i].y + (bit >> 3);
+
+					//edge k weights the vertex opposite to it
+					float e[3];
+					for (int k = 0; k < 3; k++)
+						e[k] = (float)(tri.edges.c[k] + (long long)tri.edges.a[k] * x + (long long)tri.edges.b[k] * y);
+					float b0 = e[1] * tri.inverseArea;
+					float b1 = e[2] * tri.inverseArea;
+					float b2 = e[0] * tri.inverseArea;
+
+					if (m_depthTest)
+					{
+						float z = b0 * tri.z[0] + b1 * tri.z[1] + b2 * tri.z[2];
+						float& stored = depth[y * width + x];
+						if (!(z < stored))
+							continue;
+						stored = z;
+					}
+
+					batch.x[lane] = x;
+					batch.y[lane] = y;
+					barycentric[0][lane] = b0;
+					barycentric[1][lane] = b1;
+					barycentric[2][lane] = b2;
+					batch.mask |= 1u << lane;
+
+					if (++lane == SOFT_BATCH)
+					{
+						FlushBatch(shader, m_vertices.data(), tri, batch, barycentric, varyingCount, color, width);
+						lane = 0;
+						batch.mask = 0;
+					}
+				}
+			}
+
+			if (batch.mask)
+			{
+				//unused lanes get valid weights so the interpolation stays finite
+				for (int l = lane; l < SOFT_BATCH; l++)
+				{
+					barycentric[0][l] = 1.0f;
+					barycentric[1][l] = barycentric[2][l] = 0.0f;
+				}
+				FlushBatch(shader, m_vertices.data(), tri, batch, barycentric, varyingCount, color, width);
+			}
+		}
+	}
+}
+
+void SoftRenderer::drawElements(const SoftShader& shader, const void* vertices, const VertexBufferLayout& layout,
+	const unsigned int* indices, unsigned int indexCount)
+{
+	if (indexCount < 3)
+		return;
+
+	//only the referenced range of the vertex buffer is transformed
+	unsigned int firstVertex = *std::min_element(indices, indices + indexCount);
+	unsigned int lastVertex = *std::max_element(indices, indices + indexCount);
+	unsigned int vertexCount = lastVertex - firstVertex + 1;
+
+	m_vertices.resize(vertexCount);
+	const unsigned char* data = (const unsigned char*)vertices;
+	SoftVertex* out = m_vertices.data();
+	GetThreadPool().parallelFor(vertexCount, 1024, [&](unsigned int begin, unsigned int end)
+	{
+		shader.shadeVertices(data, layout, firstVertex + begin, end - begin, out + begin);
+	});
+
+	setupTriangles(indices, indexCount, firstVertex);
+	if (m_triangles.empty())
+		return;
+
+	unsigned int chunks = std::min(GetThreadPool().workerCount() + 1, (unsigned int)m_triangles.size() / 256 + 1);
+	binTriangles(chunks);
+
+	BlockCoverageFn coverage = GetBlockCoverageFn(GetSimdLevel());
+	GetThreadPool().parallelFor(m_tilesX * m_tilesY, 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int tile = begin; tile < end; tile++)
+			rasterizeTile(shader, tile, chunks, coverage);
+	});
+}
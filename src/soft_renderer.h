@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include "raster_kernels.h"
+#include "vertex_buffer_layout.h"
+
+//Maximum number of floats a vertex stage can pass to the fragment stage
+static const int SOFT_MAX_VARYINGS = 8;
+
+//Number of fragments handed to a fragment stage at once
+static const int SOFT_BATCH = 8;
+
+//CPU color + depth target
+//Rows are stored bottom to top like OpenGL, colors are RGBA8 with R in the lowest byte
+class SoftFramebuffer
+{
+private:
+	unsigned int m_width;
+	unsigned int m_height;
+	std::vector<unsigned int> m_color;
+	std::vector<float> m_depth;
+
+public:
+	SoftFramebuffer(unsigned int width, unsigned int height);
+
+	void clear(float r, float g, float b, float a);
+	void clearDepth(float depth = 1.0f);
+
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+	unsigned int* color() { return m_color.data(); }
+	const unsigned int* color() const { return m_color.data(); }
+	float* depth() { return m_depth.data(); }
+};
+
+//Output of the vertex stage, position is in clip space
+struct SoftVertex
+{
+	float position[4];
+	float varyings[SOFT_MAX_VARYINGS];
+};
+
+//Fragments are shaded in batches of SOFT_BATCH, varyings and colors are structure of arrays: [component][lane]
+struct SoftFragmentBatch
+{
+	unsigned int mask; //bit i set when lane i holds a fragment
+	int x[SOFT_BATCH];
+	int y[SOFT_BATCH];
+	float varyings[SOFT_MAX_VARYINGS][SOFT_BATCH];
+	float color[4][SOFT_BATCH];
+};
+
+//Programmable stages of the CPU renderer
+class SoftShader
+{
+public:
+	virtual ~SoftShader() {}
+
+	virtual unsigned int varyingCount() const = 0;
+
+	//Transforms vertices [first, first + count) of a vertex buffer, out[i] receives vertex first + i
+	virtual void shadeVertices(const unsigned char* vertices, const VertexBufferLayout& layout,
+		unsigned int first, unsigned int count, SoftVertex* out) const = 0;
+
+	//Fills batch.color for the lanes in batch.mask
+	virtual void shadeFragments(SoftFragmentBatch& batch) const = 0;
+};
+
+//Reads attribute `location` of a vertex as a vec4, missing components default to (0, 0, 0, 1) like OpenGL
+void FetchAttribute(const unsigned char* vertex, const VertexBufferLayout& layout, unsigned int location, float out[4]);
+
+//CPU version of res/shaders: the position attribute goes through unchanged and every fragment gets u_Color
+class FlatColorShader : public SoftShader
+{
+private:
+	float m_color[4];
+
+public:
+	FlatColorShader();
+
+	void setColor(float r, float g, float b, float a);
+
+	unsigned int varyingCount() const override { return 4; }
+	void shadeVertices(const unsigned char* vertices, const VertexBufferLayout& layout,
+		unsigned int first, unsigned int count, SoftVertex* out) const override;
+	void shadeFragments(SoftFragmentBatch& batch) const override;
+};
+
+//Screen space triangle ready for rasterization
+struct SoftTriangle
+{
+	int x[3], y[3];               //vertices in 28.4 fixed point
+	RasterEdges edges;            //edge k runs from vertex k to vertex k + 1 and weights the vertex opposite to it
+	int minX, minY, maxX, maxY;   //pixel bounds, clamped to the framebuffer
+	float inverseArea;
+	float z[3];
+	float inverseW[3];
+	unsigned int vertex[3];       //indices into the post-transform vertex array
+};
+
+//Tiled CPU rasterizer
+//Triangles are binned into TILE_SIZE x TILE_SIZE screen tiles, then the tiles are rasterized in parallel
+//with the 8x8 block coverage kernels of raster_kernels.h
+//Each tile keeps primitive order, so the output matches drawing the triangles one by one
+class SoftRenderer
+{
+private:
+	SoftFramebuffer& m_target;
+	bool m_depthTest;
+
+	std::vector<SoftVertex> m_vertices;
+	std::vector<SoftTriangle> m_triangles;
+	std::vector<std::vector<unsigned int>> m_bins; //[chunk * tileCount + tile] -> triangle indices
+
+	unsigned int m_tilesX;
+	unsigned int m_tilesY;
+
+	void setupTriangles(const unsigned int* indices, unsigned int indexCount, unsigned int firstVertex);
+	void binTriangles(unsigned int chunks);
+	void rasterizeTile(const SoftShader& shader, unsigned int tile, unsigned int chunks, BlockCoverageFn coverage);
+
+public:
+	static const int TILE_SIZE = 64;
+	static const int SUBPIXEL_BITS = 4;
+
+	explicit SoftRenderer(SoftFramebuffer& target);
+
+	//Matches GL_DEPTH_TEST with glDepthFunc(GL_LESS), off by default like in OpenGL
+	void setDepthTest(bool enabled) { m_depthTest = enabled; }
+
+	//Equivalent of glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, ...) with the vertex buffer bound through layout
+	void drawElements(const SoftShader& shader, const void* vertices, const VertexBufferLayout& layout,
+		const unsigned int* indices, unsigned int indexCount);
+};
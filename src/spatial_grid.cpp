@@ -0,0 +1,290 @@
+#include "spatial_grid.h"
+#include "thread_pool.h"
+#include <cmath>
+
+const unsigned int SpatialGrid::OVERSIZED;
+const unsigned int SpatialGrid::FREE;
+const unsigned int SpatialGrid::EMPTY;
+
+static unsigned int HashCell(int x, int y)
+{
+	unsigned int h = (unsigned int)x * 0x9E3779B1u ^ (unsigned int)y * 0x85EBCA77u;
+	return h ^ (h >> 15);
+}
+
+SpatialGrid::SpatialGrid(float cellSize)
+	:m_cellSize(cellSize), m_inverseCellSize(1.0f / cellSize)
+{
+	m_table.assign(64, EMPTY);
+}
+
+int SpatialGrid::cellCoord(float v) const
+{
+	return (int)std::floor(v * m_inverseCellSize);
+}
+
+bool SpatialGrid::isOversized(float halfWidth, float halfHeight) const
+{
+	float limit = m_cellSize * 0.5f;
+	return halfWidth > limit || halfHeight > limit;
+}
+
+unsigned int SpatialGrid::findCell(int x, int y) const
+{
+	unsigned int mask = (unsigned int)m_table.size() - 1;
+	for (unsigned int i = HashCell(x, y) & mask;; i = (i + 1) & mask)
+	{
+		unsigned int cell = m_table[i];
+		if (cell == EMPTY)
+			return EMPTY;
+		if (m_cells[cell].x == x && m_cells[cell].y == y)
+			return cell;
+	}
+}
+
+unsigned int SpatialGrid::findOrCreateCell(int x, int y)
+{
+	unsigned int mask = (unsigned int)m_table.size() - 1;
+	unsigned int i = HashCell(x, y) & mask;
+	for (;; i = (i + 1) & mask)
+	{
+		unsigned int cell = m_table[i];
+		if (cell == EMPTY)
+			break;
+		if (m_cells[cell].x == x && m_cells[cell].y == y)
+			return cell;
+	}
+
+	unsigned int cell = (unsigned int)m_cells.size();
+	m_cells.push_back(Cell());
+	m_cells.back().x = x;
+	m_cells.back().y = y;
+	m_table[i] = cell;
+
+	//keep the table at most half full so probe sequences stay short
+	if (m_cells.size() * 2 > m_table.size())
+		rehash((unsigned int)m_table.size() * 2);
+	return cell;
+}
+
+void SpatialGrid::rehash(unsigned int capacity)
+{
+	m_table.assign(capacity, EMPTY);
+	unsigned int mask = capacity - 1;
+	for (unsigned int cell = 0; cell < m_cells.size(); cell++)
+	{
+		unsigned int i = HashCell(m_cells[cell].x, m_cells[cell].y) & mask;
+		while (m_table[i] != EMPTY)
+			i = (i + 1) & mask;
+		m_table[i] = cell;
+	}
+}
+
+void SpatialGrid::place(const GridEntry& entry)
+{
+	Record& record = m_records[entry.id];
+	if (isOversized(entry.halfWidth, entry.halfHeight))
+	{
+		record.cell = OVERSIZED;
+		record.slot = (unsigned int)m_oversized.size();
+		m_oversized.push_back(entry);
+		return;
+	}
+
+	unsigned int cell = findOrCreateCell(cellCoord(entry.x), cellCoord(entry.y));
+	record.cell = cell;
+	record.slot = (unsigned int)m_cells[cell].entries.size();
+	m_cells[cell].entries.push_back(entry);
+}
+
+void SpatialGrid::unplace(unsigned int id)
+{
+	Record& record = m_records[id];
+	std::vector<GridEntry>& entries = record.cell == OVERSIZED ? m_oversized : m_cells[record.cell].entries;
+
+	//swap with the last entry so the array stays dense
+	if (record.slot != entries.size() - 1)
+	{
+		entries[record.slot] = entries.back();
+		m_records[entries[record.slot].id].slot = record.slot;
+	}
+	entries.pop_back();
+	record.cell = FREE;
+}
+
+unsigned int SpatialGrid::insert(float x, float y, float halfWidth, float halfHeight)
+{
+	unsigned int id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = (unsigned int)m_records.size();
+		m_records.push_back(Record());
+	}
+
+	GridEntry entry = { id, x, y, halfWidth, halfHeight };
+	place(entry);
+	return id;
+}
+
+void SpatialGrid::remove(unsigned int id)
+{
+	unplace(id);
+	m_freeIds.push_back(id);
+}
+
+const GridEntry& SpatialGrid::entry(unsigned int id) const
+{
+	const Record& record = m_records[id];
+	return record.cell == OVERSIZED ? m_oversized[record.slot] : m_cells[record.cell].entries[record.slot];
+}
+
+void SpatialGrid::move(unsigned int id, float x, float y)
+{
+	Record& record = m_records[id];
+	GridEntry& current = record.cell == OVERSIZED ? m_oversized[record.slot] : m_cells[record.cell].entries[record.slot];
+
+	const Cell* cell = record.cell == OVERSIZED ? nullptr : &m_cells[record.cell];
+	if (!cell || (cell->x == cellCoord(x) && cell->y == cellCoord(y)))
+	{
+		current.x = x;
+		current.y = y;
+		return;
+	}
+
+	GridEntry moved = current;
+	moved.x = x;
+	moved.y = y;
+	unplace(id);
+	place(moved);
+}
+
+void SpatialGrid::resize(unsigned int id, float halfWidth, float halfHeight)
+{
+	GridEntry resized = entry(id);
+	resized.halfWidth = halfWidth;
+	resized.halfHeight = halfHeight;
+	unplace(id);
+	place(resized);
+}
+
+void SpatialGrid::moveBatch(const GridMove* moves, unsigned int count)
+{
+	//first pass, in parallel: moves inside the same cell only touch their own entry
+	m_crossesCell.resize(count);
+	unsigned char* crosses = m_crossesCell.data();
+
+	GetThreadPool().parallelFor(count, 4096, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const GridMove& m = moves[i];
+			const Record& record = m_records[m.id];
+
+			if (record.cell == OVERSIZED)
+			{
+				m_oversized[record.slot].x = m.x;
+				m_oversized[record.slot].y = m.y;
+				crosses[i] = 0;
+				continue;
+			}
+
+			Cell& cell = m_cells[record.cell];
+			if (cell.x == cellCoord(m.x) && cell.y == cellCoord(m.y))
+			{
+				cell.entries[record.slot].x = m.x;
+				cell.entries[record.slot].y = m.y;
+				crosses[i] = 0;
+			}
+			else
+				crosses[i] = 1;
+		}
+	});
+
+	//second pass changes cell arrays and the hash table, so it runs on this thread
+	for (unsigned int i = 0; i < count; i++)
+		if (crosses[i])
+			move(moves[i].id, moves[i].x, moves[i].y);
+}
+
+void SpatialGrid::query(const GridRect& rect, std::vector<GridSpan>& out) const
+{
+	//a cell's entries can reach half a cell outside of it
+	float margin = m_cellSize * 0.5f;
+	int minX = cellCoord(rect.minX - margin), maxX = cellCoord(rect.maxX + margin);
+	int minY = cellCoord(rect.minY - margin), maxY = cellCoord(rect.maxY + margin);
+
+	double rectCells = ((double)maxX - minX + 1) * ((double)maxY - minY + 1);
+	if (rectCells > (double)m_cells.size())
+	{
+		//the rectangle covers more cells than exist, scanning the existing ones is cheaper
+		for (const Cell& cell : m_cells)
+			if (!cell.entries.empty() && cell.x >= minX && cell.x <= maxX && cell.y >= minY && cell.y <= maxY)
+				out.push_back({ cell.entries.data(), (unsigned int)cell.entries.size() });
+	}
+	else
+	{
+		for (int y = minY; y <= maxY; y++)
+			for (int x = minX; x <= maxX; x++)
+			{
+				unsigned int cell = findCell(x, y);
+				if (cell != EMPTY && !m_cells[cell].entries.empty())
+					out.push_back({ m_cells[cell].entries.data(), (unsigned int)m_cells[cell].entries.size() });
+			}
+	}
+
+	if (!m_oversized.empty())
+		out.push_back({ m_oversized.data(), (unsigned int)m_oversized.size() });
+}
+
+void SpatialGrid::queryIds(const GridRect& rect, std::vector<unsigned int>& out) const
+{
+	std::vector<GridSpan> spans;
+	query(rect, spans);
+
+	for (const GridSpan& span : spans)
+		for (unsigned int i = 0; i < span.count; i++)
+		{
+			const GridEntry& e = span.entries[i];
+			if (e.x + e.halfWidth >= rect.minX && e.x - e.halfWidth <= rect.maxX &&
+			    e.y + e.halfHeight >= rect.minY && e.y - e.halfHeight <= rect.maxY)
+				out.push_back(e.id);
+		}
+}
+
+void SpatialGrid::shrink()
+{
+	unsigned int kept = 0;
+	for (unsigned int cell = 0; cell < m_cells.size(); cell++)
+	{
+		if (m_cells[cell].entries.empty())
+			continue;
+
+		if (kept != cell)
+		{
+			m_cells[kept] = std::move(m_cells[cell]);
+			for (const GridEntry& e : m_cells[kept].entries)
+				m_records[e.id].cell = kept;
+		}
+		kept++;
+	}
+	m_cells.resize(kept);
+
+	unsigned int capacity = 64;
+	while (capacity < m_cells.size() * 2)
+		capacity *= 2;
+	rehash(capacity);
+}
+
+void SpatialGrid::clear()
+{
+	m_cells.clear();
+	m_table.assign(64, EMPTY);
+	m_oversized.clear();
+	m_records.clear();
+	m_freeIds.clear();
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+
+struct GridRect
+{
+	float minX, minY;
+	float maxX, maxY;
+};
+
+struct GridEntry
+{
+	unsigned int id;
+	float x, y; //center
+	float halfWidth, halfHeight;
+};
+
+//Contiguous run of entries returned by a query, all entries of one cell
+struct GridSpan
+{
+	const GridEntry* entries;
+	unsigned int count;
+};
+
+struct GridMove
+{
+	unsigned int id;
+	float x, y;
+};
+
+//Loose uniform grid over an unbounded 2D plane, cells are found through a hash of their coordinates
+//Objects belong to the cell containing their center, so a cell's contents can stick out of it by up to
+//half a cell in every direction; queries grow the rectangle by that margin instead of tracking real bounds.
+//Objects bigger than a cell go to a separate list that every query returns.
+//Insert, remove and move are O(1): every cell keeps its entries in one dense array and removal swaps with the last one
+class SpatialGrid
+{
+private:
+	struct Cell
+	{
+		int x, y;
+		std::vector<GridEntry> entries;
+	};
+
+	struct Record
+	{
+		unsigned int cell; //index in m_cells, OVERSIZED for the oversized list, FREE for unused ids
+		unsigned int slot;
+	};
+
+	float m_cellSize;
+	float m_inverseCellSize;
+
+	std::vector<Cell> m_cells;
+	std::vector<unsigned int> m_table; //open addressing hash table of cell indices, EMPTY for free buckets
+	std::vector<GridEntry> m_oversized;
+
+	std::vector<Record> m_records; //indexed by id
+	std::vector<unsigned int> m_freeIds;
+
+	std::vector<unsigned char> m_crossesCell; //scratch for moveBatch()
+
+	unsigned int findCell(int x, int y) const;
+	unsigned int findOrCreateCell(int x, int y);
+	void rehash(unsigned int capacity);
+
+	bool isOversized(float halfWidth, float halfHeight) const;
+	int cellCoord(float v) const;
+	void place(const GridEntry& entry);
+	void unplace(unsigned int id);
+
+public:
+	static const unsigned int OVERSIZED = 0xFFFFFFFEu;
+	static const unsigned int FREE = 0xFFFFFFFFu;
+	static const unsigned int EMPTY = 0xFFFFFFFFu;
+
+	explicit SpatialGrid(float cellSize);
+
+	//Returns the id of the new object, ids are reused after remove()
+	unsigned int insert(float x, float y, float halfWidth, float halfHeight);
+	void remove(unsigned int id);
+	void move(unsigned int id, float x, float y);
+	void resize(unsigned int id, float halfWidth, float halfHeight);
+
+	//Applies many moves at once, moves that stay in their cell are applied in parallel
+	//Every id may only appear once per batch
+	void moveBatch(const GridMove* moves, unsigned int count);
+
+	//Appends one span per non-empty cell that can overlap rect, plus the oversized objects
+	//Spans stay valid until the grid is modified
+	void query(const GridRect& rect, std::vector<GridSpan>& out) const;
+
+	//Same as query() but tests every entry and appends the ids that really overlap rect
+	void queryIds(const GridRect& rect, std::vector<unsigned int>& out) const;
+
+	//Drops the cells that became empty, invalidates spans
+	void shrink();
+	void clear();
+
+	const GridEntry& entry(unsigned int id) const;
+	float cellSize() const { return m_cellSize; }
+	unsigned int cellCount() const { return (unsigned int)m_cells.size(); }
+};
@@ -0,0 +1,489 @@
+#include "texture.h"
+#include <cstring>
+#include <iostream>
+#include "mipmap.h"
+#include "renderer.h"
+
+static void SetDefaultParameters(bool mipmaps)
+{
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+}
+
+static size_t LevelBytes(const TextureLevels& levels)
+{
+	size_t bytes = 0;
+	for (const TextureLevelData& level : levels.levels)
+		bytes += level.size;
+	return bytes;
+}
+
+void TextureLevelsFromImages(const std::vector<Image>& images, bool srgb, TextureLevels& levels)
+{
+	levels.compressed = false;
+	levels.srgb = srgb;
+	levels.levels.clear();
+	for (const Image& image : images)
+	{
+		TextureLevelData level = { image.width, image.height, (const unsigned char*)image.pixels.data(), image.pixels.size() * sizeof(unsigned int) };
+		levels.levels.push_back(level);
+	}
+}
+
+unsigned int TextureInternalFormat(const TextureLevels& levels)
+{
+	if (!levels.compressed)
+		return levels.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+	switch (levels.format)
+	{
+	case BlockFormat::BC1: return levels.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case BlockFormat::BC3: return levels.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+	case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+	default:               return levels.srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+//storage for every level of the bound texture, without the pixels
+static void AllocateLevels(const TextureLevels& levels)
+{
+	GLenum internalFormat = TextureInternalFormat(levels);
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)levels.levels.size() - 1));
+	for (unsigned int i = 0; i < levels.levels.size(); i++)
+	{
+		const TextureLevelData& level = levels.levels[i];
+		if (levels.compressed)
+		{
+			GLCall(glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, (GLsizei)level.size, nullptr));
+		}
+		else
+		{
+			GLCall(glTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+		}
+	}
+}
+
+//pixels is a pointer, or an offset while an unpack buffer is bound
+static void UploadLevel(const TextureLevels& levels, unsigned int i, const void* pixels)
+{
+	const TextureLevelData& level = levels.levels[i];
+	if (levels.compressed)
+	{
+		GLCall(glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, TextureInternalFormat(levels), (GLsizei)level.size, pixels));
+	}
+	else
+	{
+		GLCall(glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+	}
+}
+
+Texture::Texture(const std::string& path, bool mipmaps)
+	:m_RendererID(0), m_width(0), m_height(0), m_levels(0), m_mipmaps(mipmaps), m_state(TextureState::Loading), m_loadID(0)
+{
+	GLCall(glGenTextures(1, &m_RendererID));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererID));
+	SetDefaultParameters(mipmaps);
+
+	GetTextureLoader().load(*this, path);
+}
+
+Texture::Texture(const Image& image, bool mipmaps)
+	:m_RendererID(0), m_width(image.width), m_height(image.height), m_levels(1), m_mipmaps(mipmaps), m_state(TextureState::Ready), m_loadID(0)
+{
+	GLCall(glGenTextures(1, &m_RendererID));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererID));
+	SetDefaultParameters(mipmaps);
+	if (!mipmaps)
+	{
+		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+		GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data()));
+		return;
+	}
+
+	std::vector<Image> levels;
+	GenerateMipmaps(image, MipOptions(), levels);
+	m_levels = (unsigned int)levels.size();
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)m_levels - 1));
+	for (unsigned int i = 0; i < m_levels; i++)
+	{
+		GLCall(glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, levels[i].width, levels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[i].pixels.data()));
+	}
+}
+
+Texture::~Texture()
+{
+	if (m_loadID)
+		GetTextureLoader().cancel(*this);
+	GLCall(glDeleteTextures(1, &m_RendererID));
+}
+
+void Texture::bind(unsigned int slot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+	GLCall(glBindTexture(GL_TEXTURE_2D, isReady() ? m_RendererID : GetTextureLoader().getPlaceholder()));
+}
+
+void Texture::unbind(unsigned int slot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+TextureLoader::TextureLoader(unsigned int threadCount)
+	:m_decoding(0), m_nextLoadID(1), m_placeholder(0), m_uploadBudget(16 << 20), m_s3tc(GLEW_EXT_texture_compression_s3tc != 0),
+	m_bptc(GLEW_ARB_texture_compression_bptc != 0), m_stopping(false), m_threads(threadCount ? threadCount : 2)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	//queued tasks are skipped, the running ones finish before the members they use go away
+	m_stopping = true;
+	m_threads.wait(m_tasks);
+}
+
+void TextureLoader::destroy()
+{
+	m_stopping = true;
+	m_threads.wait(m_tasks);
+
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	for (Staging& staging : m_staging)
+	{
+		if (staging.mapped)
+		{
+			GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer));
+			GLCall(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+			GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+			staging.mapped = nullptr;
+		}
+		if (staging.fence)
+		{
+			GLCall(glDeleteSync((GLsync)staging.fence));
+			staging.fence = nullptr;
+		}
+		if (staging.buffer)
+		{
+			GLCall(glDeleteBuffers(1, &staging.buffer));
+			staging.buffer = 0;
+		}
+		staging.capacity = 0;
+		staging.state = StagingState::Free;
+		staging.source = Decoded();
+	}
+	if (m_placeholder)
+	{
+		GLCall(glDeleteTextures(1, &m_placeholder));
+		m_placeholder = 0;
+	}
+
+	for (auto& load : m_loads)
+	{
+		load.second->m_state = TextureState::Failed;
+		load.second->m_loadID = 0;
+	}
+	m_loads.clear();
+	m_waitingDecode.clear();
+	m_waitingUpload.clear();
+	m_decoded.clear();
+	m_decoding = 0;
+}
+
+void TextureLoader::load(Texture& texture, const std::string& path)
+{
+	unsigned int loadID = m_nextLoadID++;
+	if (m_nextLoadID == 0)
+		m_nextLoadID = 1;
+
+	texture.m_loadID = loadID;
+	texture.m_state = TextureState::Loading;
+	m_loads[loadID] = &texture;
+	m_waitingDecode.push_back(std::make_pair(loadID, path));
+	startDecodes();
+}
+
+bool TextureLoader::mapTextureFile(const std::string& path, Decoded& decoded) const
+{
+	decoded.file.reset(new MappedFile());
+	std::string error;
+	if (!decoded.file->open(path))
+		error = "can't open the file";
+	else if (ParseTextureFile(decoded.file->data(), decoded.file->size(), decoded.levels, error))
+	{
+		BlockFormat format = decoded.levels.format;
+		bool supported = !decoded.levels.compressed || format == BlockFormat::BC4 || format == BlockFormat::BC5 ||
+			(format == BlockFormat::BC7 ? m_bptc : m_s3tc);
+		if (supported)
+			return true;
+
+		//the GPU can't sample the format, decompress it here and let the file go
+		for (const TextureLevelData& level : decoded.levels.levels)
+		{
+			CompressedImage compressed;
+			compressed.format = format;
+			compressed.width = level.width;
+			compressed.height = level.height;
+			compressed.data.assign(level.data, level.data + level.size);
+			decoded.images.emplace_back();
+			DecompressImage(compressed, decoded.images.back());
+		}
+		TextureLevelsFromImages(decoded.images, decoded.levels.srgb, decoded.levels);
+		decoded.file.reset();
+		return true;
+	}
+
+	std::cout << "failed to load texture " << path << ": " << error << "\n";
+	decoded.file.reset();
+	return false;
+}
+
+void TextureLoader::startDecodes()
+{
+	//only a few files in flight, so copies into staging buffers don't queue behind hundreds of decodes
+	//and decoded pixels don't pile up faster than they can be uploaded
+	unsigned int maxDecoding = m_threads.workerCount() * 2;
+	while (!m_waitingDecode.empty() && m_decoding < maxDecoding && m_waitingUpload.size() < STAGING_BUFFERS * 2)
+	{
+		unsigned int loadID = m_waitingDecode.front().first;
+		std::string path = std::move(m_waitingDecode.front().second);
+		m_waitingDecode.pop_front();
+		auto it = m_loads.find(loadID);
+		if (it == m_loads.end())
+			continue;
+
+		bool mipmaps = it->second->m_mipmaps;
+		m_decoding++;
+		m_threads.submit([this, loadID, path, mipmaps]
+		{
+			if (m_stopping)
+				return;
+
+			Decoded decoded;
+			decoded.loadID = loadID;
+			if (IsTextureFilePath(path))
+				decoded.ok = mapTextureFile(path, decoded);
+			else
+			{
+				Image image;
+				decoded.ok = LoadTGA(path, image);
+				if (!decoded.ok)
+					std::cout << "failed to load texture " << path << "\n";
+				else if (mipmaps)
+					GenerateMipmaps(image, MipOptions(), decoded.images);
+				else
+					decoded.images.push_back(std::move(image));
+				TextureLevelsFromImages(decoded.images, false, decoded.levels);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_decoded.push_back(std::move(decoded));
+		}, &m_tasks);
+	}
+}
+
+void TextureLoader::cancel(Texture& texture)
+{
+	m_loads.erase(texture.m_loadID);
+	texture.m_loadID = 0;
+}
+
+void TextureLoader::startUpload(Staging& staging, Decoded& decoded)
+{
+	Texture& texture = *m_loads[decoded.loadID];
+	texture.m_width = decoded.levels.levels[0].width;
+	texture.m_height = decoded.levels.levels[0].height;
+	texture.m_levels = (unsigned int)decoded.levels.levels.size();
+	texture.m_state = TextureState::Uploading;
+	unsigned int bytes = (unsigned int)LevelBytes(decoded.levels);
+
+	//allocate the storage now so glTexSubImage2D only has to move pixels
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	GLCall(glBindTexture(GL_TEXTURE_2D, texture.m_RendererID));
+	AllocateLevels(decoded.levels);
+
+	if (!staging.buffer)
+	{
+		GLCall(glGenBuffers(1, &staging.buffer));
+	}
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer));
+	if (staging.capacity < bytes)
+	{
+		GLCall(glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW));
+		staging.capacity = bytes;
+	}
+
+	//the buffer's last fence has signaled, so there's nothing to synchronize with
+	void* mapped = nullptr;
+	if (bytes)
+	{
+		GLCall(mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	}
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+	if (!mapped)
+	{
+		//no staging memory, upload from the decoded pixels or the mapped file instead
+		for (unsigned int i = 0; i < decoded.levels.levels.size(); i++)
+			UploadLevel(decoded.levels, i, decoded.levels.levels[i].data);
+		texture.m_state = TextureState::Ready;
+		texture.m_loadID = 0;
+		m_loads.erase(decoded.loadID);
+		return;
+	}
+
+	staging.state = StagingState::Copying;
+	staging.loadID = decoded.loadID;
+	staging.mapped = mapped;
+	staging.source = std::move(decoded);
+	staging.copied = false;
+
+	//for a mapped file this copy is what reads it from disk
+	Staging* target = &staging;
+	m_threads.submit([this, target]
+	{
+		if (m_stopping)
+			return;
+
+		unsigned char* out = (unsigned char*)target->mapped;
+		for (const TextureLevelData& level : target->source.levels.levels)
+		{
+			std::memcpy(out, level.data, level.size);
+			out += level.size;
+		}
+		target->copied.store(true, std::memory_order_release);
+	}, &m_tasks);
+}
+
+void TextureLoader::finishCopy(Staging& staging)
+{
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer));
+	GLboolean intact;
+	GLCall(intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+	staging.mapped = nullptr;
+
+	auto it = m_loads.find(staging.loadID);
+	if (it != m_loads.end() && intact)
+	{
+		//sources the pixels from the bound unpack buffer, the call returns before they are transferred
+		Texture& texture = *it->second;
+		GLCall(glBindTexture(GL_TEXTURE_2D, texture.m_RendererID));
+		size_t offset = 0;
+		const TextureLevels& levels = staging.source.levels;
+		for (unsigned int i = 0; i < levels.levels.size(); i++)
+		{
+			UploadLevel(levels, i, (const void*)offset);
+			offset += levels.levels[i].size;
+		}
+		GLCall(staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+		staging.state = StagingState::Uploading;
+	}
+	else
+	{
+		//cancelled, or the driver lost the mapped memory (e.g. on a mode switch)
+		if (it != m_loads.end())
+		{
+			it->second->m_state = TextureState::Failed;
+			it->second->m_loadID = 0;
+			m_loads.erase(it);
+		}
+		staging.state = StagingState::Free;
+	}
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	staging.source = Decoded();
+}
+
+void TextureLoader::update()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Decoded& decoded : m_decoded)
+			m_waitingUpload.push_back(std::move(decoded));
+		m_decoding -= (unsigned int)m_decoded.size();
+		m_decoded.clear();
+	}
+
+	for (Staging& staging : m_staging)
+	{
+		if (staging.state == StagingState::Copying && staging.copied.load(std::memory_order_acquire))
+			finishCopy(staging);
+		else if (staging.state == StagingState::Uploading)
+		{
+			//no flush bit, the buffer swap flushes every frame
+			GLenum status;
+			GLCall(status = glClientWaitSync((GLsync)staging.fence, 0, 0));
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+
+			GLCall(glDeleteSync((GLsync)staging.fence));
+			staging.fence = nullptr;
+			staging.state = StagingState::Free;
+
+			auto it = m_loads.find(staging.loadID);
+			if (it != m_loads.end())
+			{
+				it->second->m_state = TextureState::Ready;
+				it->second->m_loadID = 0;
+				m_loads.erase(it);
+			}
+		}
+	}
+
+	size_t started = 0;
+	int freeStaging = 0;
+	while (!m_waitingUpload.empty())
+	{
+		Decoded& decoded = m_waitingUpload.front();
+		auto it = m_loads.find(decoded.loadID);
+		if (it == m_loads.end())
+		{
+			m_waitingUpload.pop_front();
+			continue;
+		}
+		if (!decoded.ok)
+		{
+			it->second->m_state = TextureState::Failed;
+			it->second->m_loadID = 0;
+			m_loads.erase(it);
+			m_waitingUpload.pop_front();
+			continue;
+		}
+
+		size_t bytes = LevelBytes(decoded.levels);
+		if (started > 0 && started + bytes > m_uploadBudget)
+			break;
+
+		while (freeStaging < STAGING_BUFFERS && m_staging[freeStaging].state != StagingState::Free)
+			freeStaging++;
+		if (freeStaging == STAGING_BUFFERS)
+			break;
+
+		startUpload(m_staging[freeStaging], decoded);
+		m_waitingUpload.pop_front();
+		started += bytes;
+	}
+
+	startDecodes();
+}
+
+unsigned int TextureLoader::getPlaceholder()
+{
+	if (!m_placeholder)
+	{
+		const unsigned int checker[4] = { 0xFFFF00FFu, 0xFF000000u, 0xFF000000u, 0xFFFF00FFu };
+		GLCall(glGenTextures(1, &m_placeholder));
+		GLCall(glBindTexture(GL_TEXTURE_2D, m_placeholder));
+		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+		GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, checker));
+	}
+	return m_placeholder;
+}
+
+TextureLoader& GetTextureLoader()
+{
+	static TextureLoader loader;
+	return loader;
+}
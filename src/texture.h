@@ -0,0 +1,174 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "image.h"
+#include "mapped_file.h"
+#include "texture_file.h"
+#include "thread_pool.h"
+
+enum class TextureState
+{
+	Loading,   //the file is being read and decoded on a loader thread
+	Uploading, //pixels are on their way to the GPU
+	Ready,
+	Failed     //the file couldn't be read, the placeholder stays bound
+};
+
+//2D texture, RGBA8 or block compressed when it comes from a KTX2 or DDS file
+//Textures made from a file are loaded in the background by the TextureLoader and bind a placeholder until they are
+//Ready, so creating hundreds of them doesn't stall the frame
+//Like the buffers, a Texture must be created and destroyed on the thread that owns the GL context
+class Texture
+{
+private:
+	friend class TextureLoader;
+
+	unsigned int m_RendererID;
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_levels;
+	bool m_mipmaps;
+	TextureState m_state;
+	unsigned int m_loadID; //0 once the loader is done with this texture
+
+public:
+	//Queues the file for loading, TGA, KTX2 or DDS
+	//With mipmaps the chain of a TGA file is generated by the loader thread right after decoding, KTX2 and DDS files
+	//bring their own levels and are uploaded as stored
+	explicit Texture(const std::string& path, bool mipmaps = true);
+
+	//Uploads the image right away, generating its mipmaps on this thread
+	explicit Texture(const Image& image, bool mipmaps = true);
+
+	~Texture();
+
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	//Binds to texture unit slot, the placeholder is bound until the texture is Ready
+	void bind(unsigned int slot = 0) const;
+	void unbind(unsigned int slot = 0) const;
+
+	TextureState getState() const { return m_state; }
+	bool isReady() const { return m_state == TextureState::Ready; }
+
+	//0 until the file has been decoded
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+
+	//Mip levels on the GPU, 1 without mipmaps
+	unsigned int getLevelCount() const { return m_levels; }
+};
+
+//GL internal format of a mip chain, e.g. GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM for sRGB BC7 levels
+unsigned int TextureInternalFormat(const TextureLevels& levels);
+
+//Points levels at RGBA8 images, which must outlive them
+void TextureLevelsFromImages(const std::vector<Image>& images, bool srgb, TextureLevels& levels);
+
+//Streams texture files to the GPU without blocking the thread that renders
+//Files are decoded and mipmapped on the loader's own threads, the pixels of all levels are copied by those threads into mapped pixel unpack
+//buffers and glTexSubImage2D sources them from there, so the driver can upload asynchronously
+//KTX2 and DDS files aren't decoded at all: they are memory mapped and their levels copied from the mapped pages straight into the
+//staging buffers, so reading the file happens during that one copy; block formats the GPU can't sample are decompressed instead
+//A texture is Ready once the fence placed after its upload has signaled
+//update() does the GL side of all of this and has to be called once per frame on the GL thread
+class TextureLoader
+{
+private:
+	struct Decoded
+	{
+		unsigned int loadID;
+		bool ok;
+		std::vector<Image> images;        //a decoded TGA file and its mipmaps, or a file decompressed for the GPU
+		std::unique_ptr<MappedFile> file; //KTX2 and DDS files
+		TextureLevels levels;             //points into images or file
+	};
+
+	enum class StagingState
+	{
+		Free,
+		Copying,  //mapped, a loader thread is filling it
+		Uploading //unmapped and read by glTexSubImage2D, free again once the fence signals
+	};
+
+	struct Staging
+	{
+		unsigned int buffer = 0;
+		unsigned int capacity = 0;
+		StagingState state = StagingState::Free;
+		std::atomic<bool> copied{ false };
+		void* mapped = nullptr;
+		void* fence = nullptr; //GLsync
+		unsigned int loadID = 0;
+		Decoded source; //its levels are packed one after the other in the buffer
+	};
+
+	static const int STAGING_BUFFERS = 8;
+
+	//GL thread only
+	std::unordered_map<unsigned int, Texture*> m_loads; //load id -> texture, removed when the texture goes away
+	std::deque<std::pair<unsigned int, std::string>> m_waitingDecode;
+	std::deque<Decoded> m_waitingUpload;
+	unsigned int m_decoding;
+	Staging m_staging[STAGING_BUFFERS];
+	unsigned int m_nextLoadID;
+	unsigned int m_placeholder;
+	size_t m_uploadBudget;
+	bool m_s3tc; //BC1 and BC3
+	bool m_bptc; //BC7, BC4 and BC5 are core
+
+	//filled by the loader threads
+	std::mutex m_mutex;
+	std::vector<Decoded> m_decoded;
+	std::atomic<bool> m_stopping;
+	JobCounter m_tasks; //decodes and copies still queued or running
+
+	//declared last so it's destroyed first, its threads finish their tasks while the members above still exist
+	ThreadPool m_threads;
+
+	//loader thread, maps a KTX2 or DDS file and checks it
+	bool mapTextureFile(const std::string& path, Decoded& decoded) const;
+	void startDecodes();
+	void startUpload(Staging& staging, Decoded& decoded);
+	void finishCopy(Staging& staging);
+
+public:
+	//threadCount = 0 picks a couple of threads, decoding is mostly waiting on the disk
+	explicit TextureLoader(unsigned int threadCount = 0);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	//Starts loading path into texture, called by Texture's constructor
+	void load(Texture& texture, const std::string& path);
+
+	//Forgets a texture that is destroyed before it is Ready
+	void cancel(Texture& texture);
+
+	//Starts uploads for decoded files, at most the upload budget of bytes per call but always at least one,
+	//and marks the textures whose uploads have completed as Ready
+	void update();
+
+	void setUploadBudget(size_t bytesPerUpdate) { m_uploadBudget = bytesPerUpdate; }
+
+	//Textures still loading or uploading
+	unsigned int pendingCount() const { return (unsigned int)m_loads.size(); }
+
+	//2x2 magenta and black checker, repeated, shown in place of textures that aren't Ready
+	unsigned int getPlaceholder();
+
+	//Waits for the loader threads and deletes the staging buffers, fences and placeholder, before the context goes
+	//away; textures still loading stay Failed. The destructor only waits for the threads, it doesn't touch GL
+	void destroy();
+};
+
+//The loader used by Texture, created on first use, must be first used on the GL thread
+TextureLoader& GetTextureLoader();
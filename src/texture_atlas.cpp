@@ -0,0 +1,250 @@
+#include "texture_atlas.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include "renderer.h"
+
+//Copies a width x height image into dst with its edge pixels repeated padding times on every side,
+//(x, y) is where the padded block starts
+static void BlitPadded(unsigned int* dst, unsigned int dstStride, unsigned int x, unsigned int y,
+	const unsigned int* src, unsigned int srcStride, unsigned int width, unsigned int height, unsigned int padding)
+{
+	for (unsigned int row = 0; row < height + 2 * padding; row++)
+	{
+		unsigned int srcRow = row < padding ? 0 : std::min(row - padding, height - 1);
+		const unsigned int* from = src + (size_t)srcRow * srcStride;
+		unsigned int* to = dst + (size_t)(y + row) * dstStride + x;
+
+		std::fill(to, to + padding, from[0]);
+		std::memcpy(to + padding, from, width * sizeof(unsigned int));
+		std::fill(to + padding + width, to + 2 * padding + width, from[width - 1]);
+	}
+}
+
+TextureAtlas::TextureAtlas(unsigned int pageSize, unsigned int padding, unsigned int maxPages)
+	:m_pageSize(pageSize), m_padding(padding), m_maxPages(maxPages), m_version(0), m_RendererID(0), m_gpuPages(0)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	if (m_RendererID)
+	{
+		GLCall(glDeleteTextures(1, &m_RendererID));
+	}
+}
+
+void TextureAtlas::addPage()
+{
+	m_pages.emplace_back();
+	Page& page = m_pages.back();
+	page.packer.reset(m_pageSize, m_pageSize);
+	page.pixels.assign((size_t)m_pageSize * m_pageSize, 0);
+	page.liveArea = 0;
+	page.dirtyMinX = page.dirtyMinY = m_pageSize;
+	page.dirtyMaxX = page.dirtyMaxY = 0;
+}
+
+void TextureAtlas::setRegion(unsigned int page, unsigned int x, unsigned int y, unsigned int width, unsigned int height, AtlasRegion& region) const
+{
+	float scale = 1.0f / m_pageSize;
+	region.page = page;
+	region.x = x;
+	region.y = y;
+	region.width = width;
+	region.height = height;
+	region.u0 = x * scale;
+	region.v0 = y * scale;
+	region.u1 = (x + width) * scale;
+	region.v1 = (y + height) * scale;
+}
+
+void TextureAtlas::markDirty(Page& page, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+{
+	page.dirtyMinX = std::min(page.dirtyMinX, x);
+	page.dirtyMinY = std::min(page.dirtyMinY, y);
+	page.dirtyMaxX = std::max(page.dirtyMaxX, x + width);
+	page.dirtyMaxY = std::max(page.dirtyMaxY, y + height);
+}
+
+bool TextureAtlas::place(unsigned int pageIndex, const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int stride, Entry& entry)
+{
+	Page& page = m_pages[pageIndex];
+	unsigned int paddedWidth = width + 2 * m_padding, paddedHeight = height + 2 * m_padding;
+	unsigned int x, y;
+	if (!page.packer.insert(paddedWidth, paddedHeight, x, y))
+		return false;
+
+	BlitPadded(page.pixels.data(), m_pageSize, x, y, pixels, stride, width, height, m_padding);
+	markDirty(page, x, y, paddedWidth, paddedHeight);
+	page.liveArea += paddedWidth * paddedHeight;
+
+	setRegion(pageIndex, x + m_padding, y + m_padding, width, height, entry.region);
+	entry.live = true;
+	return true;
+}
+
+unsigned int TextureAtlas::add(const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int stride)
+{
+	unsigned int paddedWidth = width + 2 * m_padding, paddedHeight = height + 2 * m_padding;
+	if (width == 0 || height == 0 || paddedWidth > m_pageSize || paddedHeight > m_pageSize)
+		return 0;
+
+	Entry entry;
+	bool placed = false;
+	for (unsigned int page = 0; page < m_pages.size() && !placed; page++)
+		placed = place(page, pixels, width, height, stride, entry);
+
+	//pages whose removed regions would leave room for this one, the most wasteful first
+	if (!placed)
+	{
+		std::vector<std::pair<unsigned int, unsigned int>> candidates; //(dead area, page)
+		for (unsigned int page = 0; page < m_pages.size(); page++)
+		{
+			unsigned int dead = m_pages[page].packer.getUsedArea() - m_pages[page].liveArea;
+			if (dead >= paddedWidth * paddedHeight)
+				candidates.push_back(std::make_pair(dead, page));
+		}
+		std::sort(candidates.rbegin(), candidates.rend());
+
+		for (size_t i = 0; i < candidates.size() && !placed; i++)
+			if (defragment(candidates[i].second))
+				placed = place(candidates[i].second, pixels, width, height, stride, entry);
+	}
+
+	if (!placed && m_pages.size() < m_maxPages)
+	{
+		addPage();
+		placed = place((unsigned int)m_pages.size() - 1, pixels, width, height, stride, entry);
+	}
+
+	if (!placed)
+		return 0;
+
+	unsigned int id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+		m_entries[id - 1] = entry;
+	}
+	else
+	{
+		m_entries.push_back(entry);
+		id = (unsigned int)m_entries.size();
+	}
+	return id;
+}
+
+void TextureAtlas::remove(unsigned int id)
+{
+	if (!isValid(id))
+		return;
+
+	Entry& entry = m_entries[id - 1];
+	entry.live = false;
+	m_pages[entry.region.page].liveArea -= (entry.region.width + 2 * m_padding) * (entry.region.height + 2 * m_padding);
+	m_freeIds.push_back(id);
+}
+
+bool TextureAtlas::defragment(unsigned int pageIndex)
+{
+	Page& page = m_pages[pageIndex];
+
+	std::vector<unsigned int> live;
+	for (unsigned int i = 0; i < m_entries.size(); i++)
+		if (m_entries[i].live && m_entries[i].region.page == pageIndex)
+			live.push_back(i);
+
+	//tallest first packs a skyline tightest
+	std::sort(live.begin(), live.end(), [this](unsigned int a, unsigned int b)
+	{
+		const AtlasRegion& ra = m_entries[a].region;
+		const AtlasRegion& rb = m_entries[b].region;
+		return ra.height != rb.height ? ra.height > rb.height : ra.width > rb.width;
+	});
+
+	//pack into a fresh skyline first, the page is only touched once everything fits
+	SkylinePacker packer(m_pageSize, m_pageSize);
+	std::vector<unsigned int> positions(live.size() * 2);
+	for (size_t i = 0; i < live.size(); i++)
+	{
+		const AtlasRegion& region = m_entries[live[i]].region;
+		if (!packer.insert(region.width + 2 * m_padding, region.height + 2 * m_padding, positions[i * 2], positions[i * 2 + 1]))
+			return false;
+	}
+
+	std::vector<unsigned int> pixels((size_t)m_pageSize * m_pageSize, 0);
+	for (size_t i = 0; i < live.size(); i++)
+	{
+		AtlasRegion& region = m_entries[live[i]].region;
+		unsigned int paddedWidth = region.width + 2 * m_padding, paddedHeight = region.height + 2 * m_padding;
+		unsigned int fromX = region.x - m_padding, fromY = region.y - m_padding;
+		unsigned int toX = positions[i * 2], toY = positions[i * 2 + 1];
+		for (unsigned int row = 0; row < paddedHeight; row++)
+			std::memcpy(&pixels[(size_t)(toY + row) * m_pageSize + toX], &page.pixels[(size_t)(fromY + row) * m_pageSize + fromX],
+				paddedWidth * sizeof(unsigned int));
+		setRegion(pageIndex, toX + m_padding, toY + m_padding, region.width, region.height, region);
+	}
+
+	page.packer = packer;
+	page.pixels.swap(pixels);
+	markDirty(page, 0, 0, m_pageSize, m_pageSize);
+	m_version++;
+	return true;
+}
+
+float TextureAtlas::getOccupancy(unsigned int page) const
+{
+	return (float)m_pages[page].liveArea / ((float)m_pageSize * m_pageSize);
+}
+
+void TextureAtlas::upload()
+{
+	if (!m_RendererID)
+	{
+		GLCall(glGenTextures(1, &m_RendererID));
+	}
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_RendererID));
+
+	//layers can't be added to an existing array, so it's reallocated and every page sent again
+	if (m_gpuPages < m_pages.size())
+	{
+		m_gpuPages = (unsigned int)m_pages.size();
+		GLCall(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, m_pageSize, m_pageSize, m_gpuPages, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+		GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+		GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+		GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+		GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+		for (Page& page : m_pages)
+			markDirty(page, 0, 0, m_pageSize, m_pageSize);
+	}
+
+	GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, m_pageSize));
+	for (unsigned int i = 0; i < m_pages.size(); i++)
+	{
+		Page& page = m_pages[i];
+		if (page.dirtyMinX >= page.dirtyMaxX || page.dirtyMinY >= page.dirtyMaxY)
+			continue;
+
+		const unsigned int* first = &page.pixels[(size_t)page.dirtyMinY * m_pageSize + page.dirtyMinX];
+		GLCall(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, page.dirtyMinX, page.dirtyMinY, i,
+			page.dirtyMaxX - page.dirtyMinX, page.dirtyMaxY - page.dirtyMinY, 1, GL_RGBA, GL_UNSIGNED_BYTE, first));
+
+		page.dirtyMinX = page.dirtyMinY = m_pageSize;
+		page.dirtyMaxX = page.dirtyMaxY = 0;
+	}
+	GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+}
+
+void TextureAtlas::bind(unsigned int slot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_RendererID));
+}
+
+void TextureAtlas::unbind(unsigned int slot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include "image.h"
+#include "skyline_packer.h"
+
+//Where an image ended up: a layer of the atlas' texture array and the rectangle it covers there
+//x, y, width and height are in pixels, the UVs cover the same rectangle like 0..1 covers a standalone texture
+struct AtlasRegion
+{
+	unsigned int page;
+	unsigned int x, y;
+	unsigned int width, height;
+	float u0, v0, u1, v1;
+};
+
+//Many small images packed into the layers of one GL_TEXTURE_2D_ARRAY, so a batch of quads can draw them all
+//from a single binding, the layer coming from AtlasRegion::page
+//Every image gets a border of `padding` pixels copying its edge, so linear filtering doesn't bleed in the neighbours
+//Images can be removed at any time, the space they leave is reclaimed by repacking the page (defragmenting) when an
+//add doesn't fit anywhere else; regions move when that happens, and getVersion() changes so cached UVs can be refreshed
+//The pixels of every page are kept on the CPU, adds and removes only touch that copy and upload() sends the
+//changed rectangles to the GPU
+class TextureAtlas
+{
+private:
+	struct Entry
+	{
+		AtlasRegion region;
+		bool live;
+	};
+
+	struct Page
+	{
+		SkylinePacker packer;
+		std::vector<unsigned int> pixels;
+		unsigned int liveArea;   //padded area of the live entries
+		unsigned int dirtyMinX, dirtyMinY, dirtyMaxX, dirtyMaxY; //exclusive max, empty when min >= max
+	};
+
+	unsigned int m_pageSize;
+	unsigned int m_padding;
+	unsigned int m_maxPages;
+	std::vector<Page> m_pages;
+
+	std::vector<Entry> m_entries; //indexed by id - 1
+	std::vector<unsigned int> m_freeIds;
+	unsigned int m_version;
+
+	unsigned int m_RendererID;
+	unsigned int m_gpuPages; //layers allocated on the GPU
+
+	void addPage();
+	bool place(unsigned int page, const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int stride, Entry& entry);
+	void setRegion(unsigned int page, unsigned int x, unsigned int y, unsigned int width, unsigned int height, AtlasRegion& region) const;
+	void markDirty(Page& page, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+public:
+	//pageSize is the side of every layer, maxPages how many layers the atlas may grow to
+	TextureAtlas(unsigned int pageSize = 2048, unsigned int padding = 1, unsigned int maxPages = 8);
+	~TextureAtlas();
+
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+	//Copies a width x height RGBA8 image (rows bottom to top, stride in pixels) into the atlas
+	//Returns the id of its region, or 0 when it can't fit even after defragmenting
+	unsigned int add(const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int stride);
+	unsigned int add(const Image& image) { return add(image.pixels.data(), image.width, image.height, image.width); }
+
+	//Frees the region of id, its space comes back the next time its page is defragmented
+	void remove(unsigned int id);
+
+	const AtlasRegion& getRegion(unsigned int id) const { return m_entries[id - 1].region; }
+	bool isValid(unsigned int id) const { return id > 0 && id <= m_entries.size() && m_entries[id - 1].live; }
+
+	//Repacks a page with only its live regions, tallest first, returns false when they didn't fit and nothing changed
+	bool defragment(unsigned int page);
+
+	//Changes whenever regions move
+	unsigned int getVersion() const { return m_version; }
+
+	unsigned int getPageCount() const { return (unsigned int)m_pages.size(); }
+	unsigned int getPageSize() const { return m_pageSize; }
+
+	//Share of the page covered by live regions, padding included
+	float getOccupancy(unsigned int page) const;
+
+	//Pixels of a page as the GPU will see them, for debugging and tools
+	const unsigned int* getPagePixels(unsigned int page) const { return m_pages[page].pixels.data(); }
+
+	//Sends the changed parts of the pages to the texture array, growing it when pages were added
+	//Call on the GL thread before drawing with the atlas
+	void upload();
+
+	void bind(unsigned int slot = 0) const;
+	void unbind(unsigned int slot = 0) const;
+};
@@ -0,0 +1,271 @@
+#include "texture_file.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const size_t KTX2_HEADER_SIZE = 80; //identifier, header and the index of the data blocks
+static const size_t KTX2_LEVEL_INDEX_SIZE = 24;
+static const unsigned int MAX_LEVELS = 32;
+static const unsigned int MAX_SIZE = 65536; //width or height, above what any GL takes
+
+static const unsigned int DDS_MAGIC = 0x20534444; //"DDS "
+static const size_t DDS_HEADER_SIZE = 128;        //magic included
+static const size_t DDS_DX10_HEADER_SIZE = 20;
+static const unsigned int DDPF_FOURCC = 0x4;
+static const unsigned int DDPF_RGB = 0x40;
+static const unsigned int DDSCAPS2_CUBEMAP = 0x200;
+static const unsigned int DDSCAPS2_VOLUME = 0x200000;
+static const unsigned int DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+static const unsigned int DX10_TEXTURE2D = 3;
+
+static unsigned int FourCC(char a, char b, char c, char d)
+{
+	return (unsigned int)a | ((unsigned int)b << 8) | ((unsigned int)c << 16) | ((unsigned int)d << 24);
+}
+
+static unsigned int Read32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long Read64(const unsigned char* p)
+{
+	return Read32(p) | ((unsigned long long)Read32(p + 4) << 32);
+}
+
+static void SetFormat(TextureLevels& out, bool compressed, BlockFormat format, bool srgb)
+{
+	out.compressed = compressed;
+	out.format = format;
+	out.srgb = srgb;
+}
+
+//VkFormat values
+static bool KtxFormat(unsigned int vkFormat, TextureLevels& out)
+{
+	switch (vkFormat)
+	{
+	case 37:  SetFormat(out, false, BlockFormat::BC7, false); return true; //R8G8B8A8_UNORM
+	case 43:  SetFormat(out, false, BlockFormat::BC7, true); return true;  //R8G8B8A8_SRGB
+	case 131:
+	case 133: SetFormat(out, true, BlockFormat::BC1, false); return true;
+	case 132:
+	case 134: SetFormat(out, true, BlockFormat::BC1, true); return true;
+	case 137: SetFormat(out, true, BlockFormat::BC3, false); return true;
+	case 138: SetFormat(out, true, BlockFormat::BC3, true); return true;
+	case 139: SetFormat(out, true, BlockFormat::BC4, false); return true;
+	case 141: SetFormat(out, true, BlockFormat::BC5, false); return true;
+	case 145: SetFormat(out, true, BlockFormat::BC7, false); return true;
+	case 146: SetFormat(out, true, BlockFormat::BC7, true); return true;
+	}
+	return false;
+}
+
+//DXGI_FORMAT values
+static bool DxgiFormat(unsigned int dxgiFormat, TextureLevels& out)
+{
+	switch (dxgiFormat)
+	{
+	case 28: SetFormat(out, false, BlockFormat::BC7, false); return true; //R8G8B8A8_UNORM
+	case 29: SetFormat(out, false, BlockFormat::BC7, true); return true;  //R8G8B8A8_UNORM_SRGB
+	case 71: SetFormat(out, true, BlockFormat::BC1, false); return true;
+	case 72: SetFormat(out, true, BlockFormat::BC1, true); return true;
+	case 77: SetFormat(out, true, BlockFormat::BC3, false); return true;
+	case 78: SetFormat(out, true, BlockFormat::BC3, true); return true;
+	case 80: SetFormat(out, true, BlockFormat::BC4, false); return true;
+	case 83: SetFormat(out, true, BlockFormat::BC5, false); return true;
+	case 98: SetFormat(out, true, BlockFormat::BC7, false); return true;
+	case 99: SetFormat(out, true, BlockFormat::BC7, true); return true;
+	}
+	return false;
+}
+
+//64 bit so it can't wrap for sizes up to MAX_SIZE, even where size_t is 32 bit
+static unsigned long long LevelSize(const TextureLevels& levels, unsigned int width, unsigned int height)
+{
+	if (!levels.compressed)
+		return (unsigned long long)width * height * 4;
+	return (((unsigned long long)width + 3) / 4) * (((unsigned long long)height + 3) / 4) * BlockBytes(levels.format);
+}
+
+//Checks one level against the file and adds it
+static bool AddLevel(const unsigned char* data, size_t size, unsigned long long offset, unsigned long long length,
+	unsigned int width, unsigned int height, TextureLevels& out, std::string& error)
+{
+	unsigned int level = (unsigned int)out.levels.size();
+	unsigned int levelWidth = std::max(1u, width >> level), levelHeight = std::max(1u, height >> level);
+	if (level > 0 && (width >> level) == 0 && (height >> level) == 0)
+	{
+		error = "more levels than the size allows";
+		return false;
+	}
+
+	unsigned long long expected = LevelSize(out, levelWidth, levelHeight);
+	if (length != expected || offset > size || length > size - offset)
+	{
+		error = "level " + std::to_string(level) + " is truncated or doesn't match its size";
+		return false;
+	}
+
+	TextureLevelData levelData = { levelWidth, levelHeight, data + offset, (size_t)expected };
+	out.levels.push_back(levelData);
+	return true;
+}
+
+static bool ParseKTX2(const unsigned char* data, size_t size, TextureLevels& out, std::string& error)
+{
+	if (size < KTX2_HEADER_SIZE)
+	{
+		error = "truncated KTX2 header";
+		return false;
+	}
+
+	unsigned int vkFormat = Read32(data + 12);
+	unsigned int width = Read32(data + 20), height = Read32(data + 24), depth = Read32(data + 28);
+	unsigned int layers = Read32(data + 32), faces = Read32(data + 36), levelCount = Read32(data + 40);
+	unsigned int supercompression = Read32(data + 44);
+
+	if (supercompression != 0)
+	{
+		error = "supercompressed KTX2 files aren't supported";
+		return false;
+	}
+	if (!KtxFormat(vkFormat, out))
+	{
+		error = "unsupported KTX2 format " + std::to_string(vkFormat);
+		return false;
+	}
+	if (width == 0 || height == 0 || depth > 0 || layers > 1 || faces != 1)
+	{
+		error = "only 2D textures are supported";
+		return false;
+	}
+	if (width > MAX_SIZE || height > MAX_SIZE)
+	{
+		error = "bad KTX2 size";
+		return false;
+	}
+
+	//0 levels asks the loader to generate them, we upload the one that is there
+	levelCount = std::max(1u, levelCount);
+	if (levelCount > MAX_LEVELS || KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_SIZE > size)
+	{
+		error = "truncated KTX2 level index";
+		return false;
+	}
+
+	for (unsigned int level = 0; level < levelCount; level++)
+	{
+		const unsigned char* entry = data + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_SIZE;
+		if (!AddLevel(data, size, Read64(entry), Read64(entry + 8), width, height, out, error))
+			return false;
+	}
+	return true;
+}
+
+static bool ParseDDS(const unsigned char* data, size_t size, TextureLevels& out, std::string& error)
+{
+	if (size < DDS_HEADER_SIZE || Read32(data + 4) != 124)
+	{
+		error = "truncated DDS header";
+		return false;
+	}
+
+	unsigned int height = Read32(data + 12), width = Read32(data + 16), levelCount = std::max(1u, Read32(data + 28));
+	unsigned int formatFlags = Read32(data + 80), fourCC = Read32(data + 84), bitCount = Read32(data + 88);
+	unsigned int caps2 = Read32(data + 112);
+	unsigned long long offset = DDS_HEADER_SIZE;
+
+	if (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+	{
+		error = "only 2D textures are supported";
+		return false;
+	}
+
+	bool known = false;
+	if ((formatFlags & DDPF_FOURCC) && fourCC == FourCC('D', 'X', '1', '0'))
+	{
+		if (size < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+		{
+			error = "truncated DDS header";
+			return false;
+		}
+		const unsigned char* dx10 = data + DDS_HEADER_SIZE;
+		if (Read32(dx10 + 4) != DX10_TEXTURE2D || (Read32(dx10 + 8) & DDS_RESOURCE_MISC_TEXTURECUBE) || Read32(dx10 + 12) > 1)
+		{
+			error = "only 2D textures are supported";
+			return false;
+		}
+		known = DxgiFormat(Read32(dx10), out);
+		offset += DDS_DX10_HEADER_SIZE;
+	}
+	else if (formatFlags & DDPF_FOURCC)
+	{
+		known = true;
+		if (fourCC == FourCC('D', 'X', 'T', '1'))
+			SetFormat(out, true, BlockFormat::BC1, false);
+		else if (fourCC == FourCC('D', 'X', 'T', '5'))
+			SetFormat(out, true, BlockFormat::BC3, false);
+		else if (fourCC == FourCC('A', 'T', 'I', '1') || fourCC == FourCC('B', 'C', '4', 'U'))
+			SetFormat(out, true, BlockFormat::BC4, false);
+		else if (fourCC == FourCC('A', 'T', 'I', '2') || fourCC == FourCC('B', 'C', '5', 'U'))
+			SetFormat(out, true, BlockFormat::BC5, false);
+		else
+			known = false;
+	}
+	else if ((formatFlags & DDPF_RGB) && bitCount == 32 && Read32(data + 92) == 0xFFu && Read32(data + 96) == 0xFF00u &&
+		Read32(data + 100) == 0xFF0000u && Read32(data + 104) == 0xFF000000u)
+	{
+		SetFormat(out, false, BlockFormat::BC7, false);
+		known = true;
+	}
+
+	if (!known)
+	{
+		error = "unsupported DDS format, only 2D RGBA8, BC1, BC3, BC4, BC5 and BC7 textures";
+		return false;
+	}
+	if (width == 0 || height == 0 || width > MAX_SIZE || height > MAX_SIZE || levelCount > MAX_LEVELS)
+	{
+		error = "bad DDS size";
+		return false;
+	}
+
+	//levels follow each other from the largest down
+	for (unsigned int level = 0; level < levelCount; level++)
+	{
+		unsigned long long length = LevelSize(out, std::max(1u, width >> level), std::max(1u, height >> level));
+		if (!AddLevel(data, size, offset, length, width, height, out, error))
+			return false;
+		offset += length;
+	}
+	return true;
+}
+
+bool ParseTextureFile(const unsigned char* data, size_t size, TextureLevels& out, std::string& error)
+{
+	out = TextureLevels();
+	bool ok = false;
+	if (size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+		ok = ParseKTX2(data, size, out, error);
+	else if (size >= 4 && Read32(data) == DDS_MAGIC)
+		ok = ParseDDS(data, size, out, error);
+	else
+		error = "not a KTX2 or DDS file";
+
+	if (!ok)
+		out.levels.clear();
+	return ok;
+}
+
+bool IsTextureFilePath(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+	return extension == "ktx2" || extension == "dds";
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "block_compress.h"
+
+//One mip level as it is stored, pointing into memory owned by someone else, usually a MappedFile
+struct TextureLevelData
+{
+	unsigned int width;
+	unsigned int height;
+	const unsigned char* data;
+	size_t size;
+};
+
+//Mip chain that can go to the GPU as is, level 0 the largest
+struct TextureLevels
+{
+	bool compressed = false; //RGBA8 otherwise
+	BlockFormat format = BlockFormat::BC7;
+	bool srgb = false;
+	std::vector<TextureLevelData> levels;
+};
+
+//Reads the header of a KTX2 or DDS file in memory and points the levels at their data, nothing is copied
+//Only 2D textures in RGBA8 or one of the BlockFormats, KTX2 without supercompression; cube maps, arrays and
+//3D textures are refused, so are sides above 65536 and any level that doesn't lie inside the file with the size its format implies
+//Rows stay in the stored order: SaveDDS() writes them like GL, files from other tools usually start with the top
+//row and show up flipped vertically
+bool ParseTextureFile(const unsigned char* data, size_t size, TextureLevels& out, std::string& error);
+
+//True for the .ktx2 and .dds extensions
+bool IsTextureFilePath(const std::string& path);
@@ -0,0 +1,316 @@
+#include "thread_pool.h"
+#include <chrono>
+
+struct Job
+{
+	std::function<void()> fn;
+	JobCounter* counter;
+};
+
+//Chase-Lev deque: the owner pushes and pops at the bottom, thieves take from the top
+//Fixed capacity, push() fails when it's full and the job goes to the shared queue instead
+struct ThreadPool::WorkQueue
+{
+	static const long long CAPACITY = 4096;
+
+	std::atomic<long long> top;
+	char padding[64]; //top and bottom are written by different threads
+	std::atomic<long long> bottom;
+	std::unique_ptr<std::atomic<Job*>[]> jobs;
+
+	WorkQueue()
+		:top(0), bottom(0), jobs(new std::atomic<Job*>[CAPACITY])
+	{
+	}
+
+	bool push(Job* job)
+	{
+		long long b = bottom.load(std::memory_order_relaxed);
+		long long t = top.load(std::memory_order_acquire);
+		if (b - t >= CAPACITY)
+			return false;
+
+		jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	Job* pop()
+	{
+		long long b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			//the last one, a thief may be after it too
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* steal()
+	{
+		long long t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return nullptr;
+
+		Job* job = jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr; //lost to the owner or another thief
+		return job;
+	}
+};
+
+//which worker of which pool the current thread is, pools don't share workers
+static thread_local ThreadPool* t_pool = nullptr;
+static thread_local unsigned int t_worker = 0;
+
+void JobCounter::finish()
+{
+	std::vector<Job*> released;
+	ThreadPool* pool;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_count.fetch_sub(1) != 1)
+			return;
+		released.swap(m_waiting);
+		pool = m_pool;
+		m_done.notify_all();
+	}
+
+	for (Job* job : released)
+		pool->push(job);
+}
+
+bool JobCounter::isDone()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_count.load() == 0;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+	:m_pending(0), m_sleepers(0), m_stop(false)
+{
+	if (threadCount == 0)
+	{
+		unsigned int hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	//every queue exists before any worker may look at the others'
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_queues.emplace_back(new WorkQueue());
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void ThreadPool::push(Job* job)
+{
+	m_pending.fetch_add(1);
+	if (t_pool != this || !m_queues[t_worker]->push(job))
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		m_shared.push_back(job);
+	}
+
+	//a worker about to sleep either sees m_pending or is already waiting when this locks
+	if (m_sleepers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_wake.notify_one();
+	}
+}
+
+//The own deque first, then the shared queue, then the other workers' deques
+Job* ThreadPool::take()
+{
+	Job* job = nullptr;
+	if (t_pool == this)
+		job = m_queues[t_worker]->pop();
+
+	if (!job)
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		if (!m_shared.empty())
+		{
+			job = m_shared.front();
+			m_shared.pop_front();
+		}
+	}
+
+	if (!job)
+	{
+		unsigned int count = (unsigned int)m_queues.size();
+		unsigned int start = t_pool == this ? t_worker + 1 : 0;
+		for (unsigned int i = 0; i < count && !job; i++)
+			job = m_queues[(start + i) % count]->steal();
+	}
+
+	if (job)
+		m_pending.fetch_sub(1);
+	return job;
+}
+
+void ThreadPool::execute(Job* job)
+{
+	job->fn();
+	if (job->counter)
+		job->counter->finish();
+	delete job;
+}
+
+void ThreadPool::workerLoop(unsigned int index)
+{
+	t_pool = this;
+	t_worker = index;
+
+	while (true)
+	{
+		Job* job = take();
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleepers.fetch_add(1);
+		m_wake.wait(lock, [this] { return m_stop || m_pending.load() > 0; });
+		m_sleepers.fetch_sub(1);
+		if (m_stop && m_pending.load() == 0)
+			return;
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task, JobCounter* counter)
+{
+	if (counter)
+		counter->add();
+	push(new Job{ std::move(task), counter });
+}
+
+void ThreadPool::submitAfter(JobCounter& dependency, std::function<void()> task, JobCounter* counter)
+{
+	if (counter)
+		counter->add();
+	Job* job = new Job{ std::move(task), counter };
+	{
+		std::lock_guard<std::mutex> lock(dependency.m_mutex);
+		if (dependency.m_count.load() > 0)
+		{
+			dependency.m_pool = this;
+			dependency.m_waiting.push_back(job);
+			return;
+		}
+	}
+	push(job);
+}
+
+void ThreadPool::wait(JobCounter& counter)
+{
+	while (!counter.isDone())
+	{
+		Job* job = take();
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		//what's left is running elsewhere; wake up now and then in case it queues more
+		std::unique_lock<std::mutex> lock(counter.m_mutex);
+		counter.m_done.wait_for(lock, std::chrono::microseconds(200), [&counter] { return counter.m_count.load() == 0; });
+	}
+}
+
+unsigned int ThreadPool::help(unsigned int maxJobs)
+{
+	unsigned int ran = 0;
+	while (ran < maxJobs)
+	{
+		Job* job = take();
+		if (!job)
+			break;
+		execute(job);
+		ran++;
+	}
+	return ran;
+}
+
+//Works through [begin, end) a grain at a time, handing the upper half of what's left to the pool whenever fewer jobs
+//are queued than there are threads to take them
+void ThreadPool::runRange(unsigned int begin, unsigned int end, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& fn,
+	JobCounter& counter)
+{
+	while (end - begin > grain)
+	{
+		if (end - begin >= grain * 2 && m_pending.load(std::memory_order_relaxed) < m_workers.size())
+		{
+			unsigned int middle = begin + (end - begin) / 2;
+			unsigned int last = end;
+			submit([this, middle, last, grain, &fn, &counter] { runRange(middle, last, grain, fn, counter); }, &counter);
+			end = middle;
+			continue;
+		}
+
+		fn(begin, begin + grain);
+		begin += grain;
+	}
+	fn(begin, end);
+}
+
+void ThreadPool::parallelFor(unsigned int count, unsigned int minBatch, const std::function<void(unsigned int, unsigned int)>& fn)
+{
+	if (count == 0)
+		return;
+
+	//ranges no smaller than a few per thread would give, so a busy pool doesn't call fn item by item
+	unsigned int grain = count / ((workerCount() + 1) * 8);
+	if (grain < minBatch)
+		grain = minBatch;
+	if (grain == 0)
+		grain = 1;
+
+	if (count <= grain)
+	{
+		fn(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	runRange(0, count, grain, fn, counter);
+	wait(counter);
+}
+
+ThreadPool& GetThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+struct Job;
+
+//Counts unfinished jobs; jobs can be made to wait for one to reach zero, and threads can wait on it while helping
+//Must outlive the jobs counted with it and the ones waiting for it
+class JobCounter
+{
+private:
+	friend class ThreadPool;
+
+	std::atomic<unsigned int> m_count;
+	std::mutex m_mutex; //guards m_waiting, and the last decrement so a waiter can't free the counter under it
+	std::condition_variable m_done;
+	std::vector<Job*> m_waiting;
+	ThreadPool* m_pool; //the one the waiting jobs go to
+
+	void add() { m_count.fetch_add(1); }
+	void finish();
+
+public:
+	JobCounter() :m_count(0), m_pool(nullptr) {}
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool isDone();
+};
+
+//Worker threads that each own a work stealing deque (Chase-Lev): a worker pushes and pops jobs at the bottom of its
+//own deque and steals from the top of the others' when it runs dry, so jobs spawned from jobs stay on the thread that
+//spawned them while the cache is warm; jobs from other threads go through a shared queue
+//Waiting (wait(), parallelFor()) runs queued jobs instead of blocking, so it can be used from inside a job, and
+//help() lets a thread with spare time, like the GL thread, run a few
+class ThreadPool
+{
+private:
+	struct WorkQueue;
+
+	std::vector<std::unique_ptr<WorkQueue>> m_queues; //one per worker
+	std::vector<std::thread> m_workers;
+	std::deque<Job*> m_shared;
+	std::mutex m_sharedMutex;
+
+	std::atomic<unsigned int> m_pending; //queued and not yet taken
+	std::atomic<unsigned int> m_sleepers;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	bool m_stop;
+
+	void workerLoop(unsigned int index);
+	void push(Job* job);
+	Job* take();
+	void execute(Job* job);
+	void runRange(unsigned int begin, unsigned int end, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& fn,
+		JobCounter& counter);
+
+	friend class JobCounter;
+
+public:
+	//threadCount = 0 uses one worker per hardware thread minus the calling one
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int workerCount() const { return (unsigned int)m_workers.size(); }
+
+	//Queues a task, counted by counter until it has finished
+	void submit(std::function<void()> task, JobCounter* counter = nullptr);
+
+	//Queues a task once dependency reaches zero (right away if it already has)
+	void submitAfter(JobCounter& dependency, std::function<void()> task, JobCounter* counter = nullptr);
+
+	//Returns once counter reaches zero, running queued jobs on this thread meanwhile
+	void wait(JobCounter& counter);
+
+	//Runs up to maxJobs queued jobs on this thread, returns how many it ran
+	unsigned int help(unsigned int maxJobs = 1);
+
+	//Runs fn(begin, end) over [0, count) in ranges of at least minBatch items and returns once they have all finished
+	//The range is split in halves on demand, only while other threads are out of work, so a busy pool gets a few big
+	//ranges and an idle one many small ones
+	void parallelFor(unsigned int count, unsigned int minBatch, const std::function<void(unsigned int, unsigned int)>& fn);
+};
+
+//The pool shared by the engine's subsystems, created on first use
+ThreadPool& GetThreadPool();
@@ -0,0 +1,268 @@
+#include "tlsf_allocator.h"
+#include <algorithm>
+#include "simd.h"
+
+static unsigned int RoundUp(unsigned int value, unsigned int alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//The bin of a size in GRANULARITY units: the power of two, then which 16th of it
+static void Mapping(unsigned int units, unsigned int slBits, unsigned int& fl, unsigned int& sl)
+{
+	fl = (unsigned int)HighestSetBit(units);
+	if (fl >= slBits)
+		sl = (units >> (fl - slBits)) - (1u << slBits);
+	else
+		sl = (units << (slBits - fl)) - (1u << slBits);
+}
+
+TlsfAllocator::TlsfAllocator(unsigned int size)
+{
+	reset(size);
+}
+
+void TlsfAllocator::reset(unsigned int size)
+{
+	m_blocks.clear();
+	m_unusedBlocks.clear();
+	for (unsigned int fl = 0; fl < FL_COUNT; fl++)
+	{
+		for (unsigned int sl = 0; sl < SL_COUNT; sl++)
+			m_heads[fl][sl] = NO_BLOCK;
+		m_slBitmaps[fl] = 0;
+	}
+	m_flBitmap = 0;
+	m_size = size & ~(GRANULARITY - 1);
+	m_used = 0;
+	m_allocations = 0;
+
+	if (m_size > 0)
+	{
+		unsigned int block = newBlock(0, m_size);
+		m_blocks[block].free = true;
+		insertFree(block);
+	}
+}
+
+unsigned int TlsfAllocator::newBlock(unsigned int offset, unsigned int size)
+{
+	unsigned int index;
+	if (!m_unusedBlocks.empty())
+	{
+		index = m_unusedBlocks.back();
+		m_unusedBlocks.pop_back();
+	}
+	else
+	{
+		index = (unsigned int)m_blocks.size();
+		m_blocks.push_back(Block());
+	}
+
+	Block& block = m_blocks[index];
+	block.offset = offset;
+	block.size = size;
+	block.prevPhysical = block.nextPhysical = NO_BLOCK;
+	block.prevFree = block.nextFree = NO_BLOCK;
+	block.free = false;
+	return index;
+}
+
+void TlsfAllocator::insertFree(unsigned int index)
+{
+	unsigned int fl, sl;
+	Mapping(m_blocks[index].size / GRANULARITY, SL_BITS, fl, sl);
+
+	Block& block = m_blocks[index];
+	block.prevFree = NO_BLOCK;
+	block.nextFree = m_heads[fl][sl];
+	if (block.nextFree != NO_BLOCK)
+		m_blocks[block.nextFree].prevFree = index;
+	m_heads[fl][sl] = index;
+	m_flBitmap |= 1u << fl;
+	m_slBitmaps[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(unsigned int index)
+{
+	unsigned int fl, sl;
+	Mapping(m_blocks[index].size / GRANULARITY, SL_BITS, fl, sl);
+
+	Block& block = m_blocks[index];
+	if (block.prevFree != NO_BLOCK)
+		m_blocks[block.prevFree].nextFree = block.nextFree;
+	else
+		m_heads[fl][sl] = block.nextFree;
+	if (block.nextFree != NO_BLOCK)
+		m_blocks[block.nextFree].prevFree = block.prevFree;
+
+	if (m_heads[fl][sl] == NO_BLOCK)
+	{
+		m_slBitmaps[fl] &= ~(1u << sl);
+		if (!m_slBitmaps[fl])
+			m_flBitmap &= ~(1u << fl);
+	}
+}
+
+//A free block of at least size bytes: the request is rounded up to the next bin, so anything in that bin or above fits
+unsigned int TlsfAllocator::findFree(unsigned int size) const
+{
+	unsigned long long units = size / GRANULARITY;
+	unsigned int fl = (unsigned int)HighestSetBit((unsigned int)units);
+	if (fl >= SL_BITS)
+		units += (1ull << (fl - SL_BITS)) - 1;
+	if (units >> 32)
+		return NO_BLOCK;
+
+	unsigned int sl;
+	Mapping((unsigned int)units, SL_BITS, fl, sl);
+
+	unsigned int slMap = m_slBitmaps[fl] & (~0u << sl);
+	if (!slMap)
+	{
+		unsigned int flMap = fl + 1 < FL_COUNT ? m_flBitmap & (~0u << (fl + 1)) : 0;
+		if (!flMap)
+			return NO_BLOCK;
+		fl = (unsigned int)CountTrailingZeros(flMap);
+		slMap = m_slBitmaps[fl];
+	}
+	return m_heads[fl][CountTrailingZeros(slMap)];
+}
+
+//Gives everything past size back as a free block
+void TlsfAllocator::split(unsigned int index, unsigned int size)
+{
+	if (m_blocks[index].size - size < GRANULARITY)
+		return;
+
+	unsigned int rest = newBlock(m_blocks[index].offset + size, m_blocks[index].size - size);
+	Block& block = m_blocks[index];
+	Block& remainder = m_blocks[rest];
+	remainder.free = true;
+	remainder.prevPhysical = index;
+	remainder.nextPhysical = block.nextPhysical;
+	if (block.nextPhysical != NO_BLOCK)
+		m_blocks[block.nextPhysical].prevPhysical = rest;
+	block.nextPhysical = rest;
+	block.size = size;
+	insertFree(rest);
+}
+
+unsigned long long TlsfAllocator::GetRequiredSize(unsigned int size, unsigned int alignment)
+{
+	if (alignment < GRANULARITY)
+		alignment = GRANULARITY;
+	unsigned long long needed = (((unsigned long long)(size ? size : 1) + GRANULARITY - 1) & ~(unsigned long long)(GRANULARITY - 1)) + alignment - GRANULARITY;
+
+	//the same rounding as findFree(), a block of exactly the rounded size sits in the bin it searches first
+	unsigned long long units = needed / GRANULARITY;
+	unsigned int fl = (unsigned int)HighestSetBit((unsigned int)std::min(units, 0xFFFFFFFFull));
+	if (fl >= SL_BITS)
+		units += (1ull << (fl - SL_BITS)) - 1;
+	return units * GRANULARITY;
+}
+
+bool TlsfAllocator::allocate(unsigned int size, unsigned int alignment, TlsfAllocation& out)
+{
+	if (alignment < GRANULARITY)
+		alignment = GRANULARITY;
+	size = RoundUp(size ? size : 1, GRANULARITY);
+
+	//blocks start GRANULARITY aligned, a bigger alignment may need that much less than itself in front
+	unsigned long long needed = (unsigned long long)size + alignment - GRANULARITY;
+	if (size == 0 || needed > m_size)
+		return false;
+
+	unsigned int index = findFree((unsigned int)needed);
+	if (index == NO_BLOCK)
+		return false;
+	removeFree(index);
+
+	unsigned int padding = RoundUp(m_blocks[index].offset, alignment) - m_blocks[index].offset;
+	if (padding)
+	{
+		//the padding becomes a free block of its own, its neighbour in front is in use or it would have been merged
+		unsigned int front = newBlock(m_blocks[index].offset, padding);
+		Block& block = m_blocks[index];
+		Block& padBlock = m_blocks[front];
+		padBlock.free = true;
+		padBlock.prevPhysical = block.prevPhysical;
+		padBlock.nextPhysical = index;
+		if (block.prevPhysical != NO_BLOCK)
+			m_blocks[block.prevPhysical].nextPhysical = front;
+		block.prevPhysical = front;
+		block.offset += padding;
+		block.size -= padding;
+		insertFree(front);
+	}
+
+	split(index, size);
+
+	Block& block = m_blocks[index];
+	block.free = false;
+	m_used += block.size;
+	m_allocations++;
+
+	out.offset = block.offset;
+	out.size = block.size;
+	out.block = index;
+	return true;
+}
+
+void TlsfAllocator::free(unsigned int index)
+{
+	Block* block = &m_blocks[index];
+	if (block->free || block->size == 0)
+		return;
+
+	block->free = true;
+	m_used -= block->size;
+	m_allocations--;
+
+	unsigned int next = block->nextPhysical;
+	if (next != NO_BLOCK && m_blocks[next].free)
+	{
+		removeFree(next);
+		block->size += m_blocks[next].size;
+		block->nextPhysical = m_blocks[next].nextPhysical;
+		if (block->nextPhysical != NO_BLOCK)
+			m_blocks[block->nextPhysical].prevPhysical = index;
+		m_blocks[next].size = 0;
+		m_blocks[next].free = false;
+		m_unusedBlocks.push_back(next);
+	}
+
+	unsigned int prev = block->prevPhysical;
+	if (prev != NO_BLOCK && m_blocks[prev].free)
+	{
+		removeFree(prev);
+		m_blocks[prev].size += block->size;
+		m_blocks[prev].nextPhysical = block->nextPhysical;
+		if (block->nextPhysical != NO_BLOCK)
+			m_blocks[block->nextPhysical].prevPhysical = prev;
+		block->size = 0;
+		block->free = false;
+		m_unusedBlocks.push_back(index);
+		index = prev;
+	}
+
+	insertFree(index);
+}
+
+TlsfStats TlsfAllocator::getStats() const
+{
+	TlsfStats stats = { m_size, m_used, 0, 0, m_allocations, 0.0f };
+	for (const Block& block : m_blocks)
+	{
+		if (!block.free || block.size == 0)
+			continue;
+		stats.freeBlocks++;
+		if (block.size > stats.largestFree)
+			stats.largestFree = block.size;
+	}
+
+	unsigned int freeBytes = m_size - m_used;
+	if (freeBytes > 0)
+		stats.fragmentation = 1.0f - (float)stats.largestFree / freeBytes;
+	return stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+
+//Where an allocation ended up, block is what free() takes back
+struct TlsfAllocation
+{
+	unsigned int offset;
+	unsigned int size;
+	unsigned int block;
+};
+
+struct TlsfStats
+{
+	unsigned int size;
+	unsigned int used;
+	unsigned int largestFree;
+	unsigned int freeBlocks;
+	unsigned int allocations;
+	float fragmentation; //1 - largestFree / free, 0 when the free space is in one piece
+};
+
+//Two-level segregated fit allocator over a range of offsets [0, size) that lives somewhere else, like a GPU buffer,
+//so the bookkeeping is kept on the side instead of in headers inside the memory
+//Free blocks are binned by size, first by power of two then in 16 linear steps, with a bitmap per level, so
+//allocating and freeing are O(1): finding a bin is two bit scans, freeing merges with the neighbours right away
+//Offsets and sizes are multiples of GRANULARITY
+class TlsfAllocator
+{
+private:
+	static const unsigned int FL_COUNT = 32;
+	static const unsigned int SL_BITS = 4;
+	static const unsigned int SL_COUNT = 1 << SL_BITS;
+
+	struct Block
+	{
+		unsigned int offset;
+		unsigned int size;
+		unsigned int prevPhysical, nextPhysical; //neighbours in offset order
+		unsigned int prevFree, nextFree;         //in the block's bin
+		bool free;
+	};
+
+	std::vector<Block> m_blocks;
+	std::vector<unsigned int> m_unusedBlocks; //entries of m_blocks to reuse
+	unsigned int m_heads[FL_COUNT][SL_COUNT];
+	unsigned int m_flBitmap;
+	unsigned int m_slBitmaps[FL_COUNT];
+	unsigned int m_size;
+	unsigned int m_used;
+	unsigned int m_allocations;
+
+	unsigned int newBlock(unsigned int offset, unsigned int size);
+	void insertFree(unsigned int block);
+	void removeFree(unsigned int block);
+	unsigned int findFree(unsigned int size) const;
+	void split(unsigned int block, unsigned int size);
+
+public:
+	static const unsigned int GRANULARITY = 16;
+	static const unsigned int NO_BLOCK = 0xFFFFFFFFu;
+
+	explicit TlsfAllocator(unsigned int size = 0);
+
+	//Forgets every allocation, the whole range becomes one free block
+	void reset(unsigned int size);
+
+	//The smallest range that surely fits one allocation of size bytes at alignment: a request is rounded up to the
+	//next bin, so a range just size (plus padding) long can end up in a bin below the one searched
+	static unsigned long long GetRequiredSize(unsigned int size, unsigned int alignment);
+
+	//alignment is a power of two; false when no free block is big enough
+	bool allocate(unsigned int size, unsigned int alignment, TlsfAllocation& out);
+	void free(unsigned int block);
+
+	unsigned int getSize() const { return m_size; }
+	unsigned int getUsed() const { return m_used; }
+	unsigned int getAllocationCount() const { return m_allocations; }
+	TlsfStats getStats() const;
+};
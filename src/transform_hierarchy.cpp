@@ -0,0 +1,318 @@
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <atomic>
+#include "thread_pool.h"
+
+static const unsigned int NO_PARENT = 0xFFFFFFFFu;
+static const unsigned int NO_LEVEL = 0xFFFFFFFFu;
+
+//below this many nodes a level isn't worth handing to the pool
+static const unsigned int MIN_BATCH = 2048;
+
+TransformHierarchy::TransformHierarchy()
+	:m_firstRoot(0), m_liveCount(0), m_update(0), m_firstDirtyLevel(NO_LEVEL), m_lastDirtyLevel(0), m_reorder(false)
+{
+}
+
+void TransformHierarchy::link(unsigned int id, unsigned int parent)
+{
+	Node& node = m_nodes[id - 1];
+	unsigned int& head = parent ? m_nodes[parent - 1].firstChild : m_firstRoot;
+	node.parent = parent;
+	node.prevSibling = 0;
+	node.nextSibling = head;
+	if (head)
+		m_nodes[head - 1].prevSibling = id;
+	head = id;
+}
+
+void TransformHierarchy::unlink(unsigned int id)
+{
+	Node& node = m_nodes[id - 1];
+	if (node.prevSibling)
+		m_nodes[node.prevSibling - 1].nextSibling = node.nextSibling;
+	else if (node.parent)
+		m_nodes[node.parent - 1].firstChild = node.nextSibling;
+	else
+		m_firstRoot = node.nextSibling;
+	if (node.nextSibling)
+		m_nodes[node.nextSibling - 1].prevSibling = node.prevSibling;
+	node.prevSibling = node.nextSibling = 0;
+}
+
+unsigned int TransformHierarchy::create(unsigned int parent, const Vec3& position, const Quat& rotation, const Vec3& scale)
+{
+	if (parent && !isValid(parent))
+		return 0;
+
+	unsigned int id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		m_nodes.push_back(Node());
+		id = (unsigned int)m_nodes.size();
+	}
+
+	//appended out of order for now, reorder() moves it behind its parent
+	Node& node = m_nodes[id - 1];
+	node.firstChild = 0;
+	node.index = (unsigned int)m_ids.size();
+	node.live = true;
+	link(id, parent);
+
+	m_ids.push_back(id);
+	m_parents.push_back(NO_PARENT);
+	m_positions.push_back(position);
+	m_rotations.push_back(rotation);
+	m_scales.push_back(scale);
+	m_localMatrices.push_back(Mat4::Identity());
+	m_worldMatrices.push_back(Mat4::Identity());
+	m_dirty.push_back(1);
+	m_changed.push_back(0);
+
+	m_liveCount++;
+	m_reorder = true;
+	return id;
+}
+
+void TransformHierarchy::destroy(unsigned int id)
+{
+	if (!isValid(id))
+		return;
+
+	unlink(id);
+
+	//the subtree's slots in the arrays stay until reorder() drops them
+	std::vector<unsigned int> stack(1, id);
+	while (!stack.empty())
+	{
+		unsigned int current = stack.back();
+		stack.pop_back();
+
+		Node& node = m_nodes[current - 1];
+		for (unsigned int child = node.firstChild; child; child = m_nodes[child - 1].nextSibling)
+			stack.push_back(child);
+		node.live = false;
+		m_freeIds.push_back(current);
+		m_liveCount--;
+	}
+	m_reorder = true;
+}
+
+bool TransformHierarchy::setParent(unsigned int id, unsigned int parent)
+{
+	if (!isValid(id) || (parent && !isValid(parent)))
+		return false;
+	if (m_nodes[id - 1].parent == parent)
+		return true;
+
+	for (unsigned int ancestor = parent; ancestor; ancestor = m_nodes[ancestor - 1].parent)
+	{
+		if (ancestor == id)
+			return false;
+	}
+
+	unlink(id);
+	link(id, parent);
+	m_dirty[m_nodes[id - 1].index] = 1;
+	m_reorder = true;
+	return true;
+}
+
+void TransformHierarchy::markDirty(unsigned int index)
+{
+	m_dirty[index] = 1;
+	if (m_reorder)
+		return; //reorder() finds the dirty levels itself
+
+	unsigned int level = (unsigned int)(std::upper_bound(m_levelStarts.begin(), m_levelStarts.end(), index) - m_levelStarts.begin()) - 1;
+	m_firstDirtyLevel = std::min(m_firstDirtyLevel, level);
+	m_lastDirtyLevel = std::max(m_lastDirtyLevel, level);
+}
+
+void TransformHierarchy::setLocal(unsigned int id, const Vec3& position, const Quat& rotation, const Vec3& scale)
+{
+	unsigned int index = m_nodes[id - 1].index;
+	m_positions[index] = position;
+	m_rotations[index] = rotation;
+	m_scales[index] = scale;
+	markDirty(index);
+}
+
+void TransformHierarchy::setPosition(unsigned int id, const Vec3& position)
+{
+	unsigned int index = m_nodes[id - 1].index;
+	m_positions[index] = position;
+	markDirty(index);
+}
+
+void TransformHierarchy::setRotation(unsigned int id, const Quat& rotation)
+{
+	unsigned int index = m_nodes[id - 1].index;
+	m_rotations[index] = rotation;
+	markDirty(index);
+}
+
+void TransformHierarchy::setScale(unsigned int id, const Vec3& scale)
+{
+	unsigned int index = m_nodes[id - 1].index;
+	m_scales[index] = scale;
+	markDirty(index);
+}
+
+//Breadth first from the roots: levels come out contiguous and the children of a parent side by side
+void TransformHierarchy::reorder()
+{
+	std::vector<unsigned int> order;
+	order.reserve(m_liveCount);
+	m_levelStarts.clear();
+
+	for (unsigned int root = m_firstRoot; root; root = m_nodes[root - 1].nextSibling)
+		order.push_back(root);
+	unsigned int begin = 0;
+	while (begin < order.size())
+	{
+		m_levelStarts.push_back(begin);
+		unsigned int end = (unsigned int)order.size();
+		for (unsigned int i = begin; i < end; i++)
+		{
+			for (unsigned int child = m_nodes[order[i] - 1].firstChild; child; child = m_nodes[child - 1].nextSibling)
+				order.push_back(child);
+		}
+		begin = end;
+	}
+	m_levelStarts.push_back((unsigned int)order.size());
+
+	unsigned int count = (unsigned int)order.size();
+	std::vector<Vec3> positions(count), scales(count);
+	std::vector<Quat> rotations(count);
+	std::vector<Mat4> localMatrices(count), worldMatrices(count);
+	std::vector<unsigned char> dirty(count);
+	std::vector<unsigned int> changed(count), parents(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int old = m_nodes[order[i] - 1].index;
+		positions[i] = m_positions[old];
+		rotations[i] = m_rotations[old];
+		scales[i] = m_scales[old];
+		localMatrices[i] = m_localMatrices[old];
+		worldMatrices[i] = m_worldMatrices[old];
+		dirty[i] = m_dirty[old];
+		changed[i] = m_changed[old];
+	}
+
+	m_firstDirtyLevel = NO_LEVEL;
+	m_lastDirtyLevel = 0;
+	for (unsigned int level = 0; level + 1 < m_levelStarts.size(); level++)
+	{
+		for (unsigned int i = m_levelStarts[level]; i < m_levelStarts[level + 1]; i++)
+		{
+			m_nodes[order[i] - 1].index = i;
+			if (dirty[i])
+			{
+				m_firstDirtyLevel = std::min(m_firstDirtyLevel, level);
+				m_lastDirtyLevel = level;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int parent = m_nodes[order[i] - 1].parent;
+		parents[i] = parent ? m_nodes[parent - 1].index : NO_PARENT;
+	}
+
+	m_ids.swap(order);
+	m_parents.swap(parents);
+	m_positions.swap(positions);
+	m_rotations.swap(rotations);
+	m_scales.swap(scales);
+	m_localMatrices.swap(localMatrices);
+	m_worldMatrices.swap(worldMatrices);
+	m_dirty.swap(dirty);
+	m_changed.swap(changed);
+	m_reorder = false;
+}
+
+//One level's worth of nodes; the level above is final, so nothing written here is read by another range
+//Returns whether any world matrix changed
+bool TransformHierarchy::updateRange(const MathKernels& kernels, unsigned int begin, unsigned int end)
+{
+	bool changed = false;
+	unsigned int i = begin;
+	while (i < end)
+	{
+		unsigned int parent = m_parents[i];
+		if (parent != NO_PARENT && m_changed[parent] == m_update)
+		{
+			//the parent moved, so do all of its children in the range in one batch
+			unsigned int run = i;
+			for (; run < end && m_parents[run] == parent; run++)
+			{
+				if (m_dirty[run])
+				{
+					m_localMatrices[run] = Mat4::FromTRS(m_positions[run], m_rotations[run], m_scales[run]);
+					m_dirty[run] = 0;
+				}
+				m_changed[run] = m_update;
+			}
+			kernels.multiplyMatrix(m_worldMatrices[parent], &m_localMatrices[i], run - i, &m_worldMatrices[i]);
+			changed = true;
+			i = run;
+			continue;
+		}
+
+		if (m_dirty[i])
+		{
+			m_localMatrices[i] = Mat4::FromTRS(m_positions[i], m_rotations[i], m_scales[i]);
+			m_worldMatrices[i] = parent == NO_PARENT ? m_localMatrices[i] : m_worldMatrices[parent] * m_localMatrices[i];
+			m_dirty[i] = 0;
+			m_changed[i] = m_update;
+			changed = true;
+		}
+		i++;
+	}
+	return changed;
+}
+
+void TransformHierarchy::update()
+{
+	if (m_reorder)
+		reorder();
+
+	m_update++;
+	if (m_firstDirtyLevel == NO_LEVEL)
+		return;
+
+	MathKernels kernels = GetMathKernels(GetSimdLevel());
+	unsigned int levels = (unsigned int)m_levelStarts.size() - 1;
+	for (unsigned int level = m_firstDirtyLevel; level < levels; level++)
+	{
+		unsigned int begin = m_levelStarts[level];
+		unsigned int count = m_levelStarts[level + 1] - begin;
+
+		bool changed;
+		if (count < MIN_BATCH * 2)
+			changed = updateRange(kernels, begin, begin + count);
+		else
+		{
+			std::atomic<bool> anyChanged(false);
+			GetThreadPool().parallelFor(count, MIN_BATCH, [&](unsigned int first, unsigned int last)
+			{
+				if (updateRange(kernels, begin + first, begin + last))
+					anyChanged.store(true, std::memory_order_relaxed);
+			});
+			changed = anyChanged.load();
+		}
+
+		//past the last dirty level only moved parents carry changes further down
+		if (!changed && level >= m_lastDirtyLevel)
+			break;
+	}
+
+	m_firstDirtyLevel = NO_LEVEL;
+	m_lastDirtyLevel = 0;
+}
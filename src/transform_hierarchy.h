@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include "math3d.h"
+
+//Parent/child transforms for large scenes where only a few nodes move per frame
+//The hot data lives in arrays ordered by depth, every level contiguous and the children of a parent next to each other,
+//so update() walks memory front to back and a parent's world matrix is always final before its children read it
+//Only dirty nodes and the subtrees below them are recomputed; the nodes of one level don't depend on each other, so
+//every level is split over the thread pool, and siblings under a moved parent go through one batched MultiplyMatrices
+//Creating, destroying and reparenting only touch the per id links, the arrays are reordered once on the next update()
+//Ids stay valid until destroyed; world matrices are the ones of the last update()
+class TransformHierarchy
+{
+private:
+	struct Node
+	{
+		unsigned int parent;      //ids, 0 for none
+		unsigned int firstChild;
+		unsigned int nextSibling;
+		unsigned int prevSibling;
+		unsigned int index;       //into the ordered arrays
+		bool live;
+	};
+
+	//per id, only used by structural changes
+	std::vector<Node> m_nodes; //indexed by id - 1
+	std::vector<unsigned int> m_freeIds;
+	unsigned int m_firstRoot;
+	unsigned int m_liveCount;
+
+	//ordered by depth, indexed by Node::index
+	std::vector<unsigned int> m_ids;
+	std::vector<unsigned int> m_parents; //indices, ~0 for roots
+	std::vector<Vec3> m_positions;
+	std::vector<Quat> m_rotations;
+	std::vector<Vec3> m_scales;
+	std::vector<Mat4> m_localMatrices;
+	std::vector<Mat4> m_worldMatrices;
+	std::vector<unsigned char> m_dirty; //local transform changed since the last update
+	std::vector<unsigned int> m_changed; //the update that last recomputed the world matrix
+	std::vector<unsigned int> m_levelStarts; //one past the last level at the end
+
+	unsigned int m_update;
+	unsigned int m_firstDirtyLevel; //no dirty node outside these levels, first > last when clean
+	unsigned int m_lastDirtyLevel;
+	bool m_reorder;
+
+	void link(unsigned int id, unsigned int parent);
+	void unlink(unsigned int id);
+	void reorder();
+	void markDirty(unsigned int index);
+	bool updateRange(const MathKernels& kernels, unsigned int begin, unsigned int end);
+
+public:
+	TransformHierarchy();
+
+	//A node under parent (0 for a root), returns its id
+	unsigned int create(unsigned int parent = 0, const Vec3& position = Vec3(), const Quat& rotation = Quat(), const Vec3& scale = Vec3(1.0f, 1.0f, 1.0f));
+
+	//Destroys id and everything below it
+	void destroy(unsigned int id);
+
+	//Moves id under parent (0 makes it a root), keeping its local transform
+	//Returns false, changing nothing, when parent is id itself or below it
+	bool setParent(unsigned int id, unsigned int parent);
+
+	void setLocal(unsigned int id, const Vec3& position, const Quat& rotation, const Vec3& scale);
+	void setPosition(unsigned int id, const Vec3& position);
+	void setRotation(unsigned int id, const Quat& rotation);
+	void setScale(unsigned int id, const Vec3& scale);
+
+	//Recomputes the world matrices of everything that moved, parallel when there's enough of it
+	void update();
+
+	bool isValid(unsigned int id) const { return id > 0 && id <= m_nodes.size() && m_nodes[id - 1].live; }
+	unsigned int getParent(unsigned int id) const { return m_nodes[id - 1].parent; }
+	const Vec3& getPosition(unsigned int id) const { return m_positions[m_nodes[id - 1].index]; }
+	const Quat& getRotation(unsigned int id) const { return m_rotations[m_nodes[id - 1].index]; }
+	const Vec3& getScale(unsigned int id) const { return m_scales[m_nodes[id - 1].index]; }
+	const Mat4& getWorld(unsigned int id) const { return m_worldMatrices[m_nodes[id - 1].index]; }
+
+	//Whether the last update() changed the world matrix of id, for refreshing bounds or instance data
+	bool hasChanged(unsigned int id) const { return m_changed[m_nodes[id - 1].index] == m_update; }
+
+	unsigned int getCount() const { return m_liveCount; }
+	unsigned int getDepth() const { return m_levelStarts.empty() ? 0 : (unsigned int)m_levelStarts.size() - 1; }
+};
@@ -1,24 +1,50 @@
 #include "vertex_buffer.h"
+#include "gpu_buffer_allocator.h"
 #include "renderer.h"
 
 VertexBuffer::VertexBuffer(const void* data, unsigned int size)
 {
-	GLCall(glGenBuffers(1, &m_RendererID)); //create a buffer
-	GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_RendererID)); //"select" a buffer
-	GLCall(glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW));
+	m_allocation = GetGpuBufferAllocator().allocate(data, size).id; //a range of a shared buffer instead of a buffer object of its own
 }
 
 VertexBuffer::~VertexBuffer()
 {
-	GLCall(glDeleteBuffers(1, &m_RendererID));
+	GetGpuBufferAllocator().free(m_allocation);
+}
+
+VertexBuffer::VertexBuffer(VertexBuffer&& other) noexcept
+	:m_allocation(other.m_allocation)
+{
+	other.m_allocation = 0;
+}
+
+VertexBuffer& VertexBuffer::operator=(VertexBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		GetGpuBufferAllocator().free(m_allocation);
+		m_allocation = other.m_allocation;
+		other.m_allocation = 0;
+	}
+	return *this;
 }
 
 void VertexBuffer::bind() const
 {
-	GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_RendererID));
+	GLCall(glBindBuffer(GL_ARRAY_BUFFER, GetGpuBufferAllocator().get(m_allocation).buffer));
 }
 
 void VertexBuffer::unbind() const
 {
 	GLCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+unsigned int VertexBuffer::getBuffer() const
+{
+	return GetGpuBufferAllocator().get(m_allocation).buffer;
+}
+
+unsigned int VertexBuffer::getOffset() const
+{
+	return GetGpuBufferAllocator().get(m_allocation).offset;
 }
\ No newline at end of file
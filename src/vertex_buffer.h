@@ -1,14 +1,30 @@
 #pragma once
 
+//Vertex data in a range of one of GetGpuBufferAllocator()'s buffers
 class VertexBuffer
 {
 private:
-	unsigned int m_RendererID; 
+	unsigned int m_allocation; //id in GetGpuBufferAllocator()
 
 public:
 	VertexBuffer(const void* data, unsigned int size);
 	~VertexBuffer();
 
+	//Owns its range, moving hands it over and leaves the source empty
+	VertexBuffer(VertexBuffer&& other) noexcept;
+	VertexBuffer& operator=(VertexBuffer&& other) noexcept;
+	VertexBuffer(const VertexBuffer&) = delete;
+	VertexBuffer& operator=(const VertexBuffer&) = delete;
+
+	//false when the allocation failed or the buffer was moved from
+	bool isValid() const { return m_allocation != 0; }
+
 	void bind() const;
 	void unbind() const;
+
+	//The shared GL buffer the vertices are in, can change when the allocator compacts
+	unsigned int getBuffer() const;
+
+	//Where the data starts in the bound buffer, added to the attribute offsets
+	unsigned int getOffset() const;
 };
\ No newline at end of file
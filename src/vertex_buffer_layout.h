@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include "renderer.h"
+
+//One attribute of a vertex, attributes get consecutive locations in the order they are pushed
+struct VertexBufferElement
+{
+	unsigned int type;
+	unsigned int count;
+	unsigned char normalized;
+
+	static unsigned int getSizeOfType(unsigned int type)
+	{
+		switch (type)
+		{
+		case GL_FLOAT:         return 4;
+		case GL_UNSIGNED_INT:  return 4;
+		case GL_UNSIGNED_BYTE: return 1;
+		}
+		ASSERT(false);
+		return 0;
+	}
+};
+
+//Describes how the members of a vertex are laid out in a vertex buffer
+//The same layout drives glVertexAttribPointer and the CPU renderer's vertex fetch
+class VertexBufferLayout
+{
+private:
+	std::vector<VertexBufferElement> m_elements;
+	unsigned int m_stride;
+
+public:
+	VertexBufferLayout()
+		:m_stride(0)
+	{
+	}
+
+	template<typename T>
+	void push(unsigned int count);
+
+	//byte offset of an attribute inside a vertex
+	unsigned int getOffset(unsigned int location) const
+	{
+		unsigned int offset = 0;
+		for (unsigned int i = 0; i < location; i++)
+			offset += m_elements[i].count * VertexBufferElement::getSizeOfType(m_elements[i].type);
+		return offset;
+	}
+
+	const std::vector<VertexBufferElement>& getElements() const { return m_elements; }
+	unsigned int getStride() const { return m_stride; }
+};
+
+template<>
+inline void VertexBufferLayout::push<float>(unsigned int count)
+{
+	m_elements.push_back({ GL_FLOAT, count, GL_FALSE });
+	m_stride += count * VertexBufferElement::getSizeOfType(GL_FLOAT);
+}
+
+template<>
+inline void VertexBufferLayout::push<unsigned int>(unsigned int count)
+{
+	m_elements.push_back({ GL_UNSIGNED_INT, count, GL_FALSE });
+	m_stride += count * VertexBufferElement::getSizeOfType(GL_UNSIGNED_INT);
+}
+
+template<>
+inline void VertexBufferLayout::push<unsigned char>(unsigned int count)
+{
+	m_elements.push_back({ GL_UNSIGNED_BYTE, count, GL_TRUE });
+	m_stride += count * VertexBufferElement::getSizeOfType(GL_UNSIGNED_BYTE);
+}
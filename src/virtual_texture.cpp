@@ -0,0 +1,372 @@
+#include "virtual_texture.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "renderer.h"
+
+static const unsigned int EMPTY_TILE = 0xFFFFFFFFu;
+static const unsigned int NO_SLOT = 0xFFFFFFFFu;
+
+//level in the top byte, so sorting keys in descending order puts the coarsest tiles first
+static unsigned int TileKey(unsigned int level, unsigned int x, unsigned int y)
+{
+	return (level << 24) | (y << 12) | x;
+}
+
+static unsigned int KeyLevel(unsigned int key) { return key >> 24; }
+static unsigned int KeyX(unsigned int key) { return key & 0xFFF; }
+static unsigned int KeyY(unsigned int key) { return (key >> 12) & 0xFFF; }
+
+static unsigned int NextPowerOfTwo(unsigned int value)
+{
+	unsigned int power = 1;
+	while (power < value)
+		power *= 2;
+	return power;
+}
+
+VirtualTexture::VirtualTexture(const std::string& path, size_t memoryBudget, unsigned int threadCount)
+	:m_cacheTiles(0), m_tileBytes(0), m_head(NO_SLOT), m_tail(NO_SLOT), m_pinned(NO_SLOT), m_frame(1), m_maxUploads(8), m_maxLoading(16),
+	m_stats(), m_tableWidth(0), m_tableHeight(0), m_pageTableID(0), m_cacheID(0), m_stopping(false), m_threads(threadCount ? threadCount : 1)
+{
+	std::string error;
+	if (!m_file.open(path, error))
+	{
+		std::cout << "failed to load virtual texture " << path << ": " << error << "\n";
+		return;
+	}
+
+	const VirtualTextureInfo& info = m_file.getInfo();
+	unsigned int side = m_file.tileSide();
+	m_tileBytes = m_file.tileBytes();
+
+	//a square of tiles within the budget, the page table entries address up to 255 per side
+	int maxSize;
+	GLCall(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize));
+	m_cacheTiles = (unsigned int)std::sqrt((double)(memoryBudget / m_tileBytes));
+	m_cacheTiles = std::max(2u, std::min(m_cacheTiles, std::min((unsigned int)maxSize / side, 255u)));
+
+	m_slots.resize((size_t)m_cacheTiles * m_cacheTiles);
+	for (unsigned int i = 0; i < m_slots.size(); i++)
+	{
+		m_slots[i].key = EMPTY_TILE;
+		m_slots[i].lastUsed = 0;
+		pushFront(i);
+	}
+
+	m_tableWidth = NextPowerOfTwo(info.tilesX);
+	m_tableHeight = NextPowerOfTwo(info.tilesY);
+	m_table.resize(info.levels);
+	m_dirty.resize(info.levels);
+	for (unsigned int level = 0; level < info.levels; level++)
+	{
+		unsigned int width = std::max(1u, m_tableWidth >> level), height = std::max(1u, m_tableHeight >> level);
+		m_table[level].assign((size_t)width * height, 0);
+		m_dirty[level].first = 0;
+		m_dirty[level].end = height;
+	}
+
+	GLCall(glGenTextures(1, &m_cacheID));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_cacheID));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, getCacheSize(), getCacheSize(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+
+	GLCall(glGenTextures(1, &m_pageTableID));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_pageTableID));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)info.levels - 1));
+	for (unsigned int level = 0; level < info.levels; level++)
+	{
+		GLCall(glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(1u, m_tableWidth >> level), std::max(1u, m_tableHeight >> level), 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+	}
+
+	//the last level is a single tile that everything falls back to
+	unsigned int top = info.levels - 1;
+	place(TileKey(top, 0, 0), m_file.tile(top, 0, 0));
+	m_pinned = m_resident[TileKey(top, 0, 0)];
+	unlink(m_pinned);
+	uploadTable();
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	//queued loads are skipped
+	m_stopping = true;
+	GLCall(glDeleteTextures(1, &m_pageTableID));
+	GLCall(glDeleteTextures(1, &m_cacheID));
+}
+
+void VirtualTexture::unlink(unsigned int slot)
+{
+	Slot& s = m_slots[slot];
+	if (s.prev != NO_SLOT)
+		m_slots[s.prev].next = s.next;
+	else
+		m_head = s.next;
+	if (s.next != NO_SLOT)
+		m_slots[s.next].prev = s.prev;
+	else
+		m_tail = s.prev;
+}
+
+void VirtualTexture::pushFront(unsigned int slot)
+{
+	Slot& s = m_slots[slot];
+	s.prev = NO_SLOT;
+	s.next = m_head;
+	if (m_head != NO_SLOT)
+		m_slots[m_head].prev = slot;
+	m_head = slot;
+	if (m_tail == NO_SLOT)
+		m_tail = slot;
+}
+
+void VirtualTexture::touch(unsigned int slot)
+{
+	m_slots[slot].lastUsed = m_frame;
+	if (slot == m_pinned || slot == m_head)
+		return;
+	unlink(slot);
+	pushFront(slot);
+}
+
+void VirtualTexture::load(unsigned int key)
+{
+	m_loading.insert(key);
+	m_threads.submit([this, key]
+	{
+		if (m_stopping)
+			return;
+
+		Loaded loaded;
+		loaded.key = key;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_freeBuffers.empty())
+			{
+				loaded.pixels = std::move(m_freeBuffers.back());
+				m_freeBuffers.pop_back();
+			}
+		}
+
+		//reading the mapped tile is what waits on the disk
+		loaded.pixels.resize(m_tileBytes);
+		std::memcpy(loaded.pixels.data(), m_file.tile(KeyLevel(key), KeyX(key), KeyY(key)), m_tileBytes);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loaded.push_back(std::move(loaded));
+	});
+}
+
+bool VirtualTexture::place(unsigned int key, const unsigned char* pixels)
+{
+	//the least recently used slot, unless the feedback still wants it
+	unsigned int slot = m_tail;
+	Slot& s = m_slots[slot];
+	if (s.key != EMPTY_TILE && s.lastUsed == m_frame)
+		return false;
+
+	unsigned int evicted = s.key;
+	if (evicted != EMPTY_TILE)
+	{
+		m_resident.erase(evicted);
+		m_stats.evictions++;
+	}
+	s.key = key;
+	m_resident[key] = slot;
+	touch(slot);
+
+	unsigned int side = m_file.tileSide();
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_cacheID));
+	GLCall(glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % m_cacheTiles) * side, (slot / m_cacheTiles) * side, side, side, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+
+	//coarser first, when one tile covers the other the finer refresh has to see the coarser one's entries
+	if (evicted != EMPTY_TILE && KeyLevel(evicted) > KeyLevel(key))
+		refreshTable(KeyLevel(evicted), KeyX(evicted), KeyY(evicted));
+	refreshTable(KeyLevel(key), KeyX(key), KeyY(key));
+	if (evicted != EMPTY_TILE && KeyLevel(evicted) <= KeyLevel(key))
+		refreshTable(KeyLevel(evicted), KeyX(evicted), KeyY(evicted));
+	return true;
+}
+
+//Points every entry the tile covers, on its level and all finer ones, at the finest resident tile above it
+void VirtualTexture::refreshTable(unsigned int level, unsigned int x, unsigned int y)
+{
+	for (int l = (int)level; l >= 0; l--)
+	{
+		unsigned int shift = level - l;
+		unsigned int width = std::max(1u, m_tableWidth >> l), height = std::max(1u, m_tableHeight >> l);
+		unsigned int x0 = x << shift, y0 = y << shift;
+		if (x0 >= width || y0 >= height)
+			break;
+		unsigned int x1 = std::min(width, (x + 1) << shift), y1 = std::min(height, (y + 1) << shift);
+
+		std::vector<unsigned int>& table = m_table[l];
+		unsigned int parentWidth = std::max(1u, m_tableWidth >> (l + 1));
+		for (unsigned int ty = y0; ty < y1; ty++)
+		{
+			for (unsigned int tx = x0; tx < x1; tx++)
+			{
+				auto it = m_resident.find(TileKey(l, tx, ty));
+				unsigned int entry;
+				if (it != m_resident.end())
+					entry = (it->second % m_cacheTiles) | ((it->second / m_cacheTiles) << 8) | ((unsigned int)l << 16) | 0xFF000000u;
+				else
+					entry = m_table[l + 1][(size_t)(ty / 2) * parentWidth + tx / 2]; //the last level is always resident
+				table[(size_t)ty * width + tx] = entry;
+			}
+		}
+
+		DirtyRows& dirty = m_dirty[l];
+		dirty.first = dirty.first < dirty.end ? std::min(dirty.first, y0) : y0;
+		dirty.end = std::max(dirty.end, y1);
+	}
+}
+
+void VirtualTexture::uploadTable()
+{
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_pageTableID));
+	for (unsigned int level = 0; level < m_table.size(); level++)
+	{
+		DirtyRows& dirty = m_dirty[level];
+		if (dirty.first >= dirty.end)
+			continue;
+
+		unsigned int width = std::max(1u, m_tableWidth >> level);
+		GLCall(glTexSubImage2D(GL_TEXTURE_2D, level, 0, dirty.first, width, dirty.end - dirty.first, GL_RGBA, GL_UNSIGNED_BYTE,
+			&m_table[level][(size_t)dirty.first * width]));
+		dirty.first = dirty.end = 0;
+	}
+}
+
+void VirtualTexture::addFeedback(const unsigned int* pixels, unsigned int count)
+{
+	if (!isValid())
+		return;
+
+	//neighbouring pixels mostly want the same tile, skip the repeats before sorting
+	const VirtualTextureInfo& info = m_file.getInfo();
+	unsigned int last = EMPTY_TILE;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int pixel = pixels[i];
+		unsigned int level = pixel >> 24;
+		if (level >= info.levels) //cleared, nothing was drawn there
+			continue;
+
+		unsigned int x = (pixel & 0xFF) | ((pixel >> 8) & 0xF00);
+		unsigned int y = ((pixel >> 8) & 0xFF) | ((pixel >> 12) & 0xF00);
+		if (x >= VirtualTilesAt(info.tilesX, level) || y >= VirtualTilesAt(info.tilesY, level))
+			continue;
+
+		unsigned int key = TileKey(level, x, y);
+		if (key != last)
+			m_requests.push_back(key);
+		last = key;
+	}
+}
+
+void VirtualTexture::update()
+{
+	if (!isValid())
+		return;
+	m_frame++;
+	m_stats.uploads = 0;
+
+	std::vector<Loaded> arrived;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t count = std::min(m_loaded.size(), (size_t)m_maxUploads);
+		arrived.insert(arrived.end(), std::make_move_iterator(m_loaded.begin()), std::make_move_iterator(m_loaded.begin() + count));
+		m_loaded.erase(m_loaded.begin(), m_loaded.begin() + count);
+	}
+	for (Loaded& loaded : arrived)
+	{
+		//when every slot is still in view the tile is dropped, the feedback asks for it again
+		m_loading.erase(loaded.key);
+		if (!m_resident.count(loaded.key) && place(loaded.key, loaded.pixels.data()))
+			m_stats.uploads++;
+	}
+	if (!arrived.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Loaded& loaded : arrived)
+			m_freeBuffers.push_back(std::move(loaded.pixels));
+	}
+
+	//keep what the feedback shows and every resident tile above it, those are what it falls back to when evicted,
+	//and queue what's missing between each tile and the finest resident tile above it
+	std::sort(m_requests.begin(), m_requests.end());
+	m_requests.erase(std::unique(m_requests.begin(), m_requests.end()), m_requests.end());
+	m_stats.requestedTiles = (unsigned int)m_requests.size();
+	m_missing.clear();
+	unsigned int top = m_file.getInfo().levels - 1;
+	for (unsigned int key : m_requests)
+	{
+		bool covered = false;
+		while (KeyLevel(key) < top)
+		{
+			auto it = m_resident.find(key);
+			if (it != m_resident.end())
+			{
+				touch(it->second);
+				covered = true;
+			}
+			else if (!covered && !m_loading.count(key))
+				m_missing.push_back(key);
+			key = TileKey(KeyLevel(key) + 1, KeyX(key) / 2, KeyY(key) / 2);
+		}
+	}
+	m_requests.clear();
+
+	//coarsest first, so something close shows up quickly everywhere
+	std::sort(m_missing.begin(), m_missing.end(), [](unsigned int a, unsigned int b) { return a > b; });
+	m_missing.erase(std::unique(m_missing.begin(), m_missing.end()), m_missing.end());
+	for (unsigned int key : m_missing)
+	{
+		if (m_loading.size() >= m_maxLoading)
+			break;
+		load(key);
+	}
+
+	uploadTable();
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	m_stats.residentTiles = (unsigned int)m_resident.size();
+	m_stats.loadingTiles = (unsigned int)m_loading.size();
+}
+
+void VirtualTexture::setUniforms(unsigned int program) const
+{
+	const VirtualTextureInfo& info = m_file.getInfo();
+	float virtualWidth = (float)(info.tilesX * info.tileSize), virtualHeight = (float)(info.tilesY * info.tileSize);
+	GLCall(glUniform2f(glGetUniformLocation(program, "u_VirtualSize"), virtualWidth, virtualHeight));
+	GLCall(glUniform2f(glGetUniformLocation(program, "u_UvScale"), info.width / virtualWidth, info.height / virtualHeight));
+	GLCall(glUniform1f(glGetUniformLocation(program, "u_TileSize"), (float)info.tileSize));
+	GLCall(glUniform1f(glGetUniformLocation(program, "u_Border"), (float)info.border));
+	GLCall(glUniform1f(glGetUniformLocation(program, "u_CacheSize"), (float)getCacheSize()));
+	GLCall(glUniform1i(glGetUniformLocation(program, "u_MaxLevel"), (int)info.levels - 1));
+}
+
+void VirtualTexture::bind(unsigned int pageTableSlot, unsigned int cacheSlot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + pageTableSlot));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_pageTableID));
+	GLCall(glActiveTexture(GL_TEXTURE0 + cacheSlot));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_cacheID));
+}
+
+void VirtualTexture::unbind(unsigned int pageTableSlot, unsigned int cacheSlot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + pageTableSlot));
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	GLCall(glActiveTexture(GL_TEXTURE0 + cacheSlot));
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+}
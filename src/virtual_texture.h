@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "thread_pool.h"
+#include "virtual_texture_file.h"
+
+struct VirtualTextureStats
+{
+	unsigned int residentTiles;
+	unsigned int loadingTiles;
+	unsigned int requestedTiles; //different tiles in the feedback of the last update
+	unsigned int uploads;        //in the last update
+	unsigned int evictions;      //since creation
+};
+
+//A .vtex file too big for a texture, drawn through a fixed size cache of its tiles
+//The shaders in res/shaders/virtual_texture_*.shader look up every pixel's tile in the page table texture, which holds
+//for each tile of each level where in the cache texture the finest resident tile covering it is, so a tile that isn't
+//loaded yet shows its coarser parent instead of nothing
+//The fragment shader also writes the tile it wanted into a feedback target; reading that back (a downscaled copy a frame
+//late is fine) and handing it to addFeedback() is what decides which tiles get loaded. Missing tiles are read from the mapped file
+//on the streamer's own threads, coarsest first, and replace the least recently used tiles of the cache, where a tile in
+//view also keeps the coarser tiles it falls back to in use; the single tile of the last level is loaded up front and never evicted
+//Like the textures, it must be created, updated and destroyed on the GL thread
+class VirtualTexture
+{
+private:
+	struct Slot
+	{
+		unsigned int key; //EMPTY_TILE when free
+		unsigned int lastUsed; //update that last saw the tile in the feedback
+		unsigned int prev, next; //least recently used list, head is the most recent
+	};
+
+	struct Loaded
+	{
+		unsigned int key;
+		std::vector<unsigned char> pixels;
+	};
+
+	struct DirtyRows
+	{
+		unsigned int first, end; //rows of the level to upload, none when first >= end
+	};
+
+	VirtualTextureFile m_file;
+	unsigned int m_cacheTiles; //per side of the cache texture
+	size_t m_tileBytes;
+
+	std::vector<Slot> m_slots;
+	unsigned int m_head, m_tail;
+	unsigned int m_pinned; //slot of the last level's tile, never in the list
+	std::unordered_map<unsigned int, unsigned int> m_resident; //key -> slot
+	std::unordered_set<unsigned int> m_loading;
+	std::vector<unsigned int> m_requests; //keys from the feedback since the last update
+	std::vector<unsigned int> m_missing;
+	unsigned int m_frame;
+	unsigned int m_maxUploads;
+	unsigned int m_maxLoading;
+	VirtualTextureStats m_stats;
+
+	//page table, a level per mip, entries are RGBA8: cache tile x, cache tile y, level of that tile
+	unsigned int m_tableWidth, m_tableHeight; //powers of two, the texture's sizes have to halve like the tile counts
+	std::vector<std::vector<unsigned int>> m_table;
+	std::vector<DirtyRows> m_dirty;
+
+	unsigned int m_pageTableID;
+	unsigned int m_cacheID;
+
+	//filled by the streamer threads
+	std::mutex m_mutex;
+	std::vector<Loaded> m_loaded;
+	std::vector<std::vector<unsigned char>> m_freeBuffers;
+	std::atomic<bool> m_stopping;
+
+	//declared last so it's destroyed first, its threads finish their tasks while the members above still exist
+	ThreadPool m_threads;
+
+	void unlink(unsigned int slot);
+	void pushFront(unsigned int slot);
+	void touch(unsigned int slot);
+	void load(unsigned int key);
+	bool place(unsigned int key, const unsigned char* pixels);
+	void refreshTable(unsigned int level, unsigned int x, unsigned int y);
+	void uploadTable();
+
+public:
+	//memoryBudget is what the cache texture may take, it gets as many tiles as fit, at least 4
+	VirtualTexture(const std::string& path, size_t memoryBudget = 64 << 20, unsigned int threadCount = 1);
+	~VirtualTexture();
+
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	//False when the file couldn't be opened, nothing is drawn then
+	bool isValid() const { return m_file.isOpen(); }
+	const VirtualTextureInfo& getInfo() const { return m_file.getInfo(); }
+
+	//Side of the cache texture in pixels and tiles
+	unsigned int getCacheSize() const { return m_cacheTiles * m_file.tileSide(); }
+	unsigned int getCacheTiles() const { return m_cacheTiles; }
+
+	//Pixels read back from the feedback target, RGBA8 as the fragment shader wrote them
+	void addFeedback(const unsigned int* pixels, unsigned int count);
+
+	//Places the tiles that finished loading, at most maxUploads per call, updates the page table and starts loading
+	//the tiles the feedback asked for; once per frame
+	void update();
+
+	void setMaxUploads(unsigned int tilesPerUpdate) { m_maxUploads = tilesPerUpdate; }
+	const VirtualTextureStats& getStats() const { return m_stats; }
+
+	//Sets the u_ uniforms of the virtual texture shader other than the samplers, the program must be in use
+	void setUniforms(unsigned int program) const;
+
+	//The page table goes to u_PageTable, the cache to u_Cache
+	void bind(unsigned int pageTableSlot = 0, unsigned int cacheSlot = 1) const;
+	void unbind(unsigned int pageTableSlot = 0, unsigned int cacheSlot = 1) const;
+};
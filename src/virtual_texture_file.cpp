@@ -0,0 +1,183 @@
+#include "virtual_texture_file.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static const unsigned int VTEX_MAGIC = 0x58455456; //"VTEX"
+static const unsigned int VTEX_VERSION = 1;
+static const size_t VTEX_HEADER_SIZE = 36;         //magic, version and the info, the level offsets follow
+static const size_t VTEX_ALIGNMENT = 4096;         //tiles start on a page
+static const unsigned int MAX_TILES = 4096;        //per side at level 0, what the feedback can address
+static const unsigned int MAX_TILE_SIZE = 1024;    //keeps tileBytes() far from overflowing
+
+static void Put32(std::vector<unsigned char>& out, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static unsigned int Read32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned int LevelsFor(unsigned int tilesX, unsigned int tilesY)
+{
+	unsigned int levels = 1;
+	while (VirtualTilesAt(tilesX, levels - 1) > 1 || VirtualTilesAt(tilesY, levels - 1) > 1)
+		levels++;
+	return levels;
+}
+
+//one tile with its border, pixels outside the level repeat its edge
+static void CutTile(const Image& level, unsigned int tileSize, unsigned int border, unsigned int tileX, unsigned int tileY, unsigned int* out)
+{
+	unsigned int side = tileSize + 2 * border;
+	int left = (int)(tileX * tileSize) - (int)border, bottom = (int)(tileY * tileSize) - (int)border;
+	for (unsigned int y = 0; y < side; y++)
+	{
+		int sourceY = std::min(std::max(bottom + (int)y, 0), (int)level.height - 1);
+		const unsigned int* row = &level.pixels[(size_t)sourceY * level.width];
+		for (unsigned int x = 0; x < side; x++)
+			out[y * side + x] = row[std::min(std::max(left + (int)x, 0), (int)level.width - 1)];
+	}
+}
+
+bool BuildVirtualTexture(const Image& image, unsigned int tileSize, unsigned int border, const MipOptions& options, const std::string& path)
+{
+	if (image.width == 0 || image.height == 0 || tileSize < 8 || tileSize > MAX_TILE_SIZE || (tileSize & (tileSize - 1)) || border > tileSize / 2)
+	{
+		std::cout << path << ": the tile size must be a power of two from 8 to " << MAX_TILE_SIZE << ", the border at most half of it\n";
+		return false;
+	}
+
+	VirtualTextureInfo info;
+	info.width = image.width;
+	info.height = image.height;
+	info.tileSize = tileSize;
+	info.border = border;
+	info.tilesX = (image.width + tileSize - 1) / tileSize;
+	info.tilesY = (image.height + tileSize - 1) / tileSize;
+	info.levels = LevelsFor(info.tilesX, info.tilesY);
+	if (info.tilesX > MAX_TILES || info.tilesY > MAX_TILES)
+	{
+		std::cout << path << ": more than " << MAX_TILES << " tiles on a side\n";
+		return false;
+	}
+
+	//the chain of the padded image, so every level lines up with the tiles of the one below
+	Image padded(info.tilesX * tileSize, info.tilesY * tileSize);
+	for (unsigned int y = 0; y < padded.height; y++)
+	{
+		const unsigned int* row = &image.pixels[(size_t)std::min(y, image.height - 1) * image.width];
+		for (unsigned int x = 0; x < padded.width; x++)
+			padded.pixels[(size_t)y * padded.width + x] = row[std::min(x, image.width - 1)];
+	}
+	std::vector<Image> chain;
+	GenerateMipmaps(padded, options, chain);
+
+	std::vector<unsigned char> header;
+	Put32(header, VTEX_MAGIC);
+	Put32(header, VTEX_VERSION);
+	Put32(header, info.width);
+	Put32(header, info.height);
+	Put32(header, info.tileSize);
+	Put32(header, info.border);
+	Put32(header, info.levels);
+	Put32(header, info.tilesX);
+	Put32(header, info.tilesY);
+
+	size_t side = tileSize + 2 * border;
+	size_t tileBytes = side * side * 4;
+	unsigned long long offset = (VTEX_HEADER_SIZE + info.levels * 8 + VTEX_ALIGNMENT - 1) / VTEX_ALIGNMENT * VTEX_ALIGNMENT;
+	for (unsigned int level = 0; level < info.levels; level++)
+	{
+		Put32(header, (unsigned int)offset);
+		Put32(header, (unsigned int)(offset >> 32));
+		offset += (unsigned long long)VirtualTilesAt(info.tilesX, level) * VirtualTilesAt(info.tilesY, level) * tileBytes;
+	}
+	header.resize((VTEX_HEADER_SIZE + info.levels * 8 + VTEX_ALIGNMENT - 1) / VTEX_ALIGNMENT * VTEX_ALIGNMENT, 0);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file.write((const char*)header.data(), header.size());
+
+	std::vector<unsigned int> tile(side * side);
+	for (unsigned int level = 0; level < info.levels; level++)
+	{
+		const Image& source = chain[std::min(level, (unsigned int)chain.size() - 1)];
+		for (unsigned int y = 0; y < VirtualTilesAt(info.tilesY, level); y++)
+		{
+			for (unsigned int x = 0; x < VirtualTilesAt(info.tilesX, level); x++)
+			{
+				CutTile(source, tileSize, border, x, y, tile.data());
+				file.write((const char*)tile.data(), tileBytes);
+			}
+		}
+	}
+	return (bool)file;
+}
+
+VirtualTextureFile::VirtualTextureFile()
+	:m_info()
+{
+}
+
+bool VirtualTextureFile::open(const std::string& path, std::string& error)
+{
+	if (!m_file.open(path))
+	{
+		error = "can't open the file";
+		return false;
+	}
+
+	const unsigned char* data = m_file.data();
+	size_t size = m_file.size();
+	if (size < VTEX_HEADER_SIZE || Read32(data) != VTEX_MAGIC || Read32(data + 4) != VTEX_VERSION)
+	{
+		error = "not a version " + std::to_string(VTEX_VERSION) + " .vtex file";
+		m_file.close();
+		return false;
+	}
+
+	VirtualTextureInfo info;
+	info.width = Read32(data + 8);
+	info.height = Read32(data + 12);
+	info.tileSize = Read32(data + 16);
+	info.border = Read32(data + 20);
+	info.levels = Read32(data + 24);
+	info.tilesX = Read32(data + 28);
+	info.tilesY = Read32(data + 32);
+
+	bool valid = info.tileSize >= 8 && info.tileSize <= MAX_TILE_SIZE && !(info.tileSize & (info.tileSize - 1)) && info.border <= info.tileSize / 2 &&
+		info.tilesX > 0 && info.tilesY > 0 && info.tilesX <= MAX_TILES && info.tilesY <= MAX_TILES &&
+		info.levels == LevelsFor(info.tilesX, info.tilesY) && VTEX_HEADER_SIZE + info.levels * 8 <= size;
+	m_info = info;
+
+	//every level's tiles have to be inside the file
+	for (unsigned int level = 0; valid && level < info.levels; level++)
+	{
+		const unsigned char* entry = data + VTEX_HEADER_SIZE + level * 8;
+		unsigned long long offset = Read32(entry) | ((unsigned long long)Read32(entry + 4) << 32);
+		unsigned long long bytes = (unsigned long long)VirtualTilesAt(info.tilesX, level) * VirtualTilesAt(info.tilesY, level) * tileBytes();
+		valid = offset <= size && bytes <= size - offset;
+		m_levelOffsets[level] = offset;
+	}
+
+	if (!valid)
+	{
+		error = "bad header or truncated tiles";
+		m_file.close();
+		return false;
+	}
+	return true;
+}
+
+const unsigned char* VirtualTextureFile::tile(unsigned int level, unsigned int x, unsigned int y) const
+{
+	size_t index = (size_t)y * VirtualTilesAt(m_info.tilesX, level) + x;
+	return m_file.data() + m_levelOffsets[level] + index * tileBytes();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include "image.h"
+#include "mapped_file.h"
+#include "mipmap.h"
+
+//Layout of a .vtex file: an image and its mip chain cut into square tiles that can be read one at a time
+//Level 0 is padded to whole tiles by repeating its edge, every level has half the tiles of the one below (rounded up)
+//and the last level is a single tile; each tile is stored as (tileSize + 2 * border)^2 RGBA8 pixels, rows bottom to top,
+//the border repeating the neighbouring tiles so a cache of tiles can be filtered bilinearly
+struct VirtualTextureInfo
+{
+	unsigned int width;    //of the source image
+	unsigned int height;
+	unsigned int tileSize; //power of two from 8 to 1024, pixels inside the border
+	unsigned int border;
+	unsigned int levels;
+	unsigned int tilesX;   //at level 0
+	unsigned int tilesY;
+};
+
+//Tiles of a level, half the level below rounded up
+inline unsigned int VirtualTilesAt(unsigned int tiles, unsigned int level)
+{
+	return ((tiles - 1) >> level) + 1;
+}
+
+//Cuts image and its mip chain into tiles and writes them to path
+bool BuildVirtualTexture(const Image& image, unsigned int tileSize, unsigned int border, const MipOptions& options, const std::string& path);
+
+//A .vtex file mapped into memory, tiles are read from disk when they are first touched
+//Only reads, so any thread may call tile() once open() has returned
+class VirtualTextureFile
+{
+private:
+	MappedFile m_file;
+	VirtualTextureInfo m_info;
+	unsigned long long m_levelOffsets[32];
+
+public:
+	VirtualTextureFile();
+
+	//Maps path and checks that every tile lies inside it
+	bool open(const std::string& path, std::string& error);
+
+	bool isOpen() const { return m_file.isOpen(); }
+	const VirtualTextureInfo& getInfo() const { return m_info; }
+
+	unsigned int tileSide() const { return m_info.tileSize + 2 * m_info.border; }
+	size_t tileBytes() const { return (size_t)tileSide() * tileSide() * 4; }
+
+	//Pixels of a tile, x and y must be below VirtualTilesAt() of the level
+	const unsigned char* tile(unsigned int level, unsigned int x, unsigned int y) const;
+};